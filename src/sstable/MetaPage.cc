@@ -88,6 +88,14 @@ bool MetaPage::isFinalized() const {
   return (flags_ & (uint64_t) FileHeaderFlags::FINALIZED) > 0;
 }
 
+bool MetaPage::isColumnar() const {
+  return (flags_ & (uint64_t) FileHeaderFlags::COLUMNAR) > 0;
+}
+
+void MetaPage::setFlag(FileHeaderFlags flag) {
+  flags_ |= (uint64_t) flag;
+}
+
 size_t MetaPage::userdataSize() const {
   return userdata_size_;
 }
@@ -12,6 +12,7 @@
 #include <stx/buffer.h>
 #include <stx/io/inputstream.h>
 #include <stx/io/outputstream.h>
+#include <sstable/binaryformat.h>
 
 namespace stx {
 namespace sstable {
@@ -42,6 +43,16 @@ public:
    */
   bool isFinalized() const;
 
+  /**
+   * Returns true iff the table body is stored in the columnar (PAX) layout
+   */
+  bool isColumnar() const;
+
+  /**
+   * Set a header flag
+   */
+  void setFlag(FileHeaderFlags flag);
+
   /**
    * Returns the number of rows in this table
    */
@@ -0,0 +1,363 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stx/util/binarymessagereader.h>
+#include <sstable/PAXBlock.h>
+#include <sstable/SSTableColumnCodec.h>
+#include <sstable/SSTableColumnKernels.h>
+
+namespace stx {
+namespace sstable {
+
+PAXBlockBuilder::PAXBlockBuilder() :
+    id_encoding_(SSTableColumnEncoding::PLAIN),
+    num_rows_(0),
+    size_(0) {}
+
+void PAXBlockBuilder::addRow(
+    void const* key,
+    size_t key_size,
+    const SSTableColumnReader& columns) {
+  if (num_rows_ >= BinaryFormat::kPAXMaxBlockRows) {
+    RAISE(kIllegalStateError, "pax block is full");
+  }
+
+  if (num_rows_ == 0) {
+    first_key_ = String((char*) key, key_size);
+    id_encoding_ = columns.schema_->columnIDEncoding();
+  }
+
+  uint32_t key_size32 = key_size;
+  keys_.append((char*) &key_size32, sizeof(key_size32));
+  keys_.append((char*) key, key_size);
+  size_ += sizeof(key_size32) + key_size;
+
+  for (const auto& col : columns.col_data_) {
+    auto col_id = std::get<0>(col);
+    auto chunk_iter = chunks_.find(col_id);
+    if (chunk_iter == chunks_.end()) {
+      ColumnChunk chunk;
+      chunk.type = columns.schema_->columnType(col_id);
+      chunk.encoding = columns.schema_->columnEncoding(col_id);
+      chunk_iter = chunks_.emplace(col_id, chunk).first;
+      size_ += sizeof(BinaryFormat::PAXChunkDescriptor) + 1;
+    }
+
+    auto& chunk = chunk_iter->second;
+    if (chunk.counts.size() < num_rows_ + 1) {
+      chunk.counts.resize(num_rows_ + 1, 0);
+    }
+
+    ++chunk.counts[num_rows_];
+    ++size_;
+
+    switch (chunk.type) {
+
+      case SSTableColumnType::UINT32:
+        chunk.values.emplace_back(std::get<1>(col));
+        size_ += sizeof(uint32_t);
+        break;
+
+      case SSTableColumnType::UINT64:
+      case SSTableColumnType::FLOAT:
+        chunk.values.emplace_back(std::get<1>(col));
+        size_ += sizeof(uint64_t);
+        break;
+
+      case SSTableColumnType::STRING: {
+        if (chunk.encoding == SSTableColumnEncoding::DICTIONARY) {
+          chunk.values.emplace_back(std::get<1>(col));
+          size_ += sizeof(uint32_t);
+          break;
+        }
+
+        uint32_t len = std::get<2>(col);
+        chunk.values.emplace_back(len);
+        chunk.string_data.append((char*) std::get<1>(col), len);
+        size_ += sizeof(len) + len;
+        break;
+      }
+
+    }
+  }
+
+  ++num_rows_;
+}
+
+size_t PAXBlockBuilder::numRows() const {
+  return num_rows_;
+}
+
+size_t PAXBlockBuilder::size() const {
+  return sizeof(BinaryFormat::PAXBlockHeader) + size_;
+}
+
+const String& PAXBlockBuilder::firstKey() const {
+  return first_key_;
+}
+
+void PAXBlockBuilder::encode(util::BinaryMessageWriter* writer) const {
+  Vector<std::unique_ptr<util::BinaryMessageWriter>> chunks;
+
+  for (const auto& c : chunks_) {
+    std::unique_ptr<util::BinaryMessageWriter> chunk_writer(
+        new util::BinaryMessageWriter());
+
+    encodeChunk(c.second, chunk_writer.get());
+    chunks.emplace_back(std::move(chunk_writer));
+  }
+
+  writer->appendUInt32(num_rows_);
+  writer->appendUInt32(chunks_.size());
+  writer->appendUInt32(keys_.size());
+  writer->appendUInt8((uint8_t) id_encoding_);
+
+  size_t i = 0;
+  for (const auto& c : chunks_) {
+    writer->appendUInt32(c.first);
+    writer->appendUInt8((uint8_t) c.second.type);
+    writer->appendUInt8((uint8_t) c.second.encoding);
+    writer->appendUInt32(chunks[i++]->size());
+  }
+
+  writer->append(keys_.data(), keys_.size());
+
+  for (const auto& chunk : chunks) {
+    writer->append(chunk->data(), chunk->size());
+  }
+}
+
+void PAXBlockBuilder::encodeChunk(
+    const ColumnChunk& chunk,
+    util::BinaryMessageWriter* writer) const {
+  bool dense = chunk.counts.size() == num_rows_;
+  for (size_t i = 0; dense && i < chunk.counts.size(); ++i) {
+    dense = chunk.counts[i] == 1;
+  }
+
+  if (dense) {
+    writer->appendUInt8((uint8_t) PAXChunkFlags::DENSE);
+  } else {
+    writer->appendUInt8(0);
+    for (size_t i = 0; i < num_rows_; ++i) {
+      auto count = i < chunk.counts.size() ? chunk.counts[i] : 0;
+      writer->appendVarUInt(count);
+    }
+  }
+
+  auto has_string_data = SSTableColumnCodec::hasStringData(
+      chunk.type,
+      chunk.encoding);
+
+  char buf[SSTableColumnCodec::kMaxEncodedSize];
+  size_t string_pos = 0;
+  uint64_t prev = 0;
+  for (const auto& value : chunk.values) {
+    size_t len;
+    switch (chunk.encoding) {
+      case SSTableColumnEncoding::DELTA:
+        len = SSTableColumnCodec::encodeVarUInt(
+            SSTableColumnCodec::encodeZigZag(int64_t(value - prev)),
+            buf);
+        break;
+      case SSTableColumnEncoding::XOR:
+        len = SSTableColumnCodec::encodeXOR(value, prev, buf);
+        break;
+      default:
+        len = SSTableColumnCodec::encodeValue(
+            chunk.type,
+            chunk.encoding,
+            value,
+            buf);
+        break;
+    }
+
+    writer->append(buf, len);
+    prev = value;
+
+    if (has_string_data) {
+      writer->append(chunk.string_data.data() + string_pos, value);
+      string_pos += value;
+    }
+  }
+}
+
+void PAXBlockBuilder::clear() {
+  num_rows_ = 0;
+  size_ = 0;
+  first_key_.clear();
+  keys_.clear();
+  chunks_.clear();
+}
+
+PAXColumnChunk::PAXColumnChunk() :
+    column_id_(0),
+    column_type_(SSTableColumnType::STRING),
+    column_encoding_(SSTableColumnEncoding::PLAIN),
+    dense_(false) {}
+
+void PAXColumnChunk::load(
+    SSTableColumnID column_id,
+    SSTableColumnType column_type,
+    SSTableColumnEncoding column_encoding,
+    size_t num_rows,
+    String&& data) {
+  column_id_ = column_id;
+  column_type_ = column_type;
+  column_encoding_ = column_encoding;
+  data_ = std::move(data);
+  counts_.clear();
+  offsets_.clear();
+  values_.clear();
+  string_offsets_.clear();
+
+  util::BinaryMessageReader reader(data_.data(), data_.size());
+  dense_ = (*reader.readUInt8() & (uint8_t) PAXChunkFlags::DENSE) > 0;
+
+  size_t num_values = 0;
+  offsets_.reserve(num_rows + 1);
+  if (dense_) {
+    counts_.resize(num_rows, 1);
+    for (size_t i = 0; i <= num_rows; ++i) {
+      offsets_.emplace_back(i);
+    }
+
+    num_values = num_rows;
+  } else {
+    counts_.reserve(num_rows);
+    for (size_t i = 0; i < num_rows; ++i) {
+      offsets_.emplace_back(num_values);
+      counts_.emplace_back(reader.readVarUInt());
+      num_values += counts_.back();
+    }
+
+    offsets_.emplace_back(num_values);
+  }
+
+  auto has_string_data = SSTableColumnCodec::hasStringData(
+      column_type_,
+      column_encoding_);
+
+  /* fast path: decode stateless numeric chunks with the batch kernels */
+  if (!has_string_data) {
+    switch (column_encoding_) {
+
+      case SSTableColumnEncoding::PLAIN:
+        values_.resize(num_values);
+        if (column_type_ == SSTableColumnType::UINT32) {
+          SSTableColumnKernels::decodeFixedUInt32(
+              reader.read(num_values * sizeof(uint32_t)),
+              num_values,
+              values_.data());
+        } else {
+          SSTableColumnKernels::decodeFixedUInt64(
+              reader.read(num_values * sizeof(uint64_t)),
+              num_values,
+              values_.data());
+        }
+        return;
+
+      case SSTableColumnEncoding::VARINT:
+      case SSTableColumnEncoding::DICTIONARY: {
+        values_.resize(num_values);
+        auto consumed = SSTableColumnKernels::decodeVarUInt(
+            data_.data() + reader.position(),
+            reader.remaining(),
+            num_values,
+            values_.data());
+        reader.read(consumed);
+        return;
+      }
+
+      default:
+        break;
+
+    }
+  }
+
+  values_.reserve(num_values);
+  if (has_string_data) {
+    string_offsets_.reserve(num_values);
+  }
+
+  uint64_t prev = 0;
+  for (size_t i = 0; i < num_values; ++i) {
+    uint64_t value;
+    switch (column_encoding_) {
+      case SSTableColumnEncoding::DELTA:
+        value = prev + (uint64_t) SSTableColumnCodec::decodeZigZag(
+            reader.readVarUInt());
+        break;
+      case SSTableColumnEncoding::XOR:
+        value = SSTableColumnCodec::decodeXOR(prev, &reader);
+        break;
+      default:
+        value = SSTableColumnCodec::decodeValue(
+            column_type_,
+            column_encoding_,
+            &reader);
+        break;
+    }
+
+    values_.emplace_back(value);
+    prev = value;
+
+    if (has_string_data) {
+      string_offsets_.emplace_back(reader.position());
+      reader.read(value);
+    }
+  }
+}
+
+SSTableColumnID PAXColumnChunk::columnID() const {
+  return column_id_;
+}
+
+SSTableColumnType PAXColumnChunk::columnType() const {
+  return column_type_;
+}
+
+SSTableColumnEncoding PAXColumnChunk::columnEncoding() const {
+  return column_encoding_;
+}
+
+size_t PAXColumnChunk::numValues(size_t row) const {
+  return counts_[row];
+}
+
+size_t PAXColumnChunk::valueIndex(size_t row) const {
+  return offsets_[row];
+}
+
+uint64_t PAXColumnChunk::getValue(size_t idx) const {
+  return values_[idx];
+}
+
+const uint64_t* PAXColumnChunk::getValues(size_t idx) const {
+  return values_.data() + idx;
+}
+
+const char* PAXColumnChunk::getStringData(size_t idx) const {
+  return data_.data() + string_offsets_[idx];
+}
+
+const char* PAXColumnChunk::getStringDataBase() const {
+  return data_.data();
+}
+
+const uint32_t* PAXColumnChunk::getStringOffsets(size_t idx) const {
+  return string_offsets_.data() + idx;
+}
+
+bool PAXColumnChunk::isDense() const {
+  return dense_;
+}
+
+}
+}
@@ -0,0 +1,158 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <stx/buffer.h>
+#include <stx/util/binarymessagewriter.h>
+#include <sstable/binaryformat.h>
+#include <sstable/SSTableColumnSchema.h>
+#include <sstable/SSTableColumnReader.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * Collects rows and encodes them into a columnar (PAX) block. See
+ * binaryformat.h for the block layout
+ */
+class PAXBlockBuilder {
+public:
+
+  PAXBlockBuilder();
+
+  /**
+   * Add a row to the block
+   */
+  void addRow(
+      void const* key,
+      size_t key_size,
+      const SSTableColumnReader& columns);
+
+  /**
+   * Returns the number of rows in the block
+   */
+  size_t numRows() const;
+
+  /**
+   * Returns the (approximate) encoded size of the block in bytes
+   */
+  size_t size() const;
+
+  /**
+   * Returns the first key in the block
+   */
+  const String& firstKey() const;
+
+  /**
+   * Encode the block and append it to the provided writer
+   */
+  void encode(util::BinaryMessageWriter* writer) const;
+
+  /**
+   * Remove all rows from the block
+   */
+  void clear();
+
+protected:
+  struct ColumnChunk {
+    SSTableColumnType type;
+    SSTableColumnEncoding encoding;
+    Vector<uint32_t> counts;
+    Vector<uint64_t> values;
+    String string_data;
+  };
+
+  void encodeChunk(
+      const ColumnChunk& chunk,
+      util::BinaryMessageWriter* writer) const;
+
+  SSTableColumnEncoding id_encoding_;
+  size_t num_rows_;
+  size_t size_;
+  String first_key_;
+  String keys_;
+  OrderedMap<SSTableColumnID, ColumnChunk> chunks_;
+};
+
+/**
+ * A decoded column chunk of a columnar (PAX) block
+ */
+class PAXColumnChunk {
+public:
+
+  PAXColumnChunk();
+
+  /**
+   * Load and decode the chunk from its encoded representation
+   */
+  void load(
+      SSTableColumnID column_id,
+      SSTableColumnType column_type,
+      SSTableColumnEncoding column_encoding,
+      size_t num_rows,
+      String&& data);
+
+  SSTableColumnID columnID() const;
+  SSTableColumnType columnType() const;
+  SSTableColumnEncoding columnEncoding() const;
+
+  /**
+   * Returns the number of values stored for the row with the provided index
+   */
+  size_t numValues(size_t row) const;
+
+  /**
+   * Returns the index of the first value of the row with the provided index
+   */
+  size_t valueIndex(size_t row) const;
+
+  /**
+   * Returns the value with the provided index. Float values are returned as
+   * their IEEE754 bits, string values as their length and dictionary encoded
+   * values as their dictionary code
+   */
+  uint64_t getValue(size_t idx) const;
+
+  /**
+   * Returns a pointer to the values starting at the provided index
+   */
+  const uint64_t* getValues(size_t idx) const;
+
+  /**
+   * Returns the string value with the provided index
+   */
+  const char* getStringData(size_t idx) const;
+
+  /**
+   * Returns the string data offsets (relative to getStringDataBase) of the
+   * values starting at the provided index
+   */
+  const char* getStringDataBase() const;
+  const uint32_t* getStringOffsets(size_t idx) const;
+
+  /**
+   * Returns true iff the chunk stores exactly one value per row
+   */
+  bool isDense() const;
+
+protected:
+  SSTableColumnID column_id_;
+  SSTableColumnType column_type_;
+  SSTableColumnEncoding column_encoding_;
+  String data_;
+  bool dense_;
+  Vector<uint32_t> counts_;
+  Vector<uint32_t> offsets_;
+  Vector<uint64_t> values_;
+  Vector<uint32_t> string_offsets_;
+};
+
+}
+}
@@ -0,0 +1,382 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <stx/exception.h>
+#include <sstable/PAXCursor.h>
+#include <sstable/SSTableColumnCodec.h>
+#include <sstable/SSTableColumnKernels.h>
+
+namespace stx {
+namespace sstable {
+
+PAXCursor::PAXCursor(
+    RefPtr<RewindableInputStream> is,
+    size_t begin,
+    size_t limit) :
+    is_(is),
+    begin_(begin),
+    limit_(limit),
+    valid_(false),
+    block_pos_(0),
+    block_size_(0),
+    id_encoding_(SSTableColumnEncoding::PLAIN),
+    num_rows_(0),
+    row_(0),
+    has_projection_(false),
+    have_row_data_(false) {
+  seekTo(0);
+}
+
+void PAXCursor::setColumnProjection(const Set<SSTableColumnID>& column_ids) {
+  has_projection_ = true;
+  projection_ = column_ids;
+
+  if (valid_) {
+    auto row = row_;
+    loadBlock(block_pos_);
+    row_ = row;
+  }
+}
+
+void PAXCursor::setBlockFilter(Function<bool (size_t block_offset)> filter) {
+  block_filter_ = filter;
+
+  if (valid_ && block_filter_ && !block_filter_(block_pos_)) {
+    loadBlock(block_pos_ + block_size_);
+  }
+}
+
+bool PAXCursor::loadBlock(size_t block_offset) {
+  BinaryFormat::RowHeader hdr;
+  BinaryFormat::PAXBlockHeader block_hdr;
+
+  valid_ = false;
+  have_row_data_ = false;
+  block_pos_ = block_offset;
+  block_size_ = 0;
+  num_rows_ = 0;
+  row_ = 0;
+  keys_.clear();
+  key_offsets_.clear();
+  chunks_.clear();
+
+  for (;;) {
+    if (begin_ + block_offset + sizeof(hdr) >= limit_) {
+      return false;
+    }
+
+    is_->seekTo(begin_ + block_offset);
+    is_->readNextBytes(&hdr, sizeof(hdr));
+
+    if (!block_filter_ || block_filter_(block_offset)) {
+      break;
+    }
+
+    block_offset += sizeof(hdr) + hdr.key_size + hdr.data_size;
+    block_pos_ = block_offset;
+  }
+
+  is_->skipNextBytes(hdr.key_size);
+  is_->readNextBytes(&block_hdr, sizeof(block_hdr));
+
+  Vector<BinaryFormat::PAXChunkDescriptor> chunk_descs(block_hdr.num_chunks);
+  if (block_hdr.num_chunks > 0) {
+    is_->readNextBytes(
+        chunk_descs.data(),
+        block_hdr.num_chunks * sizeof(BinaryFormat::PAXChunkDescriptor));
+  }
+
+  keys_.resize(block_hdr.key_chunk_size);
+  is_->readNextBytes(&keys_[0], keys_.size());
+
+  key_offsets_.reserve(block_hdr.num_rows);
+  for (size_t pos = 0; key_offsets_.size() < block_hdr.num_rows; ) {
+    if (pos + sizeof(uint32_t) > keys_.size()) {
+      RAISE(kIllegalStateError, "corrupt pax block: key chunk too short");
+    }
+
+    uint32_t key_size;
+    memcpy(&key_size, keys_.data() + pos, sizeof(key_size));
+    key_offsets_.emplace_back(pos);
+    pos += sizeof(key_size) + key_size;
+  }
+
+  size_t chunk_pos =
+      begin_ +
+      block_offset +
+      sizeof(hdr) +
+      hdr.key_size +
+      sizeof(block_hdr) +
+      block_hdr.num_chunks * sizeof(BinaryFormat::PAXChunkDescriptor) +
+      block_hdr.key_chunk_size;
+
+  bool seek = false;
+  for (const auto& desc : chunk_descs) {
+    if (has_projection_ && projection_.count(desc.column_id) == 0) {
+      chunk_pos += desc.chunk_size;
+      seek = true;
+      continue;
+    }
+
+    if (seek) {
+      is_->seekTo(chunk_pos);
+      seek = false;
+    }
+
+    String chunk_data(desc.chunk_size, 0);
+    is_->readNextBytes(&chunk_data[0], chunk_data.size());
+    chunk_pos += desc.chunk_size;
+
+    chunks_.emplace_back();
+    chunks_.back().load(
+        desc.column_id,
+        (SSTableColumnType) desc.column_type,
+        (SSTableColumnEncoding) desc.column_encoding,
+        block_hdr.num_rows,
+        std::move(chunk_data));
+  }
+
+  block_size_ = sizeof(hdr) + hdr.key_size + hdr.data_size;
+  id_encoding_ = (SSTableColumnEncoding) block_hdr.column_id_encoding;
+  num_rows_ = block_hdr.num_rows;
+  valid_ = num_rows_ > 0;
+  return valid_;
+}
+
+void PAXCursor::seekTo(size_t body_offset) {
+  auto block_offset = body_offset >> BinaryFormat::kPAXRowIndexBits;
+  auto row = body_offset & BinaryFormat::kPAXMaxBlockRows;
+
+  if (!valid_ || block_offset != block_pos_) {
+    loadBlock(block_offset);
+  }
+
+  /* the block was skipped by the block filter */
+  if (!valid_ || block_pos_ != block_offset) {
+    return;
+  }
+
+  if (row < num_rows_) {
+    row_ = row;
+    have_row_data_ = false;
+  } else {
+    loadBlock(block_pos_ + block_size_);
+  }
+}
+
+bool PAXCursor::trySeekTo(size_t body_offset) {
+  auto block_offset = body_offset >> BinaryFormat::kPAXRowIndexBits;
+
+  if (begin_ + block_offset < limit_) {
+    seekTo(body_offset);
+    return true;
+  } else {
+    return false;
+  }
+}
+
+size_t PAXCursor::position() const {
+  return (block_pos_ << BinaryFormat::kPAXRowIndexBits) | row_;
+}
+
+size_t PAXCursor::nextPosition() {
+  if (!valid_) {
+    RAISE(kIllegalStateError, "invalid cursor");
+  }
+
+  if (row_ + 1 < num_rows_) {
+    return position() + 1;
+  } else {
+    return (block_pos_ + block_size_) << BinaryFormat::kPAXRowIndexBits;
+  }
+}
+
+bool PAXCursor::next() {
+  if (!valid_) {
+    return false;
+  }
+
+  have_row_data_ = false;
+  if (++row_ < num_rows_) {
+    return true;
+  }
+
+  return loadBlock(block_pos_ + block_size_);
+}
+
+size_t PAXCursor::remainingBlockRows() const {
+  return valid_ ? num_rows_ - row_ : 0;
+}
+
+bool PAXCursor::skipRows(size_t n) {
+  have_row_data_ = false;
+
+  while (valid_ && row_ + n >= num_rows_) {
+    n -= num_rows_ - row_;
+    loadBlock(block_pos_ + block_size_);
+  }
+
+  row_ += n;
+  return valid_;
+}
+
+void PAXCursor::readUInt32Column(
+    SSTableColumnID id,
+    size_t n,
+    uint32_t* dst) {
+  const auto& chunk = getColumnChunk(id, n, SSTableColumnType::UINT32);
+  SSTableColumnKernels::narrowUInt32(
+      chunk.getValues(chunk.valueIndex(row_)),
+      n,
+      dst);
+}
+
+void PAXCursor::readUInt64Column(
+    SSTableColumnID id,
+    size_t n,
+    uint64_t* dst) {
+  const auto& chunk = getColumnChunk(id, n, SSTableColumnType::UINT64);
+  memcpy(dst, chunk.getValues(chunk.valueIndex(row_)), n * sizeof(uint64_t));
+}
+
+void PAXCursor::readFloatColumn(
+    SSTableColumnID id,
+    size_t n,
+    double* dst) {
+  const auto& chunk = getColumnChunk(id, n, SSTableColumnType::FLOAT);
+  SSTableColumnKernels::bitsToDouble(
+      chunk.getValues(chunk.valueIndex(row_)),
+      n,
+      dst);
+}
+
+const char* PAXCursor::readStringColumn(
+    SSTableColumnID id,
+    size_t n,
+    uint32_t* offsets,
+    uint32_t* lengths) {
+  const auto& chunk = getColumnChunk(id, n, SSTableColumnType::STRING);
+  if (chunk.columnEncoding() == SSTableColumnEncoding::DICTIONARY) {
+    RAISEF(
+        kIllegalArgumentError,
+        "column is dictionary encoded, use readUInt32Column: $0",
+        id);
+  }
+
+  auto idx = chunk.valueIndex(row_);
+  SSTableColumnKernels::narrowUInt32(chunk.getValues(idx), n, lengths);
+  memcpy(offsets, chunk.getStringOffsets(idx), n * sizeof(uint32_t));
+  return chunk.getStringDataBase();
+}
+
+const PAXColumnChunk& PAXCursor::getColumnChunk(
+    SSTableColumnID id,
+    size_t n,
+    SSTableColumnType type) const {
+  if (!valid_) {
+    RAISE(kIllegalStateError, "invalid cursor");
+  }
+
+  if (n > num_rows_ - row_) {
+    RAISE(kIndexError, "batch exceeds the current block");
+  }
+
+  for (const auto& chunk : chunks_) {
+    if (chunk.columnID() != id) {
+      continue;
+    }
+
+    auto is_code =
+        type == SSTableColumnType::UINT32 &&
+        chunk.columnEncoding() == SSTableColumnEncoding::DICTIONARY;
+
+    if (chunk.columnType() != type && !is_code) {
+      RAISEF(
+          kIllegalArgumentError,
+          "invalid column type for column_id: $0",
+          id);
+    }
+
+    if (!chunk.isDense()) {
+      RAISEF(kIllegalStateError, "column is not dense in this block: $0", id);
+    }
+
+    return chunk;
+  }
+
+  RAISEF(kIndexError, "no values for column in this block: $0", id);
+}
+
+bool PAXCursor::valid() {
+  return valid_;
+}
+
+void PAXCursor::getKey(void** data, size_t* size) {
+  if (!valid_) {
+    RAISE(kIllegalStateError, "invalid cursor");
+  }
+
+  auto key_offset = key_offsets_[row_];
+  uint32_t key_size;
+  memcpy(&key_size, keys_.data() + key_offset, sizeof(key_size));
+
+  *data = (void*) (keys_.data() + key_offset + sizeof(key_size));
+  *size = key_size;
+}
+
+void PAXCursor::getData(void** data, size_t* size) {
+  if (!valid_) {
+    RAISE(kIllegalStateError, "invalid cursor");
+  }
+
+  if (!have_row_data_) {
+    row_data_.clear();
+
+    char buf[SSTableColumnCodec::kMaxEncodedSize];
+    for (const auto& chunk : chunks_) {
+      auto type = chunk.columnType();
+      auto encoding = SSTableColumnCodec::rowEncoding(chunk.columnEncoding());
+      auto has_string_data = SSTableColumnCodec::hasStringData(type, encoding);
+      auto id_len = SSTableColumnCodec::encodeValue(
+          SSTableColumnType::UINT32,
+          id_encoding_,
+          chunk.columnID(),
+          buf);
+
+      auto idx = chunk.valueIndex(row_);
+      auto idx_end = idx + chunk.numValues(row_);
+      for (; idx < idx_end; ++idx) {
+        auto value = chunk.getValue(idx);
+        row_data_.append(buf, id_len);
+
+        char value_buf[SSTableColumnCodec::kMaxEncodedSize];
+        auto value_len = SSTableColumnCodec::encodeValue(
+            type,
+            encoding,
+            value,
+            value_buf);
+
+        row_data_.append(value_buf, value_len);
+
+        if (has_string_data) {
+          row_data_.append(chunk.getStringData(idx), value);
+        }
+      }
+    }
+
+    have_row_data_ = true;
+  }
+
+  *data = (void*) row_data_.data();
+  *size = row_data_.size();
+}
+
+}
+}
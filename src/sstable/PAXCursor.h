@@ -0,0 +1,134 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <stx/io/inputstream.h>
+#include <sstable/cursor.h>
+#include <sstable/binaryformat.h>
+#include <sstable/SSTableColumnSchema.h>
+#include <sstable/PAXBlock.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * A row cursor over an sstable body stored in the columnar (PAX) layout.
+ *
+ * getData() returns the row in the same format that SSTableColumnWriter
+ * produces, so SSTableColumnReader can be used on columnar and row-oriented
+ * tables alike. If a column projection is set, only the chunks of the
+ * projected columns are read from disk and included in the row data.
+ *
+ * Positions are (block offset, row index) pairs, see
+ * BinaryFormat::kPAXRowIndexBits
+ *
+ * The batch API (read*Column) decodes a column for a run of consecutive rows
+ * in the current block into caller provided arrays:
+ *
+ *   while (cursor.valid()) {
+ *     auto n = cursor.remainingBlockRows();
+ *     cursor.readUInt64Column(id, n, values);
+ *     ...
+ *     cursor.skipRows(n);
+ *   }
+ */
+class PAXCursor : public sstable::Cursor {
+public:
+
+  PAXCursor(
+      RefPtr<RewindableInputStream> is,
+      size_t begin,
+      size_t limit);
+
+  /**
+   * Only read the provided columns. Must be called before the cursor is
+   * advanced
+   */
+  void setColumnProjection(const Set<SSTableColumnID>& column_ids);
+
+  /**
+   * Skip all blocks for which filter(block_offset) returns false. Only the
+   * row header of a skipped block is read. Seeking into a skipped block moves
+   * the cursor to the first row of the next block that is not skipped. An
+   * empty filter reads all blocks
+   */
+  void setBlockFilter(Function<bool (size_t block_offset)> filter);
+
+  void seekTo(size_t body_offset) override;
+  bool trySeekTo(size_t body_offset) override;
+  bool next() override;
+  bool valid() override;
+  void getKey(void** data, size_t* size) override;
+  void getData(void** data, size_t* size) override;
+  size_t position() const override;
+  size_t nextPosition() override;
+
+  /**
+   * Returns the number of rows from the current row to the end of the
+   * current block
+   */
+  size_t remainingBlockRows() const;
+
+  /**
+   * Advance the cursor by n rows. Returns false if the cursor is no longer
+   * valid
+   */
+  bool skipRows(size_t n);
+
+  /**
+   * Decode the values of a column for the n rows starting at the current row
+   * into dst. n must not be larger than remainingBlockRows() and the column
+   * must store exactly one value per row in the current block.
+   * readUInt32Column also returns the codes of DICTIONARY encoded columns
+   */
+  void readUInt32Column(SSTableColumnID id, size_t n, uint32_t* dst);
+  void readUInt64Column(SSTableColumnID id, size_t n, uint64_t* dst);
+  void readFloatColumn(SSTableColumnID id, size_t n, double* dst);
+
+  /**
+   * Returns a base pointer and stores the offset (relative to the base
+   * pointer) and length of the string values of a column for the n rows
+   * starting at the current row. The pointer is valid until the cursor leaves
+   * the current block
+   */
+  const char* readStringColumn(
+      SSTableColumnID id,
+      size_t n,
+      uint32_t* offsets,
+      uint32_t* lengths);
+
+protected:
+  bool loadBlock(size_t block_offset);
+  const PAXColumnChunk& getColumnChunk(
+      SSTableColumnID id,
+      size_t n,
+      SSTableColumnType type) const;
+
+  RefPtr<RewindableInputStream> is_;
+  size_t begin_;
+  size_t limit_;
+  bool valid_;
+  size_t block_pos_;
+  size_t block_size_;
+  SSTableColumnEncoding id_encoding_;
+  size_t num_rows_;
+  size_t row_;
+  String keys_;
+  Vector<uint32_t> key_offsets_;
+  Vector<PAXColumnChunk> chunks_;
+  bool has_projection_;
+  Set<SSTableColumnID> projection_;
+  Function<bool (size_t block_offset)> block_filter_;
+  String row_data_;
+  bool have_row_data_;
+};
+
+}
+}
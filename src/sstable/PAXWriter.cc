@@ -0,0 +1,139 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stx/logging.h>
+#include <stx/util/binarymessagewriter.h>
+#include <sstable/PAXWriter.h>
+#include <sstable/SSTableColumnReader.h>
+
+namespace stx {
+namespace sstable {
+
+PAXWriter::PAXWriter(
+    SSTableWriter* sstable_writer,
+    SSTableColumnSchema* schema,
+    size_t max_block_size /* = kDefaultMaxBlockSize */,
+    size_t max_block_rows /* = BinaryFormat::kPAXMaxBlockRows */) :
+    sstable_writer_(sstable_writer),
+    schema_(schema),
+    max_block_size_(max_block_size),
+    max_block_rows_(max_block_rows),
+    zone_map_(nullptr),
+    key_index_(nullptr),
+    bloom_filter_(nullptr) {
+  if (max_block_rows_ == 0 ||
+      max_block_rows_ > BinaryFormat::kPAXMaxBlockRows) {
+    RAISEF(kIllegalArgumentError, "invalid max block rows: $0", max_block_rows);
+  }
+
+  sstable_writer_->setColumnarLayout();
+}
+
+/**
+ * The sstable writer may already be committed or destroyed, so the
+ * destructor must not write the last block
+ */
+PAXWriter::~PAXWriter() {
+  if (block_.numRows() > 0) {
+    logError(
+        "fnord.sstable",
+        "PAXWriter destroyed with $0 unflushed rows; call flush() before "
+        "commit()",
+        block_.numRows());
+  }
+}
+
+void PAXWriter::appendRow(
+    const std::string& key,
+    const SSTableColumnWriter& columns) {
+  appendRow(key.data(), key.size(), columns);
+}
+
+void PAXWriter::appendRow(
+    void const* key,
+    size_t key_size,
+    const SSTableColumnWriter& columns) {
+  SSTableColumnReader reader(
+      schema_,
+      Buffer(columns.data(), columns.size()));
+
+  block_.addRow(key, key_size, reader);
+  if (zone_map_) {
+    zone_map_->addRow(key, key_size, reader);
+  }
+
+  if (key_index_) {
+    key_index_->addRow(key, key_size);
+  }
+
+  if (bloom_filter_) {
+    bloom_filter_->addKey(key, key_size);
+  }
+
+  if (block_.numRows() >= max_block_rows_ ||
+      block_.size() >= max_block_size_) {
+    flush();
+  }
+}
+
+void PAXWriter::flush() {
+  if (block_.numRows() == 0) {
+    return;
+  }
+
+  util::BinaryMessageWriter data;
+  block_.encode(&data);
+
+  const auto& first_key = block_.firstKey();
+  auto block_offset = sstable_writer_->appendBlock(
+      first_key.data(),
+      first_key.size(),
+      data.data(),
+      data.size(),
+      block_.numRows());
+
+  if (zone_map_) {
+    zone_map_->finishZone(block_offset << BinaryFormat::kPAXRowIndexBits);
+  }
+
+  if (key_index_) {
+    key_index_->finishBlock(block_offset << BinaryFormat::kPAXRowIndexBits);
+  }
+
+  block_.clear();
+}
+
+void PAXWriter::setZoneMap(SSTableZoneMap* zone_map) {
+  if (block_.numRows() > 0) {
+    RAISE(kIllegalStateError, "can't set zone map after rows were appended");
+  }
+
+  zone_map_ = zone_map;
+}
+
+void PAXWriter::setKeyIndex(SSTableKeyIndex* key_index) {
+  if (block_.numRows() > 0) {
+    RAISE(kIllegalStateError, "can't set key index after rows were appended");
+  }
+
+  key_index_ = key_index;
+}
+
+void PAXWriter::setBloomFilter(SSTableBloomFilter* bloom_filter) {
+  if (block_.numRows() > 0) {
+    RAISE(
+        kIllegalStateError,
+        "can't set bloom filter after rows were appended");
+  }
+
+  bloom_filter_ = bloom_filter;
+}
+
+}
+}
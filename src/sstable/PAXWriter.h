@@ -0,0 +1,92 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <sstable/SSTableWriter.h>
+#include <sstable/SSTableColumnSchema.h>
+#include <sstable/SSTableColumnWriter.h>
+#include <sstable/PAXBlock.h>
+#include <sstable/SSTableZoneMap.h>
+#include <sstable/SSTableKeyIndex.h>
+#include <sstable/SSTableBloomFilter.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * Writes schema rows to an sstable using the columnar (PAX) body layout. Rows
+ * are buffered and written out in blocks that store the values of each column
+ * in a contiguous chunk. The last block is written on flush(), which must
+ * be called before any footers are written and before the table is
+ * committed; the destructor does not write it, rows that were not flushed
+ * are lost.
+ */
+class PAXWriter {
+public:
+  static const size_t kDefaultMaxBlockSize = 64 * 1024;
+
+  PAXWriter(
+      SSTableWriter* sstable_writer,
+      SSTableColumnSchema* schema,
+      size_t max_block_size = kDefaultMaxBlockSize,
+      size_t max_block_rows = BinaryFormat::kPAXMaxBlockRows);
+
+  PAXWriter(const PAXWriter& other) = delete;
+  PAXWriter& operator=(const PAXWriter& other) = delete;
+  ~PAXWriter();
+
+  /**
+   * Append a row to the sstable
+   */
+  void appendRow(
+      void const* key,
+      size_t key_size,
+      const SSTableColumnWriter& columns);
+
+  /**
+   * Append a row to the sstable
+   */
+  void appendRow(
+      const std::string& key,
+      const SSTableColumnWriter& columns);
+
+  /**
+   * Write the current block to the sstable
+   */
+  void flush();
+
+  /**
+   * Record one zone per written block in the provided zone map
+   */
+  void setZoneMap(SSTableZoneMap* zone_map);
+
+  /**
+   * Record one key index entry per written block in the provided key index
+   */
+  void setKeyIndex(SSTableKeyIndex* key_index);
+
+  /**
+   * Add the keys of all written rows to the provided bloom filter
+   */
+  void setBloomFilter(SSTableBloomFilter* bloom_filter);
+
+protected:
+  SSTableWriter* sstable_writer_;
+  SSTableColumnSchema* schema_;
+  size_t max_block_size_;
+  size_t max_block_rows_;
+  PAXBlockBuilder block_;
+  SSTableZoneMap* zone_map_;
+  SSTableKeyIndex* key_index_;
+  SSTableBloomFilter* bloom_filter_;
+};
+
+}
+}
@@ -0,0 +1,628 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <stx/exception.h>
+#include <stx/ieee754.h>
+#include <stx/stringutil.h>
+#include <sstable/SSTableAggregator.h>
+#include <sstable/SSTableColumnCodec.h>
+
+namespace stx {
+namespace sstable {
+
+SSTableAggregator::SSTableAggregator(
+    const SSTableColumnSchema* schema) :
+    schema_(schema) {}
+
+void SSTableAggregator::addGroupBy(const String& column) {
+  if (groups_.size() > 0) {
+    RAISE(kIllegalStateError, "can't add group by columns after rows");
+  }
+
+  group_by_.emplace_back(column == "_key" ? 0 : schema_->columnID(column));
+  group_by_names_.emplace_back(column);
+}
+
+void SSTableAggregator::addAggregate(
+    Fn fn,
+    const String& column,
+    double quantile) {
+  if (groups_.size() > 0) {
+    RAISE(kIllegalStateError, "can't add aggregates after rows");
+  }
+
+  Aggregate aggregate;
+  aggregate.fn = fn;
+  aggregate.column = column;
+  aggregate.all_rows = false;
+  aggregate.id = 0;
+  aggregate.type = SSTableColumnType::STRING;
+  aggregate.dictionary = false;
+  aggregate.quantile = quantile;
+
+  if (column == "*" || column == "_key") {
+    if (fn != Fn::COUNT) {
+      RAISEF(kIllegalArgumentError, "only COUNT is supported on $0", column);
+    }
+
+    aggregate.all_rows = true;
+  } else {
+    aggregate.id = schema_->columnID(column);
+    aggregate.type = schema_->columnType(aggregate.id);
+    aggregate.dictionary =
+        schema_->columnEncoding(aggregate.id) ==
+        SSTableColumnEncoding::DICTIONARY;
+
+    if ((fn == Fn::SUM || fn == Fn::AVG || fn == Fn::QUANTILE) &&
+        aggregate.type == SSTableColumnType::STRING) {
+      RAISEF(
+          kIllegalArgumentError,
+          "SUM/AVG/QUANTILE require a numeric column: $0",
+          column);
+    }
+  }
+
+  if (fn == Fn::QUANTILE && !(quantile >= 0 && quantile <= 1)) {
+    RAISEF(kIllegalArgumentError, "quantile must be in [0, 1]: $0", quantile);
+  }
+
+  aggregates_.emplace_back(aggregate);
+}
+
+void SSTableAggregator::addAggregate(const String& expr) {
+  auto begin = expr.find('(');
+  auto end = expr.rfind(')');
+  if (begin == String::npos || end == String::npos || end < begin) {
+    RAISEF(kParseError, "invalid aggregate: $0, expected fn(column)", expr);
+  }
+
+  auto trim = [] (String str) -> String {
+    auto b = str.find_first_not_of(" \t");
+    auto e = str.find_last_not_of(" \t");
+    return b == String::npos ? "" : str.substr(b, e - b + 1);
+  };
+
+  auto fn = fnFromString(trim(expr.substr(0, begin)));
+  auto args = expr.substr(begin + 1, end - begin - 1);
+
+  /* quantile(column, q) */
+  if (fn == Fn::QUANTILE) {
+    auto comma = args.find(',');
+    if (comma == String::npos) {
+      RAISEF(
+          kParseError,
+          "invalid aggregate: $0, expected fn(column, q)",
+          expr);
+    }
+
+    auto q = trim(args.substr(comma + 1));
+    char* q_end;
+    auto quantile = strtod(q.c_str(), &q_end);
+    if (q.empty() || *q_end != 0) {
+      RAISEF(kParseError, "invalid quantile: $0", q);
+    }
+
+    addAggregate(fn, trim(args.substr(0, comma)), quantile);
+    return;
+  }
+
+  addAggregate(fn, trim(args));
+}
+
+SSTableAggregator::Fn SSTableAggregator::fnFromString(const String& fn) {
+  auto fn_upper = fn;
+  StringUtil::toUpper(&fn_upper);
+
+  if (fn_upper == "COUNT") return Fn::COUNT;
+  if (fn_upper == "SUM") return Fn::SUM;
+  if (fn_upper == "MIN") return Fn::MIN;
+  if (fn_upper == "MAX") return Fn::MAX;
+  if (fn_upper == "AVG") return Fn::AVG;
+  if (fn_upper == "COUNT_DISTINCT") return Fn::COUNT_DISTINCT;
+  if (fn_upper == "QUANTILE") return Fn::QUANTILE;
+
+  RAISEF(
+      kIllegalArgumentError,
+      "invalid aggregate fn: $0, valid arguments: COUNT, SUM, MIN, MAX, AVG, "
+      "COUNT_DISTINCT, QUANTILE",
+      fn);
+}
+
+/**
+ * The group key is the concatenation of the group by values; each value is
+ * stored as a presence byte followed by the 8 byte numeric value or the 4
+ * byte length and the string. Dictionary codes are specific to a table, so
+ * dictionary encoded values are stored as strings to make the groups of
+ * different tables mergeable
+ */
+void SSTableAggregator::addRow(
+    const void* key,
+    size_t key_size,
+    const SSTableColumnReader& row) {
+  group_key_.clear();
+  group_values_.assign(group_by_.size(), nullptr);
+
+  for (size_t i = 0; i < group_by_.size(); ++i) {
+    auto id = group_by_[i];
+
+    const char* data = nullptr;
+    uint32_t size = 0;
+    if (id == 0) {
+      data = (const char*) key;
+      size = key_size;
+    } else {
+      for (const auto& col : row.col_data_) {
+        if (std::get<0>(col) == id) {
+          group_values_[i] = &col;
+          break;
+        }
+      }
+
+      if (group_values_[i] == nullptr) {
+        group_key_ += '\0';
+        continue;
+      }
+
+      auto encoding = schema_->columnEncoding(id);
+      auto has_string_data = SSTableColumnCodec::hasStringData(
+          schema_->columnType(id),
+          encoding);
+
+      if (encoding == SSTableColumnEncoding::DICTIONARY) {
+        const auto& str =
+            schema_->dictionaryValue(id, std::get<1>(*group_values_[i]));
+        data = str.data();
+        size = str.size();
+      } else if (has_string_data) {
+        data = (const char*) std::get<1>(*group_values_[i]);
+        size = std::get<2>(*group_values_[i]);
+      } else {
+        auto v = std::get<1>(*group_values_[i]);
+        group_key_ += '\1';
+        group_key_.append((const char*) &v, sizeof(v));
+        continue;
+      }
+    }
+
+    group_key_ += '\1';
+    group_key_.append((const char*) &size, sizeof(size));
+    group_key_.append(data, size);
+  }
+
+  auto iter = group_index_.find(group_key_);
+  if (iter == group_index_.end()) {
+    Group group;
+    group.key = group_key_;
+
+    for (size_t i = 0; i < group_by_.size(); ++i) {
+      if (group_by_[i] == 0) {
+        group.values.emplace_back((const char*) key, key_size);
+      } else if (group_values_[i] == nullptr) {
+        group.values.emplace_back();
+      } else {
+        switch (schema_->columnType(group_by_[i])) {
+          case SSTableColumnType::UINT32:
+          case SSTableColumnType::UINT64:
+            group.values.emplace_back(
+                StringUtil::toString(std::get<1>(*group_values_[i])));
+            break;
+
+          case SSTableColumnType::FLOAT:
+            group.values.emplace_back(
+                StringUtil::toString(
+                    IEEE754::fromBytes(std::get<1>(*group_values_[i]))));
+            break;
+
+          case SSTableColumnType::STRING:
+            group.values.emplace_back(
+                row.getStringValue(*group_values_[i]));
+            break;
+        }
+      }
+    }
+
+    AggregateState state;
+    state.count = 0;
+    state.uint_value = 0;
+    state.float_value = 0;
+    group.aggregates.resize(aggregates_.size(), state);
+
+    groups_.emplace_back(std::move(group));
+    iter = group_index_.emplace(group_key_, groups_.size() - 1).first;
+  }
+
+  auto& group = groups_[iter->second];
+  for (size_t i = 0; i < aggregates_.size(); ++i) {
+    const auto& aggregate = aggregates_[i];
+    if (aggregate.all_rows) {
+      ++group.aggregates[i].count;
+      continue;
+    }
+
+    for (const auto& col : row.col_data_) {
+      if (std::get<0>(col) == aggregate.id) {
+        updateAggregate(aggregate, &group.aggregates[i], col, row);
+      }
+    }
+  }
+}
+
+void SSTableAggregator::updateAggregate(
+    const Aggregate& aggregate,
+    AggregateState* state,
+    const std::tuple<SSTableColumnID, uint64_t, uint32_t>& value,
+    const SSTableColumnReader& row) const {
+  auto first = state->count++ == 0;
+
+  switch (aggregate.fn) {
+
+    case Fn::COUNT:
+      return;
+
+    case Fn::SUM:
+    case Fn::AVG:
+      if (aggregate.type == SSTableColumnType::FLOAT) {
+        state->float_value += IEEE754::fromBytes(std::get<1>(value));
+      } else {
+        state->uint_value += std::get<1>(value);
+        state->float_value += std::get<1>(value);
+      }
+      return;
+
+    /* dictionary codes are specific to a table, so the strings are hashed
+       to make sketches of different tables mergeable */
+    case Fn::COUNT_DISTINCT:
+      if (aggregate.type != SSTableColumnType::STRING) {
+        state->distinct.add(SSTableHyperLogLog::hash(std::get<1>(value)));
+      } else if (aggregate.dictionary) {
+        const auto& str =
+            schema_->dictionaryValue(aggregate.id, std::get<1>(value));
+        state->distinct.add(SSTableHyperLogLog::hash(str.data(), str.size()));
+      } else {
+        state->distinct.add(
+            SSTableHyperLogLog::hash(
+                (const void*) std::get<1>(value),
+                std::get<2>(value)));
+      }
+      return;
+
+    case Fn::QUANTILE:
+      if (aggregate.type == SSTableColumnType::FLOAT) {
+        state->quantiles.add(IEEE754::fromBytes(std::get<1>(value)));
+      } else {
+        state->quantiles.add(std::get<1>(value));
+      }
+      return;
+
+    case Fn::MIN:
+    case Fn::MAX:
+      break;
+
+  }
+
+  auto is_min = aggregate.fn == Fn::MIN;
+  switch (aggregate.type) {
+
+    case SSTableColumnType::UINT32:
+    case SSTableColumnType::UINT64: {
+      auto v = std::get<1>(value);
+      if (first || (is_min ? v < state->uint_value : v > state->uint_value)) {
+        state->uint_value = v;
+      }
+      break;
+    }
+
+    case SSTableColumnType::FLOAT: {
+      auto v = IEEE754::fromBytes(std::get<1>(value));
+      if (first ||
+          (is_min ? v < state->float_value : v > state->float_value)) {
+        state->float_value = v;
+      }
+      break;
+    }
+
+    case SSTableColumnType::STRING: {
+      auto v = row.getStringValue(value);
+      if (first ||
+          (is_min ? v < state->string_value : v > state->string_value)) {
+        state->string_value = std::move(v);
+      }
+      break;
+    }
+
+  }
+}
+
+/**
+ * The aggregators may belong to tables with different column ids, so the
+ * group by and aggregate columns are compared by name and type
+ */
+void SSTableAggregator::merge(const SSTableAggregator& other) {
+  if (other.group_by_names_ != group_by_names_ ||
+      other.columnTypes() != columnTypes() ||
+      other.aggregates_.size() != aggregates_.size()) {
+    RAISE(kIllegalArgumentError, "can't merge different aggregations");
+  }
+
+  for (size_t i = 0; i < aggregates_.size(); ++i) {
+    if (other.aggregates_[i].fn != aggregates_[i].fn ||
+        other.aggregates_[i].column != aggregates_[i].column ||
+        other.aggregates_[i].quantile != aggregates_[i].quantile) {
+      RAISE(kIllegalArgumentError, "can't merge different aggregations");
+    }
+  }
+
+  for (const auto& other_group : other.groups_) {
+    auto iter = group_index_.find(other_group.key);
+    if (iter == group_index_.end()) {
+      groups_.emplace_back(other_group);
+      group_index_.emplace(other_group.key, groups_.size() - 1);
+      continue;
+    }
+
+    auto& group = groups_[iter->second];
+    for (size_t i = 0; i < aggregates_.size(); ++i) {
+      mergeAggregate(
+          aggregates_[i],
+          &group.aggregates[i],
+          other_group.aggregates[i]);
+    }
+  }
+}
+
+void SSTableAggregator::mergeAggregate(
+    const Aggregate& aggregate,
+    AggregateState* state,
+    const AggregateState& other) const {
+  if (other.count == 0) {
+    return;
+  }
+
+  auto first = state->count == 0;
+  state->count += other.count;
+
+  switch (aggregate.fn) {
+
+    case Fn::COUNT:
+      return;
+
+    case Fn::SUM:
+    case Fn::AVG:
+      state->uint_value += other.uint_value;
+      state->float_value += other.float_value;
+      return;
+
+    case Fn::COUNT_DISTINCT:
+      state->distinct.merge(other.distinct);
+      return;
+
+    case Fn::QUANTILE:
+      state->quantiles.merge(other.quantiles);
+      return;
+
+    case Fn::MIN:
+    case Fn::MAX:
+      break;
+
+  }
+
+  auto is_min = aggregate.fn == Fn::MIN;
+  switch (aggregate.type) {
+
+    case SSTableColumnType::UINT32:
+    case SSTableColumnType::UINT64: {
+      auto v = other.uint_value;
+      if (first || (is_min ? v < state->uint_value : v > state->uint_value)) {
+        state->uint_value = v;
+      }
+      break;
+    }
+
+    case SSTableColumnType::FLOAT: {
+      auto v = other.float_value;
+      if (first ||
+          (is_min ? v < state->float_value : v > state->float_value)) {
+        state->float_value = v;
+      }
+      break;
+    }
+
+    case SSTableColumnType::STRING: {
+      const auto& v = other.string_value;
+      if (first ||
+          (is_min ? v < state->string_value : v > state->string_value)) {
+        state->string_value = v;
+      }
+      break;
+    }
+
+  }
+}
+
+size_t SSTableAggregator::numGroups() const {
+  return groups_.size();
+}
+
+Vector<String> SSTableAggregator::columnNames() const {
+  Vector<String> names = group_by_names_;
+
+  for (const auto& aggregate : aggregates_) {
+    String fn;
+    switch (aggregate.fn) {
+      case Fn::COUNT: fn = "count"; break;
+      case Fn::SUM: fn = "sum"; break;
+      case Fn::MIN: fn = "min"; break;
+      case Fn::MAX: fn = "max"; break;
+      case Fn::AVG: fn = "avg"; break;
+      case Fn::COUNT_DISTINCT: fn = "count_distinct"; break;
+      case Fn::QUANTILE: fn = "quantile"; break;
+    }
+
+    if (aggregate.fn == Fn::QUANTILE) {
+      names.emplace_back(
+          StringUtil::format(
+              "$0($1, $2)",
+              fn,
+              aggregate.column,
+              aggregate.quantile));
+    } else {
+      names.emplace_back(StringUtil::format("$0($1)", fn, aggregate.column));
+    }
+  }
+
+  return names;
+}
+
+Vector<SSTableColumnType> SSTableAggregator::columnTypes() const {
+  Vector<SSTableColumnType> types;
+
+  for (const auto& id : group_by_) {
+    types.emplace_back(
+        id == 0 ? SSTableColumnType::STRING : schema_->columnType(id));
+  }
+
+  for (const auto& aggregate : aggregates_) {
+    switch (aggregate.fn) {
+
+      case Fn::COUNT:
+      case Fn::COUNT_DISTINCT:
+        types.emplace_back(SSTableColumnType::UINT64);
+        break;
+
+      case Fn::AVG:
+        types.emplace_back(SSTableColumnType::FLOAT);
+        break;
+
+      case Fn::SUM:
+      case Fn::QUANTILE:
+        types.emplace_back(
+            aggregate.type == SSTableColumnType::FLOAT ?
+                SSTableColumnType::FLOAT :
+                SSTableColumnType::UINT64);
+        break;
+
+      case Fn::MIN:
+      case Fn::MAX:
+        types.emplace_back(aggregate.type);
+        break;
+
+    }
+  }
+
+  return types;
+}
+
+String SSTableAggregator::aggregateValue(
+    const Aggregate& aggregate,
+    const AggregateState& state) const {
+  switch (aggregate.fn) {
+
+    case Fn::COUNT:
+      return StringUtil::toString(state.count);
+
+    case Fn::SUM:
+      if (aggregate.type == SSTableColumnType::FLOAT) {
+        return StringUtil::toString(state.float_value);
+      } else {
+        return StringUtil::toString(state.uint_value);
+      }
+
+    case Fn::AVG:
+      if (state.count == 0) {
+        return "";
+      }
+
+      return StringUtil::toString(state.float_value / state.count);
+
+    case Fn::COUNT_DISTINCT:
+      return StringUtil::toString(state.distinct.estimate());
+
+    case Fn::QUANTILE: {
+      if (state.count == 0) {
+        return "";
+      }
+
+      auto v = state.quantiles.quantile(aggregate.quantile);
+      if (aggregate.type == SSTableColumnType::FLOAT) {
+        return StringUtil::toString(v);
+      } else {
+        return StringUtil::toString(uint64_t(v));
+      }
+    }
+
+    case Fn::MIN:
+    case Fn::MAX:
+      break;
+
+  }
+
+  if (state.count == 0) {
+    return "";
+  }
+
+  switch (aggregate.type) {
+    case SSTableColumnType::UINT32:
+    case SSTableColumnType::UINT64:
+      return StringUtil::toString(state.uint_value);
+    case SSTableColumnType::FLOAT:
+      return StringUtil::toString(state.float_value);
+    case SSTableColumnType::STRING:
+      return state.string_value;
+  }
+
+  return "";
+}
+
+void SSTableAggregator::getResult(
+    Function<void (const Vector<String>& row)> fn) const {
+  Vector<String> row;
+
+  /* aggregates without group by columns always return one row */
+  if (group_by_.empty() && groups_.empty()) {
+    AggregateState state;
+    state.count = 0;
+    state.uint_value = 0;
+    state.float_value = 0;
+
+    for (const auto& aggregate : aggregates_) {
+      row.emplace_back(aggregateValue(aggregate, state));
+    }
+
+    fn(row);
+    return;
+  }
+
+  for (const auto& group : groups_) {
+    row = group.values;
+    for (size_t i = 0; i < aggregates_.size(); ++i) {
+      row.emplace_back(aggregateValue(aggregates_[i], group.aggregates[i]));
+    }
+
+    fn(row);
+  }
+}
+
+void SSTableAggregator::getColumnIDs(
+    Set<SSTableColumnID>* column_ids) const {
+  for (const auto& id : group_by_) {
+    if (id != 0) {
+      column_ids->emplace(id);
+    }
+  }
+
+  for (const auto& aggregate : aggregates_) {
+    if (!aggregate.all_rows) {
+      column_ids->emplace(aggregate.id);
+    }
+  }
+}
+
+}
+}
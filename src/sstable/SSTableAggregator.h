@@ -0,0 +1,158 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <sstable/SSTableColumnSchema.h>
+#include <sstable/SSTableColumnReader.h>
+#include <sstable/SSTableHyperLogLog.h>
+#include <sstable/SSTableQuantileSketch.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * Computes grouped aggregates (COUNT, SUM, MIN, MAX, AVG, COUNT_DISTINCT,
+ * QUANTILE) over the typed column values of rows with a hash table keyed by
+ * the group by values.
+ *
+ * The column "_key" refers to the row key. COUNT(*) counts rows; all other
+ * aggregates ignore rows without a value for the column and use every value
+ * of a column with multiple values. Rows without a value for a group by
+ * column are grouped under an empty value. SUM and AVG require a numeric
+ * column.
+ *
+ * COUNT_DISTINCT and QUANTILE are approximate: COUNT_DISTINCT estimates the
+ * number of distinct values with a HyperLogLog sketch (see
+ * SSTableHyperLogLog) and QUANTILE returns a value whose rank is about
+ * q * COUNT with a KLL sketch (see SSTableQuantileSketch). Their state takes
+ * a few KB per group, regardless of the number of rows. QUANTILE requires a
+ * numeric column.
+ *
+ * The state of two aggregators with the same group by columns and aggregates
+ * (e.g. from scans of different tables or parts of a table) can be merged
+ */
+class SSTableAggregator {
+public:
+  enum class Fn : uint8_t {
+    COUNT,
+    SUM,
+    MIN,
+    MAX,
+    AVG,
+    COUNT_DISTINCT,
+    QUANTILE
+  };
+
+  SSTableAggregator(const SSTableColumnSchema* schema);
+
+  void addGroupBy(const String& column);
+
+  /**
+   * Add an aggregate on the column; COUNT accepts the column "*". quantile
+   * is the quantile (in [0, 1]) returned by QUANTILE
+   */
+  void addAggregate(Fn fn, const String& column, double quantile = 0.5);
+
+  /**
+   * Add an aggregate from an expression like "sum(clicks)", "count(*)",
+   * "count_distinct(user_id)" or "quantile(latency, 0.99)"
+   */
+  void addAggregate(const String& expr);
+
+  static Fn fnFromString(const String& fn);
+
+  void addRow(
+      const void* key,
+      size_t key_size,
+      const SSTableColumnReader& row);
+
+  void merge(const SSTableAggregator& other);
+
+  size_t numGroups() const;
+
+  /**
+   * Returns the group by column names followed by the aggregate names
+   */
+  Vector<String> columnNames() const;
+
+  /**
+   * Returns the types of the group by columns followed by the types of the
+   * aggregates: COUNT and COUNT_DISTINCT are UINT64, AVG is FLOAT, SUM and
+   * QUANTILE are UINT64 on integer columns and FLOAT otherwise, MIN and MAX
+   * have the type of the column
+   */
+  Vector<SSTableColumnType> columnTypes() const;
+
+  /**
+   * Call fn once per group (in the order the groups were first seen) with the
+   * group by values followed by the aggregate values
+   */
+  void getResult(Function<void (const Vector<String>& row)> fn) const;
+
+  /**
+   * Add the ids of all columns the aggregator reads (excluding the key) to
+   * column_ids
+   */
+  void getColumnIDs(Set<SSTableColumnID>* column_ids) const;
+
+protected:
+
+  struct Aggregate {
+    Fn fn;
+    String column;
+    bool all_rows;
+    SSTableColumnID id;
+    SSTableColumnType type;
+    bool dictionary;
+    double quantile;
+  };
+
+  struct AggregateState {
+    uint64_t count;
+    uint64_t uint_value;
+    double float_value;
+    String string_value;
+    SSTableHyperLogLog distinct;
+    SSTableQuantileSketch quantiles;
+  };
+
+  struct Group {
+    String key;
+    Vector<String> values;
+    Vector<AggregateState> aggregates;
+  };
+
+  void updateAggregate(
+      const Aggregate& aggregate,
+      AggregateState* state,
+      const std::tuple<SSTableColumnID, uint64_t, uint32_t>& value,
+      const SSTableColumnReader& row) const;
+
+  void mergeAggregate(
+      const Aggregate& aggregate,
+      AggregateState* state,
+      const AggregateState& other) const;
+
+  String aggregateValue(
+      const Aggregate& aggregate,
+      const AggregateState& state) const;
+
+  const SSTableColumnSchema* schema_;
+  Vector<SSTableColumnID> group_by_;
+  Vector<String> group_by_names_;
+  Vector<Aggregate> aggregates_;
+  HashMap<String, size_t> group_index_;
+  Vector<Group> groups_;
+  String group_key_;
+  Vector<const std::tuple<SSTableColumnID, uint64_t, uint32_t>*> group_values_;
+};
+
+}
+}
@@ -0,0 +1,149 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <algorithm>
+#include <stx/exception.h>
+#include <stx/util/binarymessagereader.h>
+#include <stx/util/binarymessagewriter.h>
+#include <sstable/SSTableBloomFilter.h>
+#include <sstable/SSTableHyperLogLog.h>
+#include <sstable/SSTableWriter.h>
+#include <sstable/sstablereader.h>
+
+namespace stx {
+namespace sstable {
+
+SSTableBloomFilter::SSTableBloomFilter(
+    size_t bits_per_key) :
+    bits_per_key_(bits_per_key),
+    dirty_(false),
+    num_keys_(0),
+    num_probes_(0) {
+  if (bits_per_key_ == 0) {
+    RAISE(kIllegalArgumentError, "bits per key must be greater than 0");
+  }
+}
+
+void SSTableBloomFilter::addKey(const void* key, size_t key_size) {
+  hashes_.emplace_back(SSTableHyperLogLog::hash(key, key_size));
+  dirty_ = true;
+}
+
+void SSTableBloomFilter::addKey(const String& key) {
+  addKey(key.data(), key.size());
+}
+
+/**
+ * The probes are derived from one 64 bit hash by double hashing: probe i
+ * sets bit (h1 + i * h2) mod num_bits, where h1 and h2 are the lower and
+ * upper half of the hash. The optimal number of probes is
+ * bits_per_key * ln(2)
+ */
+void SSTableBloomFilter::build() {
+  num_keys_ = hashes_.size();
+  num_probes_ = std::min(30, std::max(1, int(bits_per_key_ * 0.69 + 0.5)));
+
+  auto num_bits = std::max(uint64_t(64), num_keys_ * bits_per_key_);
+  bits_.assign((num_bits + 7) / 8, 0);
+  num_bits = bits_.size() * 8;
+
+  for (auto h : hashes_) {
+    uint64_t h1 = h & 0xffffffff;
+    uint64_t h2 = (h >> 32) | 1;
+    for (size_t i = 0; i < num_probes_; ++i) {
+      auto bit = (h1 + i * h2) % num_bits;
+      bits_[bit / 8] |= 1 << (bit % 8);
+    }
+  }
+
+  dirty_ = false;
+}
+
+bool SSTableBloomFilter::mayContain(const void* key, size_t key_size) const {
+  if (dirty_) {
+    RAISE(kIllegalStateError, "keys were added since the filter was written");
+  }
+
+  if (bits_.empty()) {
+    return false;
+  }
+
+  auto h = SSTableHyperLogLog::hash(key, key_size);
+  uint64_t h1 = h & 0xffffffff;
+  uint64_t h2 = (h >> 32) | 1;
+  uint64_t num_bits = bits_.size() * 8;
+  for (size_t i = 0; i < num_probes_; ++i) {
+    auto bit = (h1 + i * h2) % num_bits;
+    if ((bits_[bit / 8] & (1 << (bit % 8))) == 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool SSTableBloomFilter::mayContain(const String& key) const {
+  return mayContain(key.data(), key.size());
+}
+
+uint64_t SSTableBloomFilter::numKeys() const {
+  return dirty_ ? hashes_.size() : num_keys_;
+}
+
+size_t SSTableBloomFilter::size() const {
+  return bits_.size();
+}
+
+/**
+ * The filter is stored as the number of probes (uint8), the number of keys
+ * (varint) and the size of the bit array in bytes (varint) followed by the
+ * bit array
+ */
+void SSTableBloomFilter::writeIndex(Buffer* buf) {
+  if (dirty_) {
+    build();
+  }
+
+  util::BinaryMessageWriter writer;
+  writer.appendUInt8(num_probes_);
+  writer.appendVarUInt(num_keys_);
+  writer.appendVarUInt(bits_.size());
+  writer.append(bits_.data(), bits_.size());
+
+  buf->append(writer.data(), writer.size());
+}
+
+void SSTableBloomFilter::writeIndex(SSTableWriter* sstable_writer) {
+  Buffer buf;
+  writeIndex(&buf);
+
+  sstable_writer->writeFooter(kSSTableIndexID, buf);
+}
+
+void SSTableBloomFilter::loadIndex(const Buffer& buf) {
+  util::BinaryMessageReader reader(buf.data(), buf.size());
+
+  num_probes_ = *reader.readUInt8();
+  num_keys_ = reader.readVarUInt();
+  auto size = reader.readVarUInt();
+  auto data = (const uint8_t*) reader.read(size);
+  bits_.assign(data, data + size);
+
+  hashes_.clear();
+  dirty_ = false;
+}
+
+void SSTableBloomFilter::loadIndex(SSTableReader* sstable_reader) {
+  auto index = sstable_reader->readFooter(kSSTableIndexID);
+  loadIndex(index);
+}
+
+}
+}
@@ -0,0 +1,75 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <stx/buffer.h>
+
+namespace stx {
+namespace sstable {
+class SSTableReader;
+class SSTableWriter;
+
+/**
+ * A bloom filter of the row keys of a table, which tells that a key is not in
+ * the table without reading it. With the default of 10 bits per key, about
+ * 1% of the keys that are not in the table pass the filter.
+ *
+ * The size of the filter depends on the number of keys, so the filter is
+ * built when it is written; the hashes of the added keys (8 bytes per key)
+ * are kept in memory. On row-oriented tables, the keys are added by calling
+ * addKey for each row; PAXWriter::setBloomFilter adds the keys of all rows.
+ * The filter is stored in a footer (kSSTableIndexID)
+ */
+class SSTableBloomFilter {
+public:
+  static const uint32_t kSSTableIndexID = 0x34678;
+  static const size_t kDefaultBitsPerKey = 10;
+
+  SSTableBloomFilter(size_t bits_per_key = kDefaultBitsPerKey);
+
+  void addKey(const void* key, size_t key_size);
+  void addKey(const String& key);
+
+  /**
+   * Returns false if the key was never added and true if it (probably) was.
+   * Raises an error if keys were added since the filter was last written
+   */
+  bool mayContain(const void* key, size_t key_size) const;
+  bool mayContain(const String& key) const;
+
+  /**
+   * Returns the number of keys in the filter
+   */
+  uint64_t numKeys() const;
+
+  /**
+   * Returns the size of the filter in bytes
+   */
+  size_t size() const;
+
+  void writeIndex(Buffer* buf);
+  void writeIndex(SSTableWriter* sstable_writer);
+
+  void loadIndex(const Buffer& buf);
+  void loadIndex(SSTableReader* sstable_reader);
+
+protected:
+  void build();
+
+  size_t bits_per_key_;
+  Vector<uint64_t> hashes_;
+  bool dirty_;
+  uint64_t num_keys_;
+  uint8_t num_probes_;
+  Vector<uint8_t> bits_;
+};
+
+}
+}
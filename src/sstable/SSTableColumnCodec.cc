@@ -0,0 +1,221 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <stx/exception.h>
+#include <sstable/SSTableColumnCodec.h>
+
+namespace stx {
+namespace sstable {
+
+bool SSTableColumnCodec::isValidEncoding(
+    SSTableColumnType type,
+    SSTableColumnEncoding encoding) {
+  switch (encoding) {
+    case SSTableColumnEncoding::PLAIN:
+      return true;
+    case SSTableColumnEncoding::VARINT:
+      return type != SSTableColumnType::FLOAT;
+    case SSTableColumnEncoding::ZIGZAG:
+    case SSTableColumnEncoding::DELTA:
+      return
+          type == SSTableColumnType::UINT32 ||
+          type == SSTableColumnType::UINT64;
+    case SSTableColumnEncoding::XOR:
+      return type == SSTableColumnType::FLOAT;
+    case SSTableColumnEncoding::DICTIONARY:
+      return type == SSTableColumnType::STRING;
+  }
+
+  return false;
+}
+
+SSTableColumnEncoding SSTableColumnCodec::rowEncoding(
+    SSTableColumnEncoding encoding) {
+  switch (encoding) {
+    case SSTableColumnEncoding::DELTA:
+      return SSTableColumnEncoding::VARINT;
+    case SSTableColumnEncoding::XOR:
+      return SSTableColumnEncoding::PLAIN;
+    default:
+      return encoding;
+  }
+}
+
+size_t SSTableColumnCodec::encodeValue(
+    SSTableColumnType type,
+    SSTableColumnEncoding encoding,
+    uint64_t value,
+    char* dst) {
+  switch (encoding) {
+
+    case SSTableColumnEncoding::PLAIN:
+      switch (type) {
+        case SSTableColumnType::UINT32:
+        case SSTableColumnType::STRING: {
+          uint32_t val32 = value;
+          memcpy(dst, &val32, sizeof(val32));
+          return sizeof(val32);
+        }
+        case SSTableColumnType::UINT64:
+        case SSTableColumnType::FLOAT:
+          memcpy(dst, &value, sizeof(value));
+          return sizeof(value);
+      }
+      break;
+
+    case SSTableColumnEncoding::VARINT:
+    case SSTableColumnEncoding::DICTIONARY:
+      return encodeVarUInt(value, dst);
+
+    case SSTableColumnEncoding::ZIGZAG:
+      if (type == SSTableColumnType::UINT32) {
+        return encodeVarUInt(encodeZigZag((int32_t) value), dst);
+      } else {
+        return encodeVarUInt(encodeZigZag((int64_t) value), dst);
+      }
+
+    default:
+      break;
+
+  }
+
+  RAISE(kIllegalArgumentError, "encoding requires a previous value");
+}
+
+uint64_t SSTableColumnCodec::decodeValue(
+    SSTableColumnType type,
+    SSTableColumnEncoding encoding,
+    util::BinaryMessageReader* reader) {
+  switch (encoding) {
+
+    case SSTableColumnEncoding::PLAIN:
+      switch (type) {
+        case SSTableColumnType::UINT32:
+        case SSTableColumnType::STRING:
+          return *reader->readUInt32();
+        case SSTableColumnType::UINT64:
+        case SSTableColumnType::FLOAT:
+          return *reader->readUInt64();
+      }
+      break;
+
+    case SSTableColumnEncoding::VARINT:
+    case SSTableColumnEncoding::DICTIONARY:
+      return reader->readVarUInt();
+
+    case SSTableColumnEncoding::ZIGZAG:
+      if (type == SSTableColumnType::UINT32) {
+        return (uint32_t) (int32_t) decodeZigZag(reader->readVarUInt());
+      } else {
+        return (uint64_t) decodeZigZag(reader->readVarUInt());
+      }
+
+    default:
+      break;
+
+  }
+
+  RAISE(kIllegalArgumentError, "encoding requires a previous value");
+}
+
+size_t SSTableColumnCodec::encodeXOR(uint64_t value, uint64_t prev, char* dst) {
+  uint64_t x = value ^ prev;
+  if (x == 0) {
+    dst[0] = 0x80;
+    return 1;
+  }
+
+  uint8_t leading = __builtin_clzll(x) / 8;
+  uint8_t trailing = __builtin_ctzll(x) / 8;
+  uint8_t len = sizeof(uint64_t) - leading - trailing;
+
+  x >>= trailing * 8;
+  dst[0] = (leading << 4) | trailing;
+  memcpy(dst + 1, &x, len);
+  return 1 + len;
+}
+
+uint64_t SSTableColumnCodec::decodeXOR(
+    uint64_t prev,
+    util::BinaryMessageReader* reader) {
+  uint8_t ctrl = *reader->readUInt8();
+  uint8_t leading = ctrl >> 4;
+  uint8_t trailing = ctrl & 0x0f;
+  if (leading + trailing > sizeof(uint64_t)) {
+    RAISE(kIllegalStateError, "invalid xor value");
+  }
+
+  uint8_t len = sizeof(uint64_t) - leading - trailing;
+  uint64_t x = 0;
+  if (len > 0) {
+    memcpy(&x, reader->read(len), len);
+    x <<= trailing * 8;
+  }
+
+  return prev ^ x;
+}
+
+bool SSTableColumnCodec::hasStringData(
+    SSTableColumnType type,
+    SSTableColumnEncoding encoding) {
+  return
+      type == SSTableColumnType::STRING &&
+      encoding != SSTableColumnEncoding::DICTIONARY;
+}
+
+size_t SSTableColumnCodec::encodeVarUInt(uint64_t value, char* dst) {
+  size_t n = 0;
+  while (value > 0x7f) {
+    dst[n++] = (value & 0x7f) | 0x80;
+    value >>= 7;
+  }
+
+  dst[n++] = value;
+  return n;
+}
+
+uint64_t SSTableColumnCodec::encodeZigZag(int64_t value) {
+  return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+int64_t SSTableColumnCodec::decodeZigZag(uint64_t value) {
+  return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+void SSTableColumnCodec::encodeSortKey(uint64_t value, String* dst) {
+  char buf[sizeof(uint64_t)];
+  for (int i = sizeof(uint64_t) - 1; i >= 0; --i) {
+    buf[i] = (char) (value & 0xff);
+    value >>= 8;
+  }
+
+  dst->append(buf, sizeof(buf));
+}
+
+/**
+ * Positive doubles sort correctly by their bits once the sign bit is set;
+ * negative doubles sort in reverse order of their bits, so all bits are
+ * flipped
+ */
+void SSTableColumnCodec::encodeSortKey(double value, String* dst) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  if (bits & (uint64_t(1) << 63)) {
+    bits = ~bits;
+  } else {
+    bits |= uint64_t(1) << 63;
+  }
+
+  encodeSortKey(bits, dst);
+}
+
+}
+}
@@ -0,0 +1,90 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <stx/util/binarymessagereader.h>
+#include <sstable/SSTableColumnSchema.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * Encodes and decodes single column values. See SSTableColumnEncoding
+ */
+class SSTableColumnCodec {
+public:
+  static const size_t kMaxEncodedSize = 10;
+
+  /**
+   * Returns true iff the encoding can be used for columns of the provided type
+   */
+  static bool isValidEncoding(
+      SSTableColumnType type,
+      SSTableColumnEncoding encoding);
+
+  /**
+   * Returns the encoding that is used when a value is stored in a single
+   * row, i.e. without a previous value
+   */
+  static SSTableColumnEncoding rowEncoding(SSTableColumnEncoding encoding);
+
+  /**
+   * Encode a numeric value, string length or dictionary code with a stateless
+   * encoding (PLAIN, VARINT, ZIGZAG or DICTIONARY) into dst and return the
+   * number of bytes written. Float values are passed as their IEEE754 bits
+   */
+  static size_t encodeValue(
+      SSTableColumnType type,
+      SSTableColumnEncoding encoding,
+      uint64_t value,
+      char* dst);
+
+  /**
+   * Decode a value written with encodeValue
+   */
+  static uint64_t decodeValue(
+      SSTableColumnType type,
+      SSTableColumnEncoding encoding,
+      util::BinaryMessageReader* reader);
+
+  /**
+   * Encode the xor of value and prev into dst and return the number of bytes
+   * written
+   */
+  static size_t encodeXOR(uint64_t value, uint64_t prev, char* dst);
+
+  /**
+   * Decode a value written with encodeXOR
+   */
+  static uint64_t decodeXOR(uint64_t prev, util::BinaryMessageReader* reader);
+
+  /**
+   * Returns true iff values of the column are followed by inline string data,
+   * i.e. for all STRING columns that are not dictionary encoded
+   */
+  static bool hasStringData(
+      SSTableColumnType type,
+      SSTableColumnEncoding encoding);
+
+  static size_t encodeVarUInt(uint64_t value, char* dst);
+  static uint64_t encodeZigZag(int64_t value);
+  static int64_t decodeZigZag(uint64_t value);
+
+  /**
+   * Append a binary-comparable encoding of the value to dst, i.e. the encoded
+   * values compare as byte strings (memcmp) in the same order as the values
+   */
+  static void encodeSortKey(uint64_t value, String* dst);
+  static void encodeSortKey(double value, String* dst);
+
+};
+
+}
+}
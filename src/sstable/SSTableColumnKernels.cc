@@ -0,0 +1,370 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <stx/exception.h>
+#include <sstable/SSTableColumnKernels.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+
+namespace stx {
+namespace sstable {
+
+#ifdef __SSE2__
+/**
+ * Widen the four uint32 lanes of v to uint64 and store them to dst
+ */
+static inline void storeWidenedUInt32(__m128i v, uint64_t* dst) {
+  auto zero = _mm_setzero_si128();
+  _mm_storeu_si128((__m128i*) dst, _mm_unpacklo_epi32(v, zero));
+  _mm_storeu_si128((__m128i*) (dst + 2), _mm_unpackhi_epi32(v, zero));
+}
+
+/**
+ * Widen the sixteen uint8 lanes of v to uint64 and store them to dst
+ */
+static inline void storeWidenedUInt8(__m128i v, uint64_t* dst) {
+  auto zero = _mm_setzero_si128();
+  auto lo16 = _mm_unpacklo_epi8(v, zero);
+  auto hi16 = _mm_unpackhi_epi8(v, zero);
+  storeWidenedUInt32(_mm_unpacklo_epi16(lo16, zero), dst);
+  storeWidenedUInt32(_mm_unpackhi_epi16(lo16, zero), dst + 4);
+  storeWidenedUInt32(_mm_unpacklo_epi16(hi16, zero), dst + 8);
+  storeWidenedUInt32(_mm_unpackhi_epi16(hi16, zero), dst + 12);
+}
+
+static inline uint64_t sumLanes(__m128i v) {
+  uint64_t lanes[2];
+  _mm_storeu_si128((__m128i*) lanes, v);
+  return lanes[0] + lanes[1];
+}
+#endif
+
+void SSTableColumnKernels::decodeFixedUInt32(
+    const void* src,
+    size_t n,
+    uint64_t* dst) {
+  auto cur = (const char*) src;
+  size_t i = 0;
+
+#ifdef __SSE2__
+  for (; i + 4 <= n; i += 4, cur += 4 * sizeof(uint32_t)) {
+    storeWidenedUInt32(_mm_loadu_si128((const __m128i*) cur), dst + i);
+  }
+#endif
+
+  for (; i < n; ++i, cur += sizeof(uint32_t)) {
+    uint32_t value;
+    memcpy(&value, cur, sizeof(value));
+    dst[i] = value;
+  }
+}
+
+void SSTableColumnKernels::decodeFixedUInt64(
+    const void* src,
+    size_t n,
+    uint64_t* dst) {
+  memcpy(dst, src, n * sizeof(uint64_t));
+}
+
+size_t SSTableColumnKernels::decodeVarUInt(
+    const void* src,
+    size_t size,
+    size_t n,
+    uint64_t* dst) {
+  auto begin = (const uint8_t*) src;
+  auto cur = begin;
+  auto end = begin + size;
+  size_t i = 0;
+
+  while (i < n) {
+#ifdef __SSE2__
+    /* fast path: decode runs of single byte varints 16 at a time */
+    if (n - i >= 16 && end - cur >= 16) {
+      auto v = _mm_loadu_si128((const __m128i*) cur);
+      auto mask = _mm_movemask_epi8(v);
+      if (mask == 0) {
+        storeWidenedUInt8(v, dst + i);
+        cur += 16;
+        i += 16;
+        continue;
+      }
+
+      for (auto run = __builtin_ctz(mask); run > 0; --run) {
+        dst[i++] = *cur++;
+      }
+    }
+#endif
+
+    uint64_t value = 0;
+    for (int shift = 0; ; shift += 7) {
+      if (cur == end || shift > 63) {
+        RAISE(kIllegalStateError, "invalid varint");
+      }
+
+      uint8_t b = *cur++;
+      value |= (uint64_t) (b & 0x7f) << shift;
+      if ((b & 0x80) == 0) {
+        break;
+      }
+    }
+
+    dst[i++] = value;
+  }
+
+  return cur - begin;
+}
+
+void SSTableColumnKernels::narrowUInt32(
+    const uint64_t* src,
+    size_t n,
+    uint32_t* dst) {
+  for (size_t i = 0; i < n; ++i) {
+    dst[i] = src[i];
+  }
+}
+
+void SSTableColumnKernels::bitsToDouble(
+    const uint64_t* src,
+    size_t n,
+    double* dst) {
+  static_assert(sizeof(double) == sizeof(uint64_t), "need 64 bit doubles");
+  memcpy(dst, src, n * sizeof(uint64_t));
+}
+
+uint64_t SSTableColumnKernels::sum(const uint32_t* values, size_t n) {
+  uint64_t sum = 0;
+  size_t i = 0;
+
+#ifdef __SSE2__
+  auto zero = _mm_setzero_si128();
+  auto acc = _mm_setzero_si128();
+  for (; i + 4 <= n; i += 4) {
+    auto v = _mm_loadu_si128((const __m128i*) (values + i));
+    acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, zero));
+    acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, zero));
+  }
+
+  sum = sumLanes(acc);
+#endif
+
+  for (; i < n; ++i) {
+    sum += values[i];
+  }
+
+  return sum;
+}
+
+uint64_t SSTableColumnKernels::sum(const uint64_t* values, size_t n) {
+  uint64_t sum = 0;
+  size_t i = 0;
+
+#ifdef __SSE2__
+  auto acc0 = _mm_setzero_si128();
+  auto acc1 = _mm_setzero_si128();
+  for (; i + 4 <= n; i += 4) {
+    acc0 = _mm_add_epi64(acc0, _mm_loadu_si128((const __m128i*) (values + i)));
+    acc1 = _mm_add_epi64(
+        acc1,
+        _mm_loadu_si128((const __m128i*) (values + i + 2)));
+  }
+
+  sum = sumLanes(_mm_add_epi64(acc0, acc1));
+#endif
+
+  for (; i < n; ++i) {
+    sum += values[i];
+  }
+
+  return sum;
+}
+
+double SSTableColumnKernels::sum(const double* values, size_t n) {
+  double sum = 0;
+  size_t i = 0;
+
+#ifdef __SSE2__
+  auto acc0 = _mm_setzero_pd();
+  auto acc1 = _mm_setzero_pd();
+  for (; i + 4 <= n; i += 4) {
+    acc0 = _mm_add_pd(acc0, _mm_loadu_pd(values + i));
+    acc1 = _mm_add_pd(acc1, _mm_loadu_pd(values + i + 2));
+  }
+
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+  sum = lanes[0] + lanes[1];
+#endif
+
+  for (; i < n; ++i) {
+    sum += values[i];
+  }
+
+  return sum;
+}
+
+uint32_t SSTableColumnKernels::min(const uint32_t* values, size_t n) {
+  uint32_t min = values[0];
+  size_t i = 0;
+
+#ifdef __SSE4_1__
+  if (n >= 4) {
+    auto acc = _mm_loadu_si128((const __m128i*) values);
+    for (i = 4; i + 4 <= n; i += 4) {
+      acc = _mm_min_epu32(acc, _mm_loadu_si128((const __m128i*) (values + i)));
+    }
+
+    uint32_t lanes[4];
+    _mm_storeu_si128((__m128i*) lanes, acc);
+    for (int j = 0; j < 4; ++j) {
+      min = lanes[j] < min ? lanes[j] : min;
+    }
+  }
+#endif
+
+  for (; i < n; ++i) {
+    min = values[i] < min ? values[i] : min;
+  }
+
+  return min;
+}
+
+uint64_t SSTableColumnKernels::min(const uint64_t* values, size_t n) {
+  uint64_t min = values[0];
+  for (size_t i = 1; i < n; ++i) {
+    min = values[i] < min ? values[i] : min;
+  }
+
+  return min;
+}
+
+double SSTableColumnKernels::min(const double* values, size_t n) {
+  double min = values[0];
+  size_t i = 0;
+
+#ifdef __SSE2__
+  if (n >= 2) {
+    auto acc = _mm_loadu_pd(values);
+    for (i = 2; i + 2 <= n; i += 2) {
+      acc = _mm_min_pd(acc, _mm_loadu_pd(values + i));
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    min = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+  }
+#endif
+
+  for (; i < n; ++i) {
+    min = values[i] < min ? values[i] : min;
+  }
+
+  return min;
+}
+
+uint32_t SSTableColumnKernels::max(const uint32_t* values, size_t n) {
+  uint32_t max = values[0];
+  size_t i = 0;
+
+#ifdef __SSE4_1__
+  if (n >= 4) {
+    auto acc = _mm_loadu_si128((const __m128i*) values);
+    for (i = 4; i + 4 <= n; i += 4) {
+      acc = _mm_max_epu32(acc, _mm_loadu_si128((const __m128i*) (values + i)));
+    }
+
+    uint32_t lanes[4];
+    _mm_storeu_si128((__m128i*) lanes, acc);
+    for (int j = 0; j < 4; ++j) {
+      max = lanes[j] > max ? lanes[j] : max;
+    }
+  }
+#endif
+
+  for (; i < n; ++i) {
+    max = values[i] > max ? values[i] : max;
+  }
+
+  return max;
+}
+
+uint64_t SSTableColumnKernels::max(const uint64_t* values, size_t n) {
+  uint64_t max = values[0];
+  for (size_t i = 1; i < n; ++i) {
+    max = values[i] > max ? values[i] : max;
+  }
+
+  return max;
+}
+
+double SSTableColumnKernels::max(const double* values, size_t n) {
+  double max = values[0];
+  size_t i = 0;
+
+#ifdef __SSE2__
+  if (n >= 2) {
+    auto acc = _mm_loadu_pd(values);
+    for (i = 2; i + 2 <= n; i += 2) {
+      acc = _mm_max_pd(acc, _mm_loadu_pd(values + i));
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    max = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+  }
+#endif
+
+  for (; i < n; ++i) {
+    max = values[i] > max ? values[i] : max;
+  }
+
+  return max;
+}
+
+size_t SSTableColumnKernels::count(
+    const uint32_t* values,
+    size_t n,
+    uint32_t value) {
+  size_t count = 0;
+  size_t i = 0;
+
+#ifdef __SSE2__
+  auto needle = _mm_set1_epi32(value);
+  for (; i + 4 <= n; i += 4) {
+    auto v = _mm_loadu_si128((const __m128i*) (values + i));
+    auto eq = _mm_cmpeq_epi32(v, needle);
+    count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(eq)));
+  }
+#endif
+
+  for (; i < n; ++i) {
+    count += values[i] == value;
+  }
+
+  return count;
+}
+
+size_t SSTableColumnKernels::count(
+    const uint64_t* values,
+    size_t n,
+    uint64_t value) {
+  size_t count = 0;
+  for (size_t i = 0; i < n; ++i) {
+    count += values[i] == value;
+  }
+
+  return count;
+}
+
+}
+}
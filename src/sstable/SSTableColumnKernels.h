@@ -0,0 +1,77 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * Batch kernels that decode and aggregate whole column arrays. The kernels use
+ * SSE2 where available (__SSE2__) and fall back to scalar loops otherwise
+ */
+class SSTableColumnKernels {
+public:
+
+  /**
+   * Decode n little endian uint32 values from src and widen them to uint64
+   */
+  static void decodeFixedUInt32(const void* src, size_t n, uint64_t* dst);
+
+  /**
+   * Decode n little endian uint64 values from src
+   */
+  static void decodeFixedUInt64(const void* src, size_t n, uint64_t* dst);
+
+  /**
+   * Decode n varints from the first size bytes of src and return the number
+   * of bytes consumed
+   */
+  static size_t decodeVarUInt(
+      const void* src,
+      size_t size,
+      size_t n,
+      uint64_t* dst);
+
+  /**
+   * Narrow n uint64 values to uint32 (truncating)
+   */
+  static void narrowUInt32(const uint64_t* src, size_t n, uint32_t* dst);
+
+  /**
+   * Reinterpret n uint64 values as IEEE754 doubles
+   */
+  static void bitsToDouble(const uint64_t* src, size_t n, double* dst);
+
+  static uint64_t sum(const uint32_t* values, size_t n);
+  static uint64_t sum(const uint64_t* values, size_t n);
+  static double sum(const double* values, size_t n);
+
+  /**
+   * The min/max kernels require n > 0
+   */
+  static uint32_t min(const uint32_t* values, size_t n);
+  static uint64_t min(const uint64_t* values, size_t n);
+  static double min(const double* values, size_t n);
+  static uint32_t max(const uint32_t* values, size_t n);
+  static uint64_t max(const uint64_t* values, size_t n);
+  static double max(const double* values, size_t n);
+
+  /**
+   * Return the number of values that are equal to value (e.g. to count
+   * matching dictionary codes)
+   */
+  static size_t count(const uint32_t* values, size_t n, uint32_t value);
+  static size_t count(const uint64_t* values, size_t n, uint64_t value);
+
+};
+
+}
+}
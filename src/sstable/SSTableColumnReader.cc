@@ -9,6 +9,7 @@
  */
 #include <stx/ieee754.h>
 #include <sstable/SSTableColumnReader.h>
+#include <sstable/SSTableColumnCodec.h>
 
 namespace stx {
 namespace sstable {
@@ -17,31 +18,69 @@ SSTableColumnReader::SSTableColumnReader(
     SSTableColumnSchema* schema,
     const Buffer& buf) :
     schema_(schema),
-    buf_(buf),
-    msg_reader_(buf_.data(), buf_.size()) {
-  while (msg_reader_.remaining() > 0) {
-    auto col_id = *msg_reader_.readUInt32();
-    auto col_type = schema_->columnType(col_id);
+    buf_(buf) {
+  decode(buf_.data(), buf_.size());
+}
 
-    switch (col_type) {
+SSTableColumnReader::SSTableColumnReader(
+    SSTableColumnSchema* schema) :
+    schema_(schema) {}
 
-      case SSTableColumnType::UINT32:
-        col_data_.emplace_back(col_id, *msg_reader_.readUInt32(), 0);
-        break;
+void SSTableColumnReader::reset(const void* data, size_t size) {
+  col_data_.clear();
+  decode(data, size);
+}
 
-      case SSTableColumnType::UINT64:
-      case SSTableColumnType::FLOAT:
-        col_data_.emplace_back(col_id, *msg_reader_.readUInt64(), 0);
-        break;
+void SSTableColumnReader::setColumnProjection(
+    const Set<SSTableColumnID>& column_ids) {
+  projection_.clear();
 
-      case SSTableColumnType::STRING: {
-        uint32_t size = *msg_reader_.readUInt32();
-        uint64_t data = (uint64_t) msg_reader_.read(size);
-        col_data_.emplace_back(col_id, data, size);
-        break;
-      }
+  for (const auto& id : column_ids) {
+    if (id >= projection_.size()) {
+      projection_.resize(id + 1, false);
+    }
 
+    projection_[id] = true;
+  }
+
+  /* an empty projection selects no column */
+  if (projection_.empty()) {
+    projection_.emplace_back(false);
+  }
+}
+
+void SSTableColumnReader::decode(const void* row, size_t row_size) {
+  util::BinaryMessageReader msg_reader(row, row_size);
+  auto id_encoding = schema_->columnIDEncoding();
+
+  while (msg_reader.remaining() > 0) {
+    auto col_id = SSTableColumnCodec::decodeValue(
+        SSTableColumnType::UINT32,
+        id_encoding,
+        &msg_reader);
+
+    auto col_type = schema_->columnType(col_id);
+    auto col_encoding = SSTableColumnCodec::rowEncoding(
+        schema_->columnEncoding(col_id));
+
+    auto value = SSTableColumnCodec::decodeValue(
+        col_type,
+        col_encoding,
+        &msg_reader);
+
+    uint32_t size = 0;
+    if (col_type == SSTableColumnType::STRING &&
+        SSTableColumnCodec::hasStringData(col_type, col_encoding)) {
+      size = value;
+      value = (uint64_t) msg_reader.read(size);
     }
+
+    if (!projection_.empty() &&
+        (col_id >= projection_.size() || !projection_[col_id])) {
+      continue;
+    }
+
+    col_data_.emplace_back(col_id, value, size);
   }
 }
 
@@ -107,7 +146,23 @@ String SSTableColumnReader::getStringColumn(SSTableColumnID id) {
 
   for (const auto& col : col_data_) {
     if (std::get<0>(col) == id) {
-      return String((char*) std::get<1>(col), std::get<2>(col));
+      return getStringValue(col);
+    }
+  }
+
+  RAISEF(kIndexError, "no value for column: $0", id);
+}
+
+uint32_t SSTableColumnReader::getDictionaryCode(SSTableColumnID id) {
+#ifndef FNORD_NODEBUG
+  if (schema_->columnEncoding(id) != SSTableColumnEncoding::DICTIONARY) {
+    RAISEF(kIllegalArgumentError, "column is not dictionary encoded: $0", id);
+  }
+#endif
+
+  for (const auto& col : col_data_) {
+    if (std::get<0>(col) == id) {
+      return std::get<1>(col);
     }
   }
 
@@ -124,13 +179,23 @@ Vector<String> SSTableColumnReader::getStringColumns(SSTableColumnID id) {
   Vector<String> data;
   for (const auto& col : col_data_) {
     if (std::get<0>(col) == id) {
-      data.emplace_back((char*) std::get<1>(col), std::get<2>(col));
+      data.emplace_back(getStringValue(col));
     }
   }
 
   return data;
 }
 
+String SSTableColumnReader::getStringValue(
+    const std::tuple<SSTableColumnID, uint64_t, uint32_t>& col) const {
+  auto id = std::get<0>(col);
+  if (schema_->columnEncoding(id) == SSTableColumnEncoding::DICTIONARY) {
+    return schema_->dictionaryValue(id, std::get<1>(col));
+  }
+
+  return String((char*) std::get<1>(col), std::get<2>(col));
+}
+
 } // namespace sstable
 } // namespace stx
 
@@ -27,12 +27,40 @@
 
 namespace stx {
 namespace sstable {
+class PAXBlockBuilder;
+class SSTableAggregator;
+class SSTableRowView;
+class SSTableScanPredicate;
+class SSTableZoneMap;
 
 class SSTableColumnReader {
+  friend class PAXBlockBuilder;
+  friend class SSTableAggregator;
+  friend class SSTableRowView;
+  friend class SSTableScanPredicate;
+  friend class SSTableZoneMap;
 public:
 
   SSTableColumnReader(SSTableColumnSchema* schema, const Buffer& buf);
 
+  /**
+   * Create a reader without a row; call reset() to decode a row
+   */
+  SSTableColumnReader(SSTableColumnSchema* schema);
+
+  /**
+   * Decode the row in data without copying it. The data must stay valid
+   * until the next call to reset(). Reusing one reader for all rows of a scan
+   * avoids allocating per row
+   */
+  void reset(const void* data, size_t size);
+
+  /**
+   * Only keep the values of the provided columns when decoding rows; the
+   * values of all other columns are skipped
+   */
+  void setColumnProjection(const Set<SSTableColumnID>& column_ids);
+
   uint32_t getUInt32Column(SSTableColumnID id);
   uint64_t getUInt64Column(SSTableColumnID id);
   double getFloatColumn(SSTableColumnID id);
@@ -40,11 +68,22 @@ public:
   String getStringColumn(SSTableColumnID id);
   Vector<String> getStringColumns(SSTableColumnID id);
 
+  /**
+   * Returns the dictionary code of a DICTIONARY encoded string column without
+   * looking up the string value
+   */
+  uint32_t getDictionaryCode(SSTableColumnID id);
+
 protected:
+  void decode(const void* row, size_t row_size);
+
+  String getStringValue(
+      const std::tuple<SSTableColumnID, uint64_t, uint32_t>& col) const;
+
   SSTableColumnSchema* schema_;
   Buffer buf_;
-  util::BinaryMessageReader msg_reader_;
   Vector<std::tuple<SSTableColumnID, uint64_t, uint32_t>> col_data_;
+  Vector<bool> projection_;
 };
 
 } // namespace sstable
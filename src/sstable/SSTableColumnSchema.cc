@@ -8,25 +8,58 @@
  * <http://www.gnu.org/licenses/>.
  */
 #include <sstable/SSTableColumnSchema.h>
+#include <sstable/SSTableColumnCodec.h>
 #include <sstable/sstablereader.h>
 #include <sstable/SSTableEditor.h>
+#include <sstable/SSTableWriter.h>
 #include <stx/util/binarymessagereader.h>
 #include <stx/util/binarymessagewriter.h>
 
 namespace stx {
 namespace sstable {
 
-SSTableColumnSchema::SSTableColumnSchema() {}
+SSTableColumnSchema::SSTableColumnSchema() :
+    id_encoding_(SSTableColumnEncoding::PLAIN) {}
 
 void SSTableColumnSchema::addColumn(
     const String& name,
     uint32_t id,
-    SSTableColumnType type) {
+    SSTableColumnType type,
+    SSTableColumnEncoding encoding /* = SSTableColumnEncoding::PLAIN */) {
+  if (!SSTableColumnCodec::isValidEncoding(type, encoding)) {
+    RAISEF(
+        kIllegalArgumentError,
+        "invalid encoding for column: $0",
+        name);
+  }
+
   SSTableColumnInfo info;
   info.name = name;
   info.type = type;
+  info.encoding = encoding;
   col_info_[id] = info;
   col_ids_[name] = id;
+
+  if (encoding == SSTableColumnEncoding::DICTIONARY) {
+    dictionaries_[id];
+  } else {
+    dictionaries_.erase(id);
+  }
+}
+
+void SSTableColumnSchema::setColumnIDEncoding(SSTableColumnEncoding encoding) {
+  switch (encoding) {
+    case SSTableColumnEncoding::PLAIN:
+    case SSTableColumnEncoding::VARINT:
+      id_encoding_ = encoding;
+      return;
+    default:
+      RAISE(kIllegalArgumentError, "column ids must be PLAIN or VARINT");
+  }
+}
+
+SSTableColumnEncoding SSTableColumnSchema::columnIDEncoding() const {
+  return id_encoding_;
 }
 
 SSTableColumnType SSTableColumnSchema::columnType(SSTableColumnID id) const {
@@ -38,6 +71,16 @@ SSTableColumnType SSTableColumnSchema::columnType(SSTableColumnID id) const {
   return iter->second.type;
 }
 
+SSTableColumnEncoding SSTableColumnSchema::columnEncoding(
+    SSTableColumnID id) const {
+  auto iter = col_info_.find(id);
+  if (iter == col_info_.end()) {
+    RAISEF(kIndexError, "invalid column index: $0", id);
+  }
+
+  return iter->second.encoding;
+}
+
 String SSTableColumnSchema::columnName(SSTableColumnID id) const {
   auto iter = col_info_.find(id);
   if (iter == col_info_.end()) {
@@ -66,11 +109,90 @@ Set<SSTableColumnID> SSTableColumnSchema::columnIDs() const {
   return ids;
 }
 
+uint32_t SSTableColumnSchema::addDictionaryValue(
+    SSTableColumnID id,
+    const String& value) {
+  auto dict_iter = dictionaries_.find(id);
+  if (dict_iter == dictionaries_.end()) {
+    RAISEF(kIllegalArgumentError, "column is not dictionary encoded: $0", id);
+  }
+
+  auto& dict = dict_iter->second;
+  auto iter = dict.codes.find(value);
+  if (iter != dict.codes.end()) {
+    return iter->second;
+  }
+
+  uint32_t code = dict.values.size();
+  dict.values.emplace_back(value);
+  dict.codes.emplace(value, code);
+  return code;
+}
+
+void SSTableColumnSchema::clearDictionaries() {
+  for (auto& d : dictionaries_) {
+    d.second.values.clear();
+    d.second.codes.clear();
+  }
+}
+
+bool SSTableColumnSchema::lookupDictionaryCode(
+    SSTableColumnID id,
+    const String& value,
+    uint32_t* code) const {
+  const auto& dict = getDictionary(id);
+
+  auto iter = dict.codes.find(value);
+  if (iter == dict.codes.end()) {
+    return false;
+  }
+
+  *code = iter->second;
+  return true;
+}
+
+const String& SSTableColumnSchema::dictionaryValue(
+    SSTableColumnID id,
+    uint32_t code) const {
+  const auto& dict = getDictionary(id);
+
+  if (code >= dict.values.size()) {
+    RAISEF(kIndexError, "invalid dictionary code $0 for column: $1", code, id);
+  }
+
+  return dict.values[code];
+}
+
+size_t SSTableColumnSchema::dictionarySize(SSTableColumnID id) const {
+  return getDictionary(id).values.size();
+}
+
+const SSTableColumnSchema::SSTableColumnDictionary&
+    SSTableColumnSchema::getDictionary(SSTableColumnID id) const {
+  auto iter = dictionaries_.find(id);
+  if (iter == dictionaries_.end()) {
+    RAISEF(kIllegalArgumentError, "column is not dictionary encoded: $0", id);
+  }
+
+  return iter->second;
+}
+
+/**
+ * The index is a list of (type, id, name) entries. The column encoding is
+ * stored in the second byte of the type field. Schemas with non-default
+ * options are prefixed with kIndexOptionsMarker and the column id encoding
+ */
 void SSTableColumnSchema::writeIndex(Buffer* buf) {
   util::BinaryMessageWriter writer;
 
+  if (id_encoding_ != SSTableColumnEncoding::PLAIN) {
+    writer.appendUInt32(kIndexOptionsMarker);
+    writer.appendUInt32((uint8_t) id_encoding_);
+  }
+
   for (const auto& c : col_info_) {
-    writer.appendUInt32((uint8_t) c.second.type);
+    writer.appendUInt32(
+        (uint8_t) c.second.type | ((uint8_t) c.second.encoding << 8));
     writer.appendUInt32(c.first);
     writer.appendUInt32(c.second.name.length());
     writer.append(c.second.name.data(), c.second.name.length());
@@ -84,6 +206,27 @@ void SSTableColumnSchema::writeIndex(SSTableEditor* sstable_writer) {
   writeIndex(&buf);
 
   sstable_writer->writeIndex(SSTableColumnSchema::kSSTableIndexID, buf);
+
+  if (dictionaries_.size() > 0) {
+    Buffer dict_buf;
+    writeDictionary(&dict_buf);
+    sstable_writer->writeIndex(kSSTableDictionaryID, dict_buf);
+    clearDictionaries();
+  }
+}
+
+void SSTableColumnSchema::writeIndex(SSTableWriter* sstable_writer) {
+  Buffer buf;
+  writeIndex(&buf);
+
+  sstable_writer->writeFooter(SSTableColumnSchema::kSSTableIndexID, buf);
+
+  if (dictionaries_.size() > 0) {
+    Buffer dict_buf;
+    writeDictionary(&dict_buf);
+    sstable_writer->writeFooter(kSSTableDictionaryID, dict_buf);
+    clearDictionaries();
+  }
 }
 
 void SSTableColumnSchema::loadIndex(const Buffer& buf) {
@@ -91,11 +234,20 @@ void SSTableColumnSchema::loadIndex(const Buffer& buf) {
 
   while (reader.remaining() > 0) {
     uint32_t col_type = *reader.readUInt32();
+    if (col_type == kIndexOptionsMarker) {
+      setColumnIDEncoding((SSTableColumnEncoding) *reader.readUInt32());
+      continue;
+    }
+
     uint32_t col_id = *reader.readUInt32();
     uint32_t col_name_len = *reader.readUInt32();
     String col_name((char*) reader.read(col_name_len), col_name_len);
 
-    addColumn(col_name, col_id, (stx::sstable::SSTableColumnType) col_type);
+    addColumn(
+        col_name,
+        col_id,
+        (stx::sstable::SSTableColumnType) (col_type & 0xff),
+        (stx::sstable::SSTableColumnEncoding) ((col_type >> 8) & 0xff));
   }
 }
 
@@ -103,6 +255,59 @@ void SSTableColumnSchema::loadIndex(
     SSTableReader* sstable_reader) {
   auto index = sstable_reader->readFooter(kSSTableIndexID);
   loadIndex(index);
+
+  if (dictionaries_.size() > 0) {
+    loadDictionary(sstable_reader->readFooter(kSSTableDictionaryID));
+  }
+}
+
+/**
+ * The dictionary footer is a list of (column id, number of values, values)
+ * entries. Each value is stored as a varint length followed by the string.
+ * The position of a value in the list is its code
+ */
+void SSTableColumnSchema::writeDictionary(Buffer* buf) {
+  util::BinaryMessageWriter writer;
+
+  for (const auto& d : dictionaries_) {
+    writer.appendUInt32(d.first);
+    writer.appendUInt32(d.second.values.size());
+
+    for (const auto& value : d.second.values) {
+      writer.appendVarUInt(value.length());
+      writer.append(value.data(), value.length());
+    }
+  }
+
+  buf->append(writer.data(), writer.size());
+}
+
+void SSTableColumnSchema::loadDictionary(const Buffer& buf) {
+  util::BinaryMessageReader reader(buf.data(), buf.size());
+
+  while (reader.remaining() > 0) {
+    uint32_t col_id = *reader.readUInt32();
+    uint32_t num_values = *reader.readUInt32();
+
+    auto dict_iter = dictionaries_.find(col_id);
+    if (dict_iter == dictionaries_.end()) {
+      RAISEF(
+          kIllegalArgumentError,
+          "column is not dictionary encoded: $0",
+          col_id);
+    }
+
+    auto& dict = dict_iter->second;
+    dict.values.clear();
+    dict.codes.clear();
+    dict.values.reserve(num_values);
+
+    for (uint32_t code = 0; code < num_values; ++code) {
+      auto len = reader.readVarUInt();
+      dict.values.emplace_back((char*) reader.read(len), len);
+      dict.codes.emplace(dict.values.back(), code);
+    }
+  }
 }
 
 } // namespace sstable
@@ -27,6 +27,7 @@ namespace stx {
 namespace sstable {
 class SSTableEditor;
 class SSTableReader;
+class SSTableWriter;
 
 enum class SSTableColumnType : uint8_t {
   UINT32 = 1,
@@ -35,38 +36,123 @@ enum class SSTableColumnType : uint8_t {
   STRING = 4
 };
 
+/**
+ * Value encodings. DELTA and XOR need the previous value of the column, so they
+ * are only applied inside columnar (PAX) chunks; single rows store DELTA
+ * columns as VARINT and XOR columns as PLAIN.
+ *
+ *   PLAIN   fixed width values and uint32 string lengths
+ *   VARINT  varint values (UINT32, UINT64) or string lengths (STRING)
+ *   ZIGZAG  zigzag varint of the value interpreted as signed (UINT32, UINT64)
+ *   DELTA   zigzag varint of the difference to the previous value (UINT32,
+ *           UINT64)
+ *   XOR     xor with the previous value, leading and trailing zero bytes
+ *           stripped (FLOAT)
+ *   DICTIONARY  varint code into the per-table dictionary of the column
+ *               (STRING); see addDictionaryValue
+ */
+enum class SSTableColumnEncoding : uint8_t {
+  PLAIN  = 0,
+  VARINT = 1,
+  ZIGZAG = 2,
+  DELTA  = 3,
+  XOR    = 4,
+  DICTIONARY = 5
+};
+
 typedef uint32_t SSTableColumnID;
 
 class SSTableColumnSchema {
 public:
   static const uint32_t kSSTableIndexID = 0x34673;
+  static const uint32_t kSSTableDictionaryID = 0x34674;
+  static const uint32_t kIndexOptionsMarker = 0xffffffff;
 
   SSTableColumnSchema();
 
   void addColumn(
       const String& name,
       SSTableColumnID id,
-      SSTableColumnType type);
+      SSTableColumnType type,
+      SSTableColumnEncoding encoding = SSTableColumnEncoding::PLAIN);
+
+  /**
+   * Set the encoding of the column ids in each row (PLAIN or VARINT)
+   */
+  void setColumnIDEncoding(SSTableColumnEncoding encoding);
+  SSTableColumnEncoding columnIDEncoding() const;
 
   SSTableColumnType columnType(SSTableColumnID id) const;
+  SSTableColumnEncoding columnEncoding(SSTableColumnID id) const;
   String columnName(SSTableColumnID id) const;
   SSTableColumnID columnID(const String& column_name) const;
   Set<SSTableColumnID> columnIDs() const;
 
+  /**
+   * Returns the dictionary code for value in a DICTIONARY encoded column,
+   * adding the value to the dictionary if it is not yet included.
+   *
+   * The dictionaries hold the values of the table that is being written and
+   * are cleared once writeIndex wrote them, so the next table written with
+   * the schema starts with empty dictionaries. The dictionaries are not
+   * synchronized: a schema with DICTIONARY columns must not be shared by
+   * concurrent writers
+   */
+  uint32_t addDictionaryValue(SSTableColumnID id, const String& value);
+
+  /**
+   * Remove all values from the dictionaries
+   */
+  void clearDictionaries();
+
+  /**
+   * Looks up the dictionary code for value in a DICTIONARY encoded column.
+   * Returns false if the value is not included in the dictionary, i.e. if
+   * no row in the table stores it
+   */
+  bool lookupDictionaryCode(
+      SSTableColumnID id,
+      const String& value,
+      uint32_t* code) const;
+
+  /**
+   * Returns the value for a dictionary code
+   */
+  const String& dictionaryValue(SSTableColumnID id, uint32_t code) const;
+
+  /**
+   * Returns the number of values in the dictionary of a column
+   */
+  size_t dictionarySize(SSTableColumnID id) const;
+
   void writeIndex(Buffer* buf);
   void writeIndex(SSTableEditor* sstable_writer);
+  void writeIndex(SSTableWriter* sstable_writer);
 
   void loadIndex(const Buffer& buf);
   void loadIndex(SSTableReader* sstable_reader);
 
+  void writeDictionary(Buffer* buf);
+  void loadDictionary(const Buffer& buf);
+
 protected:
   struct SSTableColumnInfo {
     String name;
     SSTableColumnType type;
+    SSTableColumnEncoding encoding;
+  };
+
+  struct SSTableColumnDictionary {
+    Vector<String> values;
+    HashMap<String, uint32_t> codes;
   };
 
+  const SSTableColumnDictionary& getDictionary(SSTableColumnID id) const;
+
+  SSTableColumnEncoding id_encoding_;
   HashMap<SSTableColumnID, SSTableColumnInfo> col_info_;
   HashMap<String, SSTableColumnID> col_ids_;
+  HashMap<SSTableColumnID, SSTableColumnDictionary> dictionaries_;
 };
 
 } // namespace sstable
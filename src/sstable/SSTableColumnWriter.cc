@@ -9,6 +9,7 @@
  */
 #include <stx/ieee754.h>
 #include <sstable/SSTableColumnWriter.h>
+#include <sstable/SSTableColumnCodec.h>
 
 namespace stx {
 namespace sstable {
@@ -24,8 +25,8 @@ void SSTableColumnWriter::addUInt32Column(SSTableColumnID id, uint32_t value) {
   }
 #endif
 
-  msg_writer_.appendUInt32(id);
-  msg_writer_.appendUInt32(value);
+  appendColumnID(id);
+  appendValue(id, SSTableColumnType::UINT32, value);
 }
 
 void SSTableColumnWriter::addUInt64Column(SSTableColumnID id, uint64_t value) {
@@ -35,8 +36,8 @@ void SSTableColumnWriter::addUInt64Column(SSTableColumnID id, uint64_t value) {
   }
 #endif
 
-  msg_writer_.appendUInt32(id);
-  msg_writer_.appendUInt64(value);
+  appendColumnID(id);
+  appendValue(id, SSTableColumnType::UINT64, value);
 }
 
 void SSTableColumnWriter::addFloatColumn(SSTableColumnID id, double value) {
@@ -46,8 +47,8 @@ void SSTableColumnWriter::addFloatColumn(SSTableColumnID id, double value) {
   }
 #endif
 
-  msg_writer_.appendUInt32(id);
-  msg_writer_.appendUInt64(IEEE754::toBytes(value));
+  appendColumnID(id);
+  appendValue(id, SSTableColumnType::FLOAT, IEEE754::toBytes(value));
 }
 
 void SSTableColumnWriter::addStringColumn(
@@ -59,12 +60,47 @@ void SSTableColumnWriter::addStringColumn(
   }
 #endif
 
+  appendColumnID(id);
+
+  if (schema_->columnEncoding(id) == SSTableColumnEncoding::DICTIONARY) {
+    appendValue(
+        id,
+        SSTableColumnType::STRING,
+        schema_->addDictionaryValue(id, value));
+
+    return;
+  }
+
   uint32_t len = value.length();
-  msg_writer_.appendUInt32(id);
-  msg_writer_.appendUInt32(len);
+  appendValue(id, SSTableColumnType::STRING, len);
   msg_writer_.append(value.data(), len);
 }
 
+void SSTableColumnWriter::appendColumnID(SSTableColumnID id) {
+  char buf[SSTableColumnCodec::kMaxEncodedSize];
+  auto len = SSTableColumnCodec::encodeValue(
+      SSTableColumnType::UINT32,
+      schema_->columnIDEncoding(),
+      id,
+      buf);
+
+  msg_writer_.append(buf, len);
+}
+
+void SSTableColumnWriter::appendValue(
+    SSTableColumnID id,
+    SSTableColumnType type,
+    uint64_t value) {
+  char buf[SSTableColumnCodec::kMaxEncodedSize];
+  auto len = SSTableColumnCodec::encodeValue(
+      type,
+      SSTableColumnCodec::rowEncoding(schema_->columnEncoding(id)),
+      value,
+      buf);
+
+  msg_writer_.append(buf, len);
+}
+
 void* SSTableColumnWriter::data() const {
   return msg_writer_.data();
 }
@@ -42,6 +42,9 @@ public:
   size_t size() const;
 
 protected:
+  void appendColumnID(SSTableColumnID id);
+  void appendValue(SSTableColumnID id, SSTableColumnType type, uint64_t value);
+
   SSTableColumnSchema* schema_;
   util::BinaryMessageWriter msg_writer_;
 };
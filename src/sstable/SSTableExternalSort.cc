@@ -0,0 +1,288 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <stx/exception.h>
+#include <stx/stringutil.h>
+#include <stx/io/fileutil.h>
+#include <stx/util/binarymessagereader.h>
+#include <stx/util/binarymessagewriter.h>
+#include <sstable/SSTableExternalSort.h>
+#include <sstable/SSTableWriter.h>
+
+namespace stx {
+namespace sstable {
+
+static std::atomic<uint64_t> run_file_ctr(0);
+
+SSTableExternalSort::SSTableExternalSort(
+    CompareFn compare_fn,
+    size_t memory_limit /* = kDefaultMemoryLimit */,
+    const String& tempdir /* = "/tmp" */) :
+    compare_fn_(compare_fn),
+    memory_limit_(memory_limit),
+    tempdir_(tempdir),
+    parallel_sort_threshold_(kDefaultParallelSortThreshold),
+    parallel_sort_threads_(1),
+    rows_size_(0),
+    spilled_bytes_(0) {}
+
+SSTableExternalSort::~SSTableExternalSort() {
+  for (auto& run : runs_) {
+    run->cursor.reset(nullptr);
+    run->reader.reset(nullptr);
+    FileUtil::rm(run->filename);
+  }
+}
+
+void SSTableExternalSort::setParallelSort(
+    size_t threshold,
+    size_t num_threads) {
+  parallel_sort_threshold_ = threshold;
+  parallel_sort_threads_ = num_threads;
+}
+
+void SSTableExternalSort::addRow(String&& sort_key, Vector<String>&& row) {
+  rows_size_ += sizeof(SortRow) + sort_key.size();
+  rows_size_ += row.size() * sizeof(String);
+  for (const auto& v : row) {
+    rows_size_ += v.size();
+  }
+
+  rows_.emplace_back(std::move(sort_key), std::move(row));
+
+  if (memory_limit_ > 0 && rows_size_ > memory_limit_) {
+    spill();
+  }
+}
+
+void SSTableExternalSort::sortRows() {
+  if (parallel_sort_threads_ > 1 &&
+      rows_.size() >= parallel_sort_threshold_ &&
+      rows_.size() >= parallel_sort_threads_ * 2) {
+    sortRowsParallel();
+    return;
+  }
+
+  std::sort(
+      rows_.begin(),
+      rows_.end(),
+      [this] (const SortRow& a, const SortRow& b) {
+    return compare_fn_(a.first, b.first);
+  });
+}
+
+void SSTableExternalSort::sortRowsParallel() {
+  auto cmp = [this] (const SortRow& a, const SortRow& b) {
+    return compare_fn_(a.first, b.first);
+  };
+
+  auto begin = rows_.begin();
+  auto n = rows_.size();
+  auto part_size = (n + parallel_sort_threads_ - 1) / parallel_sort_threads_;
+
+  /* runs fn(0) ... fn(num_tasks - 1) on one thread each and rethrows the
+     first exception */
+  auto run_parallel = [] (size_t num_tasks, Function<void (size_t)> fn) {
+    Vector<std::thread> threads;
+    Vector<std::exception_ptr> errors(num_tasks);
+
+    for (size_t i = 0; i < num_tasks; ++i) {
+      threads.emplace_back([&fn, &errors, i] () {
+        try {
+          fn(i);
+        } catch (...) {
+          errors[i] = std::current_exception();
+        }
+      });
+    }
+
+    for (auto& t : threads) {
+      t.join();
+    }
+
+    for (const auto& e : errors) {
+      if (e) {
+        std::rethrow_exception(e);
+      }
+    }
+  };
+
+  auto num_parts = (n + part_size - 1) / part_size;
+  run_parallel(num_parts, [&] (size_t i) {
+    auto lo = i * part_size;
+    auto hi = std::min(lo + part_size, n);
+    std::sort(begin + lo, begin + hi, cmp);
+  });
+
+  for (auto width = part_size; width < n; width *= 2) {
+    auto num_merges = (n + 2 * width - 1) / (2 * width);
+    run_parallel(num_merges, [&] (size_t i) {
+      auto lo = i * 2 * width;
+      auto mid = std::min(lo + width, n);
+      auto hi = std::min(lo + 2 * width, n);
+      std::inplace_merge(begin + lo, begin + mid, begin + hi, cmp);
+    });
+  }
+}
+
+/**
+ * A run is a row-oriented sstable keyed by the sort key; the row data is the
+ * number of values followed by each value as varint length + bytes
+ */
+void SSTableExternalSort::spill() {
+  if (rows_.empty()) {
+    return;
+  }
+
+  sortRows();
+
+  std::unique_ptr<Run> run(new Run());
+  run->filename = FileUtil::joinPaths(
+      tempdir_,
+      StringUtil::format(
+          "__sstable_sort_$0_$1.sst",
+          getpid(),
+          run_file_ctr++));
+
+  /* the run is only added to runs_ once it's complete, so remove the file
+     here if writing it fails */
+  try {
+    auto writer = SSTableWriter::create(run->filename, "", 0);
+
+    util::BinaryMessageWriter buf;
+    for (const auto& row : rows_) {
+      buf.clear();
+      buf.appendVarUInt(row.second.size());
+      for (const auto& v : row.second) {
+        buf.appendVarUInt(v.size());
+        buf.append(v.data(), v.size());
+      }
+
+      writer->appendRow(
+          row.first.data(),
+          row.first.size(),
+          buf.data(),
+          buf.size());
+    }
+
+    writer->commit();
+  } catch (...) {
+    if (FileUtil::exists(run->filename)) {
+      FileUtil::rm(run->filename);
+    }
+
+    throw;
+  }
+
+  spilled_bytes_ += FileUtil::size(run->filename);
+  runs_.emplace_back(std::move(run));
+
+  rows_.clear();
+  rows_.shrink_to_fit();
+  rows_size_ = 0;
+}
+
+void SSTableExternalSort::readRow(Run* run) {
+  void* key;
+  size_t key_size;
+  run->cursor->getKey(&key, &key_size);
+  run->row.first.assign((char*) key, key_size);
+
+  void* data;
+  size_t size;
+  run->cursor->getData(&data, &size);
+
+  util::BinaryMessageReader reader(data, size);
+  auto n = reader.readVarUInt();
+
+  run->row.second.clear();
+  for (uint64_t i = 0; i < n; ++i) {
+    auto len = reader.readVarUInt();
+    run->row.second.emplace_back(reader.readString(len), len);
+  }
+}
+
+void SSTableExternalSort::execute(
+    Function<void (const Vector<String>& row)> fn,
+    size_t offset /* = 0 */,
+    long int limit /* = -1 */) {
+  size_t n = 0;
+  auto emit = [&] (const Vector<String>& row) -> bool {
+    if (n++ < offset) {
+      return true;
+    }
+
+    fn(row);
+    return limit <= 0 || n < offset + limit;
+  };
+
+  if (runs_.empty()) {
+    sortRows();
+
+    for (const auto& row : rows_) {
+      if (!emit(row.second)) {
+        break;
+      }
+    }
+
+    return;
+  }
+
+  spill();
+
+  /* k-way merge of the runs; the heap front is the run with the smallest
+     current row */
+  auto heap_cmp = [this] (const Run* a, const Run* b) {
+    return compare_fn_(b->row.first, a->row.first);
+  };
+
+  Vector<Run*> heap;
+  for (auto& run : runs_) {
+    run->reader.reset(new SSTableReader(run->filename));
+    run->cursor = run->reader->getCursor();
+    if (run->cursor->valid()) {
+      readRow(run.get());
+      heap.emplace_back(run.get());
+    }
+  }
+
+  std::make_heap(heap.begin(), heap.end(), heap_cmp);
+
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), heap_cmp);
+    auto run = heap.back();
+
+    if (!emit(run->row.second)) {
+      break;
+    }
+
+    if (run->cursor->next() && run->cursor->valid()) {
+      readRow(run);
+      std::push_heap(heap.begin(), heap.end(), heap_cmp);
+    } else {
+      heap.pop_back();
+    }
+  }
+}
+
+uint64_t SSTableExternalSort::spilledBytes() const {
+  return spilled_bytes_;
+}
+
+size_t SSTableExternalSort::numRuns() const {
+  return runs_.size();
+}
+
+}
+}
@@ -0,0 +1,103 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <sstable/cursor.h>
+#include <sstable/sstablereader.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * Sorts a stream of rows within a fixed memory budget. Each row is added with
+ * a sort key extracted by the caller and rows are compared only by their sort
+ * keys. Rows are buffered in memory until the buffer exceeds the memory
+ * limit; the buffer is then sorted and written to a temporary sstable (a
+ * "run"). execute() merges the runs and calls the callback for each row in
+ * order.
+ *
+ * The temporary sstables are created in the temp directory and deleted when
+ * the sort is destroyed
+ */
+class SSTableExternalSort {
+public:
+  typedef Function<bool (const String& a, const String& b)> CompareFn;
+
+  static const size_t kDefaultMemoryLimit = 256 * 1024 * 1024;
+  static const size_t kDefaultParallelSortThreshold = 1000000;
+
+  SSTableExternalSort(
+      CompareFn compare_fn,
+      size_t memory_limit = kDefaultMemoryLimit,
+      const String& tempdir = "/tmp");
+
+  SSTableExternalSort(const SSTableExternalSort& other) = delete;
+  SSTableExternalSort& operator=(const SSTableExternalSort& other) = delete;
+  ~SSTableExternalSort();
+
+  /**
+   * Sort buffers of at least threshold rows with up to num_threads threads.
+   * The buffer is split into one partition per thread, the partitions are
+   * sorted in parallel and then merged pairwise in parallel. The compare
+   * function must be safe to call from multiple threads, so parallel sort
+   * is opt-in: by default buffers are sorted on one thread
+   */
+  void setParallelSort(size_t threshold, size_t num_threads);
+
+  void addRow(String&& sort_key, Vector<String>&& row);
+
+  /**
+   * Call fn for each row in sorted order, skipping the first offset rows and
+   * stopping after limit rows (if limit is greater than zero)
+   */
+  void execute(
+      Function<void (const Vector<String>& row)> fn,
+      size_t offset = 0,
+      long int limit = -1);
+
+  /**
+   * Returns the number of bytes written to temporary sstables
+   */
+  uint64_t spilledBytes() const;
+
+  /**
+   * Returns the number of sorted runs written to temporary sstables
+   */
+  size_t numRuns() const;
+
+protected:
+
+  typedef std::pair<String, Vector<String>> SortRow;
+
+  struct Run {
+    String filename;
+    std::unique_ptr<SSTableReader> reader;
+    std::unique_ptr<Cursor> cursor;
+    SortRow row;
+  };
+
+  void sortRows();
+  void sortRowsParallel();
+  void spill();
+  void readRow(Run* run);
+
+  CompareFn compare_fn_;
+  size_t memory_limit_;
+  String tempdir_;
+  size_t parallel_sort_threshold_;
+  size_t parallel_sort_threads_;
+  Vector<SortRow> rows_;
+  size_t rows_size_;
+  Vector<std::unique_ptr<Run>> runs_;
+  uint64_t spilled_bytes_;
+};
+
+}
+}
@@ -0,0 +1,138 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stx/exception.h>
+#include <stx/util/binarymessagewriter.h>
+#include <stx/util/binarymessagereader.h>
+#include <sstable/SSTableHyperLogLog.h>
+
+namespace stx {
+namespace sstable {
+
+/* splitmix64 finalizer */
+uint64_t SSTableHyperLogLog::hash(uint64_t value) {
+  uint64_t h = value + 0x9e3779b97f4a7c15ull;
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+  return h ^ (h >> 31);
+}
+
+/* 64 bit FNV-1a, mixed with the splitmix64 finalizer */
+uint64_t SSTableHyperLogLog::hash(const void* data, size_t size) {
+  auto bytes = (const unsigned char*) data;
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < size; ++i) {
+    h ^= bytes[i];
+    h *= 0x100000001b3ull;
+  }
+
+  return hash(h);
+}
+
+SSTableHyperLogLog::SSTableHyperLogLog() {}
+
+/**
+ * The first kPrecision bits of the hash select the register; the register
+ * stores the maximum position of the first set bit in the remaining bits
+ */
+void SSTableHyperLogLog::add(uint64_t hash) {
+  if (registers_.empty()) {
+    registers_.resize(kNumRegisters, 0);
+  }
+
+  auto idx = hash >> (64 - kPrecision);
+  auto rest = hash << kPrecision;
+
+  uint8_t rank = 1;
+  while (rank <= 64 - kPrecision && (rest & (1ull << 63)) == 0) {
+    rest <<= 1;
+    ++rank;
+  }
+
+  if (rank > registers_[idx]) {
+    registers_[idx] = rank;
+  }
+}
+
+void SSTableHyperLogLog::merge(const SSTableHyperLogLog& other) {
+  if (other.registers_.empty()) {
+    return;
+  }
+
+  if (registers_.empty()) {
+    registers_ = other.registers_;
+    return;
+  }
+
+  for (size_t i = 0; i < kNumRegisters; ++i) {
+    if (other.registers_[i] > registers_[i]) {
+      registers_[i] = other.registers_[i];
+    }
+  }
+}
+
+uint64_t SSTableHyperLogLog::estimate() const {
+  if (registers_.empty()) {
+    return 0;
+  }
+
+  double m = kNumRegisters;
+  double sum = 0;
+  size_t zeros = 0;
+  for (auto r : registers_) {
+    sum += ldexp(1.0, -r);
+    if (r == 0) {
+      ++zeros;
+    }
+  }
+
+  auto alpha = 0.7213 / (1 + 1.079 / m);
+  auto estimate = alpha * m * m / sum;
+
+  /* linear counting for small cardinalities */
+  if (estimate <= 2.5 * m && zeros > 0) {
+    estimate = m * log(m / zeros);
+  }
+
+  return llround(estimate);
+}
+
+size_t SSTableHyperLogLog::memoryUsage() const {
+  return registers_.size();
+}
+
+void SSTableHyperLogLog::encode(Buffer* buf) const {
+  util::BinaryMessageWriter writer;
+  writer.appendUInt8(kPrecision);
+  writer.appendUInt8(registers_.empty() ? 0 : 1);
+  if (!registers_.empty()) {
+    writer.append(registers_.data(), registers_.size());
+  }
+
+  buf->append(writer.data(), writer.size());
+}
+
+void SSTableHyperLogLog::decode(const Buffer& buf) {
+  util::BinaryMessageReader reader(buf.data(), buf.size());
+
+  auto precision = *reader.readUInt8();
+  if (precision != kPrecision) {
+    RAISEF(kParseError, "unsupported hyperloglog precision: $0", precision);
+  }
+
+  registers_.clear();
+  if (*reader.readUInt8() != 0) {
+    auto data = (const uint8_t*) reader.read(kNumRegisters);
+    registers_.assign(data, data + kNumRegisters);
+  }
+}
+
+}
+}
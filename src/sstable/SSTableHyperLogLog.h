@@ -0,0 +1,62 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <stx/buffer.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * Estimates the number of distinct values with a HyperLogLog sketch of
+ * 2^kPrecision one byte registers (4KB). The standard error of the estimate
+ * is 1.04 / sqrt(2^kPrecision), i.e. about 1.6%; small cardinalities are
+ * estimated with linear counting.
+ *
+ * The registers are only allocated once the first value is added. Two
+ * sketches can be merged, so the distinct count of a union of (possibly
+ * overlapping) inputs can be computed from sketches of the parts
+ */
+class SSTableHyperLogLog {
+public:
+  static const size_t kPrecision = 12;
+  static const size_t kNumRegisters = 1 << kPrecision;
+
+  /**
+   * 64 bit hashes of values; equal values of the same type have equal hashes
+   */
+  static uint64_t hash(uint64_t value);
+  static uint64_t hash(const void* data, size_t size);
+
+  SSTableHyperLogLog();
+
+  /**
+   * Add the hash of a value (see hash())
+   */
+  void add(uint64_t hash);
+
+  void merge(const SSTableHyperLogLog& other);
+
+  uint64_t estimate() const;
+
+  /**
+   * Returns the number of bytes allocated for the registers
+   */
+  size_t memoryUsage() const;
+
+  void encode(Buffer* buf) const;
+  void decode(const Buffer& buf);
+
+protected:
+  Vector<uint8_t> registers_;
+};
+
+}
+}
@@ -0,0 +1,158 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <stx/exception.h>
+#include <stx/util/binarymessagereader.h>
+#include <stx/util/binarymessagewriter.h>
+#include <sstable/SSTableKeyIndex.h>
+#include <sstable/SSTableWriter.h>
+#include <sstable/sstablereader.h>
+
+namespace stx {
+namespace sstable {
+
+SSTableKeyIndex::SSTableKeyIndex(
+    size_t interval /* = kDefaultInterval */) :
+    interval_(interval),
+    sorted_(true),
+    has_last_key_(false),
+    has_block_key_(false) {}
+
+void SSTableKeyIndex::checkOrder(void const* key, size_t key_size) {
+  if (has_last_key_ &&
+      sorted_ &&
+      last_key_.compare(0, last_key_.size(), (char*) key, key_size) > 0) {
+    sorted_ = false;
+  }
+
+  last_key_.assign((char*) key, key_size);
+  has_last_key_ = true;
+}
+
+void SSTableKeyIndex::addRow(
+    uint64_t position,
+    void const* key,
+    size_t key_size) {
+  checkOrder(key, key_size);
+
+  if (entries_.size() > 0) {
+    auto last_position = entries_.back().second;
+    if (position <= last_position) {
+      RAISE(kIllegalArgumentError, "rows must be added in body order");
+    }
+
+    if (position - last_position < interval_) {
+      return;
+    }
+  }
+
+  entries_.emplace_back(String((char*) key, key_size), position);
+}
+
+void SSTableKeyIndex::addRow(void const* key, size_t key_size) {
+  checkOrder(key, key_size);
+
+  if (!has_block_key_) {
+    block_key_.assign((char*) key, key_size);
+    has_block_key_ = true;
+  }
+}
+
+void SSTableKeyIndex::finishBlock(uint64_t position) {
+  if (!has_block_key_) {
+    return;
+  }
+
+  if (entries_.size() > 0 && position <= entries_.back().second) {
+    RAISE(kIllegalArgumentError, "blocks must be added in body order");
+  }
+
+  entries_.emplace_back(std::move(block_key_), position);
+  block_key_.clear();
+  has_block_key_ = false;
+}
+
+bool SSTableKeyIndex::isSorted() const {
+  return sorted_;
+}
+
+size_t SSTableKeyIndex::numEntries() const {
+  return entries_.size();
+}
+
+uint64_t SSTableKeyIndex::lowerBound(const String& key) const {
+  if (!sorted_) {
+    RAISE(kIllegalStateError, "key index is not sorted");
+  }
+
+  if (entries_.empty()) {
+    return 0;
+  }
+
+  auto iter = std::lower_bound(
+      entries_.begin(),
+      entries_.end(),
+      key,
+      [] (const std::pair<String, uint64_t>& entry, const String& key) {
+    return entry.first < key;
+  });
+
+  if (iter == entries_.begin()) {
+    return iter->second;
+  }
+
+  return (iter - 1)->second;
+}
+
+/**
+ * The index is stored as a sorted flag (uint8) followed by the entries. Each
+ * entry is stored as (position, key) with the key stored as varint length
+ * followed by the key
+ */
+void SSTableKeyIndex::writeIndex(Buffer* buf) {
+  util::BinaryMessageWriter writer;
+  writer.appendUInt8(sorted_ ? 1 : 0);
+
+  for (const auto& e : entries_) {
+    writer.appendUInt64(e.second);
+    writer.appendVarUInt(e.first.size());
+    writer.append(e.first.data(), e.first.size());
+  }
+
+  buf->append(writer.data(), writer.size());
+}
+
+void SSTableKeyIndex::writeIndex(SSTableWriter* sstable_writer) {
+  Buffer buf;
+  writeIndex(&buf);
+
+  sstable_writer->writeFooter(kSSTableIndexID, buf);
+}
+
+void SSTableKeyIndex::loadIndex(const Buffer& buf) {
+  util::BinaryMessageReader reader(buf.data(), buf.size());
+  entries_.clear();
+
+  sorted_ = *reader.readUInt8() == 1;
+
+  while (reader.remaining() > 0) {
+    auto position = *reader.readUInt64();
+    auto len = reader.readVarUInt();
+    entries_.emplace_back(String((char*) reader.read(len), len), position);
+  }
+}
+
+void SSTableKeyIndex::loadIndex(SSTableReader* sstable_reader) {
+  auto index = sstable_reader->readFooter(kSSTableIndexID);
+  loadIndex(index);
+}
+
+}
+}
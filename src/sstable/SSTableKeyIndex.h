@@ -0,0 +1,87 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <stx/buffer.h>
+
+namespace stx {
+namespace sstable {
+class SSTableReader;
+class SSTableWriter;
+
+/**
+ * A sparse index of row keys. Each entry is the key of a row and the cursor
+ * position of that row; entries are in body order. The index also records
+ * whether all rows were added in ascending key order. Only the index of a
+ * sorted table can be used to seek to a key.
+ *
+ * On row-oriented tables the index is built by calling addRow with the
+ * position returned by SSTableWriter::appendRow; an entry is recorded once
+ * every interval bytes. PAXWriter::setKeyIndex records one entry per PAX
+ * block. The index is stored in a footer (kSSTableIndexID)
+ */
+class SSTableKeyIndex {
+public:
+  static const uint32_t kSSTableIndexID = 0x34677;
+  static const size_t kDefaultInterval = 4 * 1024;
+
+  SSTableKeyIndex(size_t interval = kDefaultInterval);
+
+  /**
+   * Add a row that was written at the provided position
+   */
+  void addRow(uint64_t position, void const* key, size_t key_size);
+
+  /**
+   * Add a row without a position. An entry for the first row added since the
+   * last call to finishBlock is recorded once finishBlock is called
+   */
+  void addRow(void const* key, size_t key_size);
+
+  /**
+   * Record an entry for the first row of the current block
+   */
+  void finishBlock(uint64_t position);
+
+  /**
+   * Returns true if all rows were added in ascending key order
+   */
+  bool isSorted() const;
+
+  size_t numEntries() const;
+
+  /**
+   * Returns the position at which a scan for rows with keys greater than or
+   * equal to the provided key can start, i.e. the position of the last entry
+   * whose key is smaller than the provided key or the position of the first
+   * entry. Requires a sorted index
+   */
+  uint64_t lowerBound(const String& key) const;
+
+  void writeIndex(Buffer* buf);
+  void writeIndex(SSTableWriter* sstable_writer);
+
+  void loadIndex(const Buffer& buf);
+  void loadIndex(SSTableReader* sstable_reader);
+
+protected:
+  void checkOrder(void const* key, size_t key_size);
+
+  size_t interval_;
+  bool sorted_;
+  String last_key_;
+  bool has_last_key_;
+  Vector<std::pair<String, uint64_t>> entries_;
+  String block_key_;
+  bool has_block_key_;
+};
+
+}
+}
@@ -0,0 +1,971 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <ctype.h>
+#include <string.h>
+#include <algorithm>
+#include <bitset>
+#include <map>
+#include <stx/exception.h>
+#include <sstable/SSTableKeyMatcher.h>
+
+namespace stx {
+namespace sstable {
+
+typedef std::bitset<256> ByteSet;
+
+static const uint32_t kRepeatInfinite = uint32_t(-1);
+static const size_t kMaxNFAStates = 100000;
+
+struct KeyPatternNode {
+  enum class Type { EMPTY, CHARSET, CONCAT, ALT, REPEAT };
+
+  Type type;
+  ByteSet chars;
+  Vector<size_t> children;
+  uint32_t min;
+  uint32_t max;
+};
+
+/**
+ * Parses a pattern into a tree of KeyPatternNodes (stored in a flat list)
+ */
+class SSTableKeyPatternParser {
+public:
+
+  SSTableKeyPatternParser(
+      const String& pattern,
+      Vector<KeyPatternNode>* nodes) :
+      pattern_(pattern),
+      pos_(0),
+      nodes_(nodes) {}
+
+  size_t parse() {
+    if (pos_ < pattern_.size() && pattern_[pos_] == '^') {
+      ++pos_;
+    }
+
+    auto root = parseAlt();
+    if (pos_ < pattern_.size()) {
+      RAISEF(
+          kParseError,
+          "unexpected '$0' at position $1 in key pattern: $2",
+          pattern_.substr(pos_, 1),
+          pos_,
+          pattern_);
+    }
+
+    return root;
+  }
+
+protected:
+
+  size_t addNode(KeyPatternNode::Type type) {
+    KeyPatternNode node;
+    node.type = type;
+    node.min = 0;
+    node.max = 0;
+    nodes_->emplace_back(node);
+    return nodes_->size() - 1;
+  }
+
+  size_t addCharset(const ByteSet& chars) {
+    auto idx = addNode(KeyPatternNode::Type::CHARSET);
+    (*nodes_)[idx].chars = chars;
+    return idx;
+  }
+
+  bool eof() const {
+    return pos_ >= pattern_.size();
+  }
+
+  char peek() const {
+    return pattern_[pos_];
+  }
+
+  void error(const char* msg) const {
+    RAISEF(
+        kParseError,
+        "$0 at position $1 in key pattern: $2",
+        msg,
+        pos_,
+        pattern_);
+  }
+
+  size_t parseAlt() {
+    Vector<size_t> branches;
+    branches.emplace_back(parseConcat());
+
+    while (!eof() && peek() == '|') {
+      ++pos_;
+      branches.emplace_back(parseConcat());
+    }
+
+    if (branches.size() == 1) {
+      return branches[0];
+    }
+
+    auto idx = addNode(KeyPatternNode::Type::ALT);
+    (*nodes_)[idx].children = branches;
+    return idx;
+  }
+
+  size_t parseConcat() {
+    Vector<size_t> items;
+
+    while (!eof() && peek() != '|' && peek() != ')') {
+      if (peek() == '$' && pos_ + 1 == pattern_.size()) {
+        ++pos_;
+        break;
+      }
+
+      items.emplace_back(parseRepeat());
+    }
+
+    if (items.size() == 1) {
+      return items[0];
+    }
+
+    auto idx = addNode(
+        items.empty() ?
+            KeyPatternNode::Type::EMPTY :
+            KeyPatternNode::Type::CONCAT);
+    (*nodes_)[idx].children = items;
+    return idx;
+  }
+
+  size_t parseRepeat() {
+    auto atom = parseAtom();
+
+    while (!eof()) {
+      uint32_t min;
+      uint32_t max;
+
+      switch (peek()) {
+        case '*':
+          min = 0;
+          max = kRepeatInfinite;
+          ++pos_;
+          break;
+
+        case '+':
+          min = 1;
+          max = kRepeatInfinite;
+          ++pos_;
+          break;
+
+        case '?':
+          min = 0;
+          max = 1;
+          ++pos_;
+          break;
+
+        case '{':
+          ++pos_;
+          parseRepeatCount(&min, &max);
+          break;
+
+        default:
+          return atom;
+      }
+
+      /* lazy quantifiers match the same keys as greedy ones */
+      if (!eof() && peek() == '?') {
+        ++pos_;
+      }
+
+      auto idx = addNode(KeyPatternNode::Type::REPEAT);
+      (*nodes_)[idx].children.emplace_back(atom);
+      (*nodes_)[idx].min = min;
+      (*nodes_)[idx].max = max;
+      atom = idx;
+    }
+
+    return atom;
+  }
+
+  void parseRepeatCount(uint32_t* min, uint32_t* max) {
+    *min = parseNumber();
+    *max = *min;
+
+    if (!eof() && peek() == ',') {
+      ++pos_;
+      *max = (!eof() && peek() == '}') ? kRepeatInfinite : parseNumber();
+    }
+
+    if (eof() || peek() != '}') {
+      error("expected '}'");
+    }
+
+    ++pos_;
+
+    if (*max < *min) {
+      error("invalid repeat count");
+    }
+
+    if (*min > SSTableKeyMatcher::kMaxRepeat ||
+        (*max != kRepeatInfinite && *max > SSTableKeyMatcher::kMaxRepeat)) {
+      error("repeat count is too large");
+    }
+  }
+
+  uint32_t parseNumber() {
+    if (eof() || !isdigit((unsigned char) peek())) {
+      error("expected a number");
+    }
+
+    uint32_t n = 0;
+    while (!eof() && isdigit((unsigned char) peek())) {
+      n = n * 10 + (peek() - '0');
+      if (n > SSTableKeyMatcher::kMaxRepeat) {
+        error("repeat count is too large");
+      }
+
+      ++pos_;
+    }
+
+    return n;
+  }
+
+  size_t parseAtom() {
+    auto c = peek();
+
+    switch (c) {
+      case '(': {
+        ++pos_;
+        if (pattern_.compare(pos_, 2, "?:") == 0) {
+          pos_ += 2;
+        } else if (!eof() && peek() == '?') {
+          error("assertions are not supported");
+        }
+
+        auto idx = parseAlt();
+        if (eof() || peek() != ')') {
+          error("expected ')'");
+        }
+
+        ++pos_;
+        return idx;
+      }
+
+      case '[':
+        ++pos_;
+        return addCharset(parseClass());
+
+      case '.': {
+        ++pos_;
+        ByteSet chars;
+        chars.set();
+        chars.reset('\n');
+        chars.reset('\r');
+        return addCharset(chars);
+      }
+
+      case '\\': {
+        ++pos_;
+        ByteSet chars;
+        parseEscape(false, &chars);
+        return addCharset(chars);
+      }
+
+      case '*':
+      case '+':
+      case '?':
+      case '{':
+        error("nothing to repeat");
+
+      case '^':
+      case '$':
+        error("anchors are only supported at the beginning/end of a pattern");
+
+      default: {
+        ++pos_;
+        ByteSet chars;
+        chars.set((unsigned char) c);
+        return addCharset(chars);
+      }
+    }
+  }
+
+  ByteSet parseClass() {
+    ByteSet chars;
+    bool negate = false;
+
+    if (!eof() && peek() == '^') {
+      negate = true;
+      ++pos_;
+    }
+
+    while (!eof() && peek() != ']') {
+      ByteSet item;
+      auto single = parseClassItem(&item);
+
+      if (single >= 0 &&
+          pos_ + 1 < pattern_.size() &&
+          peek() == '-' &&
+          pattern_[pos_ + 1] != ']') {
+        ++pos_;
+
+        ByteSet upper_item;
+        auto upper = parseClassItem(&upper_item);
+        if (upper < 0 || upper < single) {
+          error("invalid character class range");
+        }
+
+        for (int i = single; i <= upper; ++i) {
+          chars.set(i);
+        }
+
+        continue;
+      }
+
+      chars |= item;
+    }
+
+    if (eof()) {
+      error("expected ']'");
+    }
+
+    ++pos_;
+
+    if (negate) {
+      chars.flip();
+    }
+
+    return chars;
+  }
+
+  /**
+   * Parse a character or escape sequence in a character class. Returns the
+   * character or -1 if the item is a class like \d
+   */
+  int parseClassItem(ByteSet* chars) {
+    if (peek() == '\\') {
+      ++pos_;
+      return parseEscape(true, chars);
+    }
+
+    auto c = (unsigned char) peek();
+    ++pos_;
+    chars->set(c);
+    return c;
+  }
+
+  /**
+   * Parse an escape sequence (after the backslash). Returns the character or
+   * -1 if the escape is a class like \d
+   */
+  int parseEscape(bool in_class, ByteSet* chars) {
+    if (eof()) {
+      error("incomplete escape sequence");
+    }
+
+    auto c = peek();
+    ++pos_;
+
+    switch (c) {
+      case 'd':
+      case 'D':
+        for (int i = '0'; i <= '9'; ++i) {
+          chars->set(i);
+        }
+        break;
+
+      case 'w':
+      case 'W':
+        for (int i = 0; i < 256; ++i) {
+          if (isalnum(i) || i == '_') {
+            chars->set(i);
+          }
+        }
+        break;
+
+      case 's':
+      case 'S':
+        chars->set(' ');
+        chars->set('\t');
+        chars->set('\n');
+        chars->set('\r');
+        chars->set('\f');
+        chars->set('\v');
+        break;
+
+      case 'n':
+        return setChar('\n', chars);
+
+      case 't':
+        return setChar('\t', chars);
+
+      case 'r':
+        return setChar('\r', chars);
+
+      case 'f':
+        return setChar('\f', chars);
+
+      case 'v':
+        return setChar('\v', chars);
+
+      case '0':
+        return setChar('\0', chars);
+
+      case 'x': {
+        if (pos_ + 2 > pattern_.size() ||
+            !isxdigit((unsigned char) pattern_[pos_]) ||
+            !isxdigit((unsigned char) pattern_[pos_ + 1])) {
+          error("invalid \\x escape sequence");
+        }
+
+        auto v = std::stoi(pattern_.substr(pos_, 2), nullptr, 16);
+        pos_ += 2;
+        return setChar(v, chars);
+      }
+
+      case 'b':
+        if (in_class) {
+          return setChar('\b', chars);
+        }
+
+        error("word boundaries are not supported");
+
+      case 'B':
+        error("word boundaries are not supported");
+
+      default:
+        if (c >= '1' && c <= '9') {
+          error("backreferences are not supported");
+        }
+
+        return setChar((unsigned char) c, chars);
+    }
+
+    if (isupper(c)) {
+      chars->flip();
+    }
+
+    return -1;
+  }
+
+  int setChar(int c, ByteSet* chars) {
+    chars->set(c);
+    return c;
+  }
+
+  const String& pattern_;
+  size_t pos_;
+  Vector<KeyPatternNode>* nodes_;
+};
+
+/**
+ * Thompson NFA built from the pattern tree. Each state either consumes one
+ * byte from a set (CHARSET), branches without consuming (SPLIT) or accepts
+ */
+class SSTableKeyPatternNFA {
+public:
+  enum class Type { CHARSET, SPLIT, ACCEPT };
+
+  struct State {
+    Type type;
+    ByteSet chars;
+    uint32_t next;
+    Vector<uint32_t> eps;
+    int32_t accept;
+  };
+
+  SSTableKeyPatternNFA(const Vector<KeyPatternNode>& nodes) : nodes_(nodes) {}
+
+  uint32_t addAccept(int32_t pattern) {
+    auto idx = addState(Type::ACCEPT);
+    states_[idx].accept = pattern;
+    return idx;
+  }
+
+  uint32_t addSplit(const Vector<uint32_t>& eps) {
+    auto idx = addState(Type::SPLIT);
+    states_[idx].eps = eps;
+    return idx;
+  }
+
+  /**
+   * Add the states for the node, leading to next, and return the entry state
+   */
+  uint32_t compile(size_t node_idx, uint32_t next) {
+    const auto& node = nodes_[node_idx];
+
+    switch (node.type) {
+
+      case KeyPatternNode::Type::EMPTY:
+        return next;
+
+      case KeyPatternNode::Type::CHARSET: {
+        auto idx = addState(Type::CHARSET);
+        states_[idx].chars = node.chars;
+        states_[idx].next = next;
+        return idx;
+      }
+
+      case KeyPatternNode::Type::CONCAT:
+        for (auto c = node.children.rbegin(); c != node.children.rend(); ++c) {
+          next = compile(*c, next);
+        }
+        return next;
+
+      case KeyPatternNode::Type::ALT: {
+        Vector<uint32_t> eps;
+        for (const auto& c : node.children) {
+          eps.emplace_back(compile(c, next));
+        }
+        return addSplit(eps);
+      }
+
+      case KeyPatternNode::Type::REPEAT: {
+        auto child = node.children[0];
+        auto entry = next;
+
+        if (node.max == kRepeatInfinite) {
+          auto loop = addSplit(Vector<uint32_t>());
+          auto body = compile(child, loop);
+          states_[loop].eps.emplace_back(body);
+          states_[loop].eps.emplace_back(next);
+          entry = loop;
+        } else {
+          for (uint32_t i = node.min; i < node.max; ++i) {
+            Vector<uint32_t> eps;
+            eps.emplace_back(compile(child, entry));
+            eps.emplace_back(next);
+            entry = addSplit(eps);
+          }
+        }
+
+        for (uint32_t i = 0; i < node.min; ++i) {
+          entry = compile(child, entry);
+        }
+
+        return entry;
+      }
+
+    }
+
+    return next;
+  }
+
+  /**
+   * Replace the provided set of states with its epsilon closure, keeping only
+   * CHARSET and ACCEPT states, sorted
+   */
+  void closure(Vector<uint32_t>* set) {
+    Vector<uint32_t> stack(*set);
+    set->clear();
+
+    visited_.assign(states_.size(), false);
+    while (!stack.empty()) {
+      auto s = stack.back();
+      stack.pop_back();
+
+      if (visited_[s]) {
+        continue;
+      }
+
+      visited_[s] = true;
+      if (states_[s].type == Type::SPLIT) {
+        for (const auto& e : states_[s].eps) {
+          stack.emplace_back(e);
+        }
+      } else {
+        set->emplace_back(s);
+      }
+    }
+
+    std::sort(set->begin(), set->end());
+  }
+
+  Vector<State> states_;
+
+protected:
+
+  uint32_t addState(Type type) {
+    if (states_.size() >= kMaxNFAStates) {
+      RAISE(kIllegalArgumentError, "key pattern is too complex");
+    }
+
+    State state;
+    state.type = type;
+    state.next = 0;
+    state.accept = -1;
+    states_.emplace_back(state);
+    return states_.size() - 1;
+  }
+
+  const Vector<KeyPatternNode>& nodes_;
+  Vector<bool> visited_;
+};
+
+/**
+ * Append the literal prefix of all strings matching the node to prefix.
+ * Returns true if the node only matches that literal, i.e. if the prefix of
+ * a following node can be appended
+ */
+static bool patternLiteralPrefix(
+    const Vector<KeyPatternNode>& nodes,
+    size_t node_idx,
+    String* prefix) {
+  const auto& node = nodes[node_idx];
+
+  switch (node.type) {
+
+    case KeyPatternNode::Type::EMPTY:
+      return true;
+
+    case KeyPatternNode::Type::CHARSET:
+      if (node.chars.count() != 1) {
+        return false;
+      }
+
+      for (int i = 0; i < 256; ++i) {
+        if (node.chars.test(i)) {
+          *prefix += (char) i;
+        }
+      }
+
+      return true;
+
+    case KeyPatternNode::Type::CONCAT:
+      for (const auto& c : node.children) {
+        if (!patternLiteralPrefix(nodes, c, prefix)) {
+          return false;
+        }
+      }
+
+      return true;
+
+    case KeyPatternNode::Type::ALT: {
+      String common;
+      for (size_t i = 0; i < node.children.size(); ++i) {
+        String branch;
+        patternLiteralPrefix(nodes, node.children[i], &branch);
+
+        if (i == 0) {
+          common = branch;
+        } else {
+          size_t n = 0;
+          while (n < common.size() &&
+                 n < branch.size() &&
+                 common[n] == branch[n]) {
+            ++n;
+          }
+
+          common.resize(n);
+        }
+      }
+
+      *prefix += common;
+      return false;
+    }
+
+    case KeyPatternNode::Type::REPEAT: {
+      String child;
+      auto complete = patternLiteralPrefix(nodes, node.children[0], &child);
+      if (node.min == 0) {
+        return false;
+      }
+
+      if (!complete) {
+        *prefix += child;
+        return false;
+      }
+
+      for (uint32_t i = 0; i < node.min; ++i) {
+        *prefix += child;
+      }
+
+      return node.min == node.max;
+    }
+
+  }
+
+  return false;
+}
+
+SSTableKeyMatcher::SSTableKeyMatcher(const String& pattern) {
+  Vector<String> patterns;
+  patterns.emplace_back(pattern);
+  compile(patterns);
+}
+
+SSTableKeyMatcher::SSTableKeyMatcher(const Vector<String>& patterns) {
+  compile(patterns);
+}
+
+void SSTableKeyMatcher::compile(const Vector<String>& patterns) {
+  if (patterns.empty()) {
+    RAISE(kIllegalArgumentError, "at least one key pattern is required");
+  }
+
+  /* parse the patterns and build one NFA that matches any pattern */
+  Vector<KeyPatternNode> nodes;
+  Vector<size_t> roots;
+  for (const auto& p : patterns) {
+    SSTableKeyPatternParser parser(p, &nodes);
+    roots.emplace_back(parser.parse());
+  }
+
+  SSTableKeyPatternNFA nfa(nodes);
+  Vector<uint32_t> start;
+  for (size_t i = 0; i < roots.size(); ++i) {
+    start.emplace_back(nfa.compile(roots[i], nfa.addAccept(i)));
+
+    String prefix;
+    patternLiteralPrefix(nodes, roots[i], &prefix);
+    if (i == 0) {
+      literal_prefix_ = prefix;
+    } else {
+      size_t n = 0;
+      while (n < literal_prefix_.size() &&
+             n < prefix.size() &&
+             literal_prefix_[n] == prefix[n]) {
+        ++n;
+      }
+
+      literal_prefix_.resize(n);
+    }
+  }
+
+  /* split the bytes into classes of bytes that no charset distinguishes */
+  Vector<uint32_t> classes(256, 0);
+  num_classes_ = 1;
+  for (const auto& s : nfa.states_) {
+    if (s.type != SSTableKeyPatternNFA::Type::CHARSET) {
+      continue;
+    }
+
+    std::map<std::pair<uint32_t, bool>, uint32_t> refined;
+    for (int i = 0; i < 256; ++i) {
+      auto key = std::make_pair(classes[i], (bool) s.chars.test(i));
+      auto iter = refined.find(key);
+      if (iter == refined.end()) {
+        iter = refined.emplace(key, refined.size()).first;
+      }
+
+      classes[i] = iter->second;
+    }
+
+    num_classes_ = refined.size();
+  }
+
+  Vector<int> class_byte(num_classes_);
+  for (int i = 255; i >= 0; --i) {
+    byte_class_[i] = classes[i];
+    class_byte[classes[i]] = i;
+  }
+
+  /* subset construction; state 0 is the dead state */
+  std::map<Vector<uint32_t>, uint32_t> dfa_states;
+  Vector<Vector<uint32_t>> queue;
+  is_dfa_ = true;
+
+  auto add_dfa_state = [&] (Vector<uint32_t>* set) -> uint32_t {
+    nfa.closure(set);
+
+    auto iter = dfa_states.find(*set);
+    if (iter != dfa_states.end()) {
+      return iter->second;
+    }
+
+    if (dfa_states.size() >= kMaxStates) {
+      is_dfa_ = false;
+      return 0;
+    }
+
+    int32_t accept = -1;
+    for (const auto& s : *set) {
+      const auto& state = nfa.states_[s];
+      if (state.type == SSTableKeyPatternNFA::Type::ACCEPT &&
+          (accept < 0 || state.accept < accept)) {
+        accept = state.accept;
+      }
+    }
+
+    uint32_t id = dfa_states.size();
+    dfa_states.emplace(*set, id);
+    queue.emplace_back(*set);
+    accept_.emplace_back(accept);
+    transitions_.resize(transitions_.size() + num_classes_, 0);
+    return id;
+  };
+
+  Vector<uint32_t> dead;
+  add_dfa_state(&dead);
+  auto start_state = add_dfa_state(&start);
+
+  for (size_t d = 1; d < queue.size() && is_dfa_; ++d) {
+    for (size_t c = 0; c < num_classes_ && is_dfa_; ++c) {
+      Vector<uint32_t> next;
+      for (const auto& s : queue[d]) {
+        const auto& state = nfa.states_[s];
+        if (state.type == SSTableKeyPatternNFA::Type::CHARSET &&
+            state.chars.test(class_byte[c])) {
+          next.emplace_back(state.next);
+        }
+      }
+
+      auto target = add_dfa_state(&next);
+      transitions_[d * num_classes_ + c] = target;
+    }
+  }
+
+  if (is_dfa_) {
+    prefix_state_ = start_state;
+    for (const auto& c : literal_prefix_) {
+      prefix_state_ = transitions_[
+          prefix_state_ * num_classes_ + byte_class_[(unsigned char) c]];
+    }
+
+    return;
+  }
+
+  /* the DFA is too large, keep the NFA instead */
+  transitions_.clear();
+  accept_.clear();
+  prefix_state_ = 0;
+
+  for (const auto& s : nfa.states_) {
+    NFAState state;
+    state.accept = s.accept;
+    state.next = s.next;
+    state.eps_begin = nfa_eps_.size();
+    nfa_eps_.insert(nfa_eps_.end(), s.eps.begin(), s.eps.end());
+    state.eps_end = nfa_eps_.size();
+    nfa_states_.emplace_back(state);
+    nfa_chars_.emplace_back(
+        s.type == SSTableKeyPatternNFA::Type::CHARSET ? s.chars : ByteSet());
+  }
+
+  NFAScratch scratch;
+  scratch.marks.resize(nfa_states_.size(), 0);
+  ++scratch.generation;
+  for (const auto& s : start) {
+    addNFAState(s, &scratch, &scratch.current);
+  }
+
+  for (const auto& c : literal_prefix_) {
+    stepNFA(c, &scratch);
+    std::swap(scratch.current, scratch.next);
+  }
+
+  nfa_prefix_states_ = scratch.current;
+}
+
+void SSTableKeyMatcher::addNFAState(
+    uint32_t state,
+    NFAScratch* scratch,
+    Vector<uint32_t>* set) const {
+  auto& stack = scratch->stack;
+  stack.clear();
+  stack.emplace_back(state);
+
+  while (!stack.empty()) {
+    auto s = stack.back();
+    stack.pop_back();
+
+    if (scratch->marks[s] == scratch->generation) {
+      continue;
+    }
+
+    scratch->marks[s] = scratch->generation;
+
+    const auto& nfa_state = nfa_states_[s];
+    if (nfa_state.eps_begin < nfa_state.eps_end) {
+      for (auto e = nfa_state.eps_begin; e < nfa_state.eps_end; ++e) {
+        stack.emplace_back(nfa_eps_[e]);
+      }
+    } else {
+      set->emplace_back(s);
+    }
+  }
+}
+
+void SSTableKeyMatcher::stepNFA(
+    unsigned char byte,
+    NFAScratch* scratch) const {
+  scratch->next.clear();
+  ++scratch->generation;
+
+  for (const auto& s : scratch->current) {
+    if (nfa_chars_[s].test(byte)) {
+      addNFAState(nfa_states_[s].next, scratch, &scratch->next);
+    }
+  }
+}
+
+ssize_t SSTableKeyMatcher::matchNFA(
+    const unsigned char* data,
+    size_t size) const {
+  /* reuse the buffers of the previous match on this thread */
+  static thread_local NFAScratch scratch;
+  if (scratch.marks.size() < nfa_states_.size()) {
+    scratch.marks.resize(nfa_states_.size(), 0);
+  }
+
+  scratch.current.assign(
+      nfa_prefix_states_.begin(),
+      nfa_prefix_states_.end());
+
+  for (size_t i = 0; i < size && !scratch.current.empty(); ++i) {
+    stepNFA(data[i], &scratch);
+    std::swap(scratch.current, scratch.next);
+  }
+
+  ssize_t accept = -1;
+  for (const auto& s : scratch.current) {
+    auto a = nfa_states_[s].accept;
+    if (a >= 0 && (accept < 0 || a < accept)) {
+      accept = a;
+    }
+  }
+
+  return accept;
+}
+
+bool SSTableKeyMatcher::matches(const void* key, size_t key_size) const {
+  return match(key, key_size) >= 0;
+}
+
+ssize_t SSTableKeyMatcher::match(const void* key, size_t key_size) const {
+  auto prefix_size = literal_prefix_.size();
+  if (key_size < prefix_size ||
+      memcmp(key, literal_prefix_.data(), prefix_size) != 0) {
+    return -1;
+  }
+
+  auto data = (const unsigned char*) key;
+  if (!is_dfa_) {
+    return matchNFA(data + prefix_size, key_size - prefix_size);
+  }
+
+  auto state = prefix_state_;
+  for (size_t i = prefix_size; i < key_size && state != 0; ++i) {
+    state = transitions_[state * num_classes_ + byte_class_[data[i]]];
+  }
+
+  return accept_[state];
+}
+
+const String& SSTableKeyMatcher::literalPrefix() const {
+  return literal_prefix_;
+}
+
+bool SSTableKeyMatcher::isDFA() const {
+  return is_dfa_;
+}
+
+size_t SSTableKeyMatcher::numStates() const {
+  return is_dfa_ ? accept_.size() : nfa_states_.size();
+}
+
+}
+}
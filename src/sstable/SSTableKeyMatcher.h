@@ -0,0 +1,129 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <bitset>
+#include <stx/stdtypes.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * Matches row keys against one or more regular expressions. The patterns are
+ * compiled once into a DFA; matching a key takes one table lookup per byte
+ * and does not allocate. Like std::regex_match, a pattern must match the
+ * whole key.
+ *
+ * The supported syntax is the regular subset of ECMAScript regexes: literals,
+ * '.', character classes ([a-z], [^...], \d, \w, \s and their negations),
+ * groups ('(...)', '(?:...)'), alternation ('|') and the quantifiers '*',
+ * '+', '?', '{n}', '{n,}' and '{n,m}' (lazy quantifiers behave like greedy
+ * ones). '^' and '$' are only allowed at the beginning and end of a pattern.
+ * Backreferences, assertions and lookaheads are not supported.
+ *
+ * The longest literal prefix shared by all matching keys is extracted from
+ * the patterns and checked with memcmp before the DFA runs.
+ *
+ * Some patterns (like ".*a.{12}") need exponentially many DFA states. If the
+ * DFA would have more than kMaxStates states, the matcher simulates the NFA
+ * instead, which takes time linear in the key size times the pattern size and
+ * does not allocate per key either
+ */
+class SSTableKeyMatcher {
+public:
+  static const size_t kMaxStates = 4096;
+  static const size_t kMaxRepeat = 1000;
+
+  SSTableKeyMatcher(const String& pattern);
+
+  /**
+   * Compile multiple patterns into one DFA
+   */
+  SSTableKeyMatcher(const Vector<String>& patterns);
+
+  /**
+   * Returns true if any pattern matches the key
+   */
+  bool matches(const void* key, size_t key_size) const;
+
+  /**
+   * Returns the index of the first pattern that matches the key or -1 if no
+   * pattern matches
+   */
+  ssize_t match(const void* key, size_t key_size) const;
+
+  /**
+   * Returns the literal prefix of all keys that can match
+   */
+  const String& literalPrefix() const;
+
+  /**
+   * Returns true if keys are matched with the DFA, false if the DFA would
+   * have been too large and the NFA is simulated
+   */
+  bool isDFA() const;
+
+  /**
+   * Returns the number of DFA states or, if the NFA is simulated, the number
+   * of NFA states
+   */
+  size_t numStates() const;
+
+protected:
+
+  struct NFAState {
+    int32_t accept;
+    uint32_t next;
+    uint32_t eps_begin;
+    uint32_t eps_end;
+  };
+
+  struct NFAScratch {
+    Vector<uint32_t> current;
+    Vector<uint32_t> next;
+    Vector<uint32_t> stack;
+    Vector<uint64_t> marks;
+    uint64_t generation = 0;
+  };
+
+  void compile(const Vector<String>& patterns);
+
+  /**
+   * Add the state and all states reachable from it without consuming a byte
+   * to the set, skipping states that were already added in this generation
+   */
+  void addNFAState(
+      uint32_t state,
+      NFAScratch* scratch,
+      Vector<uint32_t>* set) const;
+
+  /**
+   * Compute the set of NFA states after consuming the byte from
+   * scratch->current in scratch->next
+   */
+  void stepNFA(unsigned char byte, NFAScratch* scratch) const;
+
+  ssize_t matchNFA(const unsigned char* data, size_t size) const;
+
+  String literal_prefix_;
+  uint8_t byte_class_[256];
+  size_t num_classes_;
+  Vector<uint32_t> transitions_;
+  Vector<int32_t> accept_;
+  uint32_t prefix_state_;
+
+  bool is_dfa_;
+  Vector<NFAState> nfa_states_;
+  Vector<std::bitset<256>> nfa_chars_;
+  Vector<uint32_t> nfa_eps_;
+  Vector<uint32_t> nfa_prefix_states_;
+};
+
+}
+}
@@ -0,0 +1,252 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <algorithm>
+#include <stx/exception.h>
+#include <stx/ieee754.h>
+#include <stx/util/binarymessagewriter.h>
+#include <stx/util/binarymessagereader.h>
+#include <sstable/SSTableQuantileSketch.h>
+
+namespace stx {
+namespace sstable {
+
+static const uint64_t kRandomSeed = 0x2545f4914f6cdd1dull;
+
+SSTableQuantileSketch::SSTableQuantileSketch(
+    size_t k) :
+    k_(k),
+    count_(0),
+    min_(0),
+    max_(0),
+    size_(0),
+    max_size_(0),
+    random_(kRandomSeed) {
+  if (k_ < 8) {
+    RAISEF(kIllegalArgumentError, "k must be at least 8: $0", k);
+  }
+}
+
+/**
+ * The capacity shrinks by a factor of 2/3 per level below the top level
+ */
+size_t SSTableQuantileSketch::capacity(size_t level) const {
+  auto depth = compactors_.size() - level - 1;
+  return std::max(size_t(2), size_t(ceil(k_ * pow(2.0 / 3.0, depth))) + 1);
+}
+
+void SSTableQuantileSketch::grow() {
+  compactors_.emplace_back();
+
+  max_size_ = 0;
+  for (size_t h = 0; h < compactors_.size(); ++h) {
+    max_size_ += capacity(h);
+  }
+}
+
+/**
+ * Compact the lowest compactor that exceeds its capacity: sort it and promote
+ * the items at either the odd or the even positions (chosen at random) to the
+ * next compactor. If it holds an odd number of items, the largest is kept
+ */
+void SSTableQuantileSketch::compress() {
+  for (size_t h = 0; h < compactors_.size(); ++h) {
+    if (compactors_[h].size() < capacity(h)) {
+      continue;
+    }
+
+    if (h + 1 == compactors_.size()) {
+      grow();
+    }
+
+    auto& items = compactors_[h];
+    std::sort(items.begin(), items.end());
+
+    double last = 0;
+    auto keep_last = items.size() % 2 == 1;
+    if (keep_last) {
+      last = items.back();
+      items.pop_back();
+    }
+
+    /* xorshift64 */
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 7;
+    random_ ^= random_ << 17;
+
+    auto& next = compactors_[h + 1];
+    for (size_t i = random_ & 1; i < items.size(); i += 2) {
+      next.emplace_back(items[i]);
+    }
+
+    items.clear();
+    if (keep_last) {
+      items.emplace_back(last);
+    }
+
+    size_ = 0;
+    for (const auto& c : compactors_) {
+      size_ += c.size();
+    }
+
+    return;
+  }
+}
+
+void SSTableQuantileSketch::add(double value) {
+  if (compactors_.empty()) {
+    grow();
+  }
+
+  if (count_ == 0 || value < min_) {
+    min_ = value;
+  }
+
+  if (count_ == 0 || value > max_) {
+    max_ = value;
+  }
+
+  compactors_[0].emplace_back(value);
+  ++count_;
+
+  if (++size_ >= max_size_) {
+    compress();
+  }
+}
+
+void SSTableQuantileSketch::merge(const SSTableQuantileSketch& other) {
+  if (other.count_ == 0) {
+    return;
+  }
+
+  if (other.k_ != k_) {
+    RAISE(kIllegalArgumentError, "can't merge sketches with a different k");
+  }
+
+  if (count_ == 0 || other.min_ < min_) {
+    min_ = other.min_;
+  }
+
+  if (count_ == 0 || other.max_ > max_) {
+    max_ = other.max_;
+  }
+
+  while (compactors_.size() < other.compactors_.size()) {
+    grow();
+  }
+
+  for (size_t h = 0; h < other.compactors_.size(); ++h) {
+    compactors_[h].insert(
+        compactors_[h].end(),
+        other.compactors_[h].begin(),
+        other.compactors_[h].end());
+  }
+
+  count_ += other.count_;
+  size_ += other.size_;
+
+  while (size_ >= max_size_) {
+    compress();
+  }
+}
+
+uint64_t SSTableQuantileSketch::count() const {
+  return count_;
+}
+
+double SSTableQuantileSketch::quantile(double q) const {
+  if (count_ == 0) {
+    RAISE(kIllegalStateError, "the sketch is empty");
+  }
+
+  if (!(q >= 0 && q <= 1)) {
+    RAISEF(kIllegalArgumentError, "quantile must be in [0, 1]: $0", q);
+  }
+
+  if (q == 0) {
+    return min_;
+  }
+
+  if (q == 1) {
+    return max_;
+  }
+
+  /* an item in compactor h stands for 2^h values */
+  Vector<std::pair<double, uint64_t>> items;
+  items.reserve(size_);
+  for (size_t h = 0; h < compactors_.size(); ++h) {
+    for (auto v : compactors_[h]) {
+      items.emplace_back(v, uint64_t(1) << h);
+    }
+  }
+
+  std::sort(items.begin(), items.end());
+
+  auto target = q * count_;
+  uint64_t rank = 0;
+  for (const auto& item : items) {
+    rank += item.second;
+    if (rank >= target) {
+      return item.first;
+    }
+  }
+
+  return max_;
+}
+
+size_t SSTableQuantileSketch::numRetained() const {
+  return size_;
+}
+
+void SSTableQuantileSketch::encode(Buffer* buf) const {
+  util::BinaryMessageWriter writer;
+  writer.appendVarUInt(k_);
+  writer.appendVarUInt(count_);
+  writer.appendUInt64(IEEE754::toBytes(min_));
+  writer.appendUInt64(IEEE754::toBytes(max_));
+  writer.appendUInt64(random_);
+  writer.appendVarUInt(compactors_.size());
+
+  for (const auto& c : compactors_) {
+    writer.appendVarUInt(c.size());
+    for (auto v : c) {
+      writer.appendUInt64(IEEE754::toBytes(v));
+    }
+  }
+
+  buf->append(writer.data(), writer.size());
+}
+
+void SSTableQuantileSketch::decode(const Buffer& buf) {
+  util::BinaryMessageReader reader(buf.data(), buf.size());
+
+  k_ = reader.readVarUInt();
+  count_ = reader.readVarUInt();
+  min_ = IEEE754::fromBytes(*reader.readUInt64());
+  max_ = IEEE754::fromBytes(*reader.readUInt64());
+  random_ = *reader.readUInt64();
+
+  compactors_.clear();
+  size_ = 0;
+  auto num_compactors = reader.readVarUInt();
+  for (size_t h = 0; h < num_compactors; ++h) {
+    grow();
+
+    auto n = reader.readVarUInt();
+    for (size_t i = 0; i < n; ++i) {
+      compactors_[h].emplace_back(IEEE754::fromBytes(*reader.readUInt64()));
+    }
+
+    size_ += n;
+  }
+}
+
+}
+}
@@ -0,0 +1,76 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <stx/buffer.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * Estimates quantiles of a stream of numbers with a KLL sketch.
+ *
+ * The sketch keeps a stack of compactors; the items in compactor h each
+ * stand for 2^h input values. Once the sketch is full, the lowest compactor
+ * that exceeds its capacity is sorted and every other item is promoted to the
+ * next compactor. With k = kDefaultK the sketch keeps at most about 3k items
+ * (~5KB) and the rank error of a quantile is about 1.7% (of the number of
+ * values).
+ *
+ * The compactions are randomized with a fixed seed, so adding the same values
+ * in the same order always gives the same result. Two sketches can be merged
+ */
+class SSTableQuantileSketch {
+public:
+  static const size_t kDefaultK = 200;
+
+  SSTableQuantileSketch(size_t k = kDefaultK);
+
+  void add(double value);
+
+  void merge(const SSTableQuantileSketch& other);
+
+  /**
+   * Returns the number of values added
+   */
+  uint64_t count() const;
+
+  /**
+   * Returns an (added) value whose rank is approximately q * count(). The
+   * minimum (q = 0) and maximum (q = 1) are exact. Raises an error if the
+   * sketch is empty
+   */
+  double quantile(double q) const;
+
+  /**
+   * Returns the number of items retained by the sketch
+   */
+  size_t numRetained() const;
+
+  void encode(Buffer* buf) const;
+  void decode(const Buffer& buf);
+
+protected:
+  size_t capacity(size_t level) const;
+  void grow();
+  void compress();
+
+  size_t k_;
+  uint64_t count_;
+  double min_;
+  double max_;
+  size_t size_;
+  size_t max_size_;
+  uint64_t random_;
+  Vector<Vector<double>> compactors_;
+};
+
+}
+}
@@ -0,0 +1,271 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <sys/stat.h>
+#include <stx/exception.h>
+#include <sstable/SSTableReaderCache.h>
+
+namespace stx {
+namespace sstable {
+
+bool SSTableReaderCache::FileIdentity::operator==(
+    const FileIdentity& other) const {
+  return
+      device == other.device &&
+      inode == other.inode &&
+      size == other.size &&
+      mtime_nanos == other.mtime_nanos;
+}
+
+bool SSTableReaderCache::FileIdentity::operator!=(
+    const FileIdentity& other) const {
+  return !(*this == other);
+}
+
+SSTableReaderCache::Table::Table(
+    const String& path,
+    RefPtr<VFSFile> file,
+    const FileIdentity& identity) :
+    path_(path),
+    file_(file),
+    identity_(identity),
+    schema_(new SSTableColumnSchema()) {
+  auto reader = openReader();
+  if (reader->bodySize() == 0) {
+    RAISEF(
+        kIllegalStateError,
+        "sstable is unfinished (body_size == 0): $0",
+        path);
+  }
+
+  schema_->loadIndex(reader.get());
+
+  if (reader->hasFooter(SSTableZoneMap::kSSTableIndexID)) {
+    zone_map_.reset(new SSTableZoneMap(schema_.get()));
+    zone_map_->loadIndex(reader.get());
+  }
+
+  if (reader->hasFooter(SSTableKeyIndex::kSSTableIndexID)) {
+    key_index_.reset(new SSTableKeyIndex());
+    key_index_->loadIndex(reader.get());
+  }
+
+  if (reader->hasFooter(SSTableBloomFilter::kSSTableIndexID)) {
+    bloom_filter_.reset(new SSTableBloomFilter());
+    bloom_filter_->loadIndex(reader.get());
+  }
+}
+
+std::unique_ptr<SSTableReader> SSTableReaderCache::Table::openReader() const {
+  return std::unique_ptr<SSTableReader>(new SSTableReader(file_));
+}
+
+const SSTableZoneMap* SSTableReaderCache::Table::zoneMap() const {
+  return zone_map_.get();
+}
+
+const SSTableKeyIndex* SSTableReaderCache::Table::keyIndex() const {
+  return key_index_.get();
+}
+
+const SSTableBloomFilter* SSTableReaderCache::Table::bloomFilter() const {
+  return bloom_filter_.get();
+}
+
+SSTableColumnSchema* SSTableReaderCache::Table::schema() const {
+  return schema_.get();
+}
+
+const String& SSTableReaderCache::Table::path() const {
+  return path_;
+}
+
+const SSTableReaderCache::FileIdentity&
+    SSTableReaderCache::Table::identity() const {
+  return identity_;
+}
+
+bool SSTableReaderCache::getFileIdentity(
+    const String& path,
+    FileIdentity* identity) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    return false;
+  }
+
+  identity->device = st.st_dev;
+  identity->inode = st.st_ino;
+  identity->size = st.st_size;
+  identity->mtime_nanos =
+      uint64_t(st.st_mtim.tv_sec) * 1000000000ull + st.st_mtim.tv_nsec;
+
+  return true;
+}
+
+SSTableReaderCache::FileIdentity SSTableReaderCache::resolveFileIdentity(
+    const String& path,
+    const PathResolver& resolve_path) {
+  auto file_path = resolve_path ? resolve_path(path) : path;
+
+  FileIdentity identity;
+  if (!getFileIdentity(file_path, &identity)) {
+    RAISEF(
+        kIOError,
+        "can't stat() $0, the file opened for $1; set a path resolver if "
+        "the VFS maps paths to other files",
+        file_path,
+        path);
+  }
+
+  return identity;
+}
+
+/**
+ * The file is stat()ed before and after it is opened; if the file was
+ * replaced in between, it is opened again
+ */
+std::shared_ptr<const SSTableReaderCache::Table> SSTableReaderCache::loadTable(
+    VFS* vfs,
+    const String& path,
+    const PathResolver& resolve_path) {
+  static const int kMaxAttempts = 3;
+
+  for (int attempt = 1; ; ++attempt) {
+    auto identity = resolveFileIdentity(path, resolve_path);
+    auto file = vfs->openFile(path);
+    if (resolveFileIdentity(path, resolve_path) != identity &&
+        attempt < kMaxAttempts) {
+      continue;
+    }
+
+    if (file->size() != identity.size) {
+      RAISEF(
+          kIllegalStateError,
+          "the stat()ed file for $0 is not the file opened by the VFS "
+          "($1 != $2 bytes); set a path resolver if the VFS maps paths to "
+          "other files",
+          path,
+          identity.size,
+          file->size());
+    }
+
+    return std::make_shared<const Table>(path, file, identity);
+  }
+}
+
+SSTableReaderCache::SSTableReaderCache(
+    VFS* vfs,
+    size_t max_entries,
+    PathResolver resolve_path) :
+    vfs_(vfs),
+    max_entries_(max_entries),
+    resolve_path_(resolve_path),
+    num_hits_(0),
+    num_misses_(0),
+    num_invalidations_(0),
+    num_evictions_(0) {
+  if (max_entries_ == 0) {
+    RAISE(kIllegalArgumentError, "max_entries must be greater than 0");
+  }
+}
+
+/**
+ * The table is loaded without holding the lock, so a slow load doesn't block
+ * lookups of other tables. If two threads load the same table at the same
+ * time, the table that is loaded last replaces the other one
+ */
+std::shared_ptr<const SSTableReaderCache::Table> SSTableReaderCache::get(
+    const String& path) {
+  auto identity = resolveFileIdentity(path, resolve_path_);
+
+  {
+    std::unique_lock<std::mutex> lk(mutex_);
+    auto iter = entries_.find(path);
+    if (iter != entries_.end()) {
+      if (iter->second->second->identity() == identity) {
+        lru_.splice(lru_.begin(), lru_, iter->second);
+        ++num_hits_;
+        return iter->second->second;
+      }
+
+      lru_.erase(iter->second);
+      entries_.erase(iter);
+      ++num_invalidations_;
+    }
+
+    ++num_misses_;
+  }
+
+  auto table = loadTable(vfs_, path, resolve_path_);
+
+  std::unique_lock<std::mutex> lk(mutex_);
+  auto iter = entries_.find(path);
+  if (iter != entries_.end()) {
+    lru_.erase(iter->second);
+    entries_.erase(iter);
+  }
+
+  lru_.emplace_front(path, table);
+  entries_[path] = lru_.begin();
+
+  while (lru_.size() > max_entries_) {
+    entries_.erase(lru_.back().first);
+    lru_.pop_back();
+    ++num_evictions_;
+  }
+
+  return table;
+}
+
+void SSTableReaderCache::invalidate(const String& path) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  auto iter = entries_.find(path);
+  if (iter != entries_.end()) {
+    lru_.erase(iter->second);
+    entries_.erase(iter);
+  }
+}
+
+void SSTableReaderCache::clear() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  lru_.clear();
+  entries_.clear();
+}
+
+size_t SSTableReaderCache::size() const {
+  std::unique_lock<std::mutex> lk(mutex_);
+  return lru_.size();
+}
+
+size_t SSTableReaderCache::maxEntries() const {
+  return max_entries_;
+}
+
+uint64_t SSTableReaderCache::numHits() const {
+  std::unique_lock<std::mutex> lk(mutex_);
+  return num_hits_;
+}
+
+uint64_t SSTableReaderCache::numMisses() const {
+  std::unique_lock<std::mutex> lk(mutex_);
+  return num_misses_;
+}
+
+uint64_t SSTableReaderCache::numInvalidations() const {
+  std::unique_lock<std::mutex> lk(mutex_);
+  return num_invalidations_;
+}
+
+uint64_t SSTableReaderCache::numEvictions() const {
+  std::unique_lock<std::mutex> lk(mutex_);
+  return num_evictions_;
+}
+
+}
+}
@@ -0,0 +1,177 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <list>
+#include <mutex>
+#include <stx/stdtypes.h>
+#include <stx/VFS.h>
+#include <sstable/sstablereader.h>
+#include <sstable/SSTableColumnSchema.h>
+#include <sstable/SSTableZoneMap.h>
+#include <sstable/SSTableKeyIndex.h>
+#include <sstable/SSTableBloomFilter.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * Caches the opened file and the parsed schema, zone map, key index and bloom
+ * filter of up to max_entries sstables, keyed by path. The least recently
+ * used table is evicted first.
+ *
+ * Each lookup stat()s the file that the VFS opens for the path; if the
+ * device, inode, size or mtime of the file changed since it was cached, the
+ * table is loaded again. The VFS may map paths to other files, so the file
+ * is found with a PathResolver (the path itself by default). Lookups raise
+ * an error if the file can't be stat()ed or if the stat()ed file is not the
+ * file that the VFS opened (its size differs).
+ *
+ * The cache can be used from multiple threads. A table is never modified once
+ * it was loaded, so the returned tables can be shared by concurrent requests,
+ * but each request has to open its own reader (and cursor) with
+ * Table::openReader, since readers are not thread safe. A table stays valid
+ * until the last reference to it is dropped, even if it was evicted
+ */
+class SSTableReaderCache {
+public:
+  static const size_t kDefaultMaxEntries = 256;
+
+  struct FileIdentity {
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    uint64_t mtime_nanos;
+
+    bool operator==(const FileIdentity& other) const;
+    bool operator!=(const FileIdentity& other) const;
+  };
+
+  /**
+   * Returns the local path of the file that the VFS opens for a path
+   */
+  typedef Function<String (const String& path)> PathResolver;
+
+  class Table {
+  public:
+    Table(
+        const String& path,
+        RefPtr<VFSFile> file,
+        const FileIdentity& identity);
+
+    /**
+     * Returns a new reader for the cached file; opening a reader only parses
+     * the meta page
+     */
+    std::unique_ptr<SSTableReader> openReader() const;
+
+    /**
+     * Returns the zone map, key index or bloom filter or nullptr if the table
+     * has none
+     */
+    const SSTableZoneMap* zoneMap() const;
+    const SSTableKeyIndex* keyIndex() const;
+    const SSTableBloomFilter* bloomFilter() const;
+
+    /**
+     * The schema is not modified by scans; the pointer is not const since
+     * SSTableScan expects a mutable schema
+     */
+    SSTableColumnSchema* schema() const;
+
+    const String& path() const;
+
+    /**
+     * Returns the identity of the file when it was opened, e.g. to bind data
+     * like continuation tokens to the version of the file
+     */
+    const FileIdentity& identity() const;
+
+  protected:
+    String path_;
+    RefPtr<VFSFile> file_;
+    FileIdentity identity_;
+    std::unique_ptr<SSTableColumnSchema> schema_;
+    std::unique_ptr<SSTableZoneMap> zone_map_;
+    std::unique_ptr<SSTableKeyIndex> key_index_;
+    std::unique_ptr<SSTableBloomFilter> bloom_filter_;
+  };
+
+  /**
+   * Returns false if the file can't be stat()ed
+   */
+  static bool getFileIdentity(const String& path, FileIdentity* identity);
+
+  /**
+   * Open the table with the VFS without caching it. resolve_path returns the
+   * file that the VFS opens (nullptr: the path itself). Raises an error if
+   * that file can't be stat()ed or is not the opened file
+   */
+  static std::shared_ptr<const Table> loadTable(
+      VFS* vfs,
+      const String& path,
+      const PathResolver& resolve_path = nullptr);
+
+  SSTableReaderCache(
+      VFS* vfs,
+      size_t max_entries = kDefaultMaxEntries,
+      PathResolver resolve_path = nullptr);
+
+  /**
+   * Returns the cached table or opens and caches the table. Raises an error
+   * if the table can't be opened or is unfinished
+   */
+  std::shared_ptr<const Table> get(const String& path);
+
+  /**
+   * Drop a table from the cache
+   */
+  void invalidate(const String& path);
+
+  void clear();
+
+  size_t size() const;
+  size_t maxEntries() const;
+
+  /**
+   * Returns the number of lookups that were served from the cache, the number
+   * of tables that were loaded, the number of cached tables that were loaded
+   * again since the file changed and the number of evicted tables
+   */
+  uint64_t numHits() const;
+  uint64_t numMisses() const;
+  uint64_t numInvalidations() const;
+  uint64_t numEvictions() const;
+
+protected:
+
+  typedef std::list<std::pair<String, std::shared_ptr<const Table>>> LRUList;
+
+  /**
+   * Returns the identity of the file that the VFS opens for the path or
+   * raises an error
+   */
+  static FileIdentity resolveFileIdentity(
+      const String& path,
+      const PathResolver& resolve_path);
+
+  VFS* vfs_;
+  size_t max_entries_;
+  PathResolver resolve_path_;
+  mutable std::mutex mutex_;
+  LRUList lru_;
+  HashMap<String, LRUList::iterator> entries_;
+  uint64_t num_hits_;
+  uint64_t num_misses_;
+  uint64_t num_invalidations_;
+  uint64_t num_evictions_;
+};
+
+}
+}
@@ -0,0 +1,340 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <stx/exception.h>
+#include <stx/stringutil.h>
+#include <sstable/SSTableResultReader.h>
+#include <sstable/SSTableResultWriter.h>
+
+namespace stx {
+namespace sstable {
+
+static size_t valueSize(SSTableColumnType type) {
+  switch (type) {
+    case SSTableColumnType::UINT64:
+    case SSTableColumnType::FLOAT:
+      return 8;
+    case SSTableColumnType::UINT32:
+    case SSTableColumnType::STRING:
+      return 4;
+  }
+
+  return 0;
+}
+
+SSTableResultReader::SSTableResultReader() :
+    pos_(0),
+    has_header_(false),
+    finished_(false),
+    batch_rows_(0),
+    num_rows_(0) {}
+
+void SSTableResultReader::addData(const void* data, size_t size) {
+  buf_.append((const char*) data, size);
+}
+
+bool SSTableResultReader::readUInt32(size_t offset, uint32_t* value) const {
+  if (offset + sizeof(uint32_t) > buf_.size()) {
+    return false;
+  }
+
+  memcpy(value, buf_.data() + offset, sizeof(uint32_t));
+  return true;
+}
+
+bool SSTableResultReader::readHeader() {
+  size_t pos = pos_;
+
+  uint32_t magic;
+  if (!readUInt32(pos, &magic)) {
+    return false;
+  }
+
+  if (magic != SSTableResultWriter::kBinaryMagic) {
+    RAISE(kParseError, "not a binary sstable result");
+  }
+
+  pos += sizeof(uint32_t);
+  if (pos + 1 > buf_.size()) {
+    return false;
+  }
+
+  auto version = (uint8_t) buf_[pos];
+  if (version != SSTableResultWriter::kBinaryVersion) {
+    RAISEF(kParseError, "unsupported binary result version: $0", version);
+  }
+
+  pos += 1;
+
+  uint32_t num_columns;
+  if (!readUInt32(pos, &num_columns)) {
+    return false;
+  }
+
+  pos += sizeof(uint32_t);
+
+  Vector<String> columns;
+  Vector<SSTableColumnType> column_types;
+  for (size_t i = 0; i < num_columns; ++i) {
+    if (pos + 1 > buf_.size()) {
+      return false;
+    }
+
+    auto type = (SSTableColumnType) buf_[pos];
+    if (valueSize(type) == 0) {
+      RAISEF(kParseError, "invalid column type: $0", (int) type);
+    }
+
+    pos += 1;
+
+    uint32_t name_size;
+    if (!readUInt32(pos, &name_size)) {
+      return false;
+    }
+
+    pos += sizeof(uint32_t);
+    if (pos + name_size > buf_.size()) {
+      return false;
+    }
+
+    columns.emplace_back(buf_.data() + pos, name_size);
+    column_types.emplace_back(type);
+    pos += name_size;
+  }
+
+  columns_ = columns;
+  column_types_ = column_types;
+  has_header_ = true;
+  pos_ = pos;
+  return true;
+}
+
+/**
+ * The data of the previous batch is dropped from the buffer before the next
+ * batch is read
+ */
+bool SSTableResultReader::nextBatch() {
+  if (finished_) {
+    return false;
+  }
+
+  if (!has_header_ && !readHeader()) {
+    return false;
+  }
+
+  buf_.erase(0, pos_);
+  pos_ = 0;
+  batch_.clear();
+  batch_rows_ = 0;
+
+  uint32_t size;
+  if (!readUInt32(0, &size)) {
+    return false;
+  }
+
+  if (size == 0) {
+    finished_ = true;
+    pos_ = sizeof(uint32_t);
+    return false;
+  }
+
+  auto end = sizeof(uint32_t) + size;
+  if (end > buf_.size()) {
+    return false;
+  }
+
+  uint32_t num_rows;
+  if (size < sizeof(uint32_t) || !readUInt32(sizeof(uint32_t), &num_rows)) {
+    RAISE(kParseError, "corrupt record batch");
+  }
+
+  size_t pos = sizeof(uint32_t) * 2;
+  Vector<ColumnOffsets> batch;
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    ColumnOffsets column;
+    column.validity = pos;
+    pos += (num_rows + 7) / 8;
+
+    column.values = pos;
+    column.string_data = 0;
+    column.string_data_size = 0;
+    if (column_types_[i] == SSTableColumnType::STRING) {
+      pos += (num_rows + 1) * sizeof(uint32_t);
+
+      uint32_t string_data_size;
+      if (pos > end || !readUInt32(pos - sizeof(uint32_t), &string_data_size)) {
+        RAISE(kParseError, "corrupt record batch");
+      }
+
+      column.string_data = pos;
+      column.string_data_size = string_data_size;
+      pos += string_data_size;
+    } else {
+      pos += num_rows * valueSize(column_types_[i]);
+    }
+
+    if (pos > end) {
+      RAISE(kParseError, "corrupt record batch");
+    }
+
+    batch.emplace_back(column);
+  }
+
+  if (pos != end) {
+    RAISE(kParseError, "corrupt record batch");
+  }
+
+  batch_ = batch;
+  batch_rows_ = num_rows;
+  num_rows_ += num_rows;
+  pos_ = end;
+  return true;
+}
+
+bool SSTableResultReader::hasHeader() const {
+  return has_header_;
+}
+
+bool SSTableResultReader::isFinished() const {
+  return finished_;
+}
+
+const Vector<String>& SSTableResultReader::columnNames() const {
+  return columns_;
+}
+
+const Vector<SSTableColumnType>& SSTableResultReader::columnTypes() const {
+  return column_types_;
+}
+
+size_t SSTableResultReader::numRows() const {
+  return batch_rows_;
+}
+
+uint64_t SSTableResultReader::numRowsTotal() const {
+  return num_rows_;
+}
+
+const char* SSTableResultReader::valuePointer(
+    size_t column,
+    size_t row,
+    SSTableColumnType type) const {
+  if (column >= batch_.size()) {
+    RAISEF(kIndexError, "invalid column index: $0", column);
+  }
+
+  if (row >= batch_rows_) {
+    RAISEF(kIndexError, "invalid row index: $0", row);
+  }
+
+  if (column_types_[column] != type) {
+    RAISEF(
+        kIllegalArgumentError,
+        "column $0 has a different type",
+        columns_[column]);
+  }
+
+  return buf_.data() + batch_[column].values + row * valueSize(type);
+}
+
+bool SSTableResultReader::hasValue(size_t column, size_t row) const {
+  if (column >= batch_.size() || row >= batch_rows_) {
+    return false;
+  }
+
+  auto validity = (uint8_t) buf_[batch_[column].validity + row / 8];
+  return (validity & (1 << (row % 8))) != 0;
+}
+
+uint32_t SSTableResultReader::getUInt32(size_t column, size_t row) const {
+  uint32_t value;
+  memcpy(
+      &value,
+      valuePointer(column, row, SSTableColumnType::UINT32),
+      sizeof(value));
+
+  return value;
+}
+
+uint64_t SSTableResultReader::getUInt64(size_t column, size_t row) const {
+  if (column < column_types_.size() &&
+      column_types_[column] == SSTableColumnType::UINT32) {
+    return getUInt32(column, row);
+  }
+
+  uint64_t value;
+  memcpy(
+      &value,
+      valuePointer(column, row, SSTableColumnType::UINT64),
+      sizeof(value));
+
+  return value;
+}
+
+double SSTableResultReader::getFloat(size_t column, size_t row) const {
+  if (column < column_types_.size()) {
+    switch (column_types_[column]) {
+      case SSTableColumnType::UINT32:
+      case SSTableColumnType::UINT64:
+        return getUInt64(column, row);
+      default:
+        break;
+    }
+  }
+
+  double value;
+  memcpy(
+      &value,
+      valuePointer(column, row, SSTableColumnType::FLOAT),
+      sizeof(value));
+
+  return value;
+}
+
+SSTableStringView SSTableResultReader::getString(
+    size_t column,
+    size_t row) const {
+  uint32_t offsets[2];
+  memcpy(
+      offsets,
+      valuePointer(column, row, SSTableColumnType::STRING),
+      sizeof(offsets));
+
+  if (offsets[0] > offsets[1] ||
+      offsets[1] > batch_[column].string_data_size) {
+    RAISE(kParseError, "corrupt record batch");
+  }
+
+  return SSTableStringView {
+    buf_.data() + batch_[column].string_data + offsets[0],
+    offsets[1] - offsets[0]
+  };
+}
+
+String SSTableResultReader::getValueAsString(size_t column, size_t row) const {
+  if (!hasValue(column, row)) {
+    return "";
+  }
+
+  switch (column_types_[column]) {
+    case SSTableColumnType::UINT32:
+    case SSTableColumnType::UINT64:
+      return StringUtil::toString(getUInt64(column, row));
+    case SSTableColumnType::FLOAT:
+      return StringUtil::toString(getFloat(column, row));
+    case SSTableColumnType::STRING:
+      return getString(column, row).toString();
+  }
+
+  return "";
+}
+
+}
+}
@@ -0,0 +1,125 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <sstable/SSTableColumnSchema.h>
+#include <sstable/SSTableRowView.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * Decodes a result in the BINARY format of SSTableResultWriter, one record
+ * batch at a time. The data can be added in pieces of any size as it is
+ * received:
+ *
+ *   SSTableResultReader reader;
+ *   while (...) {
+ *     reader.addData(data, size);
+ *     while (reader.nextBatch()) {
+ *       for (size_t row = 0; row < reader.numRows(); ++row) {
+ *         reader.getUInt64(0, row);
+ *         ...
+ *       }
+ *     }
+ *   }
+ *
+ * The values are read from the buffered batch without copying; strings are
+ * only valid until the next call to nextBatch
+ */
+class SSTableResultReader {
+public:
+
+  SSTableResultReader();
+
+  void addData(const void* data, size_t size);
+
+  /**
+   * Decode the next batch. Returns false if the added data doesn't contain
+   * the next complete batch yet or if the end of the result was reached
+   * (see isFinished). Raises an error if the data is not a valid result
+   */
+  bool nextBatch();
+
+  /**
+   * Returns true once the header was decoded
+   */
+  bool hasHeader() const;
+
+  /**
+   * Returns true once the end of the result was decoded
+   */
+  bool isFinished() const;
+
+  const Vector<String>& columnNames() const;
+  const Vector<SSTableColumnType>& columnTypes() const;
+
+  /**
+   * Returns the number of rows in the current batch
+   */
+  size_t numRows() const;
+
+  /**
+   * Returns the number of rows in all decoded batches
+   */
+  uint64_t numRowsTotal() const;
+
+  /**
+   * Returns false if the row of the current batch has no value for the
+   * column; the typed accessors return 0 or an empty string for these rows.
+   * getUInt64 also reads UINT32 columns and getFloat reads all numeric
+   * columns
+   */
+  bool hasValue(size_t column, size_t row) const;
+  uint32_t getUInt32(size_t column, size_t row) const;
+  uint64_t getUInt64(size_t column, size_t row) const;
+  double getFloat(size_t column, size_t row) const;
+  SSTableStringView getString(size_t column, size_t row) const;
+
+  /**
+   * Returns the value formatted like in the CSV format
+   */
+  String getValueAsString(size_t column, size_t row) const;
+
+protected:
+
+  /* offsets of the column buffers in buf_ */
+  struct ColumnOffsets {
+    size_t validity;
+    size_t values;
+    size_t string_data;
+    size_t string_data_size;
+  };
+
+  bool readHeader();
+
+  /**
+   * Returns false if less than four bytes are buffered at the offset
+   */
+  bool readUInt32(size_t offset, uint32_t* value) const;
+
+  const char* valuePointer(
+      size_t column,
+      size_t row,
+      SSTableColumnType type) const;
+
+  String buf_;
+  size_t pos_;
+  bool has_header_;
+  bool finished_;
+  Vector<String> columns_;
+  Vector<SSTableColumnType> column_types_;
+  Vector<ColumnOffsets> batch_;
+  size_t batch_rows_;
+  uint64_t num_rows_;
+};
+
+}
+}
@@ -0,0 +1,312 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stx/exception.h>
+#include <stx/stringutil.h>
+#include <sstable/SSTableResultWriter.h>
+
+namespace stx {
+namespace sstable {
+
+SSTableResultWriter::Format SSTableResultWriter::formatFromString(
+    const String& format) {
+  if (format == "csv") {
+    return Format::CSV;
+  }
+
+  if (format == "json") {
+    return Format::JSON;
+  }
+
+  if (format == "binary") {
+    return Format::BINARY;
+  }
+
+  RAISEF(kIllegalArgumentError, "invalid format: $0", format);
+}
+
+SSTableResultWriter::SSTableResultWriter(
+    Format format,
+    const Vector<String>& columns,
+    Function<void (const String& data)> flush_fn,
+    size_t flush_size) :
+    SSTableResultWriter(
+        format,
+        columns,
+        Vector<SSTableColumnType>(columns.size(), SSTableColumnType::STRING),
+        flush_fn,
+        flush_size) {}
+
+SSTableResultWriter::SSTableResultWriter(
+    Format format,
+    const Vector<String>& columns,
+    const Vector<SSTableColumnType>& column_types,
+    Function<void (const String& data)> flush_fn,
+    size_t flush_size,
+    size_t batch_size) :
+    format_(format),
+    columns_(columns),
+    column_types_(column_types),
+    batch_size_(batch_size),
+    batch_rows_(0),
+    batch_bytes_(0),
+    flush_fn_(flush_fn),
+    flush_size_(flush_size),
+    num_rows_(0),
+    num_bytes_flushed_(0) {
+  if (column_types_.size() != columns_.size()) {
+    RAISEF(
+        kIllegalArgumentError,
+        "expected $0 column types, got $1",
+        columns_.size(),
+        column_types_.size());
+  }
+
+  if (batch_size_ == 0) {
+    RAISE(kIllegalArgumentError, "batch size must be greater than 0");
+  }
+
+  switch (format_) {
+    case Format::CSV:
+      buf_.append(StringUtil::join(columns_, ";"));
+      buf_.append("\n");
+      break;
+    case Format::JSON:
+      buf_.append("[");
+      break;
+    case Format::BINARY:
+      appendBinaryValue<uint32_t>(&buf_, kBinaryMagic);
+      appendBinaryValue<uint8_t>(&buf_, kBinaryVersion);
+      appendBinaryValue<uint32_t>(&buf_, columns_.size());
+      for (size_t i = 0; i < columns_.size(); ++i) {
+        appendBinaryValue<uint8_t>(&buf_, (uint8_t) column_types_[i]);
+        appendBinaryValue<uint32_t>(&buf_, columns_[i].size());
+        buf_.append(columns_[i]);
+      }
+
+      batch_.resize(columns_.size());
+      break;
+  }
+}
+
+void SSTableResultWriter::addRow(const SSTableRowView& row) {
+  switch (format_) {
+
+    case Format::CSV:
+      for (size_t i = 0; i < row.size(); ++i) {
+        if (i > 0) buf_ += ';';
+        auto v = row.getString(i);
+        buf_.append(v.data, v.size);
+      }
+      buf_ += '\n';
+      break;
+
+    case Format::JSON:
+      if (num_rows_ > 0) buf_ += ',';
+      buf_ += '{';
+      for (size_t i = 0; i < row.size(); ++i) {
+        if (i > 0) buf_ += ',';
+        appendJSONString(columns_[i].data(), columns_[i].size());
+        buf_ += ':';
+        auto v = row.getString(i);
+        appendJSONString(v.data, v.size);
+      }
+      buf_ += '}';
+      break;
+
+    case Format::BINARY:
+      appendBinaryRow(row);
+      if (batch_rows_ >= batch_size_ || batch_bytes_ >= flush_size_) {
+        appendBinaryBatch();
+      }
+      break;
+
+  }
+
+  ++num_rows_;
+
+  if (buf_.size() >= flush_size_) {
+    flush();
+  }
+}
+
+void SSTableResultWriter::appendJSONString(const char* data, size_t size) {
+  buf_ += '"';
+
+  for (size_t i = 0; i < size; ++i) {
+    auto c = (unsigned char) data[i];
+    switch (c) {
+      case '"': buf_.append("\\\""); break;
+      case '\\': buf_.append("\\\\"); break;
+      case '\b': buf_.append("\\b"); break;
+      case '\f': buf_.append("\\f"); break;
+      case '\n': buf_.append("\\n"); break;
+      case '\r': buf_.append("\\r"); break;
+      case '\t': buf_.append("\\t"); break;
+      default:
+        if (c < 0x20) {
+          static const char kHex[] = "0123456789abcdef";
+          buf_.append("\\u00");
+          buf_ += kHex[c >> 4];
+          buf_ += kHex[c & 0xf];
+        } else {
+          buf_ += (char) c;
+        }
+        break;
+    }
+  }
+
+  buf_ += '"';
+}
+
+template <typename T>
+void SSTableResultWriter::appendBinaryValue(String* buf, T value) {
+  buf->append((const char*) &value, sizeof(value));
+}
+
+void SSTableResultWriter::appendBinaryRow(const SSTableRowView& row) {
+  auto bit = batch_rows_ % 8;
+
+  for (size_t i = 0; i < batch_.size(); ++i) {
+    auto& column = batch_[i];
+    if (bit == 0) {
+      column.validity += '\0';
+    }
+
+    auto has_value = i < row.size() && row.hasValue(i);
+    if (has_value) {
+      column.validity.back() |= 1 << bit;
+    }
+
+    switch (column_types_[i]) {
+
+      case SSTableColumnType::UINT32:
+        appendBinaryValue<uint32_t>(
+            &column.values,
+            has_value ? row.getUInt32(i) : 0);
+        batch_bytes_ += sizeof(uint32_t);
+        break;
+
+      case SSTableColumnType::UINT64:
+        appendBinaryValue<uint64_t>(
+            &column.values,
+            has_value ? row.getUInt64(i) : 0);
+        batch_bytes_ += sizeof(uint64_t);
+        break;
+
+      case SSTableColumnType::FLOAT:
+        appendBinaryValue<double>(
+            &column.values,
+            has_value ? row.getFloat(i) : 0);
+        batch_bytes_ += sizeof(double);
+        break;
+
+      /* the values are the end offsets of the strings */
+      case SSTableColumnType::STRING:
+        if (has_value) {
+          auto value = row.getString(i);
+          column.string_data.append(value.data, value.size);
+          batch_bytes_ += value.size;
+        }
+
+        if (column.string_data.size() > 0xffffffff) {
+          RAISE(kIllegalArgumentError, "string data exceeds 4GB");
+        }
+
+        appendBinaryValue<uint32_t>(
+            &column.values,
+            column.string_data.size());
+        batch_bytes_ += sizeof(uint32_t);
+        break;
+
+    }
+  }
+
+  ++batch_rows_;
+}
+
+void SSTableResultWriter::appendBinaryBatch() {
+  if (batch_rows_ == 0) {
+    return;
+  }
+
+  uint64_t size = sizeof(uint32_t);
+  for (size_t i = 0; i < batch_.size(); ++i) {
+    const auto& column = batch_[i];
+    size += column.validity.size();
+    size += column.values.size();
+    size += column.string_data.size();
+    if (column_types_[i] == SSTableColumnType::STRING) {
+      size += sizeof(uint32_t);
+    }
+  }
+
+  if (size > 0xffffffff) {
+    RAISE(kIllegalArgumentError, "record batch exceeds 4GB");
+  }
+
+  appendBinaryValue<uint32_t>(&buf_, size);
+  appendBinaryValue<uint32_t>(&buf_, batch_rows_);
+
+  for (size_t i = 0; i < batch_.size(); ++i) {
+    auto& column = batch_[i];
+    buf_.append(column.validity);
+    if (column_types_[i] == SSTableColumnType::STRING) {
+      appendBinaryValue<uint32_t>(&buf_, 0);
+    }
+    buf_.append(column.values);
+    buf_.append(column.string_data);
+
+    column.validity.clear();
+    column.values.clear();
+    column.string_data.clear();
+  }
+
+  batch_rows_ = 0;
+  batch_bytes_ = 0;
+}
+
+void SSTableResultWriter::finish() {
+  switch (format_) {
+    case Format::CSV:
+      break;
+    case Format::JSON:
+      buf_.append("]");
+      break;
+    case Format::BINARY:
+      appendBinaryBatch();
+      appendBinaryValue<uint32_t>(&buf_, 0);
+      break;
+  }
+}
+
+void SSTableResultWriter::flush() {
+  if (buf_.empty()) {
+    return;
+  }
+
+  flush_fn_(buf_);
+  num_bytes_flushed_ += buf_.size();
+  buf_.clear();
+}
+
+const String& SSTableResultWriter::buffer() const {
+  return buf_;
+}
+
+uint64_t SSTableResultWriter::numRows() const {
+  return num_rows_;
+}
+
+uint64_t SSTableResultWriter::numBytes() const {
+  return num_bytes_flushed_ + buf_.size();
+}
+
+}
+}
@@ -0,0 +1,141 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <sstable/SSTableRowView.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * Formats the result rows of a scan as CSV (one line per row, values
+ * separated by ';', preceded by a line with the column names), JSON (an
+ * array with one object per row) or BINARY and passes the output to a flush
+ * callback in pieces of about flush_size bytes, so a result can be streamed
+ * without buffering it.
+ *
+ * BINARY output stores the values of up to batch_size rows column by column
+ * in record batches, typed with the provided column types. All integers are
+ * little endian:
+ *
+ *   uint32  kBinaryMagic
+ *   uint8   kBinaryVersion
+ *   uint32  number of columns
+ *   per column:
+ *     uint8   type (SSTableColumnType)
+ *     uint32  size of the column name, followed by the name
+ *
+ *   per batch:
+ *     uint32  size of the batch (without this field); 0 marks the end
+ *     uint32  number of rows (n)
+ *     per column:
+ *       ceil(n / 8) bytes validity bitmap; bit i (lsb first) is set if row i
+ *                         has a value
+ *       UINT32  n x uint32
+ *       UINT64  n x uint64
+ *       FLOAT   n x double
+ *       STRING  (n + 1) x uint32 offsets into the string data, followed by
+ *               the string data (offsets[n] bytes)
+ *
+ * Rows without a value store 0 or an empty string. SSTableResultReader
+ * decodes the BINARY format.
+ *
+ * The constructor writes the CSV header, the opening bracket or the BINARY
+ * header, finish() writes the closing bracket or the last batch and the end
+ * marker. Output that has not been flushed yet is returned by buffer();
+ * flush() passes it to the callback
+ */
+class SSTableResultWriter {
+public:
+  static const size_t kDefaultFlushSize = 256 * 1024;
+  static const size_t kDefaultBatchSize = 1024;
+  static const uint32_t kBinaryMagic = 0x42545353;
+  static const uint8_t kBinaryVersion = 1;
+
+  enum class Format : uint8_t {
+    CSV,
+    JSON,
+    BINARY
+  };
+
+  /**
+   * Parse "csv", "json" or "binary"
+   */
+  static Format formatFromString(const String& format);
+
+  /**
+   * All columns are typed as STRING
+   */
+  SSTableResultWriter(
+      Format format,
+      const Vector<String>& columns,
+      Function<void (const String& data)> flush_fn,
+      size_t flush_size = kDefaultFlushSize);
+
+  /**
+   * The column types are only used by the BINARY format; see
+   * SSTableScan::columnTypes
+   */
+  SSTableResultWriter(
+      Format format,
+      const Vector<String>& columns,
+      const Vector<SSTableColumnType>& column_types,
+      Function<void (const String& data)> flush_fn,
+      size_t flush_size = kDefaultFlushSize,
+      size_t batch_size = kDefaultBatchSize);
+
+  void addRow(const SSTableRowView& row);
+
+  void finish();
+
+  void flush();
+
+  /**
+   * Returns the output that has not been flushed yet
+   */
+  const String& buffer() const;
+
+  /**
+   * Returns the number of rows and bytes written (flushed or not)
+   */
+  uint64_t numRows() const;
+  uint64_t numBytes() const;
+
+protected:
+
+  struct BinaryColumn {
+    String validity;
+    String values;
+    String string_data;
+  };
+
+  void appendJSONString(const char* data, size_t size);
+  void appendBinaryRow(const SSTableRowView& row);
+  void appendBinaryBatch();
+
+  template <typename T>
+  void appendBinaryValue(String* buf, T value);
+
+  Format format_;
+  Vector<String> columns_;
+  Vector<SSTableColumnType> column_types_;
+  size_t batch_size_;
+  Vector<BinaryColumn> batch_;
+  size_t batch_rows_;
+  size_t batch_bytes_;
+  Function<void (const String& data)> flush_fn_;
+  size_t flush_size_;
+  String buf_;
+  uint64_t num_rows_;
+  uint64_t num_bytes_flushed_;
+};
+
+}
+}
@@ -0,0 +1,255 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stx/exception.h>
+#include <stx/ieee754.h>
+#include <sstable/SSTableRowView.h>
+
+namespace stx {
+namespace sstable {
+
+String SSTableStringView::toString() const {
+  return String(data, size);
+}
+
+bool SSTableStringView::operator==(const String& other) const {
+  return size == other.size() && memcmp(data, other.data(), size) == 0;
+}
+
+SSTableRowView::SSTableRowView(
+    SSTableColumnSchema* schema,
+    const Vector<SSTableColumnID>* select_list) :
+    schema_(schema),
+    select_list_(select_list),
+    mode_(Mode::RAW),
+    key_{ "", 0 },
+    data_{ "", 0 },
+    columns_(nullptr),
+    row_(nullptr),
+    scratch_(select_list->size()) {}
+
+size_t SSTableRowView::size() const {
+  switch (mode_) {
+    case Mode::COLUMNS:
+      return select_list_->size();
+    case Mode::RAW:
+      return 2;
+    case Mode::MATERIALIZED:
+      return row_->size();
+  }
+
+  return 0;
+}
+
+SSTableStringView SSTableRowView::key() const {
+  return key_;
+}
+
+bool SSTableRowView::hasValue(size_t idx) const {
+  if (idx >= size()) {
+    return false;
+  }
+
+  if (mode_ == Mode::MATERIALIZED) {
+    return !(*row_)[idx].empty();
+  }
+
+  if (mode_ != Mode::COLUMNS || (*select_list_)[idx] == 0) {
+    return true;
+  }
+
+  return findValue(idx) != nullptr;
+}
+
+SSTableStringView SSTableRowView::getString(size_t idx) const {
+  if (idx >= size()) {
+    RAISEF(kIndexError, "invalid column index: $0", idx);
+  }
+
+  switch (mode_) {
+    case Mode::RAW:
+      return idx == 0 ? key_ : data_;
+
+    case Mode::MATERIALIZED: {
+      const auto& value = (*row_)[idx];
+      return SSTableStringView { value.data(), value.size() };
+    }
+
+    case Mode::COLUMNS:
+      break;
+  }
+
+  auto id = (*select_list_)[idx];
+  if (id == 0) {
+    return key_;
+  }
+
+  auto value = findValue(idx);
+  if (value == nullptr) {
+    return SSTableStringView { "", 0 };
+  }
+
+  auto& scratch = scratch_[idx];
+  switch (schema_->columnType(id)) {
+
+    case SSTableColumnType::UINT32:
+    case SSTableColumnType::UINT64: {
+      char buf[20];
+      size_t pos = sizeof(buf);
+      auto v = std::get<1>(*value);
+      do {
+        buf[--pos] = '0' + v % 10;
+        v /= 10;
+      } while (v > 0);
+
+      scratch.assign(buf + pos, sizeof(buf) - pos);
+      break;
+    }
+
+    case SSTableColumnType::FLOAT:
+      scratch = StringUtil::toString(IEEE754::fromBytes(std::get<1>(*value)));
+      break;
+
+    case SSTableColumnType::STRING:
+      if (schema_->columnEncoding(id) == SSTableColumnEncoding::DICTIONARY) {
+        const auto& str = schema_->dictionaryValue(id, std::get<1>(*value));
+        return SSTableStringView { str.data(), str.size() };
+      }
+
+      return SSTableStringView {
+          (const char*) std::get<1>(*value),
+          std::get<2>(*value) };
+
+  }
+
+  return SSTableStringView { scratch.data(), scratch.size() };
+}
+
+uint32_t SSTableRowView::getUInt32(size_t idx) const {
+  return getUInt64(idx);
+}
+
+uint64_t SSTableRowView::getUInt64(size_t idx) const {
+  if (mode_ == Mode::COLUMNS && idx < size() && (*select_list_)[idx] != 0) {
+    auto id = (*select_list_)[idx];
+    switch (schema_->columnType(id)) {
+      case SSTableColumnType::UINT32:
+      case SSTableColumnType::UINT64: {
+        auto value = findValue(idx);
+        if (value == nullptr) {
+          RAISEF(kIndexError, "no value for column: $0", id);
+        }
+
+        return std::get<1>(*value);
+      }
+
+      default:
+        break;
+    }
+  }
+
+  return parseUInt(idx);
+}
+
+double SSTableRowView::getFloat(size_t idx) const {
+  if (mode_ == Mode::COLUMNS && idx < size() && (*select_list_)[idx] != 0) {
+    auto id = (*select_list_)[idx];
+    auto type = schema_->columnType(id);
+    if (type != SSTableColumnType::STRING) {
+      auto value = findValue(idx);
+      if (value == nullptr) {
+        RAISEF(kIndexError, "no value for column: $0", id);
+      }
+
+      if (type == SSTableColumnType::FLOAT) {
+        return IEEE754::fromBytes(std::get<1>(*value));
+      } else {
+        return std::get<1>(*value);
+      }
+    }
+  }
+
+  auto str = getString(idx).toString();
+  char* end;
+  auto value = strtod(str.c_str(), &end);
+  if (str.empty() || *end != 0) {
+    RAISEF(kParseError, "not a number: $0", str);
+  }
+
+  return value;
+}
+
+uint64_t SSTableRowView::parseUInt(size_t idx) const {
+  auto str = getString(idx).toString();
+  char* end;
+  auto value = strtoull(str.c_str(), &end, 10);
+  if (str.empty() || *end != 0) {
+    RAISEF(kParseError, "not an unsigned integer: $0", str);
+  }
+
+  return value;
+}
+
+void SSTableRowView::copyTo(Vector<String>* row) const {
+  auto n = size();
+  row->resize(n);
+
+  for (size_t i = 0; i < n; ++i) {
+    auto value = getString(i);
+    (*row)[i].assign(value.data, value.size);
+  }
+}
+
+Vector<String> SSTableRowView::toVector() const {
+  Vector<String> row;
+  copyTo(&row);
+  return row;
+}
+
+void SSTableRowView::setRow(
+    const void* key,
+    size_t key_size,
+    const SSTableColumnReader* columns) {
+  mode_ = Mode::COLUMNS;
+  key_ = SSTableStringView { (const char*) key, key_size };
+  columns_ = columns;
+}
+
+void SSTableRowView::setRow(
+    const void* key,
+    size_t key_size,
+    const void* data,
+    size_t data_size) {
+  mode_ = Mode::RAW;
+  key_ = SSTableStringView { (const char*) key, key_size };
+  data_ = SSTableStringView { (const char*) data, data_size };
+}
+
+void SSTableRowView::setRow(const Vector<String>* row) {
+  mode_ = Mode::MATERIALIZED;
+  key_ = SSTableStringView { "", 0 };
+  row_ = row;
+}
+
+const std::tuple<SSTableColumnID, uint64_t, uint32_t>*
+    SSTableRowView::findValue(size_t idx) const {
+  auto id = (*select_list_)[idx];
+  for (const auto& col : columns_->col_data_) {
+    if (std::get<0>(col) == id) {
+      return &col;
+    }
+  }
+
+  return nullptr;
+}
+
+}
+}
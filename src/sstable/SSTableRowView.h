@@ -0,0 +1,127 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <sstable/SSTableColumnSchema.h>
+#include <sstable/SSTableColumnReader.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * A non-owning reference to a string value. The referenced memory is only
+ * valid as long as the row it was returned from
+ */
+struct SSTableStringView {
+  const char* data;
+  size_t size;
+
+  String toString() const;
+  bool operator==(const String& other) const;
+};
+
+/**
+ * A view of the current row of a scan. The values are not copied: they point
+ * into the current row of the cursor (or into the column dictionaries) and are
+ * only valid until the callback the row view was passed to returns.
+ *
+ * Values of numeric columns are read without conversion by the typed
+ * accessors; getString formats them into a buffer owned by the row view.
+ * Rows of ORDER BY and GROUP BY scans are materialized before they are
+ * returned, so all of their values are strings and the typed accessors parse
+ * them
+ */
+class SSTableRowView {
+public:
+
+  SSTableRowView(
+      SSTableColumnSchema* schema,
+      const Vector<SSTableColumnID>* select_list);
+
+  /**
+   * Returns the number of columns in the row
+   */
+  size_t size() const;
+
+  /**
+   * Returns the row key; empty for materialized rows
+   */
+  SSTableStringView key() const;
+
+  /**
+   * Returns false if the row has no value for the column. Missing values of
+   * materialized rows are empty strings, so materialized rows have no value
+   * for empty strings
+   */
+  bool hasValue(size_t idx) const;
+
+  /**
+   * Returns the value as a string; empty if the row has no value for the
+   * column. The typed accessors raise an error instead
+   */
+  SSTableStringView getString(size_t idx) const;
+  uint32_t getUInt32(size_t idx) const;
+  uint64_t getUInt64(size_t idx) const;
+  double getFloat(size_t idx) const;
+
+  /**
+   * Copy the row into row, reusing the strings already in it
+   */
+  void copyTo(Vector<String>* row) const;
+  Vector<String> toVector() const;
+
+  /**
+   * Point the view at the selected columns of a decoded row
+   */
+  void setRow(
+      const void* key,
+      size_t key_size,
+      const SSTableColumnReader* columns);
+
+  /**
+   * Point the view at a row without a schema, which has the two columns key
+   * and value
+   */
+  void setRow(
+      const void* key,
+      size_t key_size,
+      const void* data,
+      size_t data_size);
+
+  /**
+   * Point the view at a materialized row
+   */
+  void setRow(const Vector<String>* row);
+
+protected:
+
+  enum class Mode : uint8_t {
+    COLUMNS,
+    RAW,
+    MATERIALIZED
+  };
+
+  const std::tuple<SSTableColumnID, uint64_t, uint32_t>* findValue(
+      size_t idx) const;
+
+  uint64_t parseUInt(size_t idx) const;
+
+  SSTableColumnSchema* schema_;
+  const Vector<SSTableColumnID>* select_list_;
+  Mode mode_;
+  SSTableStringView key_;
+  SSTableStringView data_;
+  const SSTableColumnReader* columns_;
+  const Vector<String>* row_;
+  mutable Vector<String> scratch_;
+};
+
+}
+}
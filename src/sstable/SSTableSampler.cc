@@ -0,0 +1,164 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <algorithm>
+#include <stx/exception.h>
+#include <sstable/SSTableSampler.h>
+
+namespace stx {
+namespace sstable {
+
+SSTableSampler::Method SSTableSampler::methodFromString(const String& method) {
+  if (method == "random") {
+    return Method::RANDOM;
+  }
+
+  if (method == "systematic") {
+    return Method::SYSTEMATIC;
+  }
+
+  RAISEF(
+      kIllegalArgumentError,
+      "invalid sample method: $0, valid arguments: random, systematic",
+      method);
+}
+
+SSTableSampler::Unit SSTableSampler::unitFromString(const String& unit) {
+  if (unit == "block") {
+    return Unit::BLOCK;
+  }
+
+  if (unit == "row") {
+    return Unit::ROW;
+  }
+
+  RAISEF(
+      kIllegalArgumentError,
+      "invalid sample unit: $0, valid arguments: block, row",
+      unit);
+}
+
+SSTableSampler::SSTableSampler(
+    double rate,
+    Method method,
+    uint64_t seed) :
+    rate_(rate),
+    method_(method),
+    seed_(seed),
+    threshold_(0),
+    interval_(1),
+    num_units_(0),
+    num_sampled_(0),
+    has_last_(false),
+    last_position_(0),
+    last_result_(false) {
+  if (!(rate > 0 && rate <= 1)) {
+    RAISEF(kIllegalArgumentError, "sample rate must be in (0, 1]: $0", rate);
+  }
+
+  switch (method_) {
+    case Method::RANDOM:
+      /* rate * 2^64, rate 1.0 is handled separately */
+      threshold_ = rate < 1 ? uint64_t(ldexp(rate, 64)) : uint64_t(-1);
+      break;
+
+    case Method::SYSTEMATIC:
+      interval_ = std::max(uint64_t(1), uint64_t(llround(1.0 / rate)));
+      rate_ = 1.0 / interval_;
+      break;
+  }
+}
+
+bool SSTableSampler::sample(uint64_t position) {
+  if (has_last_ && position == last_position_) {
+    return last_result_;
+  }
+
+  bool result;
+  switch (method_) {
+
+    case Method::RANDOM: {
+      /* splitmix64 finalizer */
+      uint64_t h = position + seed_ * 0x9e3779b97f4a7c15ull;
+      h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+      h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+      h = h ^ (h >> 31);
+      result = rate_ >= 1 || h < threshold_;
+      break;
+    }
+
+    case Method::SYSTEMATIC:
+      result = num_units_ % interval_ == seed_ % interval_;
+      break;
+
+  }
+
+  ++num_units_;
+  if (result) {
+    ++num_sampled_;
+  }
+
+  has_last_ = true;
+  last_position_ = position;
+  last_result_ = result;
+  return result;
+}
+
+double SSTableSampler::rate() const {
+  return rate_;
+}
+
+SSTableSampler::Method SSTableSampler::method() const {
+  return method_;
+}
+
+uint64_t SSTableSampler::seed() const {
+  return seed_;
+}
+
+uint64_t SSTableSampler::numUnits() const {
+  return num_units_;
+}
+
+uint64_t SSTableSampler::numSampled() const {
+  return num_sampled_;
+}
+
+void SSTableSampler::reset() {
+  num_units_ = 0;
+  num_sampled_ = 0;
+  has_last_ = false;
+}
+
+void SSTableSampler::saveState(util::BinaryMessageWriter* writer) const {
+  writer->appendVarUInt(num_units_);
+  writer->appendVarUInt(num_sampled_);
+  writer->appendUInt8(has_last_ ? (last_result_ ? 2 : 1) : 0);
+  if (has_last_) {
+    writer->appendVarUInt(last_position_);
+  }
+}
+
+void SSTableSampler::restoreState(util::BinaryMessageReader* reader) {
+  num_units_ = reader->readVarUInt();
+  num_sampled_ = reader->readVarUInt();
+
+  auto last = *reader->readUInt8();
+  if (last > 2) {
+    RAISE(kParseError, "invalid sampler state");
+  }
+
+  has_last_ = last > 0;
+  last_result_ = last == 2;
+  last_position_ = has_last_ ? reader->readVarUInt() : 0;
+}
+
+}
+}
@@ -0,0 +1,104 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <stx/util/binarymessagereader.h>
+#include <stx/util/binarymessagewriter.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * Decides which units (blocks, zones or rows) of a table are read by a
+ * sampled scan.
+ *
+ * RANDOM sampling selects each unit independently with probability rate by
+ * hashing its position with the seed, so the same seed always selects the
+ * same units, regardless of the order in which they are visited. SYSTEMATIC
+ * sampling selects every n-th unit visited (n = round(1 / rate)), starting
+ * at unit seed % n; its effective rate is 1 / n.
+ *
+ * Aggregates over the sampled rows can be scaled to the full table by
+ * dividing them by rate()
+ */
+class SSTableSampler {
+public:
+
+  enum class Method : uint8_t {
+    RANDOM,
+    SYSTEMATIC
+  };
+
+  enum class Unit : uint8_t {
+    BLOCK,
+    ROW
+  };
+
+  /**
+   * Parse "random"/"systematic" and "block"/"row"
+   */
+  static Method methodFromString(const String& method);
+  static Unit unitFromString(const String& unit);
+
+  SSTableSampler(
+      double rate,
+      Method method = Method::RANDOM,
+      uint64_t seed = 0);
+
+  /**
+   * Returns true if the unit at position should be read. Asking again for the
+   * same position as the previous call returns the same answer and is not
+   * counted twice
+   */
+  bool sample(uint64_t position);
+
+  /**
+   * Returns the (effective) sampling rate
+   */
+  double rate() const;
+
+  Method method() const;
+  uint64_t seed() const;
+
+  /**
+   * Returns the number of distinct units passed to sample and the number of
+   * them that were selected
+   */
+  uint64_t numUnits() const;
+  uint64_t numSampled() const;
+
+  /**
+   * Forget the units seen so far
+   */
+  void reset();
+
+  /**
+   * Save and restore the units seen so far, so that a scan that is continued
+   * in a later execute call (see SSTableScan::continuationToken) selects the
+   * same units as a single scan would
+   */
+  void saveState(util::BinaryMessageWriter* writer) const;
+  void restoreState(util::BinaryMessageReader* reader);
+
+protected:
+  double rate_;
+  Method method_;
+  uint64_t seed_;
+  uint64_t threshold_;
+  uint64_t interval_;
+  uint64_t num_units_;
+  uint64_t num_sampled_;
+  bool has_last_;
+  uint64_t last_position_;
+  bool last_result_;
+};
+
+}
+}
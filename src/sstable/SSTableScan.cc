@@ -7,19 +7,85 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <string.h>
 #include <algorithm>
+#include <thread>
+#include <stx/fnv.h>
+#include <stx/stringutil.h>
+#include <stx/wallclock.h>
+#include <stx/util/binarymessagereader.h>
+#include <stx/util/binarymessagewriter.h>
 #include <sstable/SSTableScan.h>
 #include <sstable/SSTableColumnReader.h>
+#include <sstable/PAXCursor.h>
+#include <sstable/SSTableExternalSort.h>
+#include <sstable/SSTableColumnCodec.h>
 
 namespace stx {
 namespace sstable {
 
+static const uint8_t kContinuationTokenVersion = 2;
+
+static String decodeHex(const String& str) {
+  auto nibble = [] (char c) -> int {
+    if (c >= '0' && c <= '9') {
+      return c - '0';
+    }
+
+    if (c >= 'a' && c <= 'f') {
+      return c - 'a' + 10;
+    }
+
+    if (c >= 'A' && c <= 'F') {
+      return c - 'A' + 10;
+    }
+
+    return -1;
+  };
+
+  if (str.size() % 2 != 0) {
+    RAISE(kParseError, "invalid continuation token");
+  }
+
+  String data;
+  for (size_t i = 0; i < str.size(); i += 2) {
+    auto hi = nibble(str[i]);
+    auto lo = nibble(str[i + 1]);
+    if (hi < 0 || lo < 0) {
+      RAISE(kParseError, "invalid continuation token");
+    }
+
+    data += (char) ((hi << 4) | lo);
+  }
+
+  return data;
+}
+
 SSTableScan::SSTableScan(
     SSTableColumnSchema* schema) :
     schema_(schema),
     limit_(-1),
     offset_(0),
-    has_order_by_(false) {
+    has_order_by_(false),
+    order_by_column_(0),
+    order_by_numeric_(false),
+    order_by_builtin_(false),
+    has_key_range_(false),
+    zone_map_(nullptr),
+    key_index_(nullptr),
+    bloom_filter_(nullptr),
+    sample_unit_(SSTableSampler::Unit::BLOCK),
+    sort_memory_limit_(SSTableExternalSort::kDefaultMemoryLimit),
+    tempdir_("/tmp"),
+    parallel_sort_threshold_(
+        SSTableExternalSort::kDefaultParallelSortThreshold),
+    parallel_sort_threads_(0),
+    spilled_bytes_(0),
+    measure_output_time_(false),
+    deadline_(0),
+    cancelled_(nullptr),
+    check_interval_(kDefaultCheckInterval),
+    continuation_mac_(SSTableSipHash::fromSecret("")) {
   if (schema_) {
     select_list_.emplace_back(0);
     auto col_ids = schema->columnIDs();
@@ -29,12 +95,65 @@ SSTableScan::SSTableScan(
   }
 }
 
+void SSTableScan::setSelectList(const Vector<String>& columns) {
+  if (!schema_) {
+    RAISE(kIllegalStateError, "requires a sstable schema");
+  }
+
+  if (columns.empty()) {
+    RAISE(kIllegalArgumentError, "the select list must not be empty");
+  }
+
+  Vector<SSTableColumnID> select_list;
+  for (const auto& c : columns) {
+    select_list.emplace_back(c == "_key" ? 0 : schema_->columnID(c));
+  }
+
+  select_list_ = select_list;
+}
+
 void SSTableScan::setKeyPrefix(const String& prefix) {
-  setKeyFilterRegex(prefix + ".*"); // FIXPAUL HACK !!! ;) :) ;)
+  /* the end of the range is the smallest key that is greater than all keys
+     with the prefix, i.e. the prefix without trailing 0xff bytes with the
+     last byte incremented. the range is unbounded if there is no such key */
+  auto end = prefix;
+  while (!end.empty() && (unsigned char) end.back() == 0xff) {
+    end.pop_back();
+  }
+
+  if (!end.empty()) {
+    end.back() = (char) ((unsigned char) end.back() + 1);
+  }
+
+  setKeyRange(prefix, end);
+}
+
+void SSTableScan::setKeyRange(const String& begin, const String& end) {
+  if (!has_key_range_) {
+    has_key_range_ = true;
+    key_begin_ = begin;
+    key_end_ = end;
+    return;
+  }
+
+  /* intersect with the existing range; an empty end is unbounded */
+  if (key_begin_ < begin) {
+    key_begin_ = begin;
+  }
+
+  if (key_end_.empty() || (!end.empty() && end < key_end_)) {
+    key_end_ = end;
+  }
 }
 
 void SSTableScan::setKeyFilterRegex(const String& regex) {
-  key_filter_regex_ = Some(std::regex(regex));
+  key_filter_regex_.reset(new SSTableKeyMatcher(regex));
+  key_regexes_ = Vector<String>{ regex };
+}
+
+void SSTableScan::setKeyFilterRegex(const Vector<String>& regexes) {
+  key_filter_regex_.reset(new SSTableKeyMatcher(regexes));
+  key_regexes_ = regexes;
 }
 
 void SSTableScan::setKeyExactMatchFilter(const String& str) {
@@ -55,36 +174,82 @@ void SSTableScan::setOffset(long unsigned int offset) {
   offset_ = offset;
 }
 
-void SSTableScan::setOrderBy(const String& column, const String& order_fn) {
-  if (order_fn == "STRASC") {
-    setOrderBy(column, [] (const String& a, const String& b) {
-      return a < b;
-    });
+void SSTableScan::setContinuationToken(const String& token) {
+  resume_token_ = decodeHex(token);
+}
 
-    return;
+void SSTableScan::setContinuationScope(const String& scope) {
+  continuation_scope_ = scope;
+}
+
+void SSTableScan::setContinuationSecret(const String& secret) {
+  continuation_mac_ = SSTableSipHash::fromSecret(secret);
+}
+
+const String& SSTableScan::continuationToken() const {
+  return continuation_token_;
+}
+
+uint64_t SSTableScan::continuationFingerprint() const {
+  FNV<uint64_t> fnv;
+  auto add = [&fnv] (const String& str) {
+    uint64_t size = str.size();
+    fnv.hash(&size, sizeof(size));
+    fnv.hash(str.data(), str.size());
+  };
+
+  add(continuation_scope_);
+  add(has_key_range_ ? "range" : "");
+  add(key_begin_);
+  add(key_end_);
+
+  add(StringUtil::toString(key_regexes_.size()));
+  for (const auto& r : key_regexes_) {
+    add(r);
   }
 
-  if (order_fn == "STRDSC") {
-    setOrderBy(column, [] (const String& a, const String& b) {
-      return b < a;
-    });
+  add(StringUtil::toString(key_exact_match_.size()));
+  for (const auto& k : key_exact_match_) {
+    add(k);
+  }
 
-    return;
+  add(StringUtil::toString(filters_.size()));
+  for (const auto& f : filters_) {
+    add(f.toString());
   }
 
-  if (order_fn == "NUMASC") {
-    setOrderBy(column, [] (const String& a, const String& b) {
-      return std::stod(a) < std::stod(b);
-    });
+  if (sampler_.get()) {
+    add(
+        StringUtil::format(
+            "$0 $1 $2 $3",
+            sampler_->rate(),
+            (int) sampler_->method(),
+            (int) sample_unit_,
+            sampler_->seed()));
+  }
+
+  return fnv.get();
+}
+
+void SSTableScan::setOrderBy(const String& column, const String& order_fn) {
+  auto asc = [] (const String& a, const String& b) {
+    return a < b;
+  };
+
+  auto dsc = [] (const String& a, const String& b) {
+    return b < a;
+  };
 
+  if (order_fn == "STRASC" || order_fn == "STRDSC") {
+    setOrderBy(column, order_fn == "STRASC" ? OrderFn(asc) : OrderFn(dsc));
+    order_by_builtin_ = true;
     return;
   }
 
-  if (order_fn == "NUMDSC") {
-    setOrderBy(column, [] (const String& a, const String& b) {
-      return std::stod(b) < std::stod(a);
-    });
-
+  if (order_fn == "NUMASC" || order_fn == "NUMDSC") {
+    setOrderBy(column, order_fn == "NUMASC" ? OrderFn(asc) : OrderFn(dsc));
+    order_by_numeric_ = true;
+    order_by_builtin_ = true;
     return;
   }
 
@@ -101,19 +266,220 @@ void SSTableScan::setOrderBy(const String& column, OrderFn order_fn) {
 
   has_order_by_ = true;
   order_by_fn_ = order_fn;
+  order_by_numeric_ = false;
+  order_by_builtin_ = false;
+
+  order_by_column_ = column == "_key" ? 0 : schema_->columnID(column);
+}
 
-  auto colid = schema_->columnID(column);
+String SSTableScan::getSortKey(
+    const String& key,
+    SSTableColumnReader* cols) const {
+  auto colid = order_by_column_;
 
-  for (int i = 0; i < select_list_.size(); ++i) {
-    if (select_list_[i] == colid) {
-      order_by_index_ = i;
-      return;
+  if (!order_by_numeric_) {
+    return colid == 0 ? key : cols->getStringColumn(colid);
+  }
+
+  String sort_key;
+  if (colid == 0) {
+    SSTableColumnCodec::encodeSortKey(std::stod(key), &sort_key);
+    return sort_key;
+  }
+
+  switch (schema_->columnType(colid)) {
+    case SSTableColumnType::UINT32:
+    case SSTableColumnType::UINT64:
+      SSTableColumnCodec::encodeSortKey(
+          cols->getUInt64Column(colid),
+          &sort_key);
+      break;
+
+    case SSTableColumnType::FLOAT:
+      SSTableColumnCodec::encodeSortKey(
+          cols->getFloatColumn(colid),
+          &sort_key);
+      break;
+
+    case SSTableColumnType::STRING:
+      SSTableColumnCodec::encodeSortKey(
+          std::stod(cols->getStringColumn(colid)),
+          &sort_key);
+      break;
+  }
+
+  return sort_key;
+}
+
+void SSTableScan::addFilter(const SSTableScanPredicate& predicate) {
+  if (!schema_) {
+    RAISE(kIllegalStateError, "requires a sstable schema");
+  }
+
+  filters_.emplace_back(predicate);
+  filters_.back().bind(schema_);
+}
+
+void SSTableScan::setSortMemoryLimit(size_t bytes) {
+  sort_memory_limit_ = bytes;
+}
+
+void SSTableScan::setTempDirectory(const String& tempdir) {
+  tempdir_ = tempdir;
+}
+
+void SSTableScan::setParallelSort(size_t threshold, size_t num_threads) {
+  parallel_sort_threshold_ = threshold;
+  parallel_sort_threads_ = num_threads;
+}
+
+void SSTableScan::setMeasureOutputTime(bool measure) {
+  measure_output_time_ = measure;
+}
+
+void SSTableScan::setDeadline(uint64_t deadline_micros) {
+  deadline_ = deadline_micros;
+}
+
+void SSTableScan::setCancellationToken(const std::atomic<bool>* cancelled) {
+  cancelled_ = cancelled;
+}
+
+void SSTableScan::setCheckInterval(size_t check_interval) {
+  if (check_interval == 0) {
+    RAISE(kIllegalArgumentError, "check interval must be greater than 0");
+  }
+
+  check_interval_ = check_interval;
+}
+
+const SSTableScanStats& SSTableScan::stats() const {
+  return stats_;
+}
+
+uint64_t SSTableScan::spilledBytes() const {
+  return spilled_bytes_;
+}
+
+void SSTableScan::setGroupBy(const Vector<String>& columns) {
+  if (!schema_) {
+    RAISE(kIllegalStateError, "requires a sstable schema");
+  }
+
+  if (!aggregator_.get()) {
+    aggregator_.reset(new SSTableAggregator(schema_));
+  }
+
+  for (const auto& c : columns) {
+    aggregator_->addGroupBy(c);
+  }
+}
+
+void SSTableScan::addAggregate(const String& expr) {
+  if (!schema_) {
+    RAISE(kIllegalStateError, "requires a sstable schema");
+  }
+
+  if (!aggregator_.get()) {
+    aggregator_.reset(new SSTableAggregator(schema_));
+  }
+
+  aggregator_->addAggregate(expr);
+}
+
+void SSTableScan::setZoneMap(const SSTableZoneMap* zone_map) {
+  zone_map_ = zone_map;
+}
+
+void SSTableScan::setKeyIndex(const SSTableKeyIndex* key_index) {
+  key_index_ = key_index;
+}
+
+void SSTableScan::setBloomFilter(const SSTableBloomFilter* bloom_filter) {
+  bloom_filter_ = bloom_filter;
+}
+
+void SSTableScan::setSample(
+    double rate,
+    SSTableSampler::Method method,
+    SSTableSampler::Unit unit,
+    uint64_t seed) {
+  sampler_.reset(new SSTableSampler(rate, method, seed));
+  sample_unit_ = unit;
+}
+
+bool SSTableScan::zoneMayMatch(
+    const SSTableZoneMap::Zone& zone,
+    const Vector<SSTableScanPredicate>& zone_filters) const {
+  for (const auto& f : zone_filters) {
+    if (!f.mayMatch(zone)) {
+      return false;
     }
   }
 
-  RAISE(
-      kIllegalArgumentError,
-      "the order_by column must be included in the select list");
+  return true;
+}
+
+bool SSTableScan::skipZones(
+    Cursor* cursor,
+    const Vector<SSTableScanPredicate>& zone_filters,
+    uint64_t* zone_begin,
+    uint64_t* zone_end,
+    uint64_t* zones_skipped,
+    SSTableSampler* sampler) const {
+  while (cursor->valid()) {
+    auto pos = cursor->position();
+    if (pos >= *zone_begin && pos < *zone_end) {
+      return true;
+    }
+
+    auto idx = zone_map_->findZone(pos);
+    if (idx < 0) {
+      /* rows before the first zone are not covered by the zone map */
+      *zone_begin = 0;
+      *zone_end = zone_map_->numZones() > 0 ?
+          zone_map_->getZone(0).begin :
+          uint64_t(-1);
+      return true;
+    }
+
+    /* find the next zone that may match without reading the zones in
+       between */
+    auto first = (size_t) idx;
+    auto next = first;
+    for (; next < zone_map_->numZones(); ++next) {
+      const auto& zone = zone_map_->getZone(next);
+
+      /* zones are sampled before they are filtered so that the sample does
+         not depend on the filters */
+      if (sampler != nullptr && !sampler->sample(zone.begin)) {
+        continue;
+      }
+
+      if (zoneMayMatch(zone, zone_filters)) {
+        break;
+      }
+
+      ++(*zones_skipped);
+    }
+
+    if (next == zone_map_->numZones()) {
+      return false;
+    }
+
+    *zone_begin = zone_map_->getZone(next).begin;
+    *zone_end = zone_map_->nextZoneBegin(next);
+
+    if (next == first) {
+      return true;
+    }
+
+    if (!cursor->trySeekTo(*zone_begin)) {
+      return false;
+    }
+  }
+
+  return false;
 }
 
 Vector<String> SSTableScan::columnNames() const {
@@ -121,6 +487,10 @@ Vector<String> SSTableScan::columnNames() const {
     RAISE(kIllegalStateError, "requires a sstable schema");
   }
 
+  if (aggregator_.get()) {
+    return aggregator_->columnNames();
+  }
+
   Vector<String> cols;
 
   for (const auto& s : select_list_) {
@@ -130,84 +500,529 @@ Vector<String> SSTableScan::columnNames() const {
   return cols;
 }
 
-void SSTableScan::execute(
+Vector<SSTableColumnType> SSTableScan::columnTypes() const {
+  if (!schema_) {
+    RAISE(kIllegalStateError, "requires a sstable schema");
+  }
+
+  if (aggregator_.get()) {
+    return aggregator_->columnTypes();
+  }
+
+  Vector<SSTableColumnType> types;
+
+  for (const auto& s : select_list_) {
+    types.emplace_back(
+        s == 0 ? SSTableColumnType::STRING : schema_->columnType(s));
+  }
+
+  return types;
+}
+
+SSTableScanStatus SSTableScan::execute(
+    Cursor* cursor,
+    Function<void (const Vector<String>& row)> fn) {
+  Vector<String> row;
+  return execute(cursor, [&fn, &row] (const SSTableRowView& view) {
+    view.copyTo(&row);
+    fn(row);
+  });
+}
+
+SSTableScanStatus SSTableScan::execute(
     Cursor* cursor,
-    Function<void (const Vector<String> row)> fn) {
-  Vector<Vector<String>> rows;
+    Function<void (const SSTableRowView& row)> fn) {
+  Vector<std::pair<String, Vector<String>>> rows;
   size_t limit_ctr = 0;
   size_t offset_ctr = 0;
 
-  for (; cursor->valid(); cursor->next()) {
-    auto key = cursor->getKeyString();
+  if (aggregator_.get() && has_order_by_) {
+    RAISE(kIllegalStateError, "ORDER BY is not supported with aggregates");
+  }
+
+  /* the token holds the position of the next row to read, the fingerprint
+     of the scan and the state of the sampler, followed by the MAC of these
+     fields. The position is only used if the MAC is valid, so clients can't
+     make the scan seek to positions that aren't row boundaries */
+  auto resumable = !aggregator_.get() && !has_order_by_;
+  auto resume = !resume_token_.empty();
+  size_t token_size = 0;
+  if (resume) {
+    if (!resumable) {
+      RAISE(
+          kIllegalStateError,
+          "continuation tokens are not supported with ORDER BY or aggregates");
+    }
+
+    if (resume_token_.size() <= sizeof(uint64_t)) {
+      RAISE(kParseError, "invalid continuation token");
+    }
+
+    token_size = resume_token_.size() - sizeof(uint64_t);
+    uint64_t mac;
+    memcpy(&mac, resume_token_.data() + token_size, sizeof(mac));
+    if (mac != continuation_mac_.hash(resume_token_.data(), token_size)) {
+      RAISE(kIllegalArgumentError, "the continuation token is not authentic");
+    }
+  }
+
+  util::BinaryMessageReader token(resume_token_.data(), token_size);
+  uint64_t resume_position = 0;
+  if (resume) {
+    if (*token.readUInt8() != kContinuationTokenVersion) {
+      RAISE(kParseError, "invalid continuation token");
+    }
+
+    if (*token.readUInt64() != continuationFingerprint()) {
+      RAISE(
+          kIllegalArgumentError,
+          "the continuation token belongs to a different scan");
+    }
+
+    resume_position = token.readVarUInt();
+  }
+
+  /* the offset was applied by the first page, a resumed scan continues with
+     the row after the last returned row */
+  size_t offset = resume ? 0 : offset_;
+
+  continuation_token_.clear();
+  stats_ = SSTableScanStats();
+  stats_.filter_rows_matched.resize(filters_.size());
+  auto scan_begin = WallClock::unixMicros();
+
+  auto emit = [this, &fn] (const SSTableRowView& row) {
+    ++stats_.rows_emitted;
+
+    if (!measure_output_time_) {
+      fn(row);
+      return;
+    }
+
+    auto t0 = WallClock::unixMicros();
+    fn(row);
+    stats_.output_micros += WallClock::unixMicros() - t0;
+  };
+
+  /* only decode the selected columns and the columns that are needed to
+     filter, aggregate and sort the rows. on columnar tables the chunks of
+     all other columns are never read */
+  SSTableColumnReader cols(schema_);
+  auto pax_cursor = dynamic_cast<PAXCursor*>(cursor);
+  if (schema_) {
+    Set<SSTableColumnID> projection;
+    for (const auto& s : select_list_) {
+      if (s != 0) {
+        projection.emplace(s);
+      }
+    }
+
+    for (const auto& f : filters_) {
+      f.getColumnIDs(&projection);
+    }
+
+    if (aggregator_.get()) {
+      aggregator_->getColumnIDs(&projection);
+    }
+
+    if (has_order_by_ && order_by_column_ != 0) {
+      projection.emplace(order_by_column_);
+    }
+
+    cols.setColumnProjection(projection);
+    if (pax_cursor) {
+      pax_cursor->setColumnProjection(projection);
+    }
+  }
+
+  /* the keys of an exact key match that pass the bloom filter, in
+     ascending order */
+  Vector<String> match_keys;
+  for (const auto& k : key_exact_match_) {
+    if (bloom_filter_ && !bloom_filter_->mayContain(k)) {
+      ++stats_.keys_bloom_filtered;
+      continue;
+    }
+
+    match_keys.emplace_back(k);
+  }
+
+  auto keys_filtered = key_exact_match_.size() > 0 && match_keys.empty();
+  auto next_match_key = match_keys.begin();
+
+  /* key filters that can be checked against the zone map key ranges */
+  Vector<SSTableScanPredicate> zone_filters;
+  if (zone_map_) {
+    zone_filters = filters_;
+
+    if (has_key_range_ && !key_begin_.empty()) {
+      zone_filters.emplace_back(
+          SSTableScanPredicate::greaterThanOrEqual("_key", key_begin_));
+      zone_filters.back().bind(schema_);
+    }
+
+    if (has_key_range_ && !key_end_.empty()) {
+      zone_filters.emplace_back(
+          SSTableScanPredicate::lessThan("_key", key_end_));
+      zone_filters.back().bind(schema_);
+    }
+
+    if (match_keys.size() > 0) {
+      zone_filters.emplace_back(SSTableScanPredicate::in("_key", match_keys));
+      zone_filters.back().bind(schema_);
+    }
+  }
+
+  /* with ORDER BY and LIMIT only the best offset + limit rows are kept in a
+     heap whose front is the worst of the kept rows */
+  auto top_k = has_order_by_ && limit_ > 0;
+  size_t k = top_k ? offset_ + limit_ : 0;
+  auto order_cmp = [this] (
+      const std::pair<String, Vector<String>>& a,
+      const std::pair<String, Vector<String>>& b) {
+    return order_by_fn_(a.first, b.first);
+  };
+
+  /* without a limit, sorted rows are spilled to disk once they exceed the
+     sort memory limit */
+  std::unique_ptr<SSTableExternalSort> sort;
+  if (has_order_by_ && !top_k) {
+    sort.reset(
+        new SSTableExternalSort(order_by_fn_, sort_memory_limit_, tempdir_));
+
+    /* custom order functions are only called from multiple threads if the
+       caller asked for it */
+    auto num_threads = parallel_sort_threads_;
+    if (num_threads == 0) {
+      num_threads = order_by_builtin_ ?
+          std::max(1u, std::thread::hardware_concurrency()) :
+          1;
+    }
+
+    sort->setParallelSort(parallel_sort_threshold_, num_threads);
+  }
+
+  /* on sorted tables with a key index, seek to the first row that may be in
+     the key range (or have the first key to match) and stop after the last */
+  auto keys_sorted = key_index_ != nullptr && key_index_->isSorted();
+  auto seek_match_keys = keys_sorted && match_keys.size() > 0;
+  Vector<String> seek_keys;
+  if (keys_sorted && has_key_range_ && !key_begin_.empty()) {
+    seek_keys.emplace_back(key_begin_);
+  }
+  if (seek_match_keys) {
+    seek_keys.emplace_back(match_keys.front());
+  }
+
+  if (resume && !cursor->trySeekTo(resume_position)) {
+    return stats_.status;
+  }
+
+  for (const auto& k : seek_keys) {
+    auto pos = key_index_->lowerBound(k);
+    if (pos > cursor->position()) {
+      ++stats_.key_index_seeks;
+      if (!cursor->trySeekTo(pos)) {
+        return stats_.status;
+      }
+    }
+  }
+
+  /* block samples skip whole zones if there is a zone map and whole blocks
+     of columnar tables otherwise */
+  SSTableSampler* zone_sampler = nullptr;
+  SSTableSampler* row_sampler = nullptr;
+  if (sampler_.get()) {
+    sampler_->reset();
+    if (resume) {
+      sampler_->restoreState(&token);
+    }
+
+    if (sample_unit_ == SSTableSampler::Unit::ROW) {
+      row_sampler = sampler_.get();
+    } else if (zone_map_) {
+      zone_sampler = sampler_.get();
+    } else if (pax_cursor) {
+      /* sample the position of the first row of the block, which is also
+         the begin of its zone, so both select the same blocks */
+      auto sampler = sampler_.get();
+      pax_cursor->setBlockFilter([sampler] (size_t block_offset) {
+        return sampler->sample(block_offset << BinaryFormat::kPAXRowIndexBits);
+      });
+    } else {
+      RAISE(
+          kIllegalStateError,
+          "block sampling requires a zone map or a columnar table");
+    }
+  }
+
+  uint64_t zone_begin = 0;
+  uint64_t zone_end = 0;
+  auto next_zone = [&] () -> bool {
+    return
+        zone_map_ == nullptr ||
+        skipZones(
+            cursor,
+            zone_filters,
+            &zone_begin,
+            &zone_end,
+            &stats_.zones_skipped,
+            zone_sampler);
+  };
+
+  /* the deadline and the cancellation token are checked every
+     check_interval_ rows */
+  size_t check_ctr = 0;
+  auto stopped = [this, &check_ctr] () -> bool {
+    if (++check_ctr < check_interval_) {
+      return false;
+    }
+
+    check_ctr = 0;
+    if (cancelled_ != nullptr && cancelled_->load()) {
+      stats_.status = SSTableScanStatus::CANCELLED;
+      return true;
+    }
+
+    if (deadline_ > 0 && WallClock::unixMicros() >= deadline_) {
+      stats_.status = SSTableScanStatus::DEADLINE_EXCEEDED;
+      return true;
+    }
+
+    return false;
+  };
+
+  /* the key, the column reader and the row view are reused for all rows */
+  String key;
+  void* key_data;
+  size_t key_size;
+  void* data;
+  size_t data_size;
+  SSTableRowView view(schema_, &select_list_);
+
+  /* the position of the next row to read if the scan stops early */
+  auto stopped_early = false;
+  uint64_t next_position = 0;
+
+  for (
+      bool more = !keys_filtered && next_zone();
+      more && cursor->valid();
+      more = cursor->next() && next_zone()) {
+    if (stopped()) {
+      stopped_early = true;
+      next_position = cursor->position();
+      break;
+    }
+
+    if (row_sampler && !row_sampler->sample(cursor->position())) {
+      continue;
+    }
+
+    cursor->getKey(&key_data, &key_size);
+    key.assign((char*) key_data, key_size);
+    ++stats_.rows_scanned;
+    stats_.key_bytes_read += key_size;
+
+    /* once the rows of a key were read, seek ahead to the next key to match
+       if the key index has an entry between the row and the key. the row at
+       the entry's position has a smaller key, so it is skipped by next() */
+    if (seek_match_keys) {
+      while (next_match_key != match_keys.end() && *next_match_key < key) {
+        ++next_match_key;
+      }
+
+      if (next_match_key == match_keys.end()) {
+        break;
+      }
+
+      if (key < *next_match_key) {
+        auto pos = key_index_->lowerBound(*next_match_key);
+        if (pos > cursor->position()) {
+          ++stats_.key_index_seeks;
+          if (!cursor->trySeekTo(pos)) {
+            break;
+          }
+
+          continue;
+        }
+      }
+    }
+
+    if (has_key_range_) {
+      if (key < key_begin_) {
+        continue;
+      }
+
+      if (!key_end_.empty() && !(key < key_end_)) {
+        if (keys_sorted) {
+          break;
+        }
+
+        continue;
+      }
+    }
+
+    ++stats_.rows_in_key_range;
 
     if (key_exact_match_.size() > 0 && key_exact_match_.count(key) == 0) {
       continue;
     }
 
-    if (!key_filter_regex_.isEmpty()) {
-      if (!std::regex_match(key, key_filter_regex_.get())) {
+    ++stats_.rows_key_matched;
+
+    if (key_filter_regex_.get()) {
+      if (!key_filter_regex_->matches(key.data(), key.size())) {
         continue;
       }
     }
 
-    Vector<String> row;
+    ++stats_.rows_regex_matched;
+
+    cursor->getData(&data, &data_size);
+    stats_.value_bytes_read += data_size;
+
+    String sort_key;
     if (schema_) {
-      auto val = cursor->getDataBuffer();
-      sstable::SSTableColumnReader cols(schema_, val);
+      cols.reset(data, data_size);
 
-      for (const auto& s : select_list_) {
-        switch (s) {
-          case 0:
-            row.emplace_back(cursor->getKeyString());
-            break;
+      bool match = true;
+      for (size_t i = 0; i < filters_.size(); ++i) {
+        if (!filters_[i].evaluate(key.data(), key.size(), cols)) {
+          match = false;
+          break;
+        }
 
-          default:
-            row.emplace_back(cols.getStringColumn(s));
-            break;
+        ++stats_.filter_rows_matched[i];
+      }
+
+      if (!match) {
+        continue;
+      }
+
+      ++stats_.rows_filter_matched;
+
+      if (aggregator_.get()) {
+        aggregator_->addRow(key.data(), key.size(), cols);
+        continue;
+      }
+
+      /* the sort key is extracted once per row; once the heap is full the
+         rest of the row is only materialized if the row qualifies */
+      if (has_order_by_) {
+        sort_key = getSortKey(key, &cols);
+
+        if (top_k &&
+            rows.size() >= k &&
+            !order_by_fn_(sort_key, rows.front().first)) {
+          continue;
         }
       }
+
+      view.setRow(key.data(), key.size(), &cols);
     } else {
-      row.emplace_back(cursor->getKeyString());
-      row.emplace_back(cursor->getDataString());
+      view.setRow(key.data(), key.size(), data, data_size);
+      ++stats_.rows_filter_matched;
     }
 
-    // filter cols...
-
-    if (!has_order_by_ && offset_ctr++ < offset_) {
+    if (!has_order_by_ && offset_ctr++ < offset) {
       continue;
     }
 
-    if (has_order_by_) {
-      rows.emplace_back(row);
+    if (top_k) {
+      if (rows.size() >= k) {
+        std::pop_heap(rows.begin(), rows.end(), order_cmp);
+        rows.pop_back();
+      }
+
+      rows.emplace_back(std::move(sort_key), view.toVector());
+      std::push_heap(rows.begin(), rows.end(), order_cmp);
+    } else if (sort.get()) {
+      sort->addRow(std::move(sort_key), view.toVector());
     } else {
-      fn(row);
+      emit(view);
 
       if (limit_ > 0 && ++limit_ctr >= limit_) {
+        stopped_early = true;
+        next_position = cursor->nextPosition();
         break;
       }
     }
   }
 
-  if (has_order_by_) {
-    std::sort(rows.begin(), rows.end(), [this] (
-        const Vector<String>& a,
-        const Vector<String>& b) {
-      return order_by_fn_(a[order_by_index_], b[order_by_index_]);
-    });
+  stats_.scan_micros =
+      WallClock::unixMicros() - scan_begin - stats_.output_micros;
 
-    auto limit = rows.size();
-    if (limit_ > 0) {
-      limit = offset_ + limit_;
+  if (resumable && stopped_early) {
+    util::BinaryMessageWriter writer;
+    writer.appendUInt8(kContinuationTokenVersion);
+    writer.appendUInt64(continuationFingerprint());
+    writer.appendVarUInt(next_position);
+    if (sampler_.get()) {
+      sampler_->saveState(&writer);
+    }
 
-      if (limit > rows.size()) {
-        limit = rows.size();
+    writer.appendUInt64(continuation_mac_.hash(writer.data(), writer.size()));
+    continuation_token_ =
+        StringUtil::hexPrint(writer.data(), writer.size(), false);
+  }
+
+  if (sampler_.get()) {
+    stats_.sample_rate = sampler_->rate();
+    stats_.sample_units = sampler_->numUnits();
+    stats_.sample_units_read = sampler_->numSampled();
+
+    if (pax_cursor && !zone_sampler && !row_sampler) {
+      pax_cursor->setBlockFilter(nullptr);
+    }
+  }
+
+  if (stats_.status == SSTableScanStatus::CANCELLED) {
+    return stats_.status;
+  }
+
+  auto materialized_fn = [&emit, &view] (const Vector<String>& row) {
+    view.setRow(&row);
+    emit(view);
+  };
+
+  if (aggregator_.get()) {
+    auto t0 = WallClock::unixMicros();
+    auto output_micros = stats_.output_micros;
+
+    size_t n = 0;
+    aggregator_->getResult([&] (const Vector<String>& row) {
+      if (n++ >= offset_ && (limit_ <= 0 || n <= offset_ + limit_)) {
+        materialized_fn(row);
       }
+    });
+
+    stats_.aggregate_micros =
+        WallClock::unixMicros() - t0 - (stats_.output_micros - output_micros);
+  }
+
+  if (sort.get() || top_k) {
+    auto t0 = WallClock::unixMicros();
+    auto output_micros = stats_.output_micros;
+
+    if (sort.get()) {
+      sort->execute(materialized_fn, offset_);
+      stats_.spilled_bytes = sort->spilledBytes();
+      spilled_bytes_ += sort->spilledBytes();
     }
 
-    for (int i = offset_; i < limit; ++i) {
-      fn(rows[i]);
+    if (top_k) {
+      std::sort_heap(rows.begin(), rows.end(), order_cmp);
+
+      for (size_t i = offset_; i < rows.size(); ++i) {
+        materialized_fn(rows[i].second);
+      }
     }
+
+    stats_.sort_micros =
+        WallClock::unixMicros() - t0 - (stats_.output_micros - output_micros);
   }
+
+  return stats_.status;
 }
 
 } // namespace sstable
@@ -13,7 +13,7 @@
 #include <string>
 #include <vector>
 #include <memory>
-#include <regex>
+#include <atomic>
 #include <stx/buffer.h>
 #include <stx/exception.h>
 #include <stx/io/file.h>
@@ -26,6 +26,16 @@
 #include <sstable/index.h>
 #include <sstable/indexprovider.h>
 #include <sstable/SSTableColumnSchema.h>
+#include <sstable/SSTableScanPredicate.h>
+#include <sstable/SSTableZoneMap.h>
+#include <sstable/SSTableKeyIndex.h>
+#include <sstable/SSTableBloomFilter.h>
+#include <sstable/SSTableKeyMatcher.h>
+#include <sstable/SSTableAggregator.h>
+#include <sstable/SSTableRowView.h>
+#include <sstable/SSTableSampler.h>
+#include <sstable/SSTableScanStats.h>
+#include <sstable/SSTableSipHash.h>
 
 namespace stx {
 namespace sstable {
@@ -33,32 +43,285 @@ namespace sstable {
 class SSTableScan {
 public:
   typedef Function<bool (const String& a, const String& b)> OrderFn;
+  static const size_t kDefaultCheckInterval = 1024;
 
   SSTableScan(SSTableColumnSchema* schema = nullptr);
 
+  /**
+   * Only return the provided columns ("_key" is the row key). By default all
+   * columns are returned. Columns that are not selected (or needed for
+   * filters, aggregates or ORDER BY) are not decoded
+   */
+  void setSelectList(const Vector<String>& columns);
+
+  /**
+   * Only return rows whose key starts with the prefix
+   */
   void setKeyPrefix(const String& prefix);
+
+  /**
+   * Only return rows whose key is in [begin, end). Keys are compared as byte
+   * strings; an empty end means no upper bound. If a range or prefix was
+   * already set, the scan only returns the rows in both ranges
+   */
+  void setKeyRange(const String& begin, const String& end);
+
+  /**
+   * Only return rows whose key matches the regex (see SSTableKeyMatcher for
+   * the supported syntax) or any of the regexes
+   */
   void setKeyFilterRegex(const String& regex);
+  void setKeyFilterRegex(const Vector<String>& regexes);
   void setKeyExactMatchFilter(const String& str);
   void setKeyExactMatchFilter(const Set<String>& str);
   void setLimit(long int limit);
   void setOffset(long unsigned int offset);
+
+  /**
+   * Continue the scan that returned the token (see continuationToken) where
+   * it stopped. The cursor is moved to the next row with trySeekTo, so a
+   * continued scan only reads the rows after the previous page instead of
+   * skipping offset rows. The scan must have the same key filters, filters,
+   * sample and continuation scope as the scan that returned the token; the
+   * limit and select list may differ. The offset is ignored: it was applied
+   * by the first page, so clients can send the same parameters (including
+   * the offset) with each token. Raises an error if the token is invalid or
+   * belongs to a different scan. Not supported with ORDER BY, GROUP BY or
+   * aggregates
+   */
+  void setContinuationToken(const String& token);
+
+  /**
+   * Tokens are only accepted by scans with the same scope, e.g. the path and
+   * version of the table, since the positions in a token are only valid for
+   * the table that was scanned
+   */
+  void setContinuationScope(const String& scope);
+
+  /**
+   * Tokens are authenticated with a MAC (see SSTableSipHash) keyed by the
+   * secret, so they can't be forged to seek to arbitrary positions. Without
+   * a secret, tokens are only protected against accidental changes and must
+   * only be accepted from trusted clients
+   */
+  void setContinuationSecret(const String& secret);
+
+  /**
+   * Returns an opaque token (a hex string) to continue the last execute call
+   * if it stopped before all rows were read, i.e. at the limit, the deadline
+   * or when cancelled, and an empty string otherwise. Scans with ORDER BY,
+   * GROUP BY or aggregates never return a token
+   */
+  const String& continuationToken() const;
+
+  /**
+   * Sort the result by the provided column. If a limit is set, only the best
+   * offset + limit rows are kept (in a heap) while scanning.
+   *
+   * NUMASC and NUMDSC sort on a binary-comparable key that is extracted once
+   * per row from the typed column value. STRASC, STRDSC and custom order
+   * functions compare the string values
+   */
   void setOrderBy(const String& column, const String& order_fn);
   void setOrderBy(const String& column, OrderFn order_fn);
 
-  void execute(Cursor* cursor, Function<void (const Vector<String> row)> fn);
+  /**
+   * Only return rows that match the predicate. Filters are evaluated on the
+   * decoded column values before the row is materialized; multiple filters
+   * are ANDed
+   */
+  void addFilter(const SSTableScanPredicate& predicate);
+
+  /**
+   * Return one row per distinct combination of the group by column values
+   * instead of the selected columns (see SSTableAggregator)
+   */
+  void setGroupBy(const Vector<String>& columns);
+
+  /**
+   * Add an aggregate like "sum(clicks)" to the result. Without group by
+   * columns, the result is a single row of aggregates
+   */
+  void addAggregate(const String& expr);
+
+  /**
+   * Skip all zones of the table whose min/max statistics show that they can't
+   * contain a row matching the filters and key filters
+   */
+  void setZoneMap(const SSTableZoneMap* zone_map);
+
+  /**
+   * If the key index is sorted, key range and prefix scans seek to the first
+   * row that may be in the range and stop after the last row in the range.
+   * Exact key match scans seek to each of the keys in ascending order (in one
+   * forward pass) and stop after the last key
+   */
+  void setKeyIndex(const SSTableKeyIndex* key_index);
+
+  /**
+   * Exact key match scans only look for the keys that pass the bloom filter
+   * and don't read the table if no key passes
+   */
+  void setBloomFilter(const SSTableBloomFilter* bloom_filter);
+
+  /**
+   * Only read a sample of the table (see SSTableSampler). BLOCK sampling
+   * seeks past the zones of the zone map or, on columnar tables without a
+   * zone map, the blocks that are not sampled; it requires one of them. ROW
+   * sampling reads the key of every row, but skips the values of the rows
+   * that are not sampled.
+   *
+   * The rate is reported in stats().sample_rate; aggregates like COUNT and SUM
+   * have to be divided by it to estimate the value for the whole table
+   */
+  void setSample(
+      double rate,
+      SSTableSampler::Method method = SSTableSampler::Method::RANDOM,
+      SSTableSampler::Unit unit = SSTableSampler::Unit::BLOCK,
+      uint64_t seed = 0);
+
+  /**
+   * Set the memory budget for sorting an ORDER BY scan without a limit. Once
+   * the buffered rows exceed the budget, they are written as sorted runs to
+   * temporary sstables in the temp directory and merged at the end. A limit
+   * of zero disables spilling
+   */
+  void setSortMemoryLimit(size_t bytes);
+  void setTempDirectory(const String& tempdir);
+
+  /**
+   * Sort ORDER BY results of at least threshold rows with up to num_threads
+   * threads (see SSTableExternalSort::setParallelSort). By default
+   * (num_threads = 0) the built-in order functions (STRASC, STRDSC, NUMASC,
+   * NUMDSC) use one thread per hardware thread and custom order functions
+   * one thread, since they may not be thread-safe; setting num_threads
+   * explicitly requires custom order functions to be thread-safe
+   */
+  void setParallelSort(size_t threshold, size_t num_threads);
+
+  /**
+   * Returns the number of bytes written to temporary sstables by execute
+   */
+  uint64_t spilledBytes() const;
+
+  /**
+   * Returns the counters and timings of the last execute call
+   */
+  const SSTableScanStats& stats() const;
+
+  /**
+   * Measure the time spent in the result callback (output_micros). This
+   * reads the clock twice per result row, so it is disabled by default and
+   * the callback time is included in scan_micros
+   */
+  void setMeasureOutputTime(bool measure);
+
+  /**
+   * Stop the scan once the deadline (in unix microseconds) has passed or the
+   * cancellation token is set. Both are checked every check_interval rows
+   * read from the cursor.
+   *
+   * A scan that stops early returns DEADLINE_EXCEEDED or CANCELLED. The rows
+   * returned until then are a partial result: after the deadline passed,
+   * ORDER BY and GROUP BY scans return the sorted rows and aggregates of the
+   * rows read so far; cancelled scans return no further rows
+   */
+  void setDeadline(uint64_t deadline_micros);
+  void setCancellationToken(const std::atomic<bool>* cancelled);
+  void setCheckInterval(size_t check_interval);
+
+  /**
+   * Call fn with a copy of each result row
+   */
+  SSTableScanStatus execute(
+      Cursor* cursor,
+      Function<void (const Vector<String>& row)> fn);
+
+  /**
+   * Call fn with a view of each result row. The row view and its values are
+   * reused for the next row; copy them to keep them. Rows of scans without
+   * ORDER BY or GROUP BY are read directly from the cursor without allocating
+   * per row
+   */
+  SSTableScanStatus execute(
+      Cursor* cursor,
+      Function<void (const SSTableRowView& row)> fn);
 
   Vector<String> columnNames() const;
 
+  /**
+   * Returns the types of the result columns; the key is a STRING column
+   */
+  Vector<SSTableColumnType> columnTypes() const;
+
 protected:
+
+  /**
+   * Returns the key that the row is sorted by with order_by_fn_
+   */
+  String getSortKey(const String& key, SSTableColumnReader* cols) const;
+
+  /**
+   * Returns a hash of the continuation scope and the parameters that select
+   * the rows of the scan
+   */
+  uint64_t continuationFingerprint() const;
+
+  /**
+   * Returns false if no row in the zone can match the filters
+   */
+  bool zoneMayMatch(
+      const SSTableZoneMap::Zone& zone,
+      const Vector<SSTableScanPredicate>& zone_filters) const;
+
+  /**
+   * Advance the cursor past all zones that can't match or are not sampled by
+   * the sampler (if any). Returns false if no zone can match anymore
+   */
+  bool skipZones(
+      Cursor* cursor,
+      const Vector<SSTableScanPredicate>& zone_filters,
+      uint64_t* zone_begin,
+      uint64_t* zone_end,
+      uint64_t* zones_skipped,
+      SSTableSampler* sampler) const;
+
   SSTableColumnSchema* schema_;
   Vector<SSTableColumnID> select_list_;
   bool has_order_by_;
-  int order_by_index_;
+  SSTableColumnID order_by_column_;
   OrderFn order_by_fn_;
+  bool order_by_numeric_;
+  bool order_by_builtin_;
   long int limit_;
   long unsigned int offset_;
-  Option<std::regex> key_filter_regex_;
+  bool has_key_range_;
+  String key_begin_;
+  String key_end_;
+  std::unique_ptr<SSTableKeyMatcher> key_filter_regex_;
+  Vector<String> key_regexes_;
   Set<String> key_exact_match_;
+  Vector<SSTableScanPredicate> filters_;
+  std::unique_ptr<SSTableAggregator> aggregator_;
+  const SSTableZoneMap* zone_map_;
+  const SSTableKeyIndex* key_index_;
+  const SSTableBloomFilter* bloom_filter_;
+  std::unique_ptr<SSTableSampler> sampler_;
+  SSTableSampler::Unit sample_unit_;
+  size_t sort_memory_limit_;
+  String tempdir_;
+  size_t parallel_sort_threshold_;
+  size_t parallel_sort_threads_;
+  uint64_t spilled_bytes_;
+  SSTableScanStats stats_;
+  bool measure_output_time_;
+  uint64_t deadline_;
+  const std::atomic<bool>* cancelled_;
+  size_t check_interval_;
+  String continuation_scope_;
+  SSTableSipHash continuation_mac_;
+  String resume_token_;
+  String continuation_token_;
 };
 
 } // namespace sstable
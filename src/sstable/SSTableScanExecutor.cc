@@ -0,0 +1,255 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <chrono>
+#include <stx/exception.h>
+#include <stx/stringutil.h>
+#include <stx/wallclock.h>
+#include <sstable/SSTableScanExecutor.h>
+
+namespace stx {
+namespace sstable {
+
+String scanPriorityToString(SSTableScanExecutor::Priority priority) {
+  switch (priority) {
+    case SSTableScanExecutor::Priority::HIGH:
+      return "high";
+    case SSTableScanExecutor::Priority::LOW:
+      return "low";
+  }
+
+  return "unknown";
+}
+
+bool waitWithTimeout(Function<bool ()> ready, uint64_t timeout_micros) {
+  auto deadline = WallClock::unixMicros() + timeout_micros;
+  uint64_t interval = 1000;
+
+  while (!ready()) {
+    auto now = WallClock::unixMicros();
+    if (now >= deadline) {
+      return false;
+    }
+
+    std::this_thread::sleep_for(
+        std::chrono::microseconds(std::min(interval, deadline - now)));
+    interval = std::min(interval * 2, uint64_t(10000));
+  }
+
+  return true;
+}
+
+SSTableScanExecutor::SSTableScanExecutor(
+    size_t num_threads,
+    size_t max_queue_length,
+    size_t max_low_priority_threads) :
+    max_queue_length_(max_queue_length),
+    max_low_priority_threads_(max_low_priority_threads),
+    shutdown_(false) {
+  if (num_threads == 0) {
+    RAISE(kIllegalArgumentError, "num_threads must be greater than 0");
+  }
+
+  if (max_low_priority_threads_ == 0) {
+    max_low_priority_threads_ = num_threads > 1 ? num_threads - 1 : 1;
+  }
+
+  if (max_low_priority_threads_ > num_threads) {
+    RAISE(
+        kIllegalArgumentError,
+        "max_low_priority_threads must not be greater than num_threads");
+  }
+
+  for (auto queue : { &high_, &low_ }) {
+    queue->num_running = 0;
+    queue->num_executed = 0;
+    queue->num_failed = 0;
+    queue->num_rejected = 0;
+    queue->queue_micros = 0;
+  }
+
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(std::bind(&SSTableScanExecutor::work, this));
+  }
+}
+
+SSTableScanExecutor::~SSTableScanExecutor() {
+  {
+    std::unique_lock<std::mutex> lk(mutex_);
+    shutdown_ = true;
+  }
+
+  cv_.notify_all();
+  for (auto& t : threads_) {
+    t.join();
+  }
+}
+
+bool SSTableScanExecutor::submit(
+    Priority priority,
+    std::function<void ()> task) {
+  {
+    std::unique_lock<std::mutex> lk(mutex_);
+    auto queue = getQueue(priority);
+    if (queue->tasks.size() >= max_queue_length_) {
+      ++queue->num_rejected;
+      return false;
+    }
+
+    Task t;
+    t.fn = task;
+    t.queued_at = WallClock::unixMicros();
+    queue->tasks.emplace_back(std::move(t));
+  }
+
+  /* a worker that is waiting may not be allowed to start a low priority
+     task, so all workers are woken up */
+  cv_.notify_all();
+  return true;
+}
+
+SSTableScanExecutor::Queue* SSTableScanExecutor::nextQueue() {
+  if (!high_.tasks.empty()) {
+    return &high_;
+  }
+
+  if (!low_.tasks.empty() && low_.num_running < max_low_priority_threads_) {
+    return &low_;
+  }
+
+  return nullptr;
+}
+
+void SSTableScanExecutor::work() {
+  std::unique_lock<std::mutex> lk(mutex_);
+
+  for (;;) {
+    auto queue = nextQueue();
+    if (queue == nullptr) {
+      if (shutdown_ && high_.tasks.empty() && low_.tasks.empty()) {
+        return;
+      }
+
+      cv_.wait(lk);
+      continue;
+    }
+
+    auto task = std::move(queue->tasks.front());
+    queue->tasks.pop_front();
+    queue->queue_micros += WallClock::unixMicros() - task.queued_at;
+    ++queue->num_running;
+
+    lk.unlock();
+    bool failed = false;
+    try {
+      task.fn();
+    } catch (...) {
+      failed = true;
+    }
+
+    /* destroy the task (and the state it holds) before it counts as done */
+    task.fn = nullptr;
+    lk.lock();
+
+    --queue->num_running;
+    ++queue->num_executed;
+    if (failed) {
+      ++queue->num_failed;
+    }
+
+    /* a low priority slot may have been freed */
+    cv_.notify_all();
+  }
+}
+
+SSTableScanExecutor::Queue* SSTableScanExecutor::getQueue(Priority priority) {
+  return priority == Priority::HIGH ? &high_ : &low_;
+}
+
+const SSTableScanExecutor::Queue* SSTableScanExecutor::getQueue(
+    Priority priority) const {
+  return priority == Priority::HIGH ? &high_ : &low_;
+}
+
+size_t SSTableScanExecutor::numThreads() const {
+  return threads_.size();
+}
+
+size_t SSTableScanExecutor::maxQueueLength() const {
+  return max_queue_length_;
+}
+
+size_t SSTableScanExecutor::maxLowPriorityThreads() const {
+  return max_low_priority_threads_;
+}
+
+size_t SSTableScanExecutor::queueLength(Priority priority) const {
+  std::unique_lock<std::mutex> lk(mutex_);
+  return getQueue(priority)->tasks.size();
+}
+
+size_t SSTableScanExecutor::numRunning(Priority priority) const {
+  std::unique_lock<std::mutex> lk(mutex_);
+  return getQueue(priority)->num_running;
+}
+
+uint64_t SSTableScanExecutor::numExecuted(Priority priority) const {
+  std::unique_lock<std::mutex> lk(mutex_);
+  return getQueue(priority)->num_executed;
+}
+
+uint64_t SSTableScanExecutor::numFailed(Priority priority) const {
+  std::unique_lock<std::mutex> lk(mutex_);
+  return getQueue(priority)->num_failed;
+}
+
+uint64_t SSTableScanExecutor::numRejected(Priority priority) const {
+  std::unique_lock<std::mutex> lk(mutex_);
+  return getQueue(priority)->num_rejected;
+}
+
+uint64_t SSTableScanExecutor::queueMicros(Priority priority) const {
+  std::unique_lock<std::mutex> lk(mutex_);
+  return getQueue(priority)->queue_micros;
+}
+
+String SSTableScanExecutor::toString() const {
+  std::unique_lock<std::mutex> lk(mutex_);
+
+  String str = StringUtil::format(
+      "threads=$0, max_low_priority_threads=$1, max_queue_length=$2",
+      threads_.size(),
+      max_low_priority_threads_,
+      max_queue_length_);
+
+  for (auto priority : { Priority::HIGH, Priority::LOW }) {
+    auto queue = getQueue(priority);
+    str.append(
+        StringUtil::format(
+            ", $0_queued=$1, $0_running=$2, $0_executed=$3, $0_failed=$4",
+            scanPriorityToString(priority),
+            queue->tasks.size(),
+            queue->num_running,
+            queue->num_executed,
+            queue->num_failed));
+
+    str.append(
+        StringUtil::format(
+            ", $0_rejected=$1, $0_queue_micros=$2",
+            scanPriorityToString(priority),
+            queue->num_rejected,
+            queue->queue_micros));
+  }
+
+  return str;
+}
+
+}
+}
@@ -0,0 +1,140 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <stx/stdtypes.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * Runs scans on a fixed number of threads (scan slots) with one queue per
+ * priority. High priority tasks (cheap requests like point reads) are always
+ * started before low priority tasks (expensive scans), and low priority
+ * tasks only run on up to max_low_priority_threads threads, so the remaining
+ * threads are kept free for high priority tasks even if many expensive
+ * scans are queued.
+ *
+ * Each queue holds at most max_queue_length tasks; submit returns false
+ * instead of queueing more tasks, so callers can reject the request right
+ * away when the executor is overloaded.
+ *
+ * Tasks must not throw; exceptions thrown by a task are counted
+ * (numFailed) and otherwise ignored. Tasks must not block without a bound
+ * (e.g. on a client that stopped reading), since a blocked task holds its
+ * thread; see waitWithTimeout. The destructor runs all queued tasks and
+ * waits for them to finish
+ */
+class SSTableScanExecutor {
+public:
+  static const size_t kDefaultNumThreads = 8;
+  static const size_t kDefaultMaxQueueLength = 64;
+
+  enum class Priority { HIGH, LOW };
+
+  /**
+   * max_low_priority_threads defaults to all but one thread
+   */
+  SSTableScanExecutor(
+      size_t num_threads = kDefaultNumThreads,
+      size_t max_queue_length = kDefaultMaxQueueLength,
+      size_t max_low_priority_threads = 0);
+
+  ~SSTableScanExecutor();
+
+  SSTableScanExecutor(const SSTableScanExecutor& other) = delete;
+  SSTableScanExecutor& operator=(const SSTableScanExecutor& other) = delete;
+
+  /**
+   * Queue the task; returns false and drops the task if the queue for the
+   * priority is full
+   */
+  bool submit(Priority priority, std::function<void ()> task);
+
+  size_t numThreads() const;
+  size_t maxQueueLength() const;
+  size_t maxLowPriorityThreads() const;
+
+  /**
+   * Returns the number of queued and running tasks of a priority
+   */
+  size_t queueLength(Priority priority) const;
+  size_t numRunning(Priority priority) const;
+
+  /**
+   * Returns the number of finished tasks, the number of tasks that threw an
+   * exception and the number of rejected tasks of a priority
+   */
+  uint64_t numExecuted(Priority priority) const;
+  uint64_t numFailed(Priority priority) const;
+  uint64_t numRejected(Priority priority) const;
+
+  /**
+   * Returns the total time that the started tasks of a priority spent in
+   * the queue in microseconds
+   */
+  uint64_t queueMicros(Priority priority) const;
+
+  /**
+   * Returns the metrics as a string, e.g. for a status page
+   */
+  String toString() const;
+
+protected:
+
+  struct Task {
+    std::function<void ()> fn;
+    uint64_t queued_at;
+  };
+
+  struct Queue {
+    std::deque<Task> tasks;
+    size_t num_running;
+    uint64_t num_executed;
+    uint64_t num_failed;
+    uint64_t num_rejected;
+    uint64_t queue_micros;
+  };
+
+  void work();
+
+  /**
+   * Returns the queue to take the next task from or nullptr if no task can be
+   * started. Must be called with the lock held
+   */
+  Queue* nextQueue();
+
+  Queue* getQueue(Priority priority);
+  const Queue* getQueue(Priority priority) const;
+
+  size_t max_queue_length_;
+  size_t max_low_priority_threads_;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  Queue high_;
+  Queue low_;
+  bool shutdown_;
+  Vector<std::thread> threads_;
+};
+
+String scanPriorityToString(SSTableScanExecutor::Priority priority);
+
+/**
+ * Wait until ready returns true, polling it every 1ms to 10ms. Returns false
+ * if ready didn't return true within timeout_micros
+ */
+bool waitWithTimeout(Function<bool ()> ready, uint64_t timeout_micros);
+
+}
+}
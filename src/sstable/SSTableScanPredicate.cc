@@ -0,0 +1,888 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <stx/exception.h>
+#include <stx/ieee754.h>
+#include <stx/stringutil.h>
+#include <sstable/SSTableScanPredicate.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * Evaluate a comparison operator. cmp(arg) must return a negative number, zero
+ * or a positive number if the value is less than, equal to or greater than
+ * arg. The arguments of IN must be sorted
+ */
+template <typename T, typename CompareFn>
+static bool evaluateOp(
+    SSTableScanPredicate::Op op,
+    const Vector<T>& args,
+    CompareFn cmp) {
+  switch (op) {
+    case SSTableScanPredicate::Op::EQ:
+      return cmp(args[0]) == 0;
+    case SSTableScanPredicate::Op::NE:
+      return cmp(args[0]) != 0;
+    case SSTableScanPredicate::Op::LT:
+      return cmp(args[0]) < 0;
+    case SSTableScanPredicate::Op::LE:
+      return cmp(args[0]) <= 0;
+    case SSTableScanPredicate::Op::GT:
+      return cmp(args[0]) > 0;
+    case SSTableScanPredicate::Op::GE:
+      return cmp(args[0]) >= 0;
+    case SSTableScanPredicate::Op::BETWEEN:
+      return cmp(args[0]) >= 0 && cmp(args[1]) <= 0;
+
+    case SSTableScanPredicate::Op::IN: {
+      size_t lo = 0;
+      size_t hi = args.size();
+      while (lo < hi) {
+        auto mid = lo + (hi - lo) / 2;
+        auto c = cmp(args[mid]);
+        if (c == 0) {
+          return true;
+        } else if (c > 0) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+
+      return false;
+    }
+
+    default:
+      return false;
+  }
+}
+
+/**
+ * Returns false if no value in [min, max] can satisfy the comparison.
+ * cmp_min(arg) and cmp_max(arg) compare min and max to arg like the cmp
+ * function of evaluateOp
+ */
+template <typename T, typename CompareMinFn, typename CompareMaxFn>
+static bool mayMatchRange(
+    SSTableScanPredicate::Op op,
+    const Vector<T>& args,
+    CompareMinFn cmp_min,
+    CompareMaxFn cmp_max) {
+  switch (op) {
+    case SSTableScanPredicate::Op::EQ:
+      return cmp_min(args[0]) <= 0 && cmp_max(args[0]) >= 0;
+    case SSTableScanPredicate::Op::NE:
+      return !(cmp_min(args[0]) == 0 && cmp_max(args[0]) == 0);
+    case SSTableScanPredicate::Op::LT:
+      return cmp_min(args[0]) < 0;
+    case SSTableScanPredicate::Op::LE:
+      return cmp_min(args[0]) <= 0;
+    case SSTableScanPredicate::Op::GT:
+      return cmp_max(args[0]) > 0;
+    case SSTableScanPredicate::Op::GE:
+      return cmp_max(args[0]) >= 0;
+    case SSTableScanPredicate::Op::BETWEEN:
+      return cmp_max(args[0]) >= 0 && cmp_min(args[1]) <= 0;
+
+    case SSTableScanPredicate::Op::IN:
+      for (const auto& arg : args) {
+        if (cmp_min(arg) <= 0 && cmp_max(arg) >= 0) {
+          return true;
+        }
+      }
+      return false;
+
+    default:
+      return true;
+  }
+}
+
+static int compareString(const char* data, size_t size, const String& arg) {
+  auto c = memcmp(data, arg.data(), std::min(size, arg.size()));
+  if (c != 0) {
+    return c;
+  }
+
+  return size < arg.size() ? -1 : (size > arg.size() ? 1 : 0);
+}
+
+static const char* opToString(SSTableScanPredicate::Op op) {
+  switch (op) {
+    case SSTableScanPredicate::Op::EQ: return "=";
+    case SSTableScanPredicate::Op::NE: return "!=";
+    case SSTableScanPredicate::Op::LT: return "<";
+    case SSTableScanPredicate::Op::LE: return "<=";
+    case SSTableScanPredicate::Op::GT: return ">";
+    case SSTableScanPredicate::Op::GE: return ">=";
+    case SSTableScanPredicate::Op::IN: return "IN";
+    case SSTableScanPredicate::Op::BETWEEN: return "BETWEEN";
+    case SSTableScanPredicate::Op::PREFIX: return "PREFIX";
+    case SSTableScanPredicate::Op::AND: return "AND";
+    case SSTableScanPredicate::Op::OR: return "OR";
+  }
+
+  return "";
+}
+
+SSTableScanPredicate SSTableScanPredicate::equals(
+    const String& column,
+    const String& value) {
+  return SSTableScanPredicate(Op::EQ, column, Vector<String>{ value });
+}
+
+SSTableScanPredicate SSTableScanPredicate::notEquals(
+    const String& column,
+    const String& value) {
+  return SSTableScanPredicate(Op::NE, column, Vector<String>{ value });
+}
+
+SSTableScanPredicate SSTableScanPredicate::lessThan(
+    const String& column,
+    const String& value) {
+  return SSTableScanPredicate(Op::LT, column, Vector<String>{ value });
+}
+
+SSTableScanPredicate SSTableScanPredicate::lessThanOrEqual(
+    const String& column,
+    const String& value) {
+  return SSTableScanPredicate(Op::LE, column, Vector<String>{ value });
+}
+
+SSTableScanPredicate SSTableScanPredicate::greaterThan(
+    const String& column,
+    const String& value) {
+  return SSTableScanPredicate(Op::GT, column, Vector<String>{ value });
+}
+
+SSTableScanPredicate SSTableScanPredicate::greaterThanOrEqual(
+    const String& column,
+    const String& value) {
+  return SSTableScanPredicate(Op::GE, column, Vector<String>{ value });
+}
+
+SSTableScanPredicate SSTableScanPredicate::in(
+    const String& column,
+    const Vector<String>& values) {
+  return SSTableScanPredicate(Op::IN, column, values);
+}
+
+SSTableScanPredicate SSTableScanPredicate::between(
+    const String& column,
+    const String& lower,
+    const String& upper) {
+  return SSTableScanPredicate(
+      Op::BETWEEN,
+      column,
+      Vector<String>{ lower, upper });
+}
+
+SSTableScanPredicate SSTableScanPredicate::prefix(
+    const String& column,
+    const String& prefix) {
+  return SSTableScanPredicate(Op::PREFIX, column, Vector<String>{ prefix });
+}
+
+SSTableScanPredicate SSTableScanPredicate::allOf(
+    const Vector<SSTableScanPredicate>& predicates) {
+  return SSTableScanPredicate(Op::AND, predicates);
+}
+
+SSTableScanPredicate SSTableScanPredicate::anyOf(
+    const Vector<SSTableScanPredicate>& predicates) {
+  return SSTableScanPredicate(Op::OR, predicates);
+}
+
+SSTableScanPredicate::SSTableScanPredicate(
+    Op op,
+    const String& column,
+    const Vector<String>& args) :
+    op_(op),
+    column_(column),
+    args_(args),
+    schema_(nullptr),
+    bound_(false),
+    is_key_(false),
+    column_id_(0),
+    column_type_(SSTableColumnType::STRING),
+    is_dictionary_(false) {
+  size_t nargs_min = 1;
+  size_t nargs_max = 1;
+
+  switch (op_) {
+    case Op::AND:
+    case Op::OR:
+      RAISE(kIllegalArgumentError, "AND/OR predicates require children");
+    case Op::IN:
+      nargs_max = size_t(-1);
+      break;
+    case Op::BETWEEN:
+      nargs_min = 2;
+      nargs_max = 2;
+      break;
+    default:
+      break;
+  }
+
+  if (args_.size() < nargs_min || args_.size() > nargs_max) {
+    RAISEF(
+        kIllegalArgumentError,
+        "wrong number of arguments for $0 on column: $1",
+        opToString(op_),
+        column_);
+  }
+}
+
+SSTableScanPredicate::SSTableScanPredicate(
+    Op op,
+    const Vector<SSTableScanPredicate>& children) :
+    op_(op),
+    children_(children),
+    schema_(nullptr),
+    bound_(false),
+    is_key_(false),
+    column_id_(0),
+    column_type_(SSTableColumnType::STRING),
+    is_dictionary_(false) {
+  if (op_ != Op::AND && op_ != Op::OR) {
+    RAISE(kIllegalArgumentError, "only AND/OR predicates can have children");
+  }
+
+  if (children_.empty()) {
+    RAISE(kIllegalArgumentError, "AND/OR predicates require children");
+  }
+}
+
+SSTableScanPredicate::Op SSTableScanPredicate::op() const {
+  return op_;
+}
+
+void SSTableScanPredicate::bind(const SSTableColumnSchema* schema) {
+  schema_ = schema;
+  bound_ = true;
+
+  if (op_ == Op::AND || op_ == Op::OR) {
+    for (auto& c : children_) {
+      c.bind(schema);
+    }
+
+    return;
+  }
+
+  number_args_.clear();
+  float_args_.clear();
+  string_args_.clear();
+
+  if (column_ == "_key") {
+    is_key_ = true;
+    column_type_ = SSTableColumnType::STRING;
+    is_dictionary_ = false;
+  } else {
+    if (!schema_) {
+      RAISE(kIllegalStateError, "column predicates require a sstable schema");
+    }
+
+    is_key_ = false;
+    column_id_ = schema_->columnID(column_);
+    column_type_ = schema_->columnType(column_id_);
+    is_dictionary_ = schema_->columnEncoding(column_id_) ==
+        SSTableColumnEncoding::DICTIONARY;
+  }
+
+  if (op_ == Op::PREFIX && column_type_ != SSTableColumnType::STRING) {
+    RAISEF(
+        kIllegalArgumentError,
+        "PREFIX requires a string column: $0",
+        column_);
+  }
+
+  for (const auto& arg : args_) {
+    bool valid = true;
+    switch (column_type_) {
+      case SSTableColumnType::UINT32:
+      case SSTableColumnType::UINT64: {
+        /* strtoull accepts (and wraps) negative numbers and leading spaces */
+        char* end;
+        errno = 0;
+        number_args_.emplace_back(strtoull(arg.c_str(), &end, 10));
+        valid =
+            !arg.empty() &&
+            isdigit((unsigned char) arg[0]) &&
+            *end == 0 &&
+            errno == 0;
+        break;
+      }
+
+      case SSTableColumnType::FLOAT: {
+        char* end;
+        float_args_.emplace_back(strtod(arg.c_str(), &end));
+        valid = !arg.empty() && *end == 0;
+        break;
+      }
+
+      case SSTableColumnType::STRING:
+        string_args_.emplace_back(arg);
+        break;
+    }
+
+    if (!valid) {
+      RAISEF(
+          kIllegalArgumentError,
+          "invalid value for column $0: '$1'",
+          column_,
+          arg);
+    }
+  }
+
+  /* equality on dictionary encoded columns compares dictionary codes */
+  if (is_dictionary_ &&
+      (op_ == Op::EQ || op_ == Op::NE || op_ == Op::IN)) {
+    for (const auto& arg : args_) {
+      uint32_t code;
+      if (schema_->lookupDictionaryCode(column_id_, arg, &code)) {
+        number_args_.emplace_back(code);
+      }
+    }
+  }
+
+  if (op_ == Op::IN) {
+    std::sort(number_args_.begin(), number_args_.end());
+    std::sort(float_args_.begin(), float_args_.end());
+    std::sort(string_args_.begin(), string_args_.end());
+  }
+}
+
+bool SSTableScanPredicate::evaluate(
+    const void* key,
+    size_t key_size,
+    const SSTableColumnReader& row) const {
+  if (!bound_) {
+    RAISE(kIllegalStateError, "predicate is not bound");
+  }
+
+  switch (op_) {
+    case Op::AND:
+      for (const auto& c : children_) {
+        if (!c.evaluate(key, key_size, row)) {
+          return false;
+        }
+      }
+      return true;
+
+    case Op::OR:
+      for (const auto& c : children_) {
+        if (c.evaluate(key, key_size, row)) {
+          return true;
+        }
+      }
+      return false;
+
+    default:
+      break;
+  }
+
+  if (is_key_) {
+    return evaluateString((const char*) key, key_size);
+  }
+
+  for (const auto& col : row.col_data_) {
+    if (std::get<0>(col) != column_id_) {
+      continue;
+    }
+
+    if (evaluateValue(
+          std::get<1>(col),
+          (const char*) std::get<1>(col),
+          std::get<2>(col))) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool SSTableScanPredicate::evaluateValue(
+    uint64_t value,
+    const char* data,
+    uint32_t size) const {
+  switch (column_type_) {
+    case SSTableColumnType::UINT32:
+    case SSTableColumnType::UINT64:
+      return evaluateNumber(value);
+
+    case SSTableColumnType::FLOAT:
+      return evaluateFloat(IEEE754::fromBytes(value));
+
+    case SSTableColumnType::STRING:
+      break;
+  }
+
+  if (!is_dictionary_) {
+    return evaluateString(data, size);
+  }
+
+  switch (op_) {
+    case Op::EQ:
+      return number_args_.size() > 0 && value == number_args_[0];
+    case Op::NE:
+      return number_args_.size() == 0 || value != number_args_[0];
+    case Op::IN:
+      return std::binary_search(
+          number_args_.begin(),
+          number_args_.end(),
+          value);
+    default: {
+      const auto& str = schema_->dictionaryValue(column_id_, value);
+      return evaluateString(str.data(), str.size());
+    }
+  }
+}
+
+bool SSTableScanPredicate::evaluateNumber(uint64_t value) const {
+  return evaluateOp(op_, number_args_, [value] (uint64_t arg) -> int {
+    return value < arg ? -1 : (value > arg ? 1 : 0);
+  });
+}
+
+bool SSTableScanPredicate::evaluateFloat(double value) const {
+  return evaluateOp(op_, float_args_, [value] (double arg) -> int {
+    return value < arg ? -1 : (value > arg ? 1 : 0);
+  });
+}
+
+bool SSTableScanPredicate::evaluateString(
+    const char* data,
+    uint32_t size) const {
+  if (op_ == Op::PREFIX) {
+    const auto& prefix = string_args_[0];
+    return
+        size >= prefix.size() &&
+        memcmp(data, prefix.data(), prefix.size()) == 0;
+  }
+
+  return evaluateOp(op_, string_args_, [data, size] (const String& arg) {
+    return compareString(data, size, arg);
+  });
+}
+
+bool SSTableScanPredicate::mayMatch(const SSTableZoneMap::Zone& zone) const {
+  if (!bound_) {
+    RAISE(kIllegalStateError, "predicate is not bound");
+  }
+
+  switch (op_) {
+    case Op::AND:
+      for (const auto& c : children_) {
+        if (!c.mayMatch(zone)) {
+          return false;
+        }
+      }
+      return true;
+
+    case Op::OR:
+      for (const auto& c : children_) {
+        if (c.mayMatch(zone)) {
+          return true;
+        }
+      }
+      return false;
+
+    default:
+      break;
+  }
+
+  const String* min_string;
+  const String* max_string;
+  uint64_t min = 0;
+  uint64_t max = 0;
+
+  if (is_key_) {
+    min_string = &zone.min_key;
+    max_string = &zone.max_key;
+  } else {
+    auto iter = zone.columns.find(column_id_);
+    if (iter == zone.columns.end()) {
+      return true;
+    }
+
+    if (iter->second.value_count == 0) {
+      return false;
+    }
+
+    min_string = &iter->second.min_string;
+    max_string = &iter->second.max_string;
+    min = iter->second.min;
+    max = iter->second.max;
+  }
+
+  switch (column_type_) {
+
+    case SSTableColumnType::UINT32:
+    case SSTableColumnType::UINT64:
+      return mayMatchRange(
+          op_,
+          number_args_,
+          [min] (uint64_t arg) -> int {
+            return min < arg ? -1 : (min > arg ? 1 : 0);
+          },
+          [max] (uint64_t arg) -> int {
+            return max < arg ? -1 : (max > arg ? 1 : 0);
+          });
+
+    case SSTableColumnType::FLOAT: {
+      auto fmin = IEEE754::fromBytes(min);
+      auto fmax = IEEE754::fromBytes(max);
+
+      /* the zone contains NaN values (see SSTableZoneMap) */
+      if (std::isnan(fmin) || std::isnan(fmax)) {
+        return true;
+      }
+
+      return mayMatchRange(
+          op_,
+          float_args_,
+          [fmin] (double arg) -> int {
+            return fmin < arg ? -1 : (fmin > arg ? 1 : 0);
+          },
+          [fmax] (double arg) -> int {
+            return fmax < arg ? -1 : (fmax > arg ? 1 : 0);
+          });
+    }
+
+    case SSTableColumnType::STRING:
+      break;
+
+  }
+
+  if (op_ == Op::PREFIX) {
+    const auto& prefix = string_args_[0];
+    return
+        compareString(max_string->data(), max_string->size(), prefix) >= 0 &&
+        compareString(
+            min_string->data(),
+            std::min(min_string->size(), prefix.size()),
+            prefix) <= 0;
+  }
+
+  return mayMatchRange(
+      op_,
+      string_args_,
+      [min_string] (const String& arg) {
+        return compareString(min_string->data(), min_string->size(), arg);
+      },
+      [max_string] (const String& arg) {
+        return compareString(max_string->data(), max_string->size(), arg);
+      });
+}
+
+void SSTableScanPredicate::getColumnIDs(
+    Set<SSTableColumnID>* column_ids) const {
+  if (!bound_) {
+    RAISE(kIllegalStateError, "predicate is not bound");
+  }
+
+  for (const auto& c : children_) {
+    c.getColumnIDs(column_ids);
+  }
+
+  if (children_.empty() && !is_key_) {
+    column_ids->emplace(column_id_);
+  }
+}
+
+bool SSTableScanPredicate::needsColumns() const {
+  for (const auto& c : children_) {
+    if (c.needsColumns()) {
+      return true;
+    }
+  }
+
+  return children_.empty() && column_ != "_key";
+}
+
+String SSTableScanPredicate::toString() const {
+  if (op_ == Op::AND || op_ == Op::OR) {
+    Vector<String> parts;
+    for (const auto& c : children_) {
+      parts.emplace_back(c.toString());
+    }
+
+    return "(" + StringUtil::join(parts, String(" ") + opToString(op_) + " ") +
+        ")";
+  }
+
+  Vector<String> args;
+  for (const auto& a : args_) {
+    String quoted = "'";
+    for (auto c : a) {
+      quoted += c;
+      if (c == '\'') {
+        quoted += c;
+      }
+    }
+
+    args.emplace_back(quoted + "'");
+  }
+
+  switch (op_) {
+    case Op::IN:
+      return StringUtil::format(
+          "$0 IN ($1)",
+          column_,
+          StringUtil::join(args, ", "));
+    case Op::BETWEEN:
+      return StringUtil::format(
+          "$0 BETWEEN $1 AND $2",
+          column_,
+          args[0],
+          args[1]);
+    default:
+      return StringUtil::format("$0 $1 $2", column_, opToString(op_), args[0]);
+  }
+}
+
+/**
+ * Recursive descent parser for predicate expressions
+ */
+class SSTableScanPredicateParser {
+public:
+  enum class TokenType { WORD, STRING, OP, LPAREN, RPAREN, COMMA };
+
+  struct Token {
+    TokenType type;
+    String value;
+  };
+
+  SSTableScanPredicateParser(const String& expr) : expr_(expr), pos_(0) {
+    tokenize();
+  }
+
+  SSTableScanPredicate parse() {
+    auto pred = parseOr();
+    if (pos_ < tokens_.size()) {
+      RAISEF(
+          kParseError,
+          "unexpected token in filter expression: $0",
+          tokens_[pos_].value);
+    }
+
+    return pred;
+  }
+
+protected:
+
+  SSTableScanPredicate parseOr() {
+    Vector<SSTableScanPredicate> preds;
+    preds.emplace_back(parseAnd());
+    while (consumeKeyword("OR")) {
+      preds.emplace_back(parseAnd());
+    }
+
+    return preds.size() == 1 ? preds[0] : SSTableScanPredicate::anyOf(preds);
+  }
+
+  SSTableScanPredicate parseAnd() {
+    Vector<SSTableScanPredicate> preds;
+    preds.emplace_back(parseTerm());
+    while (consumeKeyword("AND")) {
+      preds.emplace_back(parseTerm());
+    }
+
+    return preds.size() == 1 ? preds[0] : SSTableScanPredicate::allOf(preds);
+  }
+
+  SSTableScanPredicate parseTerm() {
+    if (consume(TokenType::LPAREN)) {
+      auto pred = parseOr();
+      expect(TokenType::RPAREN, ")");
+      return pred;
+    }
+
+    auto column = expect(TokenType::WORD, "column name");
+
+    if (consumeKeyword("IN")) {
+      expect(TokenType::LPAREN, "(");
+      Vector<String> values;
+      do {
+        values.emplace_back(parseValue());
+      } while (consume(TokenType::COMMA));
+      expect(TokenType::RPAREN, ")");
+      return SSTableScanPredicate::in(column, values);
+    }
+
+    if (consumeKeyword("BETWEEN")) {
+      auto lower = parseValue();
+      if (!consumeKeyword("AND")) {
+        RAISE(kParseError, "expected AND after BETWEEN");
+      }
+
+      auto upper = parseValue();
+      return SSTableScanPredicate::between(column, lower, upper);
+    }
+
+    if (consumeKeyword("PREFIX")) {
+      return SSTableScanPredicate::prefix(column, parseValue());
+    }
+
+    auto op = expect(TokenType::OP, "operator");
+    auto value = parseValue();
+
+    if (op == "=" || op == "==") {
+      return SSTableScanPredicate::equals(column, value);
+    } else if (op == "!=" || op == "<>") {
+      return SSTableScanPredicate::notEquals(column, value);
+    } else if (op == "<") {
+      return SSTableScanPredicate::lessThan(column, value);
+    } else if (op == "<=") {
+      return SSTableScanPredicate::lessThanOrEqual(column, value);
+    } else if (op == ">") {
+      return SSTableScanPredicate::greaterThan(column, value);
+    } else if (op == ">=") {
+      return SSTableScanPredicate::greaterThanOrEqual(column, value);
+    }
+
+    RAISEF(kParseError, "invalid operator in filter expression: $0", op);
+  }
+
+  String parseValue() {
+    if (pos_ < tokens_.size() &&
+        (tokens_[pos_].type == TokenType::WORD ||
+         tokens_[pos_].type == TokenType::STRING)) {
+      return tokens_[pos_++].value;
+    }
+
+    RAISE(kParseError, "expected value in filter expression");
+  }
+
+  bool consume(TokenType type) {
+    if (pos_ < tokens_.size() && tokens_[pos_].type == type) {
+      ++pos_;
+      return true;
+    }
+
+    return false;
+  }
+
+  bool consumeKeyword(const String& keyword) {
+    if (pos_ >= tokens_.size() || tokens_[pos_].type != TokenType::WORD) {
+      return false;
+    }
+
+    auto word = tokens_[pos_].value;
+    StringUtil::toUpper(&word);
+    if (word != keyword) {
+      return false;
+    }
+
+    ++pos_;
+    return true;
+  }
+
+  String expect(TokenType type, const String& what) {
+    if (pos_ < tokens_.size() && tokens_[pos_].type == type) {
+      return tokens_[pos_++].value;
+    }
+
+    RAISEF(kParseError, "expected $0 in filter expression", what);
+  }
+
+  void tokenize() {
+    size_t i = 0;
+    while (i < expr_.size()) {
+      auto c = expr_[i];
+
+      if (isspace((unsigned char) c)) {
+        ++i;
+        continue;
+      }
+
+      switch (c) {
+        case '(':
+          tokens_.emplace_back(Token { TokenType::LPAREN, "(" });
+          ++i;
+          continue;
+        case ')':
+          tokens_.emplace_back(Token { TokenType::RPAREN, ")" });
+          ++i;
+          continue;
+        case ',':
+          tokens_.emplace_back(Token { TokenType::COMMA, "," });
+          ++i;
+          continue;
+        case '=':
+        case '!':
+        case '<':
+        case '>': {
+          auto begin = i++;
+          if (i < expr_.size() && (expr_[i] == '=' || expr_[i] == '>')) {
+            ++i;
+          }
+
+          tokens_.emplace_back(
+              Token { TokenType::OP, expr_.substr(begin, i - begin) });
+          continue;
+        }
+        case '\'': {
+          String value;
+          for (++i; ; ++i) {
+            if (i >= expr_.size()) {
+              RAISE(kParseError, "unterminated string in filter expression");
+            }
+
+            if (expr_[i] == '\'') {
+              if (i + 1 < expr_.size() && expr_[i + 1] == '\'') {
+                value += '\'';
+                ++i;
+                continue;
+              }
+
+              ++i;
+              break;
+            }
+
+            value += expr_[i];
+          }
+
+          tokens_.emplace_back(Token { TokenType::STRING, value });
+          continue;
+        }
+        default:
+          break;
+      }
+
+      auto begin = i;
+      while (i < expr_.size() &&
+          !isspace((unsigned char) expr_[i]) &&
+          strchr("(),=!<>'", expr_[i]) == nullptr) {
+        ++i;
+      }
+
+      tokens_.emplace_back(
+          Token { TokenType::WORD, expr_.substr(begin, i - begin) });
+    }
+  }
+
+  const String& expr_;
+  Vector<Token> tokens_;
+  size_t pos_;
+};
+
+SSTableScanPredicate SSTableScanPredicate::parse(const String& expr) {
+  SSTableScanPredicateParser parser(expr);
+  return parser.parse();
+}
+
+}
+}
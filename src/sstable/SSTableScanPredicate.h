@@ -0,0 +1,176 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <sstable/SSTableColumnSchema.h>
+#include <sstable/SSTableColumnReader.h>
+#include <sstable/SSTableZoneMap.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * A typed filter on the columns of a row. Predicates are evaluated on the
+ * decoded column values of a row (numbers and pointers into the row data)
+ * before any String is materialized.
+ *
+ * The column "_key" refers to the row key and is compared as a string. A
+ * comparison on a column that has no value in a row is false; if a column
+ * has multiple values, the comparison is true if any value matches.
+ *
+ * Predicates are built with the factory methods or parsed from a text
+ * expression:
+ *
+ *   expr       := and_expr [ OR and_expr ]*
+ *   and_expr   := term [ AND term ]*
+ *   term       := '(' expr ')'
+ *               | column op value
+ *               | column IN '(' value [ ',' value ]* ')'
+ *               | column BETWEEN value AND value
+ *               | column PREFIX value
+ *   op         := = | != | < | <= | > | >=
+ *   value      := 'quoted string' | bare_word
+ *
+ * e.g. "country IN ('DE', 'US') AND (clicks >= 10 OR name PREFIX 'foo')"
+ */
+class SSTableScanPredicate {
+public:
+  enum class Op : uint8_t {
+    EQ,
+    NE,
+    LT,
+    LE,
+    GT,
+    GE,
+    IN,
+    BETWEEN,
+    PREFIX,
+    AND,
+    OR
+  };
+
+  static SSTableScanPredicate equals(
+      const String& column,
+      const String& value);
+
+  static SSTableScanPredicate notEquals(
+      const String& column,
+      const String& value);
+
+  static SSTableScanPredicate lessThan(
+      const String& column,
+      const String& value);
+
+  static SSTableScanPredicate lessThanOrEqual(
+      const String& column,
+      const String& value);
+
+  static SSTableScanPredicate greaterThan(
+      const String& column,
+      const String& value);
+
+  static SSTableScanPredicate greaterThanOrEqual(
+      const String& column,
+      const String& value);
+
+  static SSTableScanPredicate in(
+      const String& column,
+      const Vector<String>& values);
+
+  static SSTableScanPredicate between(
+      const String& column,
+      const String& lower,
+      const String& upper);
+
+  static SSTableScanPredicate prefix(
+      const String& column,
+      const String& prefix);
+
+  static SSTableScanPredicate allOf(
+      const Vector<SSTableScanPredicate>& predicates);
+
+  static SSTableScanPredicate anyOf(
+      const Vector<SSTableScanPredicate>& predicates);
+
+  /**
+   * Parse a predicate from a text expression (see above)
+   */
+  static SSTableScanPredicate parse(const String& expr);
+
+  SSTableScanPredicate(
+      Op op,
+      const String& column,
+      const Vector<String>& args);
+
+  SSTableScanPredicate(
+      Op op,
+      const Vector<SSTableScanPredicate>& children);
+
+  Op op() const;
+
+  /**
+   * Resolve the column names and convert the arguments to the column types.
+   * Must be called before evaluate
+   */
+  void bind(const SSTableColumnSchema* schema);
+
+  /**
+   * Returns true if the row with the provided key and column values matches
+   * the predicate. Requires a bound predicate
+   */
+  bool evaluate(
+      const void* key,
+      size_t key_size,
+      const SSTableColumnReader& row) const;
+
+  /**
+   * Returns false if no row in the zone can match the predicate. Requires a
+   * bound predicate
+   */
+  bool mayMatch(const SSTableZoneMap::Zone& zone) const;
+
+  /**
+   * Add the ids of all columns the predicate refers to (excluding the key) to
+   * column_ids
+   */
+  void getColumnIDs(Set<SSTableColumnID>* column_ids) const;
+
+  /**
+   * Returns true if the predicate refers to any column other than the key
+   */
+  bool needsColumns() const;
+
+  String toString() const;
+
+protected:
+  bool evaluateValue(uint64_t value, const char* data, uint32_t size) const;
+  bool evaluateNumber(uint64_t value) const;
+  bool evaluateFloat(double value) const;
+  bool evaluateString(const char* data, uint32_t size) const;
+
+  Op op_;
+  String column_;
+  Vector<String> args_;
+  Vector<SSTableScanPredicate> children_;
+
+  /* set by bind() */
+  const SSTableColumnSchema* schema_;
+  bool bound_;
+  bool is_key_;
+  SSTableColumnID column_id_;
+  SSTableColumnType column_type_;
+  bool is_dictionary_;
+  Vector<uint64_t> number_args_;
+  Vector<double> float_args_;
+  Vector<String> string_args_;
+};
+
+}
+}
@@ -0,0 +1,102 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stx/stringutil.h>
+#include <sstable/SSTableScanStats.h>
+
+namespace stx {
+namespace sstable {
+
+String scanStatusToString(SSTableScanStatus status) {
+  switch (status) {
+    case SSTableScanStatus::COMPLETE:
+      return "complete";
+    case SSTableScanStatus::DEADLINE_EXCEEDED:
+      return "deadline_exceeded";
+    case SSTableScanStatus::CANCELLED:
+      return "cancelled";
+  }
+
+  return "unknown";
+}
+
+SSTableScanStats::SSTableScanStats() :
+    status(SSTableScanStatus::COMPLETE),
+    rows_scanned(0),
+    rows_in_key_range(0),
+    rows_key_matched(0),
+    rows_regex_matched(0),
+    rows_filter_matched(0),
+    rows_emitted(0),
+    key_bytes_read(0),
+    value_bytes_read(0),
+    zones_skipped(0),
+    key_index_seeks(0),
+    keys_bloom_filtered(0),
+    sample_rate(1),
+    sample_units(0),
+    sample_units_read(0),
+    spilled_bytes(0),
+    scan_micros(0),
+    output_micros(0),
+    sort_micros(0),
+    aggregate_micros(0) {}
+
+Vector<std::pair<String, String>> SSTableScanStats::toList() const {
+  Vector<std::pair<String, String>> list;
+
+  auto add = [&list] (const String& name, uint64_t value) {
+    list.emplace_back(name, StringUtil::toString(value));
+  };
+
+  list.emplace_back("status", scanStatusToString(status));
+  add("rows_scanned", rows_scanned);
+  add("rows_in_key_range", rows_in_key_range);
+  add("rows_key_matched", rows_key_matched);
+  add("rows_regex_matched", rows_regex_matched);
+  for (size_t i = 0; i < filter_rows_matched.size(); ++i) {
+    add(StringUtil::format("filter$0_rows_matched", i), filter_rows_matched[i]);
+  }
+  add("rows_filter_matched", rows_filter_matched);
+  add("rows_emitted", rows_emitted);
+  add("key_bytes_read", key_bytes_read);
+  add("value_bytes_read", value_bytes_read);
+  add("zones_skipped", zones_skipped);
+  add("key_index_seeks", key_index_seeks);
+  add("keys_bloom_filtered", keys_bloom_filtered);
+  list.emplace_back("sample_rate", StringUtil::toString(sample_rate));
+  add("sample_units", sample_units);
+  add("sample_units_read", sample_units_read);
+  add("spilled_bytes", spilled_bytes);
+  add("scan_micros", scan_micros);
+  add("output_micros", output_micros);
+  add("sort_micros", sort_micros);
+  add("aggregate_micros", aggregate_micros);
+
+  return list;
+}
+
+String SSTableScanStats::toString() const {
+  String str;
+
+  for (const auto& s : toList()) {
+    if (!str.empty()) {
+      str.append(", ");
+    }
+
+    str.append(s.first);
+    str.append("=");
+    str.append(s.second);
+  }
+
+  return str;
+}
+
+}
+}
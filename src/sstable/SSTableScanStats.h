@@ -0,0 +1,85 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * The result of a scan. A scan that stopped because its deadline passed or it
+ * was cancelled has returned a partial result
+ */
+enum class SSTableScanStatus : uint8_t {
+  COMPLETE,
+  DEADLINE_EXCEEDED,
+  CANCELLED
+};
+
+String scanStatusToString(SSTableScanStatus status);
+
+/**
+ * Counters and phase timings of one SSTableScan::execute call.
+ *
+ * The rows_* counters count the rows that passed each stage of the scan in
+ * the order the stages are applied: key range, exact key match, key regex and
+ * column filters. filter_rows_matched has one counter per column filter.
+ *
+ * scan_micros is the time spent reading, filtering and decoding rows
+ * (excluding output_micros); output_micros is the time spent in the result
+ * callback if SSTableScan::setMeasureOutputTime is enabled; sort_micros and
+ * aggregate_micros are the time spent sorting the result and computing the
+ * aggregate result rows after the scan.
+ *
+ * keys_bloom_filtered is the number of keys of an exact key match that the
+ * bloom filter showed not to be in the table.
+ *
+ * For sampled scans, sample_rate is the (effective) sampling rate and
+ * sample_units_read of the sample_units blocks or rows that were visited
+ * were read. sample_rate is 1 for scans without sampling
+ */
+struct SSTableScanStats {
+  SSTableScanStats();
+
+  SSTableScanStatus status;
+  uint64_t rows_scanned;
+  uint64_t rows_in_key_range;
+  uint64_t rows_key_matched;
+  uint64_t rows_regex_matched;
+  uint64_t rows_filter_matched;
+  Vector<uint64_t> filter_rows_matched;
+  uint64_t rows_emitted;
+  uint64_t key_bytes_read;
+  uint64_t value_bytes_read;
+  uint64_t zones_skipped;
+  uint64_t key_index_seeks;
+  uint64_t keys_bloom_filtered;
+  double sample_rate;
+  uint64_t sample_units;
+  uint64_t sample_units_read;
+  uint64_t spilled_bytes;
+  uint64_t scan_micros;
+  uint64_t output_micros;
+  uint64_t sort_micros;
+  uint64_t aggregate_micros;
+
+  /**
+   * Returns (name, value) pairs of all counters
+   */
+  Vector<std::pair<String, String>> toList() const;
+
+  /**
+   * Returns the counters as "name=value" pairs separated by ", "
+   */
+  String toString() const;
+};
+
+}
+}
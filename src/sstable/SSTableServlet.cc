@@ -7,71 +7,468 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <stdio.h>
+#include <limits>
+#include <random>
 #include "sstable/SSTableServlet.h"
 #include "sstable/sstablereader.h"
 #include "sstable/SSTableScan.h"
+#include "sstable/SSTableExternalSort.h"
 #include "stx/io/fileutil.h"
+#include "stx/logging.h"
+#include "stx/wallclock.h"
 
 namespace stx {
 namespace sstable {
 
+static const char kTrailers[] =
+    "X-SSTable-Spilled-Bytes, X-SSTable-Scan-Stats, X-SSTable-Scan-Status, "
+    "X-SSTable-Sample-Rate, X-SSTable-Continuation-Token, X-SSTable-Error";
+
+/**
+ * Write data as one chunk of a chunked response
+ */
+static void writeChunk(
+    http::HTTPResponseStream* res_stream,
+    const void* data,
+    size_t size) {
+  char size_hex[20];
+  auto size_len = snprintf(size_hex, sizeof(size_hex), "%zx\r\n", size);
+
+  Buffer chunk;
+  chunk.reserve(size_len + size + 2);
+  chunk.append(size_hex, size_len);
+  chunk.append(data, size);
+  chunk.append("\r\n", 2);
+  res_stream->writeBodyChunk(chunk);
+}
+
+/**
+ * Returns the value with control characters escaped as \xNN and cut to
+ * kMaxHeaderValueSize bytes. Error messages quote user input and table data,
+ * and a CR or LF in a header or trailer would end it early and let the rest
+ * of the value be read as more headers or a new response
+ */
+static String headerValue(const String& value) {
+  static const size_t kMaxHeaderValueSize = 1024;
+
+  String escaped;
+  for (const auto& c : value) {
+    auto b = (unsigned char) c;
+    if (b < 0x20 || b == 0x7f) {
+      char hex[5];
+      snprintf(hex, sizeof(hex), "\\x%02x", b);
+      escaped.append(hex);
+    } else {
+      escaped += c;
+    }
+
+    if (escaped.size() >= kMaxHeaderValueSize) {
+      escaped.resize(kMaxHeaderValueSize);
+      escaped.append("...");
+      break;
+    }
+  }
+
+  return escaped;
+}
+
+/**
+ * Write the last chunk of a chunked response followed by the trailers
+ */
+static void finishChunkedResponse(
+    http::HTTPResponseStream* res_stream,
+    const Vector<std::pair<String, String>>& trailers) {
+  Buffer chunk;
+  chunk.append("0\r\n");
+  for (const auto& t : trailers) {
+    chunk.append(t.first);
+    chunk.append(": ");
+    chunk.append(headerValue(t.second));
+    chunk.append("\r\n");
+  }
+  chunk.append("\r\n");
+
+  res_stream->writeBodyChunk(chunk);
+  res_stream->finishResponse();
+}
+
 SSTableServlet::SSTableServlet(
     const String& base_path,
     VFS* vfs) :
     base_path_(base_path),
-    vfs_(vfs) {}
+    vfs_(vfs),
+    sort_memory_limit_(SSTableExternalSort::kDefaultMemoryLimit),
+    tempdir_("/tmp"),
+    max_query_time_(0),
+    flush_size_(SSTableResultWriter::kDefaultFlushSize),
+    write_timeout_(kDefaultWriteTimeout),
+    reader_cache_size_(SSTableReaderCache::kDefaultMaxEntries),
+    reader_cache_(new SSTableReaderCache(vfs)),
+    executor_(new SSTableScanExecutor()) {
+  std::random_device random;
+  for (size_t i = 0; i < SSTableSipHash::kKeySize; ++i) {
+    continuation_secret_ += (char) random();
+  }
+}
+
+void SSTableServlet::setSortMemoryLimit(size_t bytes) {
+  sort_memory_limit_ = bytes;
+}
+
+void SSTableServlet::setTempDirectory(const String& tempdir) {
+  tempdir_ = tempdir;
+}
+
+void SSTableServlet::setMaxQueryTime(uint64_t micros) {
+  max_query_time_ = micros;
+}
+
+void SSTableServlet::setContinuationSecret(const String& secret) {
+  continuation_secret_ = secret;
+}
+
+void SSTableServlet::setWriteTimeout(uint64_t micros) {
+  write_timeout_ = micros;
+}
+
+void SSTableServlet::setFlushSize(size_t bytes) {
+  flush_size_ = bytes;
+}
+
+void SSTableServlet::setReaderCacheSize(size_t max_entries) {
+  reader_cache_size_ = max_entries;
+  if (max_entries == 0) {
+    reader_cache_.reset(nullptr);
+  } else {
+    reader_cache_.reset(
+        new SSTableReaderCache(vfs_, max_entries, resolve_path_));
+  }
+}
+
+void SSTableServlet::setPathResolver(
+    SSTableReaderCache::PathResolver resolve_path) {
+  resolve_path_ = resolve_path;
+  setReaderCacheSize(reader_cache_size_);
+}
+
+const SSTableReaderCache* SSTableServlet::readerCache() const {
+  return reader_cache_.get();
+}
+
+void SSTableServlet::setScanThreads(
+    size_t num_threads,
+    size_t max_queue_length) {
+  /* finish the queued requests first */
+  executor_.reset(nullptr);
+  if (num_threads > 0) {
+    executor_.reset(new SSTableScanExecutor(num_threads, max_queue_length));
+  }
+}
+
+const SSTableScanExecutor* SSTableServlet::scanExecutor() const {
+  return executor_.get();
+}
+
+SSTableScanExecutor::Priority SSTableServlet::requestPriority(
+    const URI& uri) const {
+  auto path = uri.path();
+  if (path == base_path_ + "/get" || path == base_path_ + "/multiget") {
+    return SSTableScanExecutor::Priority::HIGH;
+  }
+
+  for (const auto& p : uri.queryParams()) {
+    if (p.first == "key_match") {
+      return SSTableScanExecutor::Priority::HIGH;
+    }
+  }
+
+  return SSTableScanExecutor::Priority::LOW;
+}
 
 void SSTableServlet::handleHTTPRequest(
-    stx::http::HTTPRequest* req,
-    stx::http::HTTPResponse* res) {
-  URI uri(req->uri());
+    RefPtr<stx::http::HTTPRequestStream> req_stream,
+    RefPtr<stx::http::HTTPResponseStream> res_stream) {
+  req_stream->readBody();
+  const auto& req = req_stream->request();
+  URI uri(req.uri());
 
-  res->addHeader("Access-Control-Allow-Origin", "*");
+  auto path = uri.path();
+  if (path == base_path_ + "/status") {
+    status(req, res_stream);
+    return;
+  }
 
-  if (uri.path() == base_path_ + "/scan") {
-    try{
-      scan(req, res, uri);
-    } catch (const Exception& e) {
-      res->setStatus(http::kStatusInternalServerError);
-      res->addBody(StringUtil::format("error: $0", e.getMessage()));
+  if (path == base_path_ + "/scan" ||
+      path == base_path_ + "/get" ||
+      path == base_path_ + "/multiget") {
+    if (!executor_.get()) {
+      handleScanRequest(req_stream, res_stream);
+      return;
     }
+
+    auto queued = executor_->submit(
+        requestPriority(uri),
+        [this, req_stream, res_stream] () {
+      handleScanRequest(req_stream, res_stream);
+    });
+
+    /* reject instead of queueing without a bound */
+    if (!queued) {
+      http::HTTPResponse res;
+      res.populateFromRequest(req);
+      res.addHeader("Access-Control-Allow-Origin", "*");
+      res.addHeader("Retry-After", "1");
+      res.setStatus(http::kStatusServiceUnavailable);
+      res.addBody("error: too many queued requests");
+      res_stream->writeResponse(res);
+    }
+
     return;
   }
 
-  res->setStatus(stx::http::kStatusNotFound);
-  res->addBody("not found");
+  http::HTTPResponse res;
+  res.populateFromRequest(req);
+  res.addHeader("Access-Control-Allow-Origin", "*");
+  res.setStatus(stx::http::kStatusNotFound);
+  res.addBody("not found");
+  res_stream->writeResponse(res);
 }
 
-void SSTableServlet::scan(
-    stx::http::HTTPRequest* req,
+void SSTableServlet::handleScanRequest(
+    RefPtr<stx::http::HTTPRequestStream> req_stream,
+    RefPtr<stx::http::HTTPResponseStream> res_stream) {
+  const auto& req = req_stream->request();
+  URI uri(req.uri());
+
+  http::HTTPResponse res;
+  res.populateFromRequest(req);
+  res.addHeader("Access-Control-Allow-Origin", "*");
+
+  /* report the error in the response; once the headers of a streamed
+     response were sent, the error can only be reported in a trailer */
+  auto report_error = [&res, res_stream] (const String& message) {
+    if (res_stream->isOutputStarted()) {
+      logError(
+          "fnord.sstableservlet",
+          "error while streaming a scan: $0",
+          message);
+
+      Vector<std::pair<String, String>> trailers;
+      trailers.emplace_back("X-SSTable-Error", message);
+      finishChunkedResponse(res_stream.get(), trailers);
+    } else {
+      res.setStatus(http::kStatusInternalServerError);
+      res.addBody(StringUtil::format("error: $0", message));
+      res_stream->writeResponse(res);
+    }
+  };
+
+  /* requests that run on the executor must always be answered, so invalid
+     parameters (std::stoull etc.) are reported like other errors */
+  auto path = uri.path();
+  try {
+    if (path == base_path_ + "/get") {
+      get(&res, res_stream, uri);
+    } else if (path == base_path_ + "/multiget") {
+      multiget(req, &res, res_stream, uri);
+    } else {
+      scan(&res, res_stream, uri, Set<String>{});
+    }
+  } catch (const Exception& e) {
+    report_error(e.getMessage());
+  } catch (const std::exception& e) {
+    report_error(e.what());
+  }
+}
+
+void SSTableServlet::status(
+    const stx::http::HTTPRequest& req,
+    RefPtr<stx::http::HTTPResponseStream> res_stream) {
+  http::HTTPResponse res;
+  res.populateFromRequest(req);
+  res.addHeader("Access-Control-Allow-Origin", "*");
+  res.addHeader("Content-Type", "text/plain; charset=utf-8");
+
+  String body;
+  if (executor_.get()) {
+    body.append(
+        StringUtil::format("executor: $0\n", executor_->toString()));
+  }
+
+  if (reader_cache_.get()) {
+    body.append(
+        StringUtil::format(
+            "reader_cache: size=$0, max_entries=$1, hits=$2, misses=$3, "
+            "invalidations=$4, evictions=$5\n",
+            reader_cache_->size(),
+            reader_cache_->maxEntries(),
+            reader_cache_->numHits(),
+            reader_cache_->numMisses(),
+            reader_cache_->numInvalidations(),
+            reader_cache_->numEvictions()));
+  }
+
+  res.setStatus(http::kStatusOK);
+  res.addBody(body);
+  res_stream->writeResponse(res);
+}
+
+void SSTableServlet::get(
+    stx::http::HTTPResponse* res,
+    RefPtr<stx::http::HTTPResponseStream> res_stream,
+    const URI& uri) {
+  Set<String> keys;
+  for (const auto& p : uri.queryParams()) {
+    if (p.first == "key") {
+      keys.emplace(p.second);
+    }
+  }
+
+  if (keys.empty()) {
+    res->addBody("error: missing ?key=... parameter");
+    res->setStatus(http::kStatusBadRequest);
+    res_stream->writeResponse(*res);
+    return;
+  }
+
+  scan(res, res_stream, uri, keys);
+}
+
+void SSTableServlet::multiget(
+    const stx::http::HTTPRequest& req,
     stx::http::HTTPResponse* res,
+    RefPtr<stx::http::HTTPResponseStream> res_stream,
     const URI& uri) {
+  if (req.method() != http::HTTPMessage::M_POST) {
+    res->addBody("error: multiget requires a POST request");
+    res->setStatus(http::kStatusMethodNotAllowed);
+    res_stream->writeResponse(*res);
+    return;
+  }
+
+  /* one key per line; the set sorts and deduplicates the keys */
+  Set<String> keys;
+  for (auto& key : StringUtil::split(req.body().toString(), "\n")) {
+    if (!key.empty() && key.back() == '\r') {
+      key.pop_back();
+    }
+
+    if (!key.empty()) {
+      keys.emplace(key);
+    }
+  }
+
+  if (keys.empty()) {
+    res->addBody("error: no keys in the request body");
+    res->setStatus(http::kStatusBadRequest);
+    res_stream->writeResponse(*res);
+    return;
+  }
+
+  scan(res, res_stream, uri, keys);
+}
+
+void SSTableServlet::scan(
+    stx::http::HTTPResponse* res,
+    RefPtr<stx::http::HTTPResponseStream> res_stream,
+    const URI& uri,
+    const Set<String>& keys) {
   stx::URI::ParamList params = uri.queryParams();
 
   auto format = ResponseFormat::CSV;
   std::string format_param;
   if (stx::URI::getParam(params, "format", &format_param)) {
-    format = formatFromString(format_param);
+    format = SSTableResultWriter::formatFromString(format_param);
   }
 
   std::string file_path;
   if (!stx::URI::getParam(params, "file", &file_path)) {
     res->addBody("error: missing ?file=... parameter");
     res->setStatus(http::kStatusBadRequest);
+    res_stream->writeResponse(*res);
     return;
   }
 
-  sstable::SSTableReader reader(vfs_->openFile(file_path));
-  if (reader.bodySize() == 0) {
-    res->addBody("sstable is unfinished (body_size == 0)");
-    res->setStatus(http::kStatusInternalServerError);
-    return;
+  /* the schema, zone map and key index are shared with concurrent requests
+     through the cache; the reader (and cursor) is per request */
+  std::shared_ptr<const SSTableReaderCache::Table> table;
+  if (reader_cache_.get()) {
+    table = reader_cache_->get(file_path);
+  } else {
+    table = SSTableReaderCache::loadTable(vfs_, file_path, resolve_path_);
+  }
+
+  auto reader = table->openReader();
+
+  sstable::SSTableScan sstable_scan(table->schema());
+  sstable_scan.setSortMemoryLimit(sort_memory_limit_);
+  sstable_scan.setTempDirectory(tempdir_);
+  sstable_scan.setMeasureOutputTime(true);
+
+  /* the query time is limited by the timeout parameter (in milliseconds)
+     and the servlet's max query time, whichever is shorter; a timeout can't
+     lift the servlet's limit */
+  uint64_t query_time = max_query_time_;
+  String timeout_str;
+  if (stx::URI::getParam(params, "timeout", &timeout_str)) {
+    auto timeout = std::stoull(timeout_str);
+    if (timeout == 0) {
+      res->addBody("error: timeout must be greater than 0");
+      res->setStatus(http::kStatusBadRequest);
+      res_stream->writeResponse(*res);
+      return;
+    }
+
+    if (timeout < std::numeric_limits<uint64_t>::max() / 1000 &&
+        (query_time == 0 || timeout * 1000 < query_time)) {
+      query_time = timeout * 1000;
+    }
+  }
+  if (query_time > 0) {
+    sstable_scan.setDeadline(WallClock::unixMicros() + query_time);
+  }
+
+  if (table->zoneMap()) {
+    sstable_scan.setZoneMap(table->zoneMap());
+  }
+
+  if (table->keyIndex()) {
+    sstable_scan.setKeyIndex(table->keyIndex());
+  }
+
+  if (table->bloomFilter()) {
+    sstable_scan.setBloomFilter(table->bloomFilter());
   }
 
-  sstable::SSTableColumnSchema schema;
-  schema.loadIndex(&reader);
+  /* ?sample=0.01&sample_method=systematic&sample_unit=row&sample_seed=42 */
+  String sample_str;
+  if (stx::URI::getParam(params, "sample", &sample_str)) {
+    String method_str = "random";
+    String unit_str = "block";
+    String seed_str = "0";
+    stx::URI::getParam(params, "sample_method", &method_str);
+    stx::URI::getParam(params, "sample_unit", &unit_str);
+    stx::URI::getParam(params, "sample_seed", &seed_str);
 
-  sstable::SSTableScan sstable_scan(&schema);
+    sstable_scan.setSample(
+        std::stod(sample_str),
+        sstable::SSTableSampler::methodFromString(method_str),
+        sstable::SSTableSampler::unitFromString(unit_str),
+        std::stoull(seed_str));
+  }
+
+  Vector<String> columns;
+  for (const auto& p : params) {
+    if (p.first == "columns") {
+      for (const auto& c : StringUtil::split(p.second, ",")) {
+        columns.emplace_back(c);
+      }
+    }
+  }
+  if (columns.size() > 0) {
+    sstable_scan.setSelectList(columns);
+  }
 
   String limit_str;
   if (stx::URI::getParam(params, "limit", &limit_str)) {
@@ -83,12 +480,25 @@ void SSTableServlet::scan(
     sstable_scan.setKeyPrefix(key_prefix_str);
   }
 
-  String key_regex_str;
-  if (stx::URI::getParam(params, "key_regex", &key_regex_str)) {
-    sstable_scan.setKeyFilterRegex(key_regex_str);
+  String key_begin_str;
+  String key_end_str;
+  auto has_key_begin = stx::URI::getParam(params, "key_begin", &key_begin_str);
+  auto has_key_end = stx::URI::getParam(params, "key_end", &key_end_str);
+  if (has_key_begin || has_key_end) {
+    sstable_scan.setKeyRange(key_begin_str, key_end_str);
+  }
+
+  Vector<String> key_regexes;
+  for (const auto& p : params) {
+    if (p.first == "key_regex") {
+      key_regexes.emplace_back(p.second);
+    }
+  }
+  if (key_regexes.size() > 0) {
+    sstable_scan.setKeyFilterRegex(key_regexes);
   }
 
-  Set<String> key_match_set;
+  Set<String> key_match_set = keys;
   for (const auto& p : params) {
     if (p.first == "key_match") {
       key_match_set.emplace(p.second);
@@ -98,11 +508,52 @@ void SSTableServlet::scan(
     sstable_scan.setKeyExactMatchFilter(key_match_set);
   }
 
+  for (const auto& p : params) {
+    if (p.first == "filter") {
+      sstable_scan.addFilter(SSTableScanPredicate::parse(p.second));
+    }
+  }
+
+  Vector<String> group_by;
+  for (const auto& p : params) {
+    if (p.first == "group_by") {
+      for (const auto& c : StringUtil::split(p.second, ",")) {
+        group_by.emplace_back(c);
+      }
+    }
+  }
+  if (group_by.size() > 0) {
+    sstable_scan.setGroupBy(group_by);
+  }
+
+  for (const auto& p : params) {
+    if (p.first == "agg") {
+      sstable_scan.addAggregate(p.second);
+    }
+  }
+
   String offset_str;
   if (stx::URI::getParam(params, "offset", &offset_str)) {
     sstable_scan.setOffset(std::stoul(offset_str));
   }
 
+  /* tokens are bound to the file version, since they contain positions */
+  const auto& identity = table->identity();
+  sstable_scan.setContinuationScope(
+      StringUtil::format(
+          "$0@$1:$2:$3:$4",
+          file_path,
+          identity.device,
+          identity.inode,
+          identity.size,
+          identity.mtime_nanos));
+  sstable_scan.setContinuationSecret(continuation_secret_);
+
+  String continuation;
+  if (stx::URI::getParam(params, "continuation", &continuation)) {
+    sstable_scan.setContinuationToken(continuation);
+  }
+
   String order_by;
   String order_fn = "STRASC";
   if (stx::URI::getParam(params, "order_by", &order_by)) {
@@ -110,70 +561,93 @@ void SSTableServlet::scan(
     sstable_scan.setOrderBy(order_by, order_fn);
   }
 
-  Buffer buf;
-  json::JSONOutputStream json(BufferOutputStream::fromBuffer(&buf));
-
-  auto headers = sstable_scan.columnNames();
-
   switch (format) {
     case ResponseFormat::CSV:
-      buf.append(StringUtil::join(headers, ";"));
-      buf.append("\n");
+      res->addHeader("Content-Type", "text/csv; charset=utf-8");
       break;
     case ResponseFormat::JSON:
-      json.beginArray();
+      res->addHeader("Content-Type", "application/json; charset=utf-8");
+      break;
+    case ResponseFormat::BINARY:
+      res->addHeader("Content-Type", "application/octet-stream");
       break;
   }
 
-  auto cursor = reader.getCursor();
-  int n = 0;
-  sstable_scan.execute(
-      cursor.get(),
-      [&buf, format, &n, &json, &headers] (const Vector<String> row) {
-    switch (format) {
-      case ResponseFormat::CSV:
-        buf.append(StringUtil::join(row, ";"));
-        buf.append("\n");
-        break;
-      case ResponseFormat::JSON:
-        if (n++ > 0) json.addComma();
-        json.beginObject();
-        for (int i = 0; i < row.size(); ++i) {
-          if (i > 0) json.addComma();
-          json.addString(headers[i]);
-          json.addColon();
-          json.addString(row[i]);
-        }
-        json.endObject();
-        break;
+  /* the response is started once the first chunk is flushed; the scan
+     waits until the client has read each chunk, but not longer than the
+     write timeout, since it holds a scan thread while it waits */
+  auto write_timeout = write_timeout_;
+  auto write_chunk = [res, res_stream, write_timeout] (const String& data) {
+    if (!res_stream->isOutputStarted()) {
+      res->setStatus(stx::http::kStatusOK);
+      res->addHeader("Transfer-Encoding", "chunked");
+      res->addHeader("Trailer", kTrailers);
+      res_stream->startResponse(*res);
+    }
+
+    writeChunk(res_stream.get(), data.data(), data.size());
+
+    auto read = waitWithTimeout(
+        [res_stream] () { return res_stream->bufferSize() == 0; },
+        write_timeout);
+
+    if (!read) {
+      RAISEF(
+          kIOError,
+          "the client didn't read the response within $0ms",
+          write_timeout / 1000);
     }
+  };
+
+  SSTableResultWriter writer(
+      format,
+      sstable_scan.columnNames(),
+      sstable_scan.columnTypes(),
+      write_chunk,
+      flush_size_);
+
+  auto cursor = reader->getCursor();
+  auto status = sstable_scan.execute(
+      cursor.get(),
+      [&writer] (const sstable::SSTableRowView& row) {
+    writer.addRow(row);
   });
 
-  switch (format) {
-    case ResponseFormat::CSV:
-      res->addHeader("Content-Type", "text/csv; charset=utf-8");
-      break;
-    case ResponseFormat::JSON:
-      json.endArray();
-      res->addHeader("Content-Type", "application/json; charset=utf-8");
-      break;
-  }
+  writer.finish();
 
-  res->setStatus(stx::http::kStatusOK);
-  res->addBody(buf);
-}
+  Vector<std::pair<String, String>> stats_headers;
+  stats_headers.emplace_back(
+      "X-SSTable-Spilled-Bytes",
+      StringUtil::toString(sstable_scan.spilledBytes()));
+  stats_headers.emplace_back(
+      "X-SSTable-Scan-Stats",
+      sstable_scan.stats().toString());
+  stats_headers.emplace_back(
+      "X-SSTable-Scan-Status",
+      sstable::scanStatusToString(status));
+  stats_headers.emplace_back(
+      "X-SSTable-Sample-Rate",
+      StringUtil::toString(sstable_scan.stats().sample_rate));
 
-SSTableServlet::ResponseFormat SSTableServlet::formatFromString(
-    const String& format) {
-  if (format == "csv") {
-    return ResponseFormat::CSV;
+  if (!sstable_scan.continuationToken().empty()) {
+    stats_headers.emplace_back(
+        "X-SSTable-Continuation-Token",
+        sstable_scan.continuationToken());
   }
 
-  if (format == "json") {
-    return ResponseFormat::JSON;
+  if (res_stream->isOutputStarted()) {
+    writer.flush();
+    finishChunkedResponse(res_stream.get(), stats_headers);
+    return;
   }
 
-  RAISEF(kIllegalArgumentError, "invalid format: $0", format);
+  for (const auto& h : stats_headers) {
+    res->addHeader(h.first, headerValue(h.second));
+  }
+
+  res->setStatus(stx::http::kStatusOK);
+  res->addBody(writer.buffer());
+  res_stream->writeResponse(*res);
 }
 
 }
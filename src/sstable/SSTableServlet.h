@@ -11,35 +11,189 @@
 #define _FNORD_SSTABLE_SSTABLESERVLET_H
 #include "stx/VFS.h"
 #include "stx/http/httpservice.h"
-#include "stx/json/json.h"
+#include "sstable/SSTableResultWriter.h"
+#include "sstable/SSTableReaderCache.h"
+#include "sstable/SSTableScanExecutor.h"
 
 namespace stx {
 namespace sstable {
 
-class SSTableServlet : public stx::http::HTTPService {
+/**
+ * Serves scans of the sstables in a VFS under base_path + "/scan" and point
+ * reads under base_path + "/get" (?key=... one or more times) and
+ * base_path + "/multiget" (a POST request with one key per line in the
+ * body). Point reads accept the same parameters as scans and return the rows
+ * with the keys in ascending key order; on sorted tables with a key index
+ * they seek to each key and skip keys that fail the table's bloom filter.
+ *
+ * The format parameter selects the response format: csv (default), json or
+ * binary (typed record batches, see SSTableResultWriter; decoded by
+ * SSTableResultReader).
+ *
+ * Scans that stop before all rows were read (at the limit or the timeout)
+ * return an X-SSTable-Continuation-Token header; the next page is requested
+ * by repeating the request with ?continuation=<token>. Unlike offset, a
+ * continued scan seeks to where the previous page stopped, so each page only
+ * reads its own rows; an offset parameter only applies to the first page.
+ * Tokens are bound to the file version and the filters of the scan and
+ * authenticated with the servlet's secret (see setContinuationSecret); they
+ * are not supported with ORDER BY, GROUP BY or aggregates.
+ *
+ * Results are streamed: once more than flush_size bytes of output were
+ * produced, the response is sent with chunked transfer encoding, one chunk
+ * per flush_size bytes, and the scan waits for the client to read each chunk
+ * before it continues, so the memory used per request is bounded. If the
+ * client doesn't read a chunk within the write timeout, the scan fails. The
+ * X-SSTable-* headers of streamed responses are sent as trailers after the
+ * last chunk, as is X-SSTable-Error if the scan fails. Smaller results are
+ * sent in one response with all headers.
+ *
+ * The opened files and the parsed schemas, zone maps and key indexes of the
+ * most recently scanned tables are kept in an SSTableReaderCache.
+ *
+ * Requests are run on an SSTableScanExecutor: point reads and scans with
+ * key_match parameters are queued with high priority, all other scans with
+ * low priority; handleHTTPRequest returns once the request is queued. If
+ * the queue is full, the request is answered with 503 Service Unavailable
+ * right away. base_path + "/status" returns the
+ * executor and reader cache metrics
+ */
+class SSTableServlet : public stx::http::StreamingHTTPService {
 public:
-  enum class ResponseFormat {
-    JSON,
-    CSV
-  };
+  typedef SSTableResultWriter::Format ResponseFormat;
+
+  static const uint64_t kDefaultWriteTimeout = 30 * 1000000;
 
   SSTableServlet(const String& base_path, VFS* vfs);
 
+  /**
+   * Memory budget and temp directory for sorting ORDER BY scans; see
+   * SSTableScan::setSortMemoryLimit
+   */
+  void setSortMemoryLimit(size_t bytes);
+  void setTempDirectory(const String& tempdir);
+
+  /**
+   * Stop scans after the provided number of microseconds (0 = no limit) and
+   * return the partial result. Requests can set a shorter limit with the
+   * timeout parameter (in milliseconds, greater than 0). The
+   * X-SSTable-Scan-Status header tells if the result is complete
+   */
+  void setMaxQueryTime(uint64_t micros);
+
+  /**
+   * Set the secret that authenticates continuation tokens (see
+   * SSTableScan::setContinuationSecret). Defaults to a random secret, so
+   * tokens are only accepted by the servlet that returned them; servers
+   * behind a load balancer must share the secret
+   */
+  void setContinuationSecret(const String& secret);
+
+  /**
+   * Give up streamed responses if the client didn't read a chunk within the
+   * provided number of microseconds (default kDefaultWriteTimeout), so
+   * clients that stop reading can't hold the scan threads
+   */
+  void setWriteTimeout(uint64_t micros);
+
+  /**
+   * Set the size of the chunks of streamed responses
+   * (default SSTableResultWriter::kDefaultFlushSize)
+   */
+  void setFlushSize(size_t bytes);
+
+  /**
+   * Set the number of tables in the reader cache (default
+   * SSTableReaderCache::kDefaultMaxEntries); 0 disables the cache. Must not
+   * be called while requests are served
+   */
+  void setReaderCacheSize(size_t max_entries);
+
+  /**
+   * Set the function that returns the local file that the VFS opens for a
+   * file parameter (default: the parameter itself). Files are stat()ed to
+   * find changed tables and to bind continuation tokens to the version of
+   * the file, so VFSs that map names to other files need a resolver. Must
+   * not be called while requests are served
+   */
+  void setPathResolver(SSTableReaderCache::PathResolver resolve_path);
+
+  /**
+   * Returns the reader cache or nullptr if the cache is disabled
+   */
+  const SSTableReaderCache* readerCache() const;
+
+  /**
+   * Set the number of threads that run requests and the maximum number of
+   * queued requests per priority (default
+   * SSTableScanExecutor::kDefaultNumThreads and kDefaultMaxQueueLength); 0
+   * threads runs requests on the calling thread without a limit. Must not
+   * be called while requests are served
+   */
+  void setScanThreads(
+      size_t num_threads,
+      size_t max_queue_length = SSTableScanExecutor::kDefaultMaxQueueLength);
+
+  /**
+   * Returns the executor or nullptr if requests run on the calling thread
+   */
+  const SSTableScanExecutor* scanExecutor() const;
+
   void handleHTTPRequest(
-      stx::http::HTTPRequest* req,
-      stx::http::HTTPResponse* res);
+      RefPtr<stx::http::HTTPRequestStream> req_stream,
+      RefPtr<stx::http::HTTPResponseStream> res_stream) override;
 
 protected:
 
-  void scan(
-      stx::http::HTTPRequest* req,
+  /**
+   * Returns HIGH for point reads and scans with key_match parameters
+   */
+  SSTableScanExecutor::Priority requestPriority(const URI& uri) const;
+
+  void handleScanRequest(
+      RefPtr<stx::http::HTTPRequestStream> req_stream,
+      RefPtr<stx::http::HTTPResponseStream> res_stream);
+
+  void status(
+      const stx::http::HTTPRequest& req,
+      RefPtr<stx::http::HTTPResponseStream> res_stream);
+
+  void get(
       stx::http::HTTPResponse* res,
+      RefPtr<stx::http::HTTPResponseStream> res_stream,
       const URI& uri);
 
-  ResponseFormat formatFromString(const String& format);
+  void multiget(
+      const stx::http::HTTPRequest& req,
+      stx::http::HTTPResponse* res,
+      RefPtr<stx::http::HTTPResponseStream> res_stream,
+      const URI& uri);
+
+  /**
+   * Scan with the parameters of the request, only returning the rows with
+   * the provided keys (in addition to the key_match parameters) if any
+   */
+  void scan(
+      stx::http::HTTPResponse* res,
+      RefPtr<stx::http::HTTPResponseStream> res_stream,
+      const URI& uri,
+      const Set<String>& keys);
 
   String base_path_;
   VFS* vfs_;
+  size_t sort_memory_limit_;
+  String tempdir_;
+  uint64_t max_query_time_;
+  String continuation_secret_;
+  size_t flush_size_;
+  uint64_t write_timeout_;
+  SSTableReaderCache::PathResolver resolve_path_;
+  size_t reader_cache_size_;
+  std::unique_ptr<SSTableReaderCache> reader_cache_;
+
+  /* declared last, so queued requests are finished before the other members
+     are destroyed */
+  std::unique_ptr<SSTableScanExecutor> executor_;
 };
 
 }
@@ -0,0 +1,113 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stx/exception.h>
+#include <sstable/SSTableSipHash.h>
+
+namespace stx {
+namespace sstable {
+
+static uint64_t loadUInt64LE(const unsigned char* data) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; --i) {
+    v = (v << 8) | data[i];
+  }
+
+  return v;
+}
+
+static uint64_t rotl(uint64_t x, int b) {
+  return (x << b) | (x >> (64 - b));
+}
+
+static void sipRound(uint64_t* v) {
+  v[0] += v[1];
+  v[1] = rotl(v[1], 13);
+  v[1] ^= v[0];
+  v[0] = rotl(v[0], 32);
+  v[2] += v[3];
+  v[3] = rotl(v[3], 16);
+  v[3] ^= v[2];
+  v[0] += v[3];
+  v[3] = rotl(v[3], 21);
+  v[3] ^= v[0];
+  v[2] += v[1];
+  v[1] = rotl(v[1], 17);
+  v[1] ^= v[2];
+  v[2] = rotl(v[2], 32);
+}
+
+SSTableSipHash::SSTableSipHash(const String& key) {
+  if (key.size() != kKeySize) {
+    RAISEF(
+        kIllegalArgumentError,
+        "SipHash keys must be $0 bytes long",
+        kKeySize);
+  }
+
+  auto data = (const unsigned char*) key.data();
+  k0_ = loadUInt64LE(data);
+  k1_ = loadUInt64LE(data + 8);
+}
+
+/**
+ * The key is the hash of the secret under two fixed keys
+ */
+SSTableSipHash SSTableSipHash::fromSecret(const String& secret) {
+  String key;
+  for (int i = 0; i < 2; ++i) {
+    String fixed_key(kKeySize, (char) i);
+    auto h = SSTableSipHash(fixed_key).hash(secret.data(), secret.size());
+    for (int j = 0; j < 8; ++j) {
+      key += (char) (h >> (j * 8));
+    }
+  }
+
+  return SSTableSipHash(key);
+}
+
+uint64_t SSTableSipHash::hash(const void* data, size_t size) const {
+  auto bytes = (const unsigned char*) data;
+
+  uint64_t v[4];
+  v[0] = k0_ ^ 0x736f6d6570736575ull;
+  v[1] = k1_ ^ 0x646f72616e646f6dull;
+  v[2] = k0_ ^ 0x6c7967656e657261ull;
+  v[3] = k1_ ^ 0x7465646279746573ull;
+
+  auto end = size - size % 8;
+  for (size_t i = 0; i < end; i += 8) {
+    auto m = loadUInt64LE(bytes + i);
+    v[3] ^= m;
+    sipRound(v);
+    sipRound(v);
+    v[0] ^= m;
+  }
+
+  /* the last block holds the remaining bytes and the message length */
+  uint64_t m = uint64_t(size) << 56;
+  for (size_t i = end; i < size; ++i) {
+    m |= uint64_t(bytes[i]) << ((i - end) * 8);
+  }
+
+  v[3] ^= m;
+  sipRound(v);
+  sipRound(v);
+  v[0] ^= m;
+
+  v[2] ^= 0xff;
+  for (int i = 0; i < 4; ++i) {
+    sipRound(v);
+  }
+
+  return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+}
+}
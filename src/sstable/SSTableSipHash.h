@@ -0,0 +1,44 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+
+namespace stx {
+namespace sstable {
+
+/**
+ * SipHash-2-4, a keyed 64 bit hash function. Unlike FNV, the hash of a
+ * message can't be computed (or forged) without the 128 bit key, so it is
+ * used as a MAC for data that is handed out to clients and read back, like
+ * continuation tokens
+ */
+class SSTableSipHash {
+public:
+  static const size_t kKeySize = 16;
+
+  /**
+   * The key must be kKeySize bytes long
+   */
+  SSTableSipHash(const String& key);
+
+  /**
+   * Derive a key from a secret of any length
+   */
+  static SSTableSipHash fromSecret(const String& secret);
+
+  uint64_t hash(const void* data, size_t size) const;
+
+protected:
+  uint64_t k0_;
+  uint64_t k1_;
+};
+
+}
+}
@@ -71,6 +71,10 @@ uint64_t SSTableWriter::appendRow(
     RAISE(kIllegalStateError, "can't append row to finalized sstable");
   }
 
+  if (hdr_.isColumnar()) {
+    RAISE(kIllegalStateError, "can't append row to columnar sstable");
+  }
+
   if (data_size == 0) {
     RAISE(kIllegalArgumentError, "can't append empty row");
   }
@@ -87,6 +91,53 @@ uint64_t SSTableWriter::appendRow(
   return roff;
 }
 
+uint64_t SSTableWriter::appendBlock(
+    void const* key,
+    size_t key_size,
+    void const* data,
+    size_t data_size,
+    size_t num_rows) {
+  if (!hdr_.isColumnar()) {
+    RAISE(kIllegalStateError, "can't append block to row-oriented sstable");
+  }
+
+  if (hdr_.isFinalized()) {
+    RAISE(kIllegalStateError, "can't append block to finalized sstable");
+  }
+
+  if (num_rows == 0 || num_rows > BinaryFormat::kPAXMaxBlockRows) {
+    RAISEF(kIllegalArgumentError, "invalid block row count: $0", num_rows);
+  }
+
+  file_.seekTo(hdr_.bodyOffset() + hdr_.bodySize());
+  BufferedOutputStream os(FileOutputStream::fromFileDescriptor(file_.fd()));
+  auto rsize = RowWriter::appendRow(hdr_, key, key_size, data, data_size, &os);
+
+  auto roff = hdr_.bodySize();
+  hdr_.setBodySize(roff + rsize);
+  hdr_.setRowCount(hdr_.rowCount() + num_rows);
+  meta_dirty_ = true;
+
+  return roff;
+}
+
+void SSTableWriter::setColumnarLayout() {
+  if (hdr_.isColumnar()) {
+    return;
+  }
+
+  if (hdr_.bodySize() > 0) {
+    RAISE(kIllegalStateError, "can't change the layout of a non-empty sstable");
+  }
+
+  hdr_.setFlag(FileHeaderFlags::COLUMNAR);
+  meta_dirty_ = true;
+}
+
+bool SSTableWriter::isColumnar() const {
+  return hdr_.isColumnar();
+}
+
 uint64_t SSTableWriter::appendRow(
     const std::string& key,
     const std::string& value) {
@@ -110,5 +161,35 @@ void SSTableWriter::commit() {
   meta_dirty_ = false;
 }
 
+void SSTableWriter::writeFooter(uint32_t footer_type, const Buffer& buf) {
+  writeFooter(footer_type, buf.data(), buf.size());
+}
+
+void SSTableWriter::writeFooter(
+    uint32_t footer_type,
+    void* data,
+    size_t size) {
+  if (size == 0) {
+    return;
+  }
+
+  if (!hdr_.isFinalized()) {
+    hdr_.setFlag(FileHeaderFlags::FINALIZED);
+    meta_dirty_ = true;
+  }
+
+  FNV<uint32_t> fnv;
+  BinaryFormat::FooterHeader footer_header;
+  footer_header.magic = BinaryFormat::kMagicBytes;
+  footer_header.type = footer_type;
+  footer_header.footer_checksum = fnv.hash(data, size);
+  footer_header.footer_size = size;
+
+  file_.seekTo(file_.size());
+  BufferedOutputStream os(FileOutputStream::fromFileDescriptor(file_.fd()));
+  os.write((char*) &footer_header, sizeof(footer_header));
+  os.write((char*) data, size);
+}
+
 }
 }
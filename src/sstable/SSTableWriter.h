@@ -64,11 +64,36 @@ public:
       const std::string& key,
       const SSTableColumnWriter& columns);
 
+  /**
+   * Append a columnar (PAX) block holding num_rows rows to the sstable
+   */
+  uint64_t appendBlock(
+      void const* key,
+      size_t key_size,
+      void const* data,
+      size_t data_size,
+      size_t num_rows);
+
+  /**
+   * Store the table body in the columnar (PAX) layout. Must be called before
+   * the first row is appended
+   */
+  void setColumnarLayout();
+
+  /**
+   * Returns true iff the table body is stored in the columnar (PAX) layout
+   */
+  bool isColumnar() const;
+
   /**
    * Commit written rows // metadata to disk
    */
   void commit();
 
+  /**
+   * Append a footer to the sstable. No more rows can be appended after the
+   * first footer was written
+   */
   void writeFooter(uint32_t footer_type, void* data, size_t size);
   void writeFooter(uint32_t footer_type, const Buffer& buf);
 
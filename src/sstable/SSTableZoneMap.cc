@@ -0,0 +1,333 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cmath>
+#include <stx/exception.h>
+#include <stx/ieee754.h>
+#include <stx/util/binarymessagereader.h>
+#include <stx/util/binarymessagewriter.h>
+#include <sstable/SSTableZoneMap.h>
+#include <sstable/SSTableWriter.h>
+#include <sstable/sstablereader.h>
+
+namespace stx {
+namespace sstable {
+
+SSTableZoneMap::SSTableZoneMap(
+    const SSTableColumnSchema* schema,
+    size_t zone_size /* = kDefaultZoneSize */) :
+    schema_(schema),
+    zone_size_(zone_size),
+    open_zone_positioned_(false) {
+  open_zone_.begin = 0;
+  open_zone_.num_rows = 0;
+}
+
+void SSTableZoneMap::addRow(
+    uint64_t position,
+    void const* key,
+    size_t key_size,
+    const SSTableColumnReader& columns) {
+  if (open_zone_.num_rows > 0 &&
+      open_zone_positioned_ &&
+      position - open_zone_.begin >= zone_size_) {
+    finishZone(open_zone_.begin);
+  }
+
+  if (open_zone_.num_rows == 0) {
+    open_zone_.begin = position;
+    open_zone_positioned_ = true;
+  }
+
+  addRow(key, key_size, columns);
+}
+
+void SSTableZoneMap::addRow(
+    void const* key,
+    size_t key_size,
+    const SSTableColumnReader& columns) {
+  String key_str((char*) key, key_size);
+  if (open_zone_.num_rows == 0) {
+    open_zone_.min_key = key_str;
+    open_zone_.max_key = key_str;
+  } else if (key_str < open_zone_.min_key) {
+    open_zone_.min_key = key_str;
+  } else if (key_str > open_zone_.max_key) {
+    open_zone_.max_key = key_str;
+  }
+
+  Vector<SSTableColumnID> row_columns;
+  for (const auto& col : columns.col_data_) {
+    auto id = std::get<0>(col);
+
+    auto iter = open_zone_.columns.find(id);
+    if (iter == open_zone_.columns.end()) {
+      ColumnZone column_zone;
+      column_zone.type = schema_->columnType(id);
+      column_zone.null_count = 0;
+      column_zone.value_count = 0;
+      column_zone.min = 0;
+      column_zone.max = 0;
+      iter = open_zone_.columns.emplace(id, column_zone).first;
+    }
+
+    addValue(&iter->second, id, col);
+
+    if (std::find(row_columns.begin(), row_columns.end(), id) ==
+        row_columns.end()) {
+      row_columns.emplace_back(id);
+      ++open_rows_with_value_[id];
+    }
+  }
+
+  ++open_zone_.num_rows;
+}
+
+void SSTableZoneMap::addValue(
+    ColumnZone* zone,
+    SSTableColumnID id,
+    const std::tuple<SSTableColumnID, uint64_t, uint32_t>& value) {
+  auto first = zone->value_count++ == 0;
+
+  switch (zone->type) {
+
+    case SSTableColumnType::UINT32:
+    case SSTableColumnType::UINT64: {
+      auto v = std::get<1>(value);
+      if (first || v < zone->min) {
+        zone->min = v;
+      }
+      if (first || v > zone->max) {
+        zone->max = v;
+      }
+      break;
+    }
+
+    /* NaN is neither less nor greater than any value, so a zone with a NaN
+       value gets NaN bounds, which SSTableScanPredicate::mayMatch treats as
+       unknown */
+    case SSTableColumnType::FLOAT: {
+      auto v = std::get<1>(value);
+      auto d = IEEE754::fromBytes(v);
+      if (first || std::isnan(d)) {
+        zone->min = v;
+        zone->max = v;
+        break;
+      }
+
+      if (std::isnan(IEEE754::fromBytes(zone->min))) {
+        break;
+      }
+
+      if (d < IEEE754::fromBytes(zone->min)) {
+        zone->min = v;
+      }
+      if (d > IEEE754::fromBytes(zone->max)) {
+        zone->max = v;
+      }
+      break;
+    }
+
+    case SSTableColumnType::STRING: {
+      String v;
+      if (schema_->columnEncoding(id) == SSTableColumnEncoding::DICTIONARY) {
+        v = schema_->dictionaryValue(id, std::get<1>(value));
+      } else {
+        v = String((char*) std::get<1>(value), std::get<2>(value));
+      }
+
+      if (first || v < zone->min_string) {
+        zone->min_string = v;
+      }
+      if (first || v > zone->max_string) {
+        zone->max_string = v;
+      }
+      break;
+    }
+
+  }
+}
+
+void SSTableZoneMap::finishZone(uint64_t begin) {
+  if (open_zone_.num_rows == 0) {
+    return;
+  }
+
+  if (zones_.size() > 0 && begin <= zones_.back().begin) {
+    RAISE(kIllegalArgumentError, "zones must be added in body order");
+  }
+
+  open_zone_.begin = begin;
+
+  for (const auto& id : schema_->columnIDs()) {
+    auto iter = open_zone_.columns.find(id);
+    if (iter == open_zone_.columns.end()) {
+      ColumnZone column_zone;
+      column_zone.type = schema_->columnType(id);
+      column_zone.value_count = 0;
+      column_zone.min = 0;
+      column_zone.max = 0;
+      iter = open_zone_.columns.emplace(id, column_zone).first;
+    }
+
+    iter->second.null_count =
+        open_zone_.num_rows - open_rows_with_value_[id];
+  }
+
+  zones_.emplace_back(std::move(open_zone_));
+
+  open_zone_ = Zone();
+  open_zone_.begin = 0;
+  open_zone_.num_rows = 0;
+  open_zone_positioned_ = false;
+  open_rows_with_value_.clear();
+}
+
+void SSTableZoneMap::flush() {
+  if (open_zone_positioned_) {
+    finishZone(open_zone_.begin);
+  }
+}
+
+size_t SSTableZoneMap::numZones() const {
+  return zones_.size();
+}
+
+const SSTableZoneMap::Zone& SSTableZoneMap::getZone(size_t idx) const {
+  if (idx >= zones_.size()) {
+    RAISEF(kIndexError, "invalid zone index: $0", idx);
+  }
+
+  return zones_[idx];
+}
+
+ssize_t SSTableZoneMap::findZone(uint64_t position) const {
+  auto iter = std::upper_bound(
+      zones_.begin(),
+      zones_.end(),
+      position,
+      [] (uint64_t pos, const Zone& zone) {
+    return pos < zone.begin;
+  });
+
+  return (iter - zones_.begin()) - 1;
+}
+
+uint64_t SSTableZoneMap::nextZoneBegin(size_t idx) const {
+  if (idx + 1 < zones_.size()) {
+    return zones_[idx + 1].begin;
+  } else {
+    return uint64_t(-1);
+  }
+}
+
+/**
+ * The index is a list of zones. Each zone is stored as (begin, num_rows,
+ * min_key, max_key, num_columns) followed by num_columns column entries of
+ * (id, type, null_count, value_count, min, max). Strings are stored as varint
+ * length followed by the string; min/max are omitted if value_count is zero
+ */
+void SSTableZoneMap::writeIndex(Buffer* buf) {
+  flush();
+
+  util::BinaryMessageWriter writer;
+
+  for (const auto& zone : zones_) {
+    writer.appendUInt64(zone.begin);
+    writer.appendUInt64(zone.num_rows);
+    writer.appendVarUInt(zone.min_key.size());
+    writer.append(zone.min_key.data(), zone.min_key.size());
+    writer.appendVarUInt(zone.max_key.size());
+    writer.append(zone.max_key.data(), zone.max_key.size());
+    writer.appendUInt32(zone.columns.size());
+
+    for (const auto& c : zone.columns) {
+      writer.appendUInt32(c.first);
+      writer.appendUInt8((uint8_t) c.second.type);
+      writer.appendUInt64(c.second.null_count);
+      writer.appendUInt64(c.second.value_count);
+
+      if (c.second.value_count == 0) {
+        continue;
+      }
+
+      if (c.second.type == SSTableColumnType::STRING) {
+        writer.appendVarUInt(c.second.min_string.size());
+        writer.append(c.second.min_string.data(), c.second.min_string.size());
+        writer.appendVarUInt(c.second.max_string.size());
+        writer.append(c.second.max_string.data(), c.second.max_string.size());
+      } else {
+        writer.appendUInt64(c.second.min);
+        writer.appendUInt64(c.second.max);
+      }
+    }
+  }
+
+  buf->append(writer.data(), writer.size());
+}
+
+void SSTableZoneMap::writeIndex(SSTableWriter* sstable_writer) {
+  Buffer buf;
+  writeIndex(&buf);
+
+  sstable_writer->writeFooter(kSSTableIndexID, buf);
+}
+
+void SSTableZoneMap::loadIndex(const Buffer& buf) {
+  util::BinaryMessageReader reader(buf.data(), buf.size());
+  zones_.clear();
+
+  auto readString = [&reader] () -> String {
+    auto len = reader.readVarUInt();
+    return String((char*) reader.read(len), len);
+  };
+
+  while (reader.remaining() > 0) {
+    Zone zone;
+    zone.begin = *reader.readUInt64();
+    zone.num_rows = *reader.readUInt64();
+    zone.min_key = readString();
+    zone.max_key = readString();
+
+    auto num_columns = *reader.readUInt32();
+    for (uint32_t i = 0; i < num_columns; ++i) {
+      auto id = *reader.readUInt32();
+
+      ColumnZone column_zone;
+      column_zone.type = (SSTableColumnType) *reader.readUInt8();
+      column_zone.null_count = *reader.readUInt64();
+      column_zone.value_count = *reader.readUInt64();
+      column_zone.min = 0;
+      column_zone.max = 0;
+
+      if (column_zone.value_count > 0) {
+        if (column_zone.type == SSTableColumnType::STRING) {
+          column_zone.min_string = readString();
+          column_zone.max_string = readString();
+        } else {
+          column_zone.min = *reader.readUInt64();
+          column_zone.max = *reader.readUInt64();
+        }
+      }
+
+      zone.columns.emplace(id, column_zone);
+    }
+
+    zones_.emplace_back(std::move(zone));
+  }
+}
+
+void SSTableZoneMap::loadIndex(SSTableReader* sstable_reader) {
+  auto index = sstable_reader->readFooter(kSSTableIndexID);
+  loadIndex(index);
+}
+
+}
+}
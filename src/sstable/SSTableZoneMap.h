@@ -0,0 +1,128 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <stx/buffer.h>
+#include <sstable/SSTableColumnSchema.h>
+#include <sstable/SSTableColumnReader.h>
+
+namespace stx {
+namespace sstable {
+class SSTableReader;
+class SSTableWriter;
+
+/**
+ * Per-zone min/max/null-count statistics for the key and each schema column.
+ * A zone is a contiguous range of the table body; zone i covers all rows from
+ * zones[i].begin up to zones[i + 1].begin (or the end of the body). Positions
+ * are cursor positions, i.e. body offsets on row-oriented tables and block
+ * positions on columnar (PAX) tables.
+ *
+ * On row-oriented tables the zone map is built by calling addRow with the
+ * position returned by SSTableWriter::appendRow; a new zone is started once
+ * a zone spans zone_size bytes. PAXWriter::setZoneMap creates one zone per
+ * PAX block. The zone map is stored in a footer (kSSTableIndexID)
+ */
+class SSTableZoneMap {
+public:
+  static const uint32_t kSSTableIndexID = 0x34676;
+  static const size_t kDefaultZoneSize = 64 * 1024;
+
+  struct ColumnZone {
+    SSTableColumnType type;
+    uint64_t null_count;
+    uint64_t value_count;
+
+    /* numeric values and float bits */
+    uint64_t min;
+    uint64_t max;
+
+    /* string values (dictionary encoded values are stored as strings) */
+    String min_string;
+    String max_string;
+  };
+
+  struct Zone {
+    uint64_t begin;
+    uint64_t num_rows;
+    String min_key;
+    String max_key;
+    OrderedMap<SSTableColumnID, ColumnZone> columns;
+  };
+
+  SSTableZoneMap(
+      const SSTableColumnSchema* schema,
+      size_t zone_size = kDefaultZoneSize);
+
+  /**
+   * Add a row that was written at the provided position. Starts a new zone if
+   * the current zone spans zone_size or more bytes
+   */
+  void addRow(
+      uint64_t position,
+      void const* key,
+      size_t key_size,
+      const SSTableColumnReader& columns);
+
+  /**
+   * Add a row to the current zone without a position. The zone must be
+   * closed with finishZone once its position is known
+   */
+  void addRow(
+      void const* key,
+      size_t key_size,
+      const SSTableColumnReader& columns);
+
+  /**
+   * Close the current zone, starting at the provided position
+   */
+  void finishZone(uint64_t begin);
+
+  /**
+   * Close the current zone (if it was started with a positioned addRow)
+   */
+  void flush();
+
+  size_t numZones() const;
+  const Zone& getZone(size_t idx) const;
+
+  /**
+   * Returns the index of the zone that contains the provided position or -1
+   * if the position is before the first zone
+   */
+  ssize_t findZone(uint64_t position) const;
+
+  /**
+   * Returns the begin of the zone after zone idx or -1 for the last zone
+   */
+  uint64_t nextZoneBegin(size_t idx) const;
+
+  void writeIndex(Buffer* buf);
+  void writeIndex(SSTableWriter* sstable_writer);
+
+  void loadIndex(const Buffer& buf);
+  void loadIndex(SSTableReader* sstable_reader);
+
+protected:
+  void addValue(
+      ColumnZone* zone,
+      SSTableColumnID id,
+      const std::tuple<SSTableColumnID, uint64_t, uint32_t>& value);
+
+  const SSTableColumnSchema* schema_;
+  size_t zone_size_;
+  Vector<Zone> zones_;
+  Zone open_zone_;
+  bool open_zone_positioned_;
+  HashMap<SSTableColumnID, uint64_t> open_rows_with_value_;
+};
+
+}
+}
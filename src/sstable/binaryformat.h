@@ -34,7 +34,7 @@ namespace sstable {
  *   <header v2> :=
  *       %x17 %x17 %x17 %x17"    // magic bytes
  *       %x00 %x02               // sstable file format version
- *       <uint64_t>              // flags (1=finalized)
+ *       <uint64_t>              // flags (1=finalized, 2=columnar)
  *       <uint64_t>              // total body size in bytes
  *       <uint32_t>              // userdata checksum
  *       <uint32_t>              // userdata size in bytes
@@ -43,7 +43,7 @@ namespace sstable {
  *   <header v3> :=
  *       %x17 %x17 %x17 %x17"    // magic bytes
  *       %x00 %x03               // sstable file format version
- *       <uint64_t>              // flags (1=finalized)
+ *       <uint64_t>              // flags (1=finalized, 2=columnar)
  *       <uint64_t>              // number of rows in the table
  *       <uint64_t>              // total body size in bytes
  *       <uint32_t>              // userdata checksum
@@ -60,6 +60,33 @@ namespace sstable {
  *       <bytes>                 // key
  *       <bytes>                 // data
  *
+ *   If the COLUMNAR flag is set, each body row holds a PAX block of up to
+ *   kPAXMaxBlockRows logical rows. The row key is the first key in the block
+ *   and the row data is:
+ *
+ *   <pax block> :=
+ *       <uint32_t>              // number of rows in the block
+ *       <uint32_t>              // number of column chunks
+ *       <uint32_t>              // key chunk size in bytes
+ *       <uint8_t>               // column id encoding of the rows
+ *       *<pax chunk descriptor>
+ *       <pax key chunk>
+ *       *<pax column chunk>     // in the order of the chunk descriptors
+ *
+ *   <pax chunk descriptor> :=
+ *       <uint32_t>              // column id
+ *       <uint8_t>               // column type
+ *       <uint8_t>               // column encoding
+ *       <uint32_t>              // chunk size in bytes
+ *
+ *   <pax key chunk> :=
+ *       *(<uint32_t> <bytes>)   // key size in bytes and key, one per row
+ *
+ *   <pax column chunk> :=
+ *       <uint8_t>               // chunk flags (1=dense)
+ *       *<varuint>              // number of values per row (omitted if dense)
+ *       *<bytes>                // values in the column encoding
+ *
  *   <footer> :=
  *       %x17 %x17 %x17 %x17"    // magic bytes
  *       <uint32_t>              // footer type id
@@ -68,7 +95,12 @@ namespace sstable {
  *
  */
 enum class FileHeaderFlags : uint64_t {
-  FINALIZED = 1
+  FINALIZED = 1,
+  COLUMNAR = 2
+};
+
+enum class PAXChunkFlags : uint8_t {
+  DENSE = 1
 };
 
 class BinaryFormat {
@@ -82,6 +114,27 @@ public:
     uint32_t data_size;
   };
 
+  struct __attribute__((packed)) PAXBlockHeader {
+    uint32_t num_rows;
+    uint32_t num_chunks;
+    uint32_t key_chunk_size;
+    uint8_t column_id_encoding;
+  };
+
+  struct __attribute__((packed)) PAXChunkDescriptor {
+    uint32_t column_id;
+    uint8_t column_type;
+    uint8_t column_encoding;
+    uint32_t chunk_size;
+  };
+
+  /**
+   * Cursor positions in columnar tables are (block offset, row index) pairs
+   * packed into a single size_t
+   */
+  static const size_t kPAXRowIndexBits = 16;
+  static const size_t kPAXMaxBlockRows = (1 << kPAXRowIndexBits) - 1;
+
   struct __attribute__((packed)) FooterHeader {
     uint64_t magic;
     uint32_t type;
@@ -9,12 +9,16 @@
  */
 #include <stdlib.h>
 #include <unistd.h>
+#include <stdio.h>
 #include "stx/application.h"
 #include "stx/cli/flagparser.h"
 #include "stx/logging.h"
 #include "stx/inspect.h"
+#include "stx/wallclock.h"
 #include "sstable/sstablereader.h"
+#include "sstable/SSTableReaderCache.h"
 #include "sstable/SSTableScan.h"
+#include "sstable/SSTableResultWriter.h"
 
 using namespace stx;
 
@@ -33,6 +37,15 @@ int main(int argc, const char** argv) {
       "input sstable file",
       "<file>");
 
+  flags.defineFlag(
+      "columns",
+      stx::cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "comma separated list of columns to return, e.g. \"_key,clicks\"",
+      "<columns>");
+
   flags.defineFlag(
       "limit",
       stx::cli::FlagParser::T_INTEGER,
@@ -51,6 +64,15 @@ int main(int argc, const char** argv) {
       "offset",
       "<num>");
 
+  flags.defineFlag(
+      "continuation",
+      stx::cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "continue a previous scan that stopped at the limit or the timeout",
+      "<token>");
+
   flags.defineFlag(
       "order_by",
       stx::cli::FlagParser::T_STRING,
@@ -69,6 +91,132 @@ int main(int argc, const char** argv) {
       "one of: STRASC, STRDSC, NUMASC, NUMDSC",
       "<fn>");
 
+  flags.defineFlag(
+      "key_prefix",
+      stx::cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "only return rows whose key starts with the prefix",
+      "<prefix>");
+
+  flags.defineFlag(
+      "key_begin",
+      stx::cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "only return rows whose key is >= key_begin",
+      "<key>");
+
+  flags.defineFlag(
+      "key_end",
+      stx::cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "only return rows whose key is < key_end",
+      "<key>");
+
+  flags.defineFlag(
+      "sort_memory_limit",
+      stx::cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      NULL,
+      "memory budget for ORDER BY in bytes before spilling to disk",
+      "<bytes>");
+
+  flags.defineFlag(
+      "tempdir",
+      stx::cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      "/tmp",
+      "directory for temporary sort files",
+      "<dir>");
+
+  flags.defineFlag(
+      "filter",
+      stx::cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "filter expression, e.g. \"clicks > 10 AND country IN ('DE', 'US')\"",
+      "<expr>");
+
+  flags.defineFlag(
+      "group_by",
+      stx::cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "comma separated list of columns to group by",
+      "<columns>");
+
+  flags.defineFlag(
+      "agg",
+      stx::cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      NULL,
+      "aggregates, e.g. \"count(*),count_distinct(user),quantile(ms, 0.99)\"",
+      "<exprs>");
+
+  flags.defineFlag(
+      "timeout",
+      stx::cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      NULL,
+      "stop the scan after the timeout and return the partial result",
+      "<ms>");
+
+  flags.defineFlag(
+      "sample",
+      stx::cli::FlagParser::T_FLOAT,
+      false,
+      NULL,
+      NULL,
+      "only scan a sample of the table, e.g. 0.01 for 1%",
+      "<rate>");
+
+  flags.defineFlag(
+      "sample_method",
+      stx::cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      "random",
+      "sample method (random, systematic)",
+      "<method>");
+
+  flags.defineFlag(
+      "sample_unit",
+      stx::cli::FlagParser::T_STRING,
+      false,
+      NULL,
+      "block",
+      "sample blocks or rows (block, row)",
+      "<unit>");
+
+  flags.defineFlag(
+      "sample_seed",
+      stx::cli::FlagParser::T_INTEGER,
+      false,
+      NULL,
+      "0",
+      "seed of the sample",
+      "<seed>");
+
+  flags.defineFlag(
+      "stats",
+      stx::cli::FlagParser::T_SWITCH,
+      false,
+      NULL,
+      NULL,
+      "print scan statistics to stderr",
+      NULL);
+
   flags.defineFlag(
       "loglevel",
       stx::cli::FlagParser::T_STRING,
@@ -95,6 +243,29 @@ int main(int argc, const char** argv) {
 
   /* set up scan */
   sstable::SSTableScan scan(&schema);
+
+  sstable::SSTableZoneMap zone_map(&schema);
+  if (reader.hasFooter(sstable::SSTableZoneMap::kSSTableIndexID)) {
+    zone_map.loadIndex(&reader);
+    scan.setZoneMap(&zone_map);
+  }
+
+  sstable::SSTableKeyIndex key_index;
+  if (reader.hasFooter(sstable::SSTableKeyIndex::kSSTableIndexID)) {
+    key_index.loadIndex(&reader);
+    scan.setKeyIndex(&key_index);
+  }
+
+  sstable::SSTableBloomFilter bloom_filter;
+  if (reader.hasFooter(sstable::SSTableBloomFilter::kSSTableIndexID)) {
+    bloom_filter.loadIndex(&reader);
+    scan.setBloomFilter(&bloom_filter);
+  }
+
+  if (flags.isSet("columns")) {
+    scan.setSelectList(StringUtil::split(flags.getString("columns"), ","));
+  }
+
   if (flags.isSet("limit")) {
     scan.setLimit(flags.getInt("limit"));
   }
@@ -103,19 +274,140 @@ int main(int argc, const char** argv) {
     scan.setOffset(flags.getInt("offset"));
   }
 
+  /* tokens are bound to the file version, since they contain positions */
+  sstable::SSTableReaderCache::FileIdentity identity;
+  if (!sstable::SSTableReaderCache::getFileIdentity(input_file, &identity)) {
+    RAISEF(kIOError, "can't stat() $0", input_file);
+  }
+
+  scan.setContinuationScope(
+      StringUtil::format(
+          "$0@$1:$2:$3:$4",
+          input_file,
+          identity.device,
+          identity.inode,
+          identity.size,
+          identity.mtime_nanos));
+  if (flags.isSet("continuation")) {
+    scan.setContinuationToken(flags.getString("continuation"));
+  }
+
+  if (flags.isSet("key_prefix")) {
+    scan.setKeyPrefix(flags.getString("key_prefix"));
+  }
+
+  if (flags.isSet("key_begin") || flags.isSet("key_end")) {
+    scan.setKeyRange(
+        flags.isSet("key_begin") ? flags.getString("key_begin") : "",
+        flags.isSet("key_end") ? flags.getString("key_end") : "");
+  }
+
+  if (flags.isSet("filter")) {
+    scan.addFilter(
+        sstable::SSTableScanPredicate::parse(flags.getString("filter")));
+  }
+
+  if (flags.isSet("group_by")) {
+    scan.setGroupBy(StringUtil::split(flags.getString("group_by"), ","));
+  }
+
+  /* aggregates are separated by commas outside of parentheses, e.g.
+     "count(*),quantile(latency, 0.99)" */
+  if (flags.isSet("agg")) {
+    auto aggs = flags.getString("agg");
+    String expr;
+    int depth = 0;
+    for (auto c : aggs) {
+      if (c == ',' && depth == 0) {
+        scan.addAggregate(expr);
+        expr.clear();
+        continue;
+      }
+
+      if (c == '(') ++depth;
+      if (c == ')') --depth;
+      expr += c;
+    }
+
+    scan.addAggregate(expr);
+  }
+
   if (flags.isSet("order_by")) {
     scan.setOrderBy(flags.getString("order_by"), flags.getString("order_fn"));
   }
 
+  if (flags.isSet("sort_memory_limit")) {
+    scan.setSortMemoryLimit(flags.getInt("sort_memory_limit"));
+  }
+
+  scan.setTempDirectory(flags.getString("tempdir"));
+  scan.setMeasureOutputTime(flags.isSet("stats"));
+
+  if (flags.isSet("timeout")) {
+    scan.setDeadline(WallClock::unixMicros() + flags.getInt("timeout") * 1000);
+  }
+
+  if (flags.isSet("sample")) {
+    scan.setSample(
+        flags.getFloat("sample"),
+        sstable::SSTableSampler::methodFromString(
+            flags.getString("sample_method")),
+        sstable::SSTableSampler::unitFromString(flags.getString("sample_unit")),
+        flags.getInt("sample_seed"));
+  }
+
   /* execute scan */
-  auto headers = scan.columnNames();
-  stx::iputs("$0", StringUtil::join(headers, ";"));
+  sstable::SSTableResultWriter writer(
+      sstable::SSTableResultWriter::Format::CSV,
+      scan.columnNames(),
+      [] (const String& data) {
+        fwrite(data.data(), 1, data.size(), stdout);
+      });
 
   auto cursor = reader.getCursor();
-  scan.execute(cursor.get(), [] (const Vector<String> row) {
-    stx::iputs("$0", StringUtil::join(row, ";"));
+  auto status = scan.execute(
+      cursor.get(),
+      [&writer] (const sstable::SSTableRowView& row) {
+    writer.addRow(row);
   });
 
+  writer.finish();
+  writer.flush();
+
+  if (status != sstable::SSTableScanStatus::COMPLETE) {
+    stx::logWarning(
+        "fnord.sstablescan",
+        "scan stopped early, the result is partial: $0",
+        sstable::scanStatusToString(status));
+  }
+
+  if (!scan.continuationToken().empty()) {
+    stx::logInfo(
+        "fnord.sstablescan",
+        "more rows available, continue with --continuation $0",
+        scan.continuationToken());
+  }
+
+  if (flags.isSet("sample")) {
+    stx::logInfo(
+        "fnord.sstablescan",
+        "scanned a sample of the table, sample rate: $0",
+        scan.stats().sample_rate);
+  }
+
+  if (flags.isSet("stats")) {
+    for (const auto& s : scan.stats().toList()) {
+      fprintf(stderr, "%s: %s\n", s.first.c_str(), s.second.c_str());
+    }
+  }
+
+  if (scan.spilledBytes() > 0) {
+    stx::logDebug(
+        "fnord.sstablescan",
+        "spilled $0 bytes to disk",
+        scan.spilledBytes());
+  }
+
   return 0;
 }
 
@@ -0,0 +1,715 @@
+/**
+ * This file is part of the "libsstable" project
+ *   Copyright (c) 2015 Paul Asmuth, FnordCorp B.V.
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <algorithm>
+#include <regex>
+#include <thread>
+#include <stx/stdtypes.h>
+#include <stx/wallclock.h>
+#include <stx/io/fileutil.h>
+#include <sstable/SSTableWriter.h>
+#include <sstable/sstablereader.h>
+#include <sstable/SSTableColumnSchema.h>
+#include <sstable/SSTableColumnReader.h>
+#include <sstable/SSTableColumnWriter.h>
+#include <sstable/SSTableColumnKernels.h>
+#include <sstable/PAXWriter.h>
+#include <sstable/PAXCursor.h>
+#include <sstable/SSTableScan.h>
+#include <sstable/SSTableExternalSort.h>
+#include <sstable/SSTableColumnCodec.h>
+#include <sstable/SSTableKeyMatcher.h>
+#include <sstable/SSTableRowView.h>
+#include <sstable/SSTableZoneMap.h>
+#include <sstable/SSTableKeyIndex.h>
+#include <sstable/SSTableBloomFilter.h>
+
+using namespace stx;
+using namespace stx::sstable;
+
+static const char kBenchmarkFile[] = "/tmp/__fnord__sstablebenchmark.sstable";
+
+static void printResult(const char* name, size_t rows, uint64_t micros) {
+  printf(
+      "%-32s %10.2fms %10.2f Mrows/s\n",
+      name,
+      micros / 1000.0,
+      micros > 0 ? rows / (double) micros : 0);
+}
+
+/**
+ * Sums a uint64 and a float column of a columnar table with the per-row
+ * getters (SSTableColumnReader) and with the batch API + kernels
+ */
+static void benchmarkColumnAggregation(size_t num_rows) {
+  SSTableColumnSchema schema;
+  schema.addColumn(
+      "count",
+      1,
+      SSTableColumnType::UINT64,
+      SSTableColumnEncoding::VARINT);
+  schema.addColumn("value", 2, SSTableColumnType::FLOAT);
+
+  FileUtil::rm(kBenchmarkFile);
+
+  {
+    String header = "benchmark";
+    auto tbl = SSTableWriter::create(
+        kBenchmarkFile,
+        header.data(),
+        header.size());
+
+    PAXWriter pax(tbl.get(), &schema);
+    for (size_t i = 0; i < num_rows; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i % 1000);
+      cols.addFloatColumn(2, i * 0.25);
+      pax.appendRow(StringUtil::toString(i), cols);
+    }
+
+    pax.flush();
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  String filename(kBenchmarkFile);
+  SSTableReader tbl(filename);
+
+  {
+    auto t0 = WallClock::unixMicros();
+    uint64_t sum = 0;
+    double value_sum = 0;
+
+    auto cursor = tbl.getCursor();
+    for (; cursor->valid(); cursor->next()) {
+      SSTableColumnReader cols(&schema, cursor->getDataBuffer());
+      sum += cols.getUInt64Column(1);
+      value_sum += cols.getFloatColumn(2);
+    }
+
+    printResult("per-row getters", num_rows, WallClock::unixMicros() - t0);
+    printf("  sum=%llu value_sum=%f\n", (unsigned long long) sum, value_sum);
+  }
+
+  {
+    auto t0 = WallClock::unixMicros();
+    uint64_t sum = 0;
+    double value_sum = 0;
+
+    Vector<uint64_t> counts(BinaryFormat::kPAXMaxBlockRows);
+    Vector<double> values(BinaryFormat::kPAXMaxBlockRows);
+
+    auto cursor = tbl.getCursor();
+    auto pax_cursor = dynamic_cast<PAXCursor*>(cursor.get());
+    while (pax_cursor->valid()) {
+      auto n = pax_cursor->remainingBlockRows();
+      pax_cursor->readUInt64Column(1, n, counts.data());
+      pax_cursor->readFloatColumn(2, n, values.data());
+      sum += SSTableColumnKernels::sum(counts.data(), n);
+      value_sum += SSTableColumnKernels::sum(values.data(), n);
+      pax_cursor->skipRows(n);
+    }
+
+    printResult(
+        "batch decode + kernels",
+        num_rows,
+        WallClock::unixMicros() - t0);
+    printf("  sum=%llu value_sum=%f\n", (unsigned long long) sum, value_sum);
+  }
+
+  FileUtil::rm(kBenchmarkFile);
+}
+
+/**
+ * Sorts a table by a float column with a comparator that parses the string
+ * values (std::stod) on every comparison and with the NUMASC sort keys
+ */
+static void benchmarkOrderBy(size_t num_rows) {
+  SSTableColumnSchema schema;
+  schema.addColumn("value", 1, SSTableColumnType::FLOAT);
+
+  FileUtil::rm(kBenchmarkFile);
+
+  {
+    String header = "benchmark";
+    auto tbl = SSTableWriter::create(
+        kBenchmarkFile,
+        header.data(),
+        header.size());
+
+    for (size_t i = 0; i < num_rows; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addFloatColumn(1, ((i * 7919) % num_rows) * 0.25);
+      tbl->appendRow(StringUtil::toString(i), cols);
+    }
+
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  String filename(kBenchmarkFile);
+  SSTableReader tbl(filename);
+
+  auto run = [&] (const char* name, SSTableScan* scan) {
+    scan->setSortMemoryLimit(0);
+
+    auto t0 = WallClock::unixMicros();
+    size_t n = 0;
+    auto cursor = tbl.getCursor();
+    scan->execute(cursor.get(), [&n] (const Vector<String>& row) { ++n; });
+    printResult(name, n, WallClock::unixMicros() - t0);
+  };
+
+  {
+    SSTableScan scan(&schema);
+    scan.setOrderBy("value", [] (const String& a, const String& b) {
+      return std::stod(a) < std::stod(b);
+    });
+
+    run("order by, std::stod comparator", &scan);
+  }
+
+  {
+    SSTableScan scan(&schema);
+    scan.setOrderBy("value", "NUMASC");
+    run("order by, NUMASC sort keys", &scan);
+  }
+
+  FileUtil::rm(kBenchmarkFile);
+}
+
+/**
+ * Sorts num_rows rows with 8 byte sort keys in memory on a single thread and
+ * with the parallel sort on num_threads threads (0 = one per hardware thread)
+ */
+static void benchmarkSort(size_t num_rows, size_t num_threads) {
+  auto run = [num_rows] (const char* name, size_t num_threads) {
+    SSTableExternalSort sort(
+        [] (const String& a, const String& b) { return a < b; },
+        0);
+
+    sort.setParallelSort(0, num_threads);
+
+    uint64_t x = 88172645463325252ull;
+    for (size_t i = 0; i < num_rows; ++i) {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+
+      String sort_key;
+      SSTableColumnCodec::encodeSortKey(x, &sort_key);
+      sort.addRow(std::move(sort_key), Vector<String>());
+    }
+
+    auto t0 = WallClock::unixMicros();
+    size_t n = 0;
+    sort.execute([&n] (const Vector<String>& row) { ++n; });
+    printResult(name, n, WallClock::unixMicros() - t0);
+  };
+
+  if (num_threads == 0) {
+    num_threads = std::thread::hardware_concurrency();
+  }
+
+  printf(
+      "  %u hardware threads, %llu sort threads\n",
+      std::thread::hardware_concurrency(),
+      (unsigned long long) num_threads);
+
+  run("sort, single thread", 1);
+  run("sort, parallel", num_threads);
+}
+
+/**
+ * Matches num_rows keys against a key regex with std::regex_match and with
+ * the compiled SSTableKeyMatcher
+ */
+static void benchmarkKeyRegex(size_t num_rows) {
+  String pattern = "user_[0-9]+/(click|view)s?/.*";
+
+  Vector<String> keys;
+  for (size_t i = 0; i < num_rows; ++i) {
+    keys.emplace_back(
+        StringUtil::format(
+            "user_$0/$1/$2",
+            i % 10000,
+            i % 3 == 0 ? "clicks" : (i % 3 == 1 ? "views" : "other"),
+            i));
+  }
+
+  {
+    std::regex re(pattern);
+    auto t0 = WallClock::unixMicros();
+    size_t n = 0;
+    for (const auto& k : keys) {
+      n += std::regex_match(k, re);
+    }
+
+    printResult("std::regex_match", num_rows, WallClock::unixMicros() - t0);
+    printf("  matches=%llu\n", (unsigned long long) n);
+  }
+
+  {
+    SSTableKeyMatcher matcher(pattern);
+    auto t0 = WallClock::unixMicros();
+    size_t n = 0;
+    for (const auto& k : keys) {
+      n += matcher.matches(k.data(), k.size());
+    }
+
+    printResult("SSTableKeyMatcher", num_rows, WallClock::unixMicros() - t0);
+    printf("  matches=%llu\n", (unsigned long long) n);
+  }
+}
+
+/**
+ * Scans a table and writes every row as CSV into a buffer with the copying
+ * Vector<String> callback and with the row view callback
+ */
+static void benchmarkRowView(size_t num_rows) {
+  SSTableColumnSchema schema;
+  schema.addColumn("count", 1, SSTableColumnType::UINT64);
+  schema.addColumn("value", 2, SSTableColumnType::FLOAT);
+  schema.addColumn("name", 3, SSTableColumnType::STRING);
+
+  FileUtil::rm(kBenchmarkFile);
+
+  {
+    String header = "benchmark";
+    auto tbl = SSTableWriter::create(
+        kBenchmarkFile,
+        header.data(),
+        header.size());
+
+    for (size_t i = 0; i < num_rows; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i);
+      cols.addFloatColumn(2, i * 0.25);
+      cols.addStringColumn(3, StringUtil::format("some_longer_name_$0", i));
+      tbl->appendRow(StringUtil::format("key_$0", i), cols);
+    }
+
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  String filename(kBenchmarkFile);
+  SSTableReader tbl(filename);
+
+  {
+    SSTableScan scan(&schema);
+    String line;
+
+    auto t0 = WallClock::unixMicros();
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&line] (const Vector<String>& row) {
+      line.clear();
+      line.append(StringUtil::join(row, ";"));
+    });
+
+    printResult("Vector<String> rows", num_rows, WallClock::unixMicros() - t0);
+  }
+
+  {
+    SSTableScan scan(&schema);
+    String line;
+
+    auto t0 = WallClock::unixMicros();
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&line] (const SSTableRowView& row) {
+      line.clear();
+      for (size_t i = 0; i < row.size(); ++i) {
+        if (i > 0) line.append(";");
+        auto v = row.getString(i);
+        line.append(v.data, v.size);
+      }
+    });
+
+    printResult("row view", num_rows, WallClock::unixMicros() - t0);
+  }
+
+  FileUtil::rm(kBenchmarkFile);
+}
+
+/**
+ * Scans all columns and a single column of a columnar table with ten columns
+ */
+static void benchmarkSelectList(size_t num_rows) {
+  SSTableColumnSchema schema;
+  for (int i = 1; i <= 10; ++i) {
+    schema.addColumn(
+        StringUtil::format("col$0", i),
+        i,
+        i % 2 == 0 ? SSTableColumnType::UINT64 : SSTableColumnType::STRING);
+  }
+
+  FileUtil::rm(kBenchmarkFile);
+
+  {
+    String header = "benchmark";
+    auto tbl = SSTableWriter::create(
+        kBenchmarkFile,
+        header.data(),
+        header.size());
+
+    PAXWriter pax(tbl.get(), &schema);
+    for (size_t i = 0; i < num_rows; ++i) {
+      SSTableColumnWriter cols(&schema);
+      for (int c = 1; c <= 10; ++c) {
+        if (c % 2 == 0) {
+          cols.addUInt64Column(c, i * c);
+        } else {
+          cols.addStringColumn(c, StringUtil::format("value_$0_$1", c, i));
+        }
+      }
+
+      pax.appendRow(StringUtil::toString(i), cols);
+    }
+
+    pax.flush();
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  String filename(kBenchmarkFile);
+  SSTableReader tbl(filename);
+
+  auto run = [&] (const char* name, SSTableScan* scan) {
+    auto t0 = WallClock::unixMicros();
+    size_t bytes = 0;
+    auto cursor = tbl.getCursor();
+    scan->execute(cursor.get(), [&bytes] (const SSTableRowView& row) {
+      for (size_t i = 0; i < row.size(); ++i) {
+        bytes += row.getString(i).size;
+      }
+    });
+
+    printResult(name, num_rows, WallClock::unixMicros() - t0);
+    printf("  bytes=%llu\n", (unsigned long long) bytes);
+  };
+
+  {
+    SSTableScan scan(&schema);
+    run("all columns", &scan);
+  }
+
+  {
+    SSTableScan scan(&schema);
+    Vector<String> columns;
+    columns.emplace_back("col2");
+    scan.setSelectList(columns);
+    run("one column", &scan);
+  }
+
+  FileUtil::rm(kBenchmarkFile);
+}
+
+/**
+ * Counts the rows of a columnar table with a full scan and with 1% block
+ * samples that skip the other blocks using the zone map and the PAX cursor
+ */
+static void benchmarkSample(size_t num_rows) {
+  SSTableColumnSchema schema;
+  schema.addColumn("clicks", 1, SSTableColumnType::UINT64);
+  schema.addColumn("name", 2, SSTableColumnType::STRING);
+
+  FileUtil::rm(kBenchmarkFile);
+
+  {
+    String header = "benchmark";
+    auto tbl = SSTableWriter::create(
+        kBenchmarkFile,
+        header.data(),
+        header.size());
+
+    SSTableZoneMap zone_map(&schema);
+    PAXWriter pax(tbl.get(), &schema);
+    pax.setZoneMap(&zone_map);
+    for (size_t i = 0; i < num_rows; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i % 100);
+      cols.addStringColumn(2, StringUtil::format("name$0", i));
+      pax.appendRow(StringUtil::toString(i), cols);
+    }
+
+    pax.flush();
+    schema.writeIndex(tbl.get());
+    zone_map.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  String filename(kBenchmarkFile);
+  SSTableReader tbl(filename);
+  SSTableZoneMap zone_map(&schema);
+  zone_map.loadIndex(&tbl);
+
+  auto run = [&] (const char* name, SSTableScan* scan) {
+    scan->addAggregate("count(*)");
+
+    auto t0 = WallClock::unixMicros();
+    String count;
+    auto cursor = tbl.getCursor();
+    scan->execute(cursor.get(), [&count] (const Vector<String>& row) {
+      count = row[0];
+    });
+
+    printResult(name, num_rows, WallClock::unixMicros() - t0);
+    printf(
+        "  count=%s estimate=%.0f value_bytes_read=%llu\n",
+        count.c_str(),
+        std::stod(count) / scan->stats().sample_rate,
+        (unsigned long long) scan->stats().value_bytes_read);
+  };
+
+  {
+    SSTableScan scan(&schema);
+    run("full scan", &scan);
+  }
+
+  {
+    SSTableScan scan(&schema);
+    scan.setZoneMap(&zone_map);
+    scan.setSample(0.01);
+    run("1% block sample, zone map", &scan);
+  }
+
+  {
+    SSTableScan scan(&schema);
+    scan.setSample(0.01);
+    run("1% block sample, cursor", &scan);
+  }
+
+  {
+    SSTableScan scan(&schema);
+    scan.setSample(0.01, SSTableSampler::Method::RANDOM,
+        SSTableSampler::Unit::ROW);
+    run("1% row sample", &scan);
+  }
+
+  FileUtil::rm(kBenchmarkFile);
+}
+
+/**
+ * Reads single keys and batches of keys from a sorted row-oriented table with
+ * a key index and a bloom filter; each lookup opens a new cursor and scan
+ */
+static void benchmarkPointLookup(size_t num_rows) {
+  SSTableColumnSchema schema;
+  schema.addColumn("clicks", 1, SSTableColumnType::UINT64);
+  schema.addColumn("name", 2, SSTableColumnType::STRING);
+
+  FileUtil::rm(kBenchmarkFile);
+
+  /* all keys have the same number of digits, so they are sorted */
+  auto make_key = [num_rows] (size_t i) -> String {
+    return StringUtil::toString(num_rows * 10 + i);
+  };
+
+  {
+    String header = "benchmark";
+    auto tbl = SSTableWriter::create(
+        kBenchmarkFile,
+        header.data(),
+        header.size());
+
+    SSTableKeyIndex key_index;
+    SSTableBloomFilter bloom_filter;
+    for (size_t i = 0; i < num_rows; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i % 100);
+      cols.addStringColumn(2, StringUtil::format("name$0", i));
+
+      auto key = make_key(i);
+      auto pos = tbl->appendRow(
+          key.data(),
+          key.size(),
+          cols.data(),
+          cols.size());
+
+      key_index.addRow(pos, key.data(), key.size());
+      bloom_filter.addKey(key);
+    }
+
+    schema.writeIndex(tbl.get());
+    key_index.writeIndex(tbl.get());
+    bloom_filter.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  String filename(kBenchmarkFile);
+  SSTableReader tbl(filename);
+  SSTableKeyIndex key_index;
+  key_index.loadIndex(&tbl);
+  SSTableBloomFilter bloom_filter;
+  bloom_filter.loadIndex(&tbl);
+
+  auto lookup = [&] (const Set<String>& keys) -> size_t {
+    SSTableScan scan(&schema);
+    scan.setKeyIndex(&key_index);
+    scan.setBloomFilter(&bloom_filter);
+    scan.setKeyExactMatchFilter(keys);
+
+    size_t rows = 0;
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&rows] (const SSTableRowView& row) {
+      ++rows;
+    });
+
+    return rows;
+  };
+
+  const size_t num_lookups = 1000;
+  auto run = [&] (const char* name, size_t key_offset) {
+    size_t rows = 0;
+    auto t0 = WallClock::unixMicros();
+    for (size_t i = 0; i < num_lookups; ++i) {
+      auto key = make_key((i * 7919 + key_offset) % (num_rows * 2));
+      rows += lookup(Set<String>{ key });
+    }
+
+    auto micros = WallClock::unixMicros() - t0;
+    printResult(name, num_lookups, micros);
+    printf(
+        "  %.2fus per lookup, %llu rows\n",
+        micros / (double) num_lookups,
+        (unsigned long long) rows);
+  };
+
+  run("get (hit or miss)", 0);
+
+  {
+    Set<String> keys;
+    for (size_t i = 0; i < num_lookups; ++i) {
+      keys.emplace(make_key((i * 7919) % num_rows));
+    }
+
+    auto t0 = WallClock::unixMicros();
+    auto rows = lookup(keys);
+    auto micros = WallClock::unixMicros() - t0;
+    printResult("multiget (1000 keys)", num_lookups, micros);
+    printf("  %llu rows\n", (unsigned long long) rows);
+  }
+
+  FileUtil::rm(kBenchmarkFile);
+}
+
+/**
+ * Pages through a table with offset + limit and with continuation tokens.
+ * Offset pages walk all previous rows, so only the first pages are read
+ */
+static void benchmarkPagination(size_t num_rows) {
+  SSTableColumnSchema schema;
+  schema.addColumn("clicks", 1, SSTableColumnType::UINT64);
+  schema.addColumn("name", 2, SSTableColumnType::STRING);
+
+  FileUtil::rm(kBenchmarkFile);
+
+  {
+    String header = "benchmark";
+    auto tbl = SSTableWriter::create(
+        kBenchmarkFile,
+        header.data(),
+        header.size());
+
+    for (size_t i = 0; i < num_rows; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i % 100);
+      cols.addStringColumn(2, StringUtil::format("name$0", i));
+
+      auto key = StringUtil::format("key$0", i);
+      tbl->appendRow(key.data(), key.size(), cols.data(), cols.size());
+    }
+
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  String filename(kBenchmarkFile);
+  SSTableReader tbl(filename);
+
+  const size_t page_size = 1000;
+  const size_t num_pages = std::min(size_t(50), num_rows / page_size);
+
+  auto run = [&] (const char* name, bool use_token) {
+    size_t rows = 0;
+    uint64_t rows_scanned = 0;
+    String token;
+    auto t0 = WallClock::unixMicros();
+    for (size_t i = 0; i < num_pages; ++i) {
+      SSTableScan scan(&schema);
+      scan.setLimit(page_size);
+      if (use_token) {
+        if (i > 0) {
+          scan.setContinuationToken(token);
+        }
+      } else {
+        scan.setOffset(i * page_size);
+      }
+
+      auto cursor = tbl.getCursor();
+      scan.execute(cursor.get(), [&rows] (const SSTableRowView& row) {
+        ++rows;
+      });
+
+      token = scan.continuationToken();
+      rows_scanned += scan.stats().rows_scanned;
+    }
+
+    auto micros = WallClock::unixMicros() - t0;
+    printResult(name, rows, micros);
+    printf(
+        "  %llu pages, %.2fms per page, %llu rows scanned\n",
+        (unsigned long long) num_pages,
+        num_pages > 0 ? micros / 1000.0 / num_pages : 0,
+        (unsigned long long) rows_scanned);
+  };
+
+  run("offset", false);
+  run("continuation token", true);
+
+  FileUtil::rm(kBenchmarkFile);
+}
+
+int main(int argc, const char** argv) {
+  size_t num_rows = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+  size_t sort_threads = argc > 2 ? strtoull(argv[2], NULL, 10) : 0;
+
+  printf("column aggregation, %llu rows\n", (unsigned long long) num_rows);
+  benchmarkColumnAggregation(num_rows);
+
+  printf("order by, %llu rows\n", (unsigned long long) num_rows);
+  benchmarkOrderBy(num_rows);
+
+  printf("row view, %llu rows\n", (unsigned long long) num_rows);
+  benchmarkRowView(num_rows);
+
+  printf("select list, %llu rows\n", (unsigned long long) num_rows);
+  benchmarkSelectList(num_rows);
+
+  printf("sample, %llu rows\n", (unsigned long long) num_rows);
+  benchmarkSample(num_rows);
+
+  printf("point lookup, %llu rows\n", (unsigned long long) num_rows);
+  benchmarkPointLookup(num_rows);
+
+  printf("pagination, %llu rows\n", (unsigned long long) num_rows);
+  benchmarkPagination(num_rows);
+
+  printf("key regex, %llu rows\n", (unsigned long long) num_rows);
+  benchmarkKeyRegex(num_rows);
+
+  for (auto sort_rows : { num_rows, num_rows * 10, num_rows * 100 }) {
+    printf("sort, %llu rows\n", (unsigned long long) sort_rows);
+    benchmarkSort(sort_rows, sort_threads);
+  }
+
+  return 0;
+}
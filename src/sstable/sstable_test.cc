@@ -7,13 +7,43 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <math.h>
+#include <atomic>
+#include <limits>
+#include <regex>
+#include <thread>
 #include <stx/stdtypes.h>
 #include <stx/io/file.h>
+#include <stx/io/mmappedfile.h>
+#include <stx/wallclock.h>
 #include <stx/test/unittest.h>
 #include <sstable/SSTableEditor.h>
 #include <sstable/SSTableWriter.h>
 #include <sstable/sstablereader.h>
 #include <sstable/rowoffsetindex.h>
+#include <sstable/SSTableColumnSchema.h>
+#include <sstable/SSTableColumnReader.h>
+#include <sstable/SSTableColumnWriter.h>
+#include <sstable/PAXWriter.h>
+#include <sstable/PAXCursor.h>
+#include <sstable/SSTableColumnCodec.h>
+#include <sstable/SSTableColumnKernels.h>
+#include <sstable/SSTableScan.h>
+#include <sstable/SSTableScanPredicate.h>
+#include <sstable/SSTableZoneMap.h>
+#include <sstable/SSTableExternalSort.h>
+#include <sstable/SSTableKeyIndex.h>
+#include <sstable/SSTableBloomFilter.h>
+#include <sstable/SSTableKeyMatcher.h>
+#include <sstable/SSTableAggregator.h>
+#include <sstable/SSTableRowView.h>
+#include <sstable/SSTableHyperLogLog.h>
+#include <sstable/SSTableQuantileSketch.h>
+#include <sstable/SSTableResultWriter.h>
+#include <sstable/SSTableResultReader.h>
+#include <sstable/SSTableReaderCache.h>
+#include <sstable/SSTableScanExecutor.h>
+#include <sstable/SSTableSipHash.h>
 
 using namespace stx::sstable;
 using namespace stx;
@@ -185,3 +215,3410 @@ TEST_CASE(SSTableTest, TestSSTableWriteReopenThenRead, [] () {
 });
 
 
+
+TEST_CASE(SSTableTest, TestColumnarSSTableWriteThenRead, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest3.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn("count", 1, SSTableColumnType::UINT64);
+  schema.addColumn("name", 2, SSTableColumnType::STRING);
+  schema.addColumn("ratio", 3, SSTableColumnType::FLOAT);
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest3.sstable",
+        header.data(),
+        header.size());
+
+    PAXWriter pax(tbl.get(), &schema, PAXWriter::kDefaultMaxBlockSize, 2);
+    for (int i = 1; i <= 5; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i * 10);
+      cols.addStringColumn(2, StringUtil::format("name$0", i));
+      if (i % 2 == 0) {
+        cols.addFloatColumn(3, i / 2.0);
+      }
+
+      pax.appendRow(StringUtil::format("key$0", i), cols);
+    }
+
+    pax.flush();
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  {
+    SSTableReader tbl(String("/tmp/__fnord__sstabletest3.sstable"));
+    EXPECT_EQ(tbl.isColumnar(), true);
+    EXPECT_EQ(tbl.countRows(), 5);
+
+    SSTableColumnSchema schema2;
+    schema2.loadIndex(&tbl);
+
+    auto cursor = tbl.getCursor();
+    for (int i = 1; i <= 5; ++i) {
+      EXPECT_EQ(cursor->valid(), true);
+      EXPECT_EQ(cursor->getKeyString(), StringUtil::format("key$0", i));
+
+      SSTableColumnReader cols(&schema2, cursor->getDataBuffer());
+      EXPECT_EQ(cols.getUInt64Column(1), i * 10);
+      EXPECT_EQ(cols.getStringColumn(2), StringUtil::format("name$0", i));
+      if (i % 2 == 0) {
+        EXPECT_EQ(cols.getFloatColumn(3), i / 2.0);
+      }
+
+      EXPECT_EQ(cursor->next(), i < 5);
+    }
+
+    auto pax_cursor = tbl.getCursor();
+    dynamic_cast<PAXCursor*>(pax_cursor.get())->setColumnProjection({ 2 });
+    EXPECT_EQ(pax_cursor->next(), true);
+    EXPECT_EQ(pax_cursor->next(), true);
+    EXPECT_EQ(pax_cursor->getKeyString(), "key3");
+    SSTableColumnReader cols(&schema2, pax_cursor->getDataBuffer());
+    EXPECT_EQ(cols.getStringColumn(2), "name3");
+  }
+});
+
+TEST_CASE(SSTableTest, TestColumnEncodings, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest4.sstable");
+
+  SSTableColumnSchema schema;
+  schema.setColumnIDEncoding(SSTableColumnEncoding::VARINT);
+  schema.addColumn(
+      "time",
+      1,
+      SSTableColumnType::UINT64,
+      SSTableColumnEncoding::DELTA);
+  schema.addColumn(
+      "offset",
+      2,
+      SSTableColumnType::UINT32,
+      SSTableColumnEncoding::ZIGZAG);
+  schema.addColumn(
+      "value",
+      3,
+      SSTableColumnType::FLOAT,
+      SSTableColumnEncoding::XOR);
+  schema.addColumn(
+      "name",
+      4,
+      SSTableColumnType::STRING,
+      SSTableColumnEncoding::VARINT);
+
+  SSTableColumnSchema plain_schema;
+  plain_schema.addColumn("time", 1, SSTableColumnType::UINT64);
+  plain_schema.addColumn("offset", 2, SSTableColumnType::UINT32);
+  plain_schema.addColumn("value", 3, SSTableColumnType::FLOAT);
+  plain_schema.addColumn("name", 4, SSTableColumnType::STRING);
+
+  {
+    SSTableColumnWriter cols(&schema);
+    cols.addUInt64Column(1, 1430000000000);
+    cols.addUInt32Column(2, (uint32_t) -3);
+    cols.addFloatColumn(3, 23.5);
+    cols.addStringColumn(4, "fnord");
+
+    SSTableColumnWriter plain_cols(&plain_schema);
+    plain_cols.addUInt64Column(1, 1430000000000);
+    plain_cols.addUInt32Column(2, (uint32_t) -3);
+    plain_cols.addFloatColumn(3, 23.5);
+    plain_cols.addStringColumn(4, "fnord");
+    EXPECT_EQ(cols.size() < plain_cols.size(), true);
+
+    SSTableColumnReader reader(&schema, Buffer(cols.data(), cols.size()));
+    EXPECT_EQ(reader.getUInt64Column(1), 1430000000000);
+    EXPECT_EQ(reader.getUInt32Column(2), (uint32_t) -3);
+    EXPECT_EQ(reader.getFloatColumn(3), 23.5);
+    EXPECT_EQ(reader.getStringColumn(4), "fnord");
+  }
+
+  {
+    Buffer index;
+    schema.writeIndex(&index);
+
+    SSTableColumnSchema schema2;
+    schema2.loadIndex(index);
+    EXPECT_EQ(
+        schema2.columnIDEncoding() == SSTableColumnEncoding::VARINT,
+        true);
+    EXPECT_EQ(schema2.columnEncoding(1) == SSTableColumnEncoding::DELTA, true);
+    EXPECT_EQ(schema2.columnEncoding(3) == SSTableColumnEncoding::XOR, true);
+    EXPECT_EQ(schema2.columnType(3) == SSTableColumnType::FLOAT, true);
+  }
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest4.sstable",
+        header.data(),
+        header.size());
+
+    PAXWriter pax(tbl.get(), &schema);
+    for (int i = 0; i < 100; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, 1430000000000 + i * 1000);
+      cols.addUInt32Column(2, 50 - i);
+      cols.addFloatColumn(3, 20 + (i % 3) * 0.5);
+      cols.addStringColumn(4, StringUtil::format("name$0", i));
+      pax.appendRow(StringUtil::format("key$0", i), cols);
+    }
+
+    pax.flush();
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  {
+    SSTableReader tbl(String("/tmp/__fnord__sstabletest4.sstable"));
+    EXPECT_EQ(tbl.countRows(), 100);
+
+    SSTableColumnSchema schema2;
+    schema2.loadIndex(&tbl);
+
+    auto cursor = tbl.getCursor();
+    for (int i = 0; i < 100; ++i) {
+      EXPECT_EQ(cursor->valid(), true);
+
+      SSTableColumnReader cols(&schema2, cursor->getDataBuffer());
+      EXPECT_EQ(cols.getUInt64Column(1), 1430000000000 + i * 1000);
+      EXPECT_EQ(cols.getUInt32Column(2), (uint32_t) (50 - i));
+      EXPECT_EQ(cols.getFloatColumn(3), 20 + (i % 3) * 0.5);
+      EXPECT_EQ(cols.getStringColumn(4), StringUtil::format("name$0", i));
+
+      cursor->next();
+    }
+
+    EXPECT_EQ(cursor->valid(), false);
+  }
+});
+
+TEST_CASE(SSTableTest, TestDictionaryEncodedColumns, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest5.sstable");
+  FileUtil::rm("/tmp/__fnord__sstabletest6.sstable");
+
+  Vector<String> countries;
+  countries.emplace_back("DE");
+  countries.emplace_back("US");
+  countries.emplace_back("FR");
+
+  SSTableColumnSchema schema;
+  schema.addColumn(
+      "country",
+      1,
+      SSTableColumnType::STRING,
+      SSTableColumnEncoding::DICTIONARY);
+  schema.addColumn("clicks", 2, SSTableColumnType::UINT64);
+
+  for (int columnar = 0; columnar < 2; ++columnar) {
+    auto filename = StringUtil::format(
+        "/tmp/__fnord__sstabletest$0.sstable",
+        5 + columnar);
+
+    {
+      std::string header = "myfnordyheader!";
+      auto tbl = SSTableWriter::create(filename, header.data(), header.size());
+
+      std::unique_ptr<PAXWriter> pax;
+      if (columnar) {
+        pax.reset(new PAXWriter(tbl.get(), &schema));
+      }
+
+      for (int i = 0; i < 10; ++i) {
+        SSTableColumnWriter cols(&schema);
+        cols.addStringColumn(1, countries[i % countries.size()]);
+        cols.addUInt64Column(2, i);
+
+        auto key = StringUtil::format("key$0", i);
+        if (pax.get()) {
+          pax->appendRow(key, cols);
+        } else {
+          tbl->appendRow(key.data(), key.size(), cols.data(), cols.size());
+        }
+      }
+
+      if (pax.get()) {
+        pax->flush();
+      }
+
+      schema.writeIndex(tbl.get());
+      tbl->commit();
+    }
+
+    SSTableReader tbl(filename);
+    EXPECT_EQ(tbl.countRows(), 10);
+
+    SSTableColumnSchema schema2;
+    schema2.loadIndex(&tbl);
+    EXPECT_EQ(schema2.dictionarySize(1), 3);
+
+    uint32_t us_code;
+    EXPECT_EQ(schema2.lookupDictionaryCode(1, "US", &us_code), true);
+    EXPECT_EQ(schema2.dictionaryValue(1, us_code), "US");
+
+    uint32_t code;
+    EXPECT_EQ(schema2.lookupDictionaryCode(1, "XX", &code), false);
+
+    auto cursor = tbl.getCursor();
+    for (int i = 0; i < 10; ++i) {
+      EXPECT_EQ(cursor->valid(), true);
+
+      SSTableColumnReader cols(&schema2, cursor->getDataBuffer());
+      EXPECT_EQ(cols.getStringColumn(1), countries[i % countries.size()]);
+      EXPECT_EQ(cols.getDictionaryCode(1) == us_code, i % 3 == 1);
+      EXPECT_EQ(cols.getUInt64Column(2), i);
+
+      cursor->next();
+    }
+  }
+
+  /* the dictionary of the next table written with the schema only holds
+     its own values */
+  EXPECT_EQ(schema.dictionarySize(1), 0);
+  FileUtil::rm("/tmp/__fnord__sstabletest30.sstable");
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest30.sstable",
+        header.data(),
+        header.size());
+
+    SSTableColumnWriter cols(&schema);
+    cols.addStringColumn(1, "NL");
+    cols.addUInt64Column(2, 1);
+    tbl->appendRow("key", 3, cols.data(), cols.size());
+
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  SSTableReader tbl(String("/tmp/__fnord__sstabletest30.sstable"));
+  SSTableColumnSchema schema2;
+  schema2.loadIndex(&tbl);
+  EXPECT_EQ(schema2.dictionarySize(1), 1);
+  EXPECT_EQ(schema2.dictionaryValue(1, 0), "NL");
+
+  uint32_t code;
+  EXPECT_EQ(schema2.lookupDictionaryCode(1, "DE", &code), false);
+});
+
+TEST_CASE(SSTableTest, TestColumnKernels, [] () {
+  Vector<uint64_t> values;
+  String encoded;
+  for (uint64_t i = 0; i < 100; ++i) {
+    values.emplace_back(i % 7 == 0 ? i * 100000 : i);
+
+    char buf[SSTableColumnCodec::kMaxEncodedSize];
+    auto len = SSTableColumnCodec::encodeVarUInt(values.back(), buf);
+    encoded.append(buf, len);
+  }
+
+  Vector<uint64_t> decoded(values.size());
+  auto consumed = SSTableColumnKernels::decodeVarUInt(
+      encoded.data(),
+      encoded.size(),
+      decoded.size(),
+      decoded.data());
+
+  EXPECT_EQ(consumed, encoded.size());
+  EXPECT_EQ(decoded == values, true);
+
+  Vector<uint32_t> values32(values.size());
+  SSTableColumnKernels::narrowUInt32(
+      values.data(),
+      values.size(),
+      &values32[0]);
+
+  uint64_t sum = 0;
+  for (const auto& v : values) {
+    sum += v;
+  }
+
+  EXPECT_EQ(SSTableColumnKernels::sum(values.data(), values.size()), sum);
+  EXPECT_EQ(SSTableColumnKernels::sum(values32.data(), values32.size()), sum);
+  EXPECT_EQ(SSTableColumnKernels::min(values32.data() + 1, 98), 1);
+  EXPECT_EQ(SSTableColumnKernels::max(values32.data(), 99), 9800000);
+  EXPECT_EQ(SSTableColumnKernels::count(values32.data(), 100, 0), 1);
+  EXPECT_EQ(SSTableColumnKernels::count(values.data(), 100, 13), 1);
+
+  Vector<uint64_t> widened(values32.size());
+  SSTableColumnKernels::decodeFixedUInt32(
+      values32.data(),
+      values32.size(),
+      widened.data());
+  EXPECT_EQ(widened == values, true);
+
+  Vector<double> doubles;
+  doubles.emplace_back(1.5);
+  doubles.emplace_back(-2.0);
+  doubles.emplace_back(3.25);
+  doubles.emplace_back(0.5);
+  doubles.emplace_back(8.0);
+  EXPECT_EQ(SSTableColumnKernels::sum(doubles.data(), 5), 11.25);
+  EXPECT_EQ(SSTableColumnKernels::min(doubles.data(), 5), -2.0);
+  EXPECT_EQ(SSTableColumnKernels::max(doubles.data(), 5), 8.0);
+});
+
+TEST_CASE(SSTableTest, TestPAXCursorBatchRead, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest7.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn(
+      "count",
+      1,
+      SSTableColumnType::UINT64,
+      SSTableColumnEncoding::VARINT);
+  schema.addColumn("ratio", 2, SSTableColumnType::FLOAT);
+  schema.addColumn("name", 3, SSTableColumnType::STRING);
+  schema.addColumn("len", 4, SSTableColumnType::UINT32);
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest7.sstable",
+        header.data(),
+        header.size());
+
+    PAXWriter pax(tbl.get(), &schema, PAXWriter::kDefaultMaxBlockSize, 64);
+    for (int i = 0; i < 1000; ++i) {
+      auto name = StringUtil::format("name$0", i);
+
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i);
+      cols.addFloatColumn(2, i * 0.5);
+      cols.addStringColumn(3, name);
+      cols.addUInt32Column(4, name.size());
+      pax.appendRow(StringUtil::format("key$0", i), cols);
+    }
+
+    pax.flush();
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  SSTableReader tbl(String("/tmp/__fnord__sstabletest7.sstable"));
+  auto cursor = tbl.getCursor();
+  auto pax_cursor = dynamic_cast<PAXCursor*>(cursor.get());
+  EXPECT_EQ(pax_cursor->skipRows(10), true);
+
+  uint64_t counts[64];
+  double ratios[64];
+  uint32_t lens[64];
+  uint32_t name_offsets[64];
+  uint32_t name_lens[64];
+  uint64_t sum = 0;
+  double ratio_sum = 0;
+  size_t rows = 0;
+  while (pax_cursor->valid()) {
+    auto n = pax_cursor->remainingBlockRows();
+    EXPECT_EQ(n <= 64, true);
+
+    pax_cursor->readUInt64Column(1, n, counts);
+    pax_cursor->readFloatColumn(2, n, ratios);
+    pax_cursor->readUInt32Column(4, n, lens);
+    auto names = pax_cursor->readStringColumn(3, n, name_offsets, name_lens);
+
+    for (size_t i = 0; i < n; ++i) {
+      EXPECT_EQ(counts[i], rows + i + 10);
+      EXPECT_EQ(lens[i], name_lens[i]);
+      EXPECT_EQ(
+          String(names + name_offsets[i], name_lens[i]),
+          StringUtil::format("name$0", counts[i]));
+    }
+
+    sum += SSTableColumnKernels::sum(counts, n);
+    ratio_sum += SSTableColumnKernels::sum(ratios, n);
+    rows += n;
+    pax_cursor->skipRows(n);
+  }
+
+  EXPECT_EQ(rows, 990);
+  EXPECT_EQ(sum, 499500 - 45);
+  EXPECT_EQ(ratio_sum, (499500 - 45) * 0.5);
+});
+
+TEST_CASE(SSTableTest, TestScanPredicates, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest8.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn("clicks", 1, SSTableColumnType::UINT64);
+  schema.addColumn("ctr", 2, SSTableColumnType::FLOAT);
+  schema.addColumn("name", 3, SSTableColumnType::STRING);
+  schema.addColumn(
+      "country",
+      4,
+      SSTableColumnType::STRING,
+      SSTableColumnEncoding::DICTIONARY);
+
+  Vector<String> countries;
+  countries.emplace_back("DE");
+  countries.emplace_back("US");
+  countries.emplace_back("FR");
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest8.sstable",
+        header.data(),
+        header.size());
+
+    for (int i = 0; i < 100; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i);
+      cols.addFloatColumn(2, i / 100.0);
+      cols.addStringColumn(3, StringUtil::format("name$0", i));
+      cols.addStringColumn(4, countries[i % countries.size()]);
+
+      auto key = StringUtil::format("key$0", i);
+      tbl->appendRow(key.data(), key.size(), cols.data(), cols.size());
+    }
+
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  SSTableReader tbl(String("/tmp/__fnord__sstabletest8.sstable"));
+  SSTableColumnSchema schema2;
+  schema2.loadIndex(&tbl);
+
+  auto count = [&] (const String& filter) -> size_t {
+    SSTableScan scan(&schema2);
+    scan.addFilter(SSTableScanPredicate::parse(filter));
+
+    size_t n = 0;
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&n] (const Vector<String>& row) { ++n; });
+    return n;
+  };
+
+  EXPECT_EQ(count("clicks = 42"), 1);
+  EXPECT_EQ(count("clicks != 42"), 99);
+  EXPECT_EQ(count("clicks < 10"), 10);
+  EXPECT_EQ(count("clicks <= 10"), 11);
+  EXPECT_EQ(count("clicks > 89"), 10);
+  EXPECT_EQ(count("clicks >= 89"), 11);
+  EXPECT_EQ(count("clicks IN (1, 5, 500)"), 2);
+  EXPECT_EQ(count("clicks BETWEEN 10 AND 19"), 10);
+  EXPECT_EQ(count("ctr >= 0.5"), 50);
+  EXPECT_EQ(count("name PREFIX 'name1'"), 11);
+  EXPECT_EQ(count("name = 'name7'"), 1);
+  EXPECT_EQ(count("_key BETWEEN 'key10' AND 'key19'"), 10);
+  EXPECT_EQ(count("country = 'US'"), 33);
+  EXPECT_EQ(count("country != 'US'"), 67);
+  EXPECT_EQ(count("country = 'XX'"), 0);
+  EXPECT_EQ(count("country IN ('DE', 'FR')"), 67);
+  EXPECT_EQ(count("country PREFIX 'D'"), 34);
+  EXPECT_EQ(count("country = 'DE' AND clicks < 10"), 4);
+  EXPECT_EQ(count("clicks < 5 OR clicks > 94 AND country = 'DE'"), 7);
+  EXPECT_EQ(count("(clicks < 5 OR clicks > 94) and country = 'DE'"), 4);
+
+  /* negative and out of range values are rejected for unsigned columns */
+  Vector<String> invalid;
+  invalid.emplace_back("-1");
+  invalid.emplace_back(" 1");
+  invalid.emplace_back("18446744073709551616");
+  invalid.emplace_back("fnord");
+  for (const auto& value : invalid) {
+    bool raised = false;
+    try {
+      auto filter = SSTableScanPredicate::greaterThan("clicks", value);
+      filter.bind(&schema2);
+    } catch (const Exception& e) {
+      raised = true;
+    }
+
+    EXPECT_TRUE(raised);
+  }
+
+  SSTableScan scan(&schema2);
+  scan.addFilter(SSTableScanPredicate::greaterThan("clicks", "50"));
+
+  Vector<SSTableScanPredicate> any;
+  any.emplace_back(SSTableScanPredicate::equals("country", "FR"));
+  any.emplace_back(SSTableScanPredicate::prefix("name", "name99"));
+  scan.addFilter(SSTableScanPredicate::anyOf(any));
+
+  Vector<String> keys;
+  auto cursor = tbl.getCursor();
+  scan.execute(cursor.get(), [&keys] (const Vector<String>& row) {
+    keys.emplace_back(row[0]);
+  });
+
+  EXPECT_EQ(keys.size(), 17);
+  EXPECT_EQ(keys.back(), "key99");
+});
+
+TEST_CASE(SSTableTest, TestZoneMapScan, [] () {
+  SSTableColumnSchema schema;
+  schema.addColumn("time", 1, SSTableColumnType::UINT64);
+  schema.addColumn("value", 2, SSTableColumnType::FLOAT);
+  schema.addColumn("host", 3, SSTableColumnType::STRING);
+
+  {
+    SSTableZoneMap zone_map(&schema);
+    for (int i = 0; i < 10; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, 100 - i);
+      if (i % 3 == 0) {
+        cols.addStringColumn(3, "myhost");
+      }
+
+      auto key = StringUtil::format("key$0", i);
+      zone_map.addRow(
+          key.data(),
+          key.size(),
+          SSTableColumnReader(&schema, Buffer(cols.data(), cols.size())));
+    }
+
+    zone_map.finishZone(0);
+    EXPECT_EQ(zone_map.numZones(), 1);
+    EXPECT_EQ(zone_map.getZone(0).num_rows, 10);
+    EXPECT_EQ(zone_map.getZone(0).columns.at(1).min, 91);
+    EXPECT_EQ(zone_map.getZone(0).columns.at(1).max, 100);
+    EXPECT_EQ(zone_map.getZone(0).columns.at(2).null_count, 10);
+    EXPECT_EQ(zone_map.getZone(0).columns.at(3).null_count, 6);
+  }
+
+  /* zones with NaN values may match any float filter */
+  for (int nan_pos = 0; nan_pos < 2; ++nan_pos) {
+    SSTableZoneMap zone_map(&schema);
+    for (int i = 0; i < 10; ++i) {
+      SSTableColumnWriter cols(&schema);
+      if (i == nan_pos * 5) {
+        cols.addFloatColumn(2, std::numeric_limits<double>::quiet_NaN());
+      } else {
+        cols.addFloatColumn(2, i);
+      }
+
+      auto key = StringUtil::format("key$0", i);
+      zone_map.addRow(
+          key.data(),
+          key.size(),
+          SSTableColumnReader(&schema, Buffer(cols.data(), cols.size())));
+    }
+
+    zone_map.finishZone(0);
+
+    Vector<String> filters;
+    filters.emplace_back("value < 3");
+    filters.emplace_back("value > 3");
+    filters.emplace_back("value <= 2");
+    filters.emplace_back("value >= 7");
+    filters.emplace_back("value != 4");
+    filters.emplace_back("value = 4");
+    for (const auto& f : filters) {
+      auto filter = SSTableScanPredicate::parse(f);
+      filter.bind(&schema);
+      EXPECT_TRUE(filter.mayMatch(zone_map.getZone(0)));
+    }
+  }
+
+  for (int columnar = 0; columnar < 2; ++columnar) {
+    auto filename = StringUtil::format(
+        "/tmp/__fnord__sstabletest$0.sstable",
+        9 + columnar);
+
+    FileUtil::rm(filename);
+
+    {
+      std::string header = "myfnordyheader!";
+      auto tbl = SSTableWriter::create(filename, header.data(), header.size());
+      SSTableZoneMap zone_map(&schema, 1024);
+
+      std::unique_ptr<PAXWriter> pax;
+      if (columnar) {
+        pax.reset(
+            new PAXWriter(
+                tbl.get(),
+                &schema,
+                PAXWriter::kDefaultMaxBlockSize,
+                50));
+        pax->setZoneMap(&zone_map);
+      }
+
+      for (int i = 0; i < 1000; ++i) {
+        SSTableColumnWriter cols(&schema);
+        cols.addUInt64Column(1, 1430000000 + i);
+        cols.addFloatColumn(2, i % 10);
+        cols.addStringColumn(3, StringUtil::format("host$0", i / 100));
+
+        auto key = StringUtil::format("key$0", 1000 + i);
+        if (pax.get()) {
+          pax->appendRow(key, cols);
+        } else {
+          auto pos = tbl->appendRow(key, cols);
+          zone_map.addRow(
+              pos,
+              key.data(),
+              key.size(),
+              SSTableColumnReader(&schema, Buffer(cols.data(), cols.size())));
+        }
+      }
+
+      if (pax.get()) {
+        pax->flush();
+      }
+
+      schema.writeIndex(tbl.get());
+      zone_map.writeIndex(tbl.get());
+      tbl->commit();
+    }
+
+    SSTableReader tbl(filename);
+    EXPECT_EQ(tbl.hasFooter(SSTableZoneMap::kSSTableIndexID), true);
+
+    SSTableColumnSchema schema2;
+    schema2.loadIndex(&tbl);
+    SSTableZoneMap zone_map(&schema2);
+    zone_map.loadIndex(&tbl);
+    EXPECT_EQ(zone_map.numZones() >= 10, true);
+
+    const auto& zone = zone_map.getZone(0);
+    EXPECT_EQ(zone.min_key, "key1000");
+    EXPECT_EQ(zone.columns.at(1).min, 1430000000);
+    EXPECT_EQ(zone.columns.at(3).null_count, 0);
+    EXPECT_EQ(zone.columns.at(3).min_string, "host0");
+
+    auto filter = SSTableScanPredicate::parse(
+        "time BETWEEN 1430000100 AND 1430000149");
+    filter.bind(&schema2);
+
+    size_t matching_zones = 0;
+    for (size_t i = 0; i < zone_map.numZones(); ++i) {
+      if (filter.mayMatch(zone_map.getZone(i))) {
+        ++matching_zones;
+      }
+    }
+
+    EXPECT_EQ(matching_zones <= 3, true);
+
+    auto scan = [&] (const String& filter, const String& key_prefix) {
+      SSTableScan scan(&schema2);
+      scan.setZoneMap(&zone_map);
+      scan.addFilter(SSTableScanPredicate::parse(filter));
+      if (!key_prefix.empty()) {
+        scan.setKeyPrefix(key_prefix);
+      }
+
+      Vector<String> keys;
+      auto cursor = tbl.getCursor();
+      scan.execute(cursor.get(), [&keys] (const Vector<String>& row) {
+        keys.emplace_back(row[0]);
+      });
+
+      return keys;
+    };
+
+    auto keys = scan("time BETWEEN 1430000100 AND 1430000149", "");
+    EXPECT_EQ(keys.size(), 50);
+    EXPECT_EQ(keys.front(), "key1100");
+    EXPECT_EQ(keys.back(), "key1149");
+
+    EXPECT_EQ(scan("time >= 1430000990", "").size(), 10);
+    EXPECT_EQ(scan("time < 1430000005", "").size(), 5);
+    EXPECT_EQ(scan("value = 3.0", "key19").size(), 10);
+    EXPECT_EQ(scan("host = 'host7'", "").size(), 100);
+    EXPECT_EQ(scan("host PREFIX 'host9' OR time < 1430000002", "").size(), 102);
+  }
+});
+
+TEST_CASE(SSTableTest, TestOrderByLimit, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest10.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn("clicks", 1, SSTableColumnType::UINT64);
+  schema.addColumn("name", 2, SSTableColumnType::STRING);
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest10.sstable",
+        header.data(),
+        header.size());
+
+    for (int i = 0; i < 1000; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, (i * 7919) % 1000);
+      cols.addStringColumn(2, StringUtil::format("name$0", i));
+
+      auto key = StringUtil::format("key$0", i);
+      tbl->appendRow(key.data(), key.size(), cols.data(), cols.size());
+    }
+
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  SSTableReader tbl(String("/tmp/__fnord__sstabletest10.sstable"));
+  SSTableColumnSchema schema2;
+  schema2.loadIndex(&tbl);
+
+  auto run = [&] (const String& order_fn, long limit, size_t offset) {
+    SSTableScan scan(&schema2);
+    scan.setOrderBy("clicks", order_fn);
+    scan.setLimit(limit);
+    scan.setOffset(offset);
+
+    Vector<String> values;
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&values] (const Vector<String>& row) {
+      values.emplace_back(row[1]);
+    });
+
+    return values;
+  };
+
+  auto all_asc = run("NUMASC", -1, 0);
+  auto all_dsc = run("NUMDSC", -1, 0);
+  EXPECT_EQ(all_asc.size(), 1000);
+  EXPECT_EQ(all_dsc.size(), 1000);
+
+  auto top = run("NUMASC", 10, 0);
+  EXPECT_EQ(top.size(), 10);
+  for (int i = 0; i < top.size(); ++i) {
+    EXPECT_EQ(top[i], all_asc[i]);
+  }
+
+  auto page = run("NUMDSC", 5, 20);
+  EXPECT_EQ(page.size(), 5);
+  for (int i = 0; i < page.size(); ++i) {
+    EXPECT_EQ(page[i], all_dsc[20 + i]);
+  }
+
+  auto tail = run("NUMASC", 10, 995);
+  EXPECT_EQ(tail.size(), 5);
+  EXPECT_EQ(tail.back(), "999");
+
+  auto past_end = run("NUMASC", 10, 2000);
+  EXPECT_EQ(past_end.size(), 0);
+});
+
+TEST_CASE(SSTableTest, TestOrderBySpillToDisk, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest11.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn("clicks", 1, SSTableColumnType::UINT64);
+  schema.addColumn("name", 2, SSTableColumnType::STRING);
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest11.sstable",
+        header.data(),
+        header.size());
+
+    for (int i = 0; i < 5000; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, (i * 7919) % 5000);
+      cols.addStringColumn(2, StringUtil::format("name$0", i));
+
+      auto key = StringUtil::format("key$0", i);
+      tbl->appendRow(key.data(), key.size(), cols.data(), cols.size());
+    }
+
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  SSTableReader tbl(String("/tmp/__fnord__sstabletest11.sstable"));
+  SSTableColumnSchema schema2;
+  schema2.loadIndex(&tbl);
+
+  auto run = [&] (size_t memory_limit, size_t offset, uint64_t* spilled) {
+    SSTableScan scan(&schema2);
+    scan.setOrderBy("clicks", "NUMASC");
+    scan.setOffset(offset);
+    scan.setSortMemoryLimit(memory_limit);
+    scan.setTempDirectory("/tmp");
+
+    Vector<String> values;
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&values] (const Vector<String>& row) {
+      values.emplace_back(row[1]);
+    });
+
+    *spilled = scan.spilledBytes();
+    return values;
+  };
+
+  uint64_t spilled;
+  auto in_memory = run(0, 0, &spilled);
+  EXPECT_EQ(spilled, 0);
+  EXPECT_EQ(in_memory.size(), 5000);
+
+  auto spilled_rows = run(16 * 1024, 0, &spilled);
+  EXPECT_TRUE(spilled > 0);
+  EXPECT_EQ(spilled_rows.size(), 5000);
+  for (int i = 0; i < spilled_rows.size(); ++i) {
+    EXPECT_EQ(spilled_rows[i], StringUtil::toString(i));
+  }
+
+  auto with_offset = run(16 * 1024, 4990, &spilled);
+  EXPECT_EQ(with_offset.size(), 10);
+  EXPECT_EQ(with_offset.front(), "4990");
+
+  SSTableExternalSort sort(
+      [] (const String& a, const String& b) {
+        return a < b;
+      },
+      64,
+      "/tmp");
+
+  for (int i = 0; i < 100; ++i) {
+    Vector<String> row;
+    row.emplace_back(StringUtil::format("$0", 99 - i));
+    sort.addRow(StringUtil::format("$0", 99 - i), std::move(row));
+  }
+
+  EXPECT_TRUE(sort.numRuns() > 1);
+
+  Vector<String> sorted;
+  sort.execute([&sorted] (const Vector<String>& row) {
+    sorted.emplace_back(row[0]);
+  }, 5, 3);
+
+  EXPECT_EQ(sorted.size(), 3);
+  EXPECT_EQ(sorted[0], "13");
+  EXPECT_EQ(sorted[1], "14");
+  EXPECT_EQ(sorted[2], "15");
+});
+
+TEST_CASE(SSTableTest, TestSortKeys, [] () {
+  Vector<uint64_t> uints;
+  uints.emplace_back(0);
+  uints.emplace_back(1);
+  uints.emplace_back(255);
+  uints.emplace_back(256);
+  uints.emplace_back(0xffffffff);
+  uints.emplace_back(uint64_t(-1));
+
+  for (int i = 1; i < uints.size(); ++i) {
+    String a;
+    String b;
+    SSTableColumnCodec::encodeSortKey(uints[i - 1], &a);
+    SSTableColumnCodec::encodeSortKey(uints[i], &b);
+    EXPECT_TRUE(a < b);
+  }
+
+  Vector<double> doubles;
+  doubles.emplace_back(-1e300);
+  doubles.emplace_back(-2.5);
+  doubles.emplace_back(-0.001);
+  doubles.emplace_back(0);
+  doubles.emplace_back(0.001);
+  doubles.emplace_back(2.5);
+  doubles.emplace_back(1e300);
+
+  for (int i = 1; i < doubles.size(); ++i) {
+    String a;
+    String b;
+    SSTableColumnCodec::encodeSortKey(doubles[i - 1], &a);
+    SSTableColumnCodec::encodeSortKey(doubles[i], &b);
+    EXPECT_TRUE(a < b);
+  }
+
+  FileUtil::rm("/tmp/__fnord__sstabletest12.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn("value", 1, SSTableColumnType::FLOAT);
+  schema.addColumn("count", 2, SSTableColumnType::UINT64);
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest12.sstable",
+        header.data(),
+        header.size());
+
+    for (int i = 0; i < 100; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addFloatColumn(1, (i % 2 ? -1 : 1) * i * 1.5);
+      cols.addUInt64Column(2, (i * 37) % 100);
+
+      auto key = StringUtil::format("key$0", i);
+      tbl->appendRow(key.data(), key.size(), cols.data(), cols.size());
+    }
+
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  SSTableReader tbl(String("/tmp/__fnord__sstabletest12.sstable"));
+  SSTableColumnSchema schema2;
+  schema2.loadIndex(&tbl);
+
+  auto run = [&] (const String& column, const String& order_fn) {
+    SSTableScan scan(&schema2);
+    scan.setOrderBy(column, order_fn);
+
+    Vector<double> values;
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&values] (const Vector<String>& row) {
+      values.emplace_back(std::stod(row[1]));
+    });
+
+    return values;
+  };
+
+  auto by_value = run("value", "NUMDSC");
+  EXPECT_EQ(by_value.size(), 100);
+  EXPECT_EQ(by_value.front(), 98 * 1.5);
+  EXPECT_EQ(by_value.back(), -99 * 1.5);
+  for (int i = 1; i < by_value.size(); ++i) {
+    EXPECT_TRUE(by_value[i - 1] >= by_value[i]);
+  }
+
+  auto by_count = run("count", "NUMASC");
+  EXPECT_EQ(by_count.size(), 100);
+  EXPECT_EQ(by_count.front(), 0);
+  EXPECT_EQ(by_count.back(), -27 * 1.5);
+});
+
+TEST_CASE(SSTableTest, TestParallelSort, [] () {
+  auto run = [] (size_t memory_limit, size_t num_threads) {
+    SSTableExternalSort sort(
+        [] (const String& a, const String& b) {
+          return a < b;
+        },
+        memory_limit,
+        "/tmp");
+
+    sort.setParallelSort(1, num_threads);
+
+    for (uint64_t i = 0; i < 10007; ++i) {
+      String sort_key;
+      SSTableColumnCodec::encodeSortKey((i * 7919) % 10007, &sort_key);
+
+      Vector<String> row;
+      row.emplace_back(StringUtil::toString((i * 7919) % 10007));
+      sort.addRow(std::move(sort_key), std::move(row));
+    }
+
+    Vector<String> sorted;
+    sort.execute([&sorted] (const Vector<String>& row) {
+      sorted.emplace_back(row[0]);
+    });
+
+    return sorted;
+  };
+
+  auto single = run(0, 1);
+  auto parallel = run(0, 4);
+  auto parallel_spilled = run(64 * 1024, 3);
+
+  EXPECT_EQ(single.size(), 10007);
+  EXPECT_EQ(parallel.size(), 10007);
+  EXPECT_EQ(parallel_spilled.size(), 10007);
+  for (int i = 0; i < single.size(); ++i) {
+    EXPECT_EQ(single[i], StringUtil::toString(i));
+    EXPECT_EQ(parallel[i], single[i]);
+    EXPECT_EQ(parallel_spilled[i], single[i]);
+  }
+
+  /* scans only call custom order functions from multiple threads if
+     parallel sort was enabled explicitly */
+  FileUtil::rm("/tmp/__fnord__sstabletest28.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn("value", 1, SSTableColumnType::UINT64);
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest28.sstable",
+        header.data(),
+        header.size());
+
+    for (uint64_t i = 0; i < 10007; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, (i * 7919) % 10007);
+
+      auto key = StringUtil::format("key$0", i);
+      tbl->appendRow(key.data(), key.size(), cols.data(), cols.size());
+    }
+
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  SSTableReader tbl(String("/tmp/__fnord__sstabletest28.sstable"));
+  std::atomic<int> num_callers(0);
+  std::atomic<bool> concurrent(false);
+  auto custom_fn = [&] (const String& a, const String& b) {
+    if (++num_callers > 1) {
+      concurrent = true;
+    }
+
+    auto result = std::stoull(a) < std::stoull(b);
+    --num_callers;
+    return result;
+  };
+
+  for (size_t num_threads : Vector<size_t>{ 0, 4 }) {
+    SSTableScan scan(&schema);
+    scan.setOrderBy("value", custom_fn);
+    scan.setParallelSort(1, num_threads);
+
+    Vector<String> values;
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&values] (const Vector<String>& row) {
+      values.emplace_back(row[1]);
+    });
+
+    EXPECT_EQ(values.size(), 10007);
+    EXPECT_EQ(values.front(), "0");
+    EXPECT_EQ(values.back(), "10006");
+
+    if (num_threads == 0) {
+      EXPECT_FALSE(concurrent.load());
+    }
+  }
+});
+
+TEST_CASE(SSTableTest, TestKeyRangeScan, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest13.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn("value", 1, SSTableColumnType::UINT64);
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest13.sstable",
+        header.data(),
+        header.size());
+
+    SSTableKeyIndex key_index(256);
+    for (int i = 0; i < 1000; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i);
+
+      auto key = "key" + StringUtil::format("$0", 10000 + i).substr(1);
+      auto pos = tbl->appendRow(
+          key.data(),
+          key.size(),
+          cols.data(),
+          cols.size());
+      key_index.addRow(pos, key.data(), key.size());
+    }
+
+    String odd_key("a.b");
+    odd_key += (char) 0xff;
+    odd_key += (char) 0xff;
+
+    SSTableColumnWriter cols(&schema);
+    cols.addUInt64Column(1, 1000);
+    auto pos = tbl->appendRow(
+        odd_key.data(),
+        odd_key.size(),
+        cols.data(),
+        cols.size());
+    key_index.addRow(pos, odd_key.data(), odd_key.size());
+
+    EXPECT_FALSE(key_index.isSorted());
+    EXPECT_TRUE(key_index.numEntries() > 1);
+
+    schema.writeIndex(tbl.get());
+    key_index.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  SSTableReader tbl(String("/tmp/__fnord__sstabletest13.sstable"));
+  SSTableColumnSchema schema2;
+  schema2.loadIndex(&tbl);
+
+  SSTableKeyIndex key_index;
+  key_index.loadIndex(&tbl);
+  EXPECT_FALSE(key_index.isSorted());
+
+  auto run = [&] (const String& begin, const String& end, bool prefix) {
+    SSTableScan scan(&schema2);
+    scan.setKeyIndex(&key_index);
+    if (prefix) {
+      scan.setKeyPrefix(begin);
+    } else {
+      scan.setKeyRange(begin, end);
+    }
+
+    Vector<String> keys;
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&keys] (const Vector<String>& row) {
+      keys.emplace_back(row[0]);
+    });
+
+    return keys;
+  };
+
+  EXPECT_EQ(run("key01", "", true).size(), 100);
+  EXPECT_EQ(run("key050", "", true).size(), 10);
+  EXPECT_EQ(run("key", "", true).size(), 1000);
+  EXPECT_EQ(run("a.b", "", true).size(), 1);
+  EXPECT_EQ(run("a.", "", true).size(), 1);
+  EXPECT_EQ(run("ax", "", true).size(), 0);
+  EXPECT_EQ(run(String("a.b") + (char) 0xff, "", true).size(), 1);
+  EXPECT_EQ(run("key0500", "key0510", false).size(), 10);
+  EXPECT_EQ(run("key0995", "", false).size(), 5);
+  EXPECT_EQ(run("", "key0010", false).size(), 11);
+
+  /* a prefix and a range are intersected */
+  auto run_both = [&] (
+      const String& prefix,
+      const String& begin,
+      const String& end) {
+    SSTableScan scan(&schema2);
+    scan.setKeyIndex(&key_index);
+    scan.setKeyPrefix(prefix);
+    scan.setKeyRange(begin, end);
+
+    Vector<String> keys;
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&keys] (const Vector<String>& row) {
+      keys.emplace_back(row[0]);
+    });
+
+    return keys;
+  };
+
+  auto both = run_both("key05", "key0550", "key0700");
+  EXPECT_EQ(both.size(), 50);
+  EXPECT_EQ(both.front(), "key0550");
+  EXPECT_EQ(both.back(), "key0599");
+  EXPECT_EQ(run_both("key05", "", "key0510").size(), 10);
+  EXPECT_EQ(run_both("key05", "key0700", "").size(), 0);
+  EXPECT_EQ(run_both("key05", "", "").size(), 100);
+
+  /* a sorted PAX table: prefix scans seek to the first block */
+  FileUtil::rm("/tmp/__fnord__sstabletest14.sstable");
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest14.sstable",
+        header.data(),
+        header.size());
+
+    SSTableKeyIndex key_index;
+    PAXWriter pax(tbl.get(), &schema, PAXWriter::kDefaultMaxBlockSize, 100);
+    pax.setKeyIndex(&key_index);
+
+    for (int i = 0; i < 1000; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i);
+      pax.appendRow(StringUtil::format("key$0", 1000 + i), cols);
+    }
+
+    pax.flush();
+    EXPECT_TRUE(key_index.isSorted());
+    EXPECT_EQ(key_index.numEntries(), 10);
+
+    schema.writeIndex(tbl.get());
+    key_index.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  SSTableReader pax_tbl(String("/tmp/__fnord__sstabletest14.sstable"));
+  SSTableKeyIndex pax_key_index;
+  pax_key_index.loadIndex(&pax_tbl);
+  EXPECT_TRUE(pax_key_index.isSorted());
+  EXPECT_EQ(pax_key_index.lowerBound("key1000"), 0);
+  EXPECT_TRUE(pax_key_index.lowerBound("key1550") > 0);
+
+  SSTableScan scan(&schema2);
+  scan.setKeyIndex(&pax_key_index);
+  scan.setKeyPrefix("key155");
+
+  Vector<String> values;
+  auto cursor = pax_tbl.getCursor();
+  scan.execute(cursor.get(), [&values] (const Vector<String>& row) {
+    values.emplace_back(row[1]);
+  });
+
+  EXPECT_EQ(values.size(), 10);
+  EXPECT_EQ(values.front(), "550");
+  EXPECT_EQ(values.back(), "559");
+});
+
+TEST_CASE(SSTableTest, TestKeyMatcher, [] () {
+  Vector<String> patterns;
+  patterns.emplace_back("key1.*");
+  patterns.emplace_back("^key[0-9]+$");
+  patterns.emplace_back("key(1|22|333)");
+  patterns.emplace_back("k(?:e|x)y\\d{2,3}");
+  patterns.emplace_back("[^a-j]+");
+  patterns.emplace_back("a.b\\.c");
+  patterns.emplace_back("(ab|a)*c?");
+  patterns.emplace_back("\\w+-\\s?\\W");
+  patterns.emplace_back("x{3}|y{0,2}z");
+  patterns.emplace_back("");
+  patterns.emplace_back("[a\\-z]+");
+  patterns.emplace_back(".*foo.*");
+
+  Vector<String> keys;
+  keys.emplace_back("");
+  keys.emplace_back("key");
+  keys.emplace_back("key1");
+  keys.emplace_back("key22");
+  keys.emplace_back("key333");
+  keys.emplace_back("key3333");
+  keys.emplace_back("kxy12");
+  keys.emplace_back("key1234");
+  keys.emplace_back("klm");
+  keys.emplace_back("axb.c");
+  keys.emplace_back("axbxc");
+  keys.emplace_back("ababac");
+  keys.emplace_back("abba");
+  keys.emplace_back("foo_1- !");
+  keys.emplace_back("foo- a");
+  keys.emplace_back("xxx");
+  keys.emplace_back("yyz");
+  keys.emplace_back("z");
+  keys.emplace_back("a-z-a");
+  keys.emplace_back("a\nb.c");
+  keys.emplace_back("barfoobar");
+
+  for (const auto& p : patterns) {
+    SSTableKeyMatcher matcher(p);
+    std::regex re(p);
+
+    for (const auto& k : keys) {
+      EXPECT_EQ(
+          matcher.matches(k.data(), k.size()),
+          std::regex_match(k, re));
+    }
+  }
+
+  EXPECT_EQ(SSTableKeyMatcher("key1.*").literalPrefix(), "key1");
+  EXPECT_EQ(SSTableKeyMatcher("k(?:e|x)y").literalPrefix(), "k");
+  EXPECT_EQ(SSTableKeyMatcher("(abc|abd)x").literalPrefix(), "ab");
+  EXPECT_EQ(SSTableKeyMatcher("a{3}b+c").literalPrefix(), "aaab");
+  EXPECT_EQ(SSTableKeyMatcher("a?b").literalPrefix(), "");
+
+  Vector<String> multi;
+  multi.emplace_back("key1.*");
+  multi.emplace_back("key2.*");
+  multi.emplace_back("key22");
+  SSTableKeyMatcher multi_matcher(multi);
+  EXPECT_EQ(multi_matcher.literalPrefix(), "key");
+  EXPECT_EQ(multi_matcher.match("key1", 4), 0);
+  EXPECT_EQ(multi_matcher.match("key22", 5), 1);
+  EXPECT_EQ(multi_matcher.match("key3", 4), -1);
+  EXPECT_EQ(multi_matcher.match("ke", 2), -1);
+  EXPECT_TRUE(multi_matcher.isDFA());
+
+  /* patterns with too many DFA states are matched with the NFA */
+  Vector<String> complex;
+  complex.emplace_back(".*a.{12}");
+  complex.emplace_back("key.*b.{12}");
+  complex.emplace_back("(x|.*a.{11}b)c?");
+
+  Vector<String> complex_keys;
+  complex_keys.emplace_back("");
+  complex_keys.emplace_back("a123456789012");
+  complex_keys.emplace_back("a12345678901");
+  complex_keys.emplace_back("xxa123456789012");
+  complex_keys.emplace_back("a1234567890123");
+  complex_keys.emplace_back("aaaaaaaaaaaaaa");
+  complex_keys.emplace_back("keya123456789012");
+  complex_keys.emplace_back("keyxa123456789012");
+  complex_keys.emplace_back("keyxb12345678901x");
+  complex_keys.emplace_back("ba12345678901bc");
+  complex_keys.emplace_back("x");
+  complex_keys.emplace_back("xc");
+
+  for (const auto& p : complex) {
+    SSTableKeyMatcher matcher(p);
+    std::regex re(p);
+    EXPECT_FALSE(matcher.isDFA());
+
+    for (const auto& k : complex_keys) {
+      EXPECT_EQ(
+          matcher.matches(k.data(), k.size()),
+          std::regex_match(k, re));
+    }
+  }
+
+  SSTableKeyMatcher complex_matcher(complex);
+  EXPECT_FALSE(complex_matcher.isDFA());
+  EXPECT_EQ(complex_matcher.match("a123456789012", 13), 0);
+  EXPECT_EQ(complex_matcher.match("keya123456789012", 16), 0);
+  EXPECT_EQ(complex_matcher.match("keyxb123456789012", 17), 1);
+  EXPECT_EQ(complex_matcher.match("xc", 2), 2);
+  EXPECT_EQ(complex_matcher.match("a12345678901", 12), -1);
+
+  Vector<String> invalid;
+  invalid.emplace_back("(a)\\1");
+  invalid.emplace_back("*a");
+  invalid.emplace_back("a(?=b)");
+  invalid.emplace_back("a$b");
+  invalid.emplace_back("[abc");
+  invalid.emplace_back("a{2");
+
+  for (const auto& p : invalid) {
+    bool raised = false;
+    try {
+      SSTableKeyMatcher m(p);
+    } catch (const Exception& e) {
+      raised = true;
+    }
+
+    EXPECT_TRUE(raised);
+  }
+});
+
+TEST_CASE(SSTableTest, TestGroupByAggregates, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest15.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn("clicks", 1, SSTableColumnType::UINT64);
+  schema.addColumn("ctr", 2, SSTableColumnType::FLOAT);
+  schema.addColumn("name", 3, SSTableColumnType::STRING);
+  schema.addColumn(
+      "country",
+      4,
+      SSTableColumnType::STRING,
+      SSTableColumnEncoding::DICTIONARY);
+
+  Vector<String> countries;
+  countries.emplace_back("DE");
+  countries.emplace_back("US");
+  countries.emplace_back("FR");
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest15.sstable",
+        header.data(),
+        header.size());
+
+    for (int i = 0; i < 100; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i);
+      cols.addFloatColumn(2, i / 4.0);
+      cols.addStringColumn(3, StringUtil::format("name$0", i));
+      cols.addStringColumn(4, countries[i % countries.size()]);
+
+      auto key = StringUtil::format("key$0", i);
+      tbl->appendRow(key.data(), key.size(), cols.data(), cols.size());
+    }
+
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  SSTableReader tbl(String("/tmp/__fnord__sstabletest15.sstable"));
+  SSTableColumnSchema schema2;
+  schema2.loadIndex(&tbl);
+
+  Vector<Vector<String>> rows;
+  auto run = [&] (SSTableScan* scan) {
+    rows.clear();
+    auto cursor = tbl.getCursor();
+    scan->execute(cursor.get(), [&rows] (const Vector<String>& row) {
+      rows.emplace_back(row);
+    });
+  };
+
+  {
+    SSTableScan scan(&schema2);
+    scan.setGroupBy(Vector<String>{ "country" });
+    scan.addAggregate("count(*)");
+    scan.addAggregate("sum(clicks)");
+    scan.addAggregate("min(clicks)");
+    scan.addAggregate("MAX(name)");
+    scan.addAggregate("avg(ctr)");
+    run(&scan);
+
+    auto cols = scan.columnNames();
+    EXPECT_EQ(cols.size(), 6);
+    EXPECT_EQ(cols[0], "country");
+    EXPECT_EQ(cols[2], "sum(clicks)");
+
+    EXPECT_EQ(rows.size(), 3);
+    EXPECT_EQ(rows[0][0], "DE");
+    EXPECT_EQ(rows[0][1], "34");
+    EXPECT_EQ(rows[0][2], "1683");
+    EXPECT_EQ(rows[0][3], "0");
+    EXPECT_EQ(rows[0][4], "name99");
+    EXPECT_EQ(std::stod(rows[0][5]), 49.5 / 4.0);
+    EXPECT_EQ(rows[1][0], "US");
+    EXPECT_EQ(rows[1][1], "33");
+    EXPECT_EQ(rows[1][2], "1617");
+    EXPECT_EQ(rows[1][3], "1");
+    EXPECT_EQ(rows[2][0], "FR");
+    EXPECT_EQ(rows[2][2], "1650");
+  }
+
+  {
+    SSTableScan scan(&schema2);
+    scan.addAggregate("count(*)");
+    scan.addAggregate("sum(clicks)");
+    scan.addAggregate("max(clicks)");
+    scan.addAggregate("sum(ctr)");
+    run(&scan);
+
+    EXPECT_EQ(rows.size(), 1);
+    EXPECT_EQ(rows[0][0], "100");
+    EXPECT_EQ(rows[0][1], "4950");
+    EXPECT_EQ(rows[0][2], "99");
+    EXPECT_EQ(std::stod(rows[0][3]), 4950 / 4.0);
+
+    /* aggregates without a matching row still return one row */
+    SSTableScan empty_scan(&schema2);
+    empty_scan.addAggregate("count(*)");
+    empty_scan.addAggregate("min(clicks)");
+    empty_scan.addFilter(SSTableScanPredicate::parse("clicks > 1000"));
+    run(&empty_scan);
+
+    EXPECT_EQ(rows.size(), 1);
+    EXPECT_EQ(rows[0][0], "0");
+    EXPECT_EQ(rows[0][1], "");
+  }
+
+  {
+    SSTableScan scan(&schema2);
+    scan.setGroupBy(Vector<String>{ "country" });
+    scan.addAggregate("count(*)");
+    scan.addFilter(SSTableScanPredicate::parse("clicks < 10"));
+    scan.setOffset(1);
+    scan.setLimit(1);
+    run(&scan);
+
+    EXPECT_EQ(rows.size(), 1);
+    EXPECT_EQ(rows[0][0], "US");
+    EXPECT_EQ(rows[0][1], "3");
+  }
+
+  /* partial aggregates of two halves of the table are merged */
+  SSTableAggregator first(&schema2);
+  SSTableAggregator second(&schema2);
+  SSTableAggregator* aggrs[2];
+  aggrs[0] = &first;
+  aggrs[1] = &second;
+  for (auto aggr : aggrs) {
+    aggr->addGroupBy("country");
+    aggr->addAggregate(SSTableAggregator::Fn::SUM, "clicks");
+    aggr->addAggregate(SSTableAggregator::Fn::MIN, "clicks");
+    aggr->addAggregate(SSTableAggregator::Fn::AVG, "clicks");
+  }
+
+  auto cursor = tbl.getCursor();
+  for (int i = 0; cursor->valid(); ++i) {
+    auto key = cursor->getKeyString();
+    SSTableColumnReader cols(&schema2, cursor->getDataBuffer());
+    aggrs[i < 50 ? 0 : 1]->addRow(key.data(), key.size(), cols);
+    cursor->next();
+  }
+
+  EXPECT_EQ(first.numGroups(), 3);
+  first.merge(second);
+  EXPECT_EQ(first.numGroups(), 3);
+
+  rows.clear();
+  first.getResult([&rows] (const Vector<String>& row) {
+    rows.emplace_back(row);
+  });
+
+  EXPECT_EQ(rows.size(), 3);
+  EXPECT_EQ(rows[0][1], "1683");
+  EXPECT_EQ(rows[0][2], "0");
+  EXPECT_EQ(std::stod(rows[0][3]), 49.5);
+  EXPECT_EQ(rows[2][1], "1650");
+  EXPECT_EQ(rows[2][2], "2");
+
+  /* aggregates of a table with different dictionary codes (and column ids)
+     are merged by the dictionary values */
+  FileUtil::rm("/tmp/__fnord__sstabletest29.sstable");
+
+  SSTableColumnSchema other_schema;
+  other_schema.addColumn("clicks", 1, SSTableColumnType::UINT64);
+  other_schema.addColumn(
+      "country",
+      5,
+      SSTableColumnType::STRING,
+      SSTableColumnEncoding::DICTIONARY);
+
+  {
+    std::string header = "myfnordyheader!";
+    auto other_tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest29.sstable",
+        header.data(),
+        header.size());
+
+    for (int i = 0; i < 30; ++i) {
+      SSTableColumnWriter cols(&other_schema);
+      cols.addUInt64Column(1, i);
+      cols.addStringColumn(5, countries[countries.size() - 1 - i % 3]);
+
+      auto key = StringUtil::format("key$0", i);
+      other_tbl->appendRow(key.data(), key.size(), cols.data(), cols.size());
+    }
+
+    other_schema.writeIndex(other_tbl.get());
+    other_tbl->commit();
+  }
+
+  SSTableReader other_tbl(String("/tmp/__fnord__sstabletest29.sstable"));
+  SSTableColumnSchema other_schema2;
+  other_schema2.loadIndex(&other_tbl);
+
+  uint32_t de_code;
+  uint32_t other_de_code;
+  EXPECT_TRUE(schema2.lookupDictionaryCode(4, "DE", &de_code));
+  EXPECT_TRUE(other_schema2.lookupDictionaryCode(5, "DE", &other_de_code));
+  EXPECT_TRUE(de_code != other_de_code);
+
+  SSTableAggregator all(&schema2);
+  SSTableAggregator other(&other_schema2);
+  aggrs[0] = &all;
+  aggrs[1] = &other;
+  for (auto aggr : aggrs) {
+    aggr->addGroupBy("country");
+    aggr->addAggregate(SSTableAggregator::Fn::COUNT, "*");
+    aggr->addAggregate(SSTableAggregator::Fn::SUM, "clicks");
+  }
+
+  cursor = tbl.getCursor();
+  while (cursor->valid()) {
+    auto key = cursor->getKeyString();
+    SSTableColumnReader cols(&schema2, cursor->getDataBuffer());
+    all.addRow(key.data(), key.size(), cols);
+    cursor->next();
+  }
+
+  cursor = other_tbl.getCursor();
+  while (cursor->valid()) {
+    auto key = cursor->getKeyString();
+    SSTableColumnReader cols(&other_schema2, cursor->getDataBuffer());
+    other.addRow(key.data(), key.size(), cols);
+    cursor->next();
+  }
+
+  all.merge(other);
+  EXPECT_EQ(all.numGroups(), 3);
+
+  rows.clear();
+  all.getResult([&rows] (const Vector<String>& row) {
+    rows.emplace_back(row);
+  });
+
+  EXPECT_EQ(rows.size(), 3);
+  EXPECT_EQ(rows[0][0], "DE");
+  EXPECT_EQ(rows[0][1], "44");
+  EXPECT_EQ(rows[0][2], "1838");
+  EXPECT_EQ(rows[1][0], "US");
+  EXPECT_EQ(rows[1][1], "43");
+  EXPECT_EQ(rows[1][2], "1762");
+  EXPECT_EQ(rows[2][0], "FR");
+  EXPECT_EQ(rows[2][1], "43");
+  EXPECT_EQ(rows[2][2], "1785");
+
+  /* aggregators grouped by different columns can't be merged */
+  SSTableAggregator by_name(&schema2);
+  by_name.addGroupBy("name");
+  by_name.addAggregate(SSTableAggregator::Fn::COUNT, "*");
+  SSTableAggregator by_country(&schema2);
+  by_country.addGroupBy("country");
+  by_country.addAggregate(SSTableAggregator::Fn::COUNT, "*");
+
+  bool raised = false;
+  try {
+    by_name.merge(by_country);
+  } catch (const Exception& e) {
+    raised = true;
+  }
+
+  EXPECT_TRUE(raised);
+
+  raised = false;
+  try {
+    SSTableScan scan(&schema2);
+    scan.addAggregate("sum(name)");
+  } catch (const Exception& e) {
+    raised = true;
+  }
+
+  EXPECT_TRUE(raised);
+
+  raised = false;
+  try {
+    SSTableScan scan(&schema2);
+    scan.addAggregate("count(*)");
+    scan.setOrderBy("clicks", "NUMASC");
+    run(&scan);
+  } catch (const Exception& e) {
+    raised = true;
+  }
+
+  EXPECT_TRUE(raised);
+});
+
+TEST_CASE(SSTableTest, TestRowView, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest16.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn("count", 1, SSTableColumnType::UINT64);
+  schema.addColumn("ratio", 2, SSTableColumnType::FLOAT);
+  schema.addColumn("name", 3, SSTableColumnType::STRING);
+  schema.addColumn(
+      "country",
+      4,
+      SSTableColumnType::STRING,
+      SSTableColumnEncoding::DICTIONARY);
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest16.sstable",
+        header.data(),
+        header.size());
+
+    for (int i = 0; i < 10; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i * 10);
+      if (i % 2 == 0) {
+        cols.addFloatColumn(2, i / 4.0);
+      }
+      cols.addStringColumn(3, StringUtil::format("name$0", i));
+      cols.addStringColumn(4, i < 5 ? "DE" : "US");
+
+      auto key = StringUtil::format("key$0", i);
+      tbl->appendRow(key.data(), key.size(), cols.data(), cols.size());
+    }
+
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  SSTableReader tbl(String("/tmp/__fnord__sstabletest16.sstable"));
+  SSTableColumnSchema schema2;
+  schema2.loadIndex(&tbl);
+
+  {
+    SSTableScan scan(&schema2);
+    auto cols = scan.columnNames();
+    EXPECT_EQ(cols.size(), 5);
+    EXPECT_EQ(cols[1], "count");
+
+    size_t n = 0;
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&n] (const SSTableRowView& row) {
+      EXPECT_EQ(row.size(), 5);
+      EXPECT_TRUE(row.key() == StringUtil::format("key$0", n));
+      EXPECT_TRUE(row.getString(0) == StringUtil::format("key$0", n));
+      EXPECT_EQ(row.getUInt64(1), n * 10);
+      EXPECT_TRUE(row.getString(1) == StringUtil::toString(n * 10));
+      EXPECT_EQ(row.hasValue(2), n % 2 == 0);
+      if (n % 2 == 0) {
+        EXPECT_EQ(row.getFloat(2), n / 4.0);
+      }
+      EXPECT_TRUE(row.getString(3) == StringUtil::format("name$0", n));
+      EXPECT_EQ(row.getString(4).toString(), n < 5 ? "DE" : "US");
+      EXPECT_EQ(row.getFloat(1), n * 10.0);
+      ++n;
+    });
+
+    EXPECT_EQ(n, 10);
+  }
+
+  /* the row view and the Vector<String> rows return the same values */
+  {
+    SSTableScan scan(&schema2);
+    scan.addFilter(SSTableScanPredicate::parse("ratio >= 0"));
+
+    Vector<Vector<String>> rows;
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&rows] (const Vector<String>& row) {
+      rows.emplace_back(row);
+    });
+
+    Vector<Vector<String>> view_rows;
+    cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&view_rows] (const SSTableRowView& row) {
+      view_rows.emplace_back(row.toVector());
+    });
+
+    EXPECT_EQ(rows.size(), 5);
+    EXPECT_TRUE(rows == view_rows);
+    EXPECT_EQ(rows[2][3], "name4");
+  }
+
+  /* rows of ORDER BY scans are materialized */
+  {
+    SSTableScan scan(&schema2);
+    scan.setOrderBy("count", "NUMDSC");
+    scan.setLimit(3);
+
+    Vector<uint64_t> counts;
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&counts] (const SSTableRowView& row) {
+      EXPECT_EQ(row.key().size, 0);
+      counts.emplace_back(row.getUInt64(1));
+    });
+
+    EXPECT_EQ(counts.size(), 3);
+    EXPECT_EQ(counts[0], 90);
+    EXPECT_EQ(counts[2], 70);
+  }
+
+  /* without a schema, rows have the columns key and value */
+  {
+    SSTableScan scan;
+    size_t n = 0;
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&n] (const SSTableRowView& row) {
+      EXPECT_EQ(row.size(), 2);
+      EXPECT_TRUE(row.getString(0) == StringUtil::format("key$0", n));
+      EXPECT_TRUE(row.getString(1).size > 0);
+      ++n;
+    });
+
+    EXPECT_EQ(n, 10);
+  }
+});
+
+TEST_CASE(SSTableTest, TestSelectList, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest17.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn("clicks", 1, SSTableColumnType::UINT64);
+  schema.addColumn("name", 2, SSTableColumnType::STRING);
+  schema.addColumn("ctr", 3, SSTableColumnType::FLOAT);
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest17.sstable",
+        header.data(),
+        header.size());
+
+    PAXWriter pax(tbl.get(), &schema, PAXWriter::kDefaultMaxBlockSize, 10);
+    for (int i = 0; i < 50; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, (i * 7) % 50);
+      cols.addStringColumn(2, StringUtil::format("name$0", i));
+      cols.addFloatColumn(3, i / 2.0);
+      pax.appendRow(StringUtil::format("key$0", i), cols);
+    }
+
+    pax.flush();
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  SSTableReader tbl(String("/tmp/__fnord__sstabletest17.sstable"));
+  SSTableColumnSchema schema2;
+  schema2.loadIndex(&tbl);
+
+  Vector<String> select_list;
+  select_list.emplace_back("name");
+  select_list.emplace_back("_key");
+
+  {
+    SSTableScan scan(&schema2);
+    scan.setSelectList(select_list);
+
+    auto cols = scan.columnNames();
+    EXPECT_EQ(cols.size(), 2);
+    EXPECT_EQ(cols[0], "name");
+    EXPECT_EQ(cols[1], "_key");
+
+    /* the cursor only reads the chunks of the selected columns */
+    size_t n = 0;
+    auto cursor = tbl.getCursor();
+    auto cursor_ptr = cursor.get();
+    scan.execute(cursor.get(), [&] (const SSTableRowView& row) {
+      EXPECT_EQ(row.size(), 2);
+      EXPECT_TRUE(row.getString(0) == StringUtil::format("name$0", n));
+      EXPECT_TRUE(row.getString(1) == StringUtil::format("key$0", n));
+
+      SSTableColumnReader data(&schema2, cursor_ptr->getDataBuffer());
+      EXPECT_EQ(data.getStringColumn(2), StringUtil::format("name$0", n));
+
+      bool raised = false;
+      try {
+        data.getUInt64Column(1);
+      } catch (const Exception& e) {
+        raised = true;
+      }
+
+      EXPECT_TRUE(raised);
+      ++n;
+    });
+
+    EXPECT_EQ(n, 50);
+  }
+
+  /* filter and ORDER BY columns do not need to be selected */
+  {
+    SSTableScan scan(&schema2);
+    scan.setSelectList(select_list);
+    scan.addFilter(SSTableScanPredicate::parse("ctr >= 10"));
+    scan.setOrderBy("clicks", "NUMASC");
+    scan.setLimit(3);
+
+    Vector<Vector<String>> rows;
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&rows] (const Vector<String>& row) {
+      rows.emplace_back(row);
+    });
+
+    EXPECT_EQ(rows.size(), 3);
+    EXPECT_EQ(rows[0].size(), 2);
+    EXPECT_EQ(rows[0][1], "key43");
+    EXPECT_EQ(rows[1][1], "key36");
+    EXPECT_EQ(rows[2][0], "name29");
+  }
+
+  /* the column reader skips the values of unprojected columns */
+  {
+    SSTableColumnWriter writer(&schema2);
+    writer.addUInt64Column(1, 23);
+    writer.addStringColumn(2, "fnord");
+    writer.addFloatColumn(3, 1.5);
+
+    Set<SSTableColumnID> projection;
+    projection.emplace(3);
+
+    SSTableColumnReader reader(&schema2);
+    reader.setColumnProjection(projection);
+    reader.reset(writer.data(), writer.size());
+    EXPECT_EQ(reader.getFloatColumn(3), 1.5);
+
+    bool raised = false;
+    try {
+      reader.getStringColumn(2);
+    } catch (const Exception& e) {
+      raised = true;
+    }
+
+    EXPECT_TRUE(raised);
+  }
+
+  bool raised = false;
+  try {
+    SSTableScan scan(&schema2);
+    Vector<String> invalid;
+    invalid.emplace_back("fnord");
+    scan.setSelectList(invalid);
+  } catch (const Exception& e) {
+    raised = true;
+  }
+
+  EXPECT_TRUE(raised);
+});
+
+TEST_CASE(SSTableTest, TestScanStats, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest18.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn("time", 1, SSTableColumnType::UINT64);
+  schema.addColumn("host", 2, SSTableColumnType::STRING);
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest18.sstable",
+        header.data(),
+        header.size());
+
+    SSTableZoneMap zone_map(&schema);
+    PAXWriter pax(tbl.get(), &schema, PAXWriter::kDefaultMaxBlockSize, 100);
+    pax.setZoneMap(&zone_map);
+
+    for (int i = 0; i < 1000; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i);
+      cols.addStringColumn(2, StringUtil::format("host$0", i % 4));
+      pax.appendRow(StringUtil::format("key$0", 1000 + i), cols);
+    }
+
+    pax.flush();
+    schema.writeIndex(tbl.get());
+    zone_map.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  SSTableReader tbl(String("/tmp/__fnord__sstabletest18.sstable"));
+  SSTableColumnSchema schema2;
+  schema2.loadIndex(&tbl);
+  SSTableZoneMap zone_map(&schema2);
+  zone_map.loadIndex(&tbl);
+
+  SSTableScan scan(&schema2);
+  scan.setZoneMap(&zone_map);
+  scan.setKeyRange("key1000", "key1500");
+  scan.setKeyFilterRegex("key1[0-9]*[02468]");
+  scan.addFilter(SSTableScanPredicate::parse("time >= 100"));
+  scan.addFilter(SSTableScanPredicate::parse("host = 'host0'"));
+  scan.setLimit(10);
+
+  /* the first zone is skipped; the 10th match is the 37th row scanned */
+  size_t n = 0;
+  auto cursor = tbl.getCursor();
+  scan.execute(cursor.get(), [&n] (const SSTableRowView& row) {
+    ++n;
+  });
+
+  const auto& stats = scan.stats();
+  EXPECT_EQ(n, 10);
+  EXPECT_EQ(stats.rows_emitted, 10);
+  EXPECT_EQ(stats.zones_skipped, 1);
+  EXPECT_EQ(stats.rows_scanned, 37);
+  EXPECT_EQ(stats.rows_in_key_range, 37);
+  EXPECT_EQ(stats.rows_key_matched, 37);
+  EXPECT_EQ(stats.rows_regex_matched, 19);
+  EXPECT_EQ(stats.filter_rows_matched.size(), 2);
+  EXPECT_EQ(stats.filter_rows_matched[0], 19);
+  EXPECT_EQ(stats.filter_rows_matched[1], 10);
+  EXPECT_EQ(stats.rows_filter_matched, 10);
+  EXPECT_EQ(stats.key_bytes_read, 37 * 7);
+  EXPECT_TRUE(stats.value_bytes_read > 0);
+
+  auto stats_str = stats.toString();
+  EXPECT_TRUE(stats_str.find("status=complete, rows_scanned=37, ") == 0);
+  EXPECT_TRUE(stats_str.find("filter1_rows_matched=10") != String::npos);
+
+  /* the stats are reset by every execute */
+  SSTableScan sorted_scan(&schema2);
+  sorted_scan.setOrderBy("time", "NUMDSC");
+  cursor = tbl.getCursor();
+  sorted_scan.execute(cursor.get(), [] (const SSTableRowView& row) {});
+  EXPECT_EQ(sorted_scan.stats().rows_scanned, 1000);
+  EXPECT_EQ(sorted_scan.stats().rows_emitted, 1000);
+  EXPECT_EQ(sorted_scan.stats().zones_skipped, 0);
+
+  cursor = tbl.getCursor();
+  sorted_scan.execute(cursor.get(), [] (const SSTableRowView& row) {});
+  EXPECT_EQ(sorted_scan.stats().rows_scanned, 1000);
+});
+
+TEST_CASE(SSTableTest, TestScanDeadlineAndCancellation, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest19.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn("value", 1, SSTableColumnType::UINT64);
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest19.sstable",
+        header.data(),
+        header.size());
+
+    for (int i = 0; i < 10000; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i);
+
+      auto key = StringUtil::format("key$0", i);
+      tbl->appendRow(key.data(), key.size(), cols.data(), cols.size());
+    }
+
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  SSTableReader tbl(String("/tmp/__fnord__sstabletest19.sstable"));
+  SSTableColumnSchema schema2;
+  schema2.loadIndex(&tbl);
+
+  {
+    std::atomic<bool> cancelled(false);
+    SSTableScan scan(&schema2);
+    scan.setCancellationToken(&cancelled);
+    scan.setCheckInterval(100);
+
+    size_t n = 0;
+    auto cursor = tbl.getCursor();
+    auto status = scan.execute(cursor.get(), [&] (const SSTableRowView& row) {
+      if (++n == 10) {
+        cancelled = true;
+      }
+    });
+
+    EXPECT_TRUE(status == SSTableScanStatus::CANCELLED);
+    EXPECT_TRUE(scan.stats().status == SSTableScanStatus::CANCELLED);
+    EXPECT_EQ(n, 99);
+  }
+
+  /* the partial result of an ORDER BY scan contains the rows read before the
+     deadline passed */
+  {
+    SSTableScan scan(&schema2);
+    scan.setDeadline(1);
+    scan.setCheckInterval(100);
+    scan.setOrderBy("value", "NUMDSC");
+    scan.setLimit(5);
+
+    Vector<String> values;
+    auto cursor = tbl.getCursor();
+    auto status = scan.execute(
+        cursor.get(),
+        [&values] (const Vector<String>& row) {
+      values.emplace_back(row[1]);
+    });
+
+    EXPECT_TRUE(status == SSTableScanStatus::DEADLINE_EXCEEDED);
+    EXPECT_EQ(scan.stats().rows_scanned, 99);
+    EXPECT_EQ(values.size(), 5);
+    EXPECT_EQ(values[0], "98");
+    EXPECT_EQ(values[4], "94");
+    EXPECT_TRUE(
+        scan.stats().toString().find("status=deadline_exceeded") == 0);
+  }
+
+  {
+    SSTableScan scan(&schema2);
+    scan.setDeadline(WallClock::unixMicros() + 3600000000ull);
+
+    size_t n = 0;
+    auto cursor = tbl.getCursor();
+    auto status = scan.execute(cursor.get(), [&n] (const SSTableRowView& row) {
+      ++n;
+    });
+
+    EXPECT_TRUE(status == SSTableScanStatus::COMPLETE);
+    EXPECT_EQ(n, 10000);
+  }
+});
+
+TEST_CASE(SSTableTest, TestSampledScan, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest20.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn("value", 1, SSTableColumnType::UINT64);
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest20.sstable",
+        header.data(),
+        header.size());
+
+    SSTableZoneMap zone_map(&schema);
+    PAXWriter pax(tbl.get(), &schema, PAXWriter::kDefaultMaxBlockSize, 100);
+    pax.setZoneMap(&zone_map);
+
+    for (int i = 0; i < 1000; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i);
+      pax.appendRow(StringUtil::format("key$0", 1000 + i), cols);
+    }
+
+    pax.flush();
+    schema.writeIndex(tbl.get());
+    zone_map.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  SSTableReader tbl(String("/tmp/__fnord__sstabletest20.sstable"));
+  SSTableColumnSchema schema2;
+  schema2.loadIndex(&tbl);
+  SSTableZoneMap zone_map(&schema2);
+  zone_map.loadIndex(&tbl);
+
+  auto scan_values = [&] (SSTableScan* scan) -> Vector<uint64_t> {
+    Vector<uint64_t> values;
+    auto cursor = tbl.getCursor();
+    scan->execute(cursor.get(), [&values] (const SSTableRowView& row) {
+      values.emplace_back(row.getUInt64(1));
+    });
+
+    return values;
+  };
+
+  /* random block samples are deterministic under the seed and read whole
+     blocks of 100 rows */
+  {
+    SSTableScan scan(&schema2);
+    scan.setSample(0.3, SSTableSampler::Method::RANDOM,
+        SSTableSampler::Unit::BLOCK, 42);
+
+    auto values = scan_values(&scan);
+    EXPECT_EQ(values.size() % 100, 0);
+    EXPECT_EQ(scan.stats().sample_units, 10);
+    EXPECT_EQ(scan.stats().sample_units_read * 100, values.size());
+    EXPECT_EQ(scan.stats().rows_scanned, values.size());
+    EXPECT_TRUE(scan.stats().sample_rate == 0.3);
+
+    EXPECT_TRUE(scan_values(&scan) == values);
+
+    /* the zone map samples the same blocks without reading the others */
+    scan.setZoneMap(&zone_map);
+    EXPECT_TRUE(scan_values(&scan) == values);
+  }
+
+  /* systematic block samples read every n-th block */
+  {
+    SSTableScan scan(&schema2);
+    scan.setZoneMap(&zone_map);
+    scan.setSample(0.25, SSTableSampler::Method::SYSTEMATIC,
+        SSTableSampler::Unit::BLOCK, 1);
+
+    auto values = scan_values(&scan);
+    EXPECT_EQ(values.size(), 300);
+    EXPECT_EQ(values[0], 100);
+    EXPECT_EQ(values[100], 500);
+    EXPECT_EQ(values[299], 999);
+    EXPECT_EQ(scan.stats().sample_units_read, 3);
+    EXPECT_TRUE(scan.stats().sample_rate == 0.25);
+  }
+
+  /* row samples */
+  {
+    SSTableScan scan(&schema2);
+    scan.setSample(0.1, SSTableSampler::Method::SYSTEMATIC,
+        SSTableSampler::Unit::ROW);
+    scan.addAggregate("count(*)");
+    scan.addAggregate("sum(value)");
+
+    Vector<String> result;
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&result] (const Vector<String>& row) {
+      result = row;
+    });
+
+    EXPECT_EQ(result[0], "100");
+    EXPECT_EQ(result[1], "49500");
+    EXPECT_EQ(scan.stats().sample_units, 1000);
+    EXPECT_EQ(scan.stats().rows_scanned, 100);
+  }
+
+  {
+    bool raised = false;
+    try {
+      SSTableScan scan(&schema2);
+      scan.setSample(0);
+    } catch (const Exception& e) {
+      raised = true;
+    }
+
+    EXPECT_TRUE(raised);
+  }
+});
+
+TEST_CASE(SSTableTest, TestApproximateAggregates, [] () {
+  SSTableHyperLogLog hll1;
+  SSTableHyperLogLog hll2;
+  EXPECT_EQ(hll1.estimate(), 0);
+  EXPECT_EQ(hll1.memoryUsage(), 0);
+
+  for (uint64_t i = 0; i < 100000; ++i) {
+    hll1.add(SSTableHyperLogLog::hash(i));
+    hll1.add(SSTableHyperLogLog::hash(i));
+    hll2.add(SSTableHyperLogLog::hash(i + 50000));
+  }
+
+  EXPECT_TRUE(hll1.estimate() > 95000 && hll1.estimate() < 105000);
+  EXPECT_EQ(hll1.memoryUsage(), 4096);
+
+  hll1.merge(hll2);
+  EXPECT_TRUE(hll1.estimate() > 142500 && hll1.estimate() < 157500);
+
+  {
+    Buffer buf;
+    hll1.encode(&buf);
+    SSTableHyperLogLog hll3;
+    hll3.decode(buf);
+    EXPECT_EQ(hll3.estimate(), hll1.estimate());
+  }
+
+  SSTableQuantileSketch qs1;
+  SSTableQuantileSketch qs2;
+  for (uint64_t i = 0; i < 100000; ++i) {
+    qs1.add((i * 7919) % 100000);
+    qs2.add(100000 + i);
+  }
+
+  EXPECT_EQ(qs1.count(), 100000);
+  EXPECT_TRUE(qs1.numRetained() < 3 * SSTableQuantileSketch::kDefaultK);
+  EXPECT_TRUE(fabs(qs1.quantile(0.5) - 50000) < 2000);
+  EXPECT_TRUE(fabs(qs1.quantile(0.99) - 99000) < 2000);
+  EXPECT_EQ(qs1.quantile(0), 0);
+  EXPECT_EQ(qs1.quantile(1), 99999);
+
+  qs1.merge(qs2);
+  EXPECT_EQ(qs1.count(), 200000);
+  EXPECT_TRUE(fabs(qs1.quantile(0.5) - 100000) < 4000);
+  EXPECT_TRUE(fabs(qs1.quantile(0.9) - 180000) < 4000);
+
+  {
+    Buffer buf;
+    qs1.encode(&buf);
+    SSTableQuantileSketch qs3;
+    qs3.decode(buf);
+    EXPECT_EQ(qs3.count(), qs1.count());
+    EXPECT_EQ(qs3.quantile(0.9), qs1.quantile(0.9));
+  }
+
+  SSTableColumnSchema schema;
+  schema.addColumn("host", 1, SSTableColumnType::STRING);
+  schema.addColumn("user", 2, SSTableColumnType::UINT64);
+  schema.addColumn("latency", 3, SSTableColumnType::FLOAT);
+
+  /* two partial aggregations over 10000 rows each */
+  Vector<std::unique_ptr<SSTableAggregator>> partials;
+  for (int p = 0; p < 2; ++p) {
+    partials.emplace_back(new SSTableAggregator(&schema));
+    partials.back()->addGroupBy("host");
+    partials.back()->addAggregate("count_distinct(user)");
+    partials.back()->addAggregate("quantile(latency, 0.9)");
+    partials.back()->addAggregate("count_distinct(host)");
+
+    for (int i = 0; i < 10000; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addStringColumn(1, StringUtil::format("host$0", i % 2));
+      cols.addUInt64Column(2, (p * 10000 + i) % 15000);
+      cols.addFloatColumn(3, i / 100.0);
+
+      SSTableColumnReader row(&schema, Buffer(cols.data(), cols.size()));
+      partials.back()->addRow("key", 3, row);
+    }
+  }
+
+  partials[0]->merge(*partials[1]);
+
+  auto names = partials[0]->columnNames();
+  EXPECT_EQ(names[1], "count_distinct(user)");
+  EXPECT_EQ(names[2].substr(0, 18), "quantile(latency, ");
+
+  Vector<Vector<String>> rows;
+  partials[0]->getResult([&rows] (const Vector<String>& row) {
+    rows.emplace_back(row);
+  });
+
+  EXPECT_EQ(rows.size(), 2);
+  EXPECT_EQ(rows[0][0], "host0");
+  auto users = std::stoull(rows[0][1]);
+  EXPECT_TRUE(users > 7125 && users < 7875);
+  EXPECT_TRUE(fabs(std::stod(rows[0][2]) - 90) < 2);
+  EXPECT_EQ(rows[0][3], "1");
+
+  {
+    bool raised = false;
+    try {
+      SSTableAggregator aggr(&schema);
+      aggr.addAggregate("quantile(host, 0.5)");
+    } catch (const Exception& e) {
+      raised = true;
+    }
+
+    EXPECT_TRUE(raised);
+  }
+});
+
+TEST_CASE(SSTableTest, TestResultWriter, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest21.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn("name", 1, SSTableColumnType::STRING);
+  schema.addColumn("count", 2, SSTableColumnType::UINT64);
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest21.sstable",
+        header.data(),
+        header.size());
+
+    for (int i = 0; i < 2000; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addStringColumn(1, StringUtil::format("name \"$0\"\n", i));
+      cols.addUInt64Column(2, i);
+
+      auto key = StringUtil::format("key$0", i);
+      tbl->appendRow(key.data(), key.size(), cols.data(), cols.size());
+    }
+
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  SSTableReader tbl(String("/tmp/__fnord__sstabletest21.sstable"));
+  SSTableColumnSchema schema2;
+  schema2.loadIndex(&tbl);
+
+  /* the output is flushed in pieces of about flush_size bytes while the
+     scan is running */
+  {
+    SSTableScan scan(&schema2);
+    Vector<String> chunks;
+    Vector<uint64_t> rows_at_flush;
+    SSTableResultWriter* writer_ptr = nullptr;
+
+    SSTableResultWriter writer(
+        SSTableResultWriter::Format::CSV,
+        scan.columnNames(),
+        [&] (const String& data) {
+          chunks.emplace_back(data);
+          rows_at_flush.emplace_back(writer_ptr->numRows());
+        },
+        1024);
+    writer_ptr = &writer;
+
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&writer] (const SSTableRowView& row) {
+      writer.addRow(row);
+    });
+
+    writer.finish();
+    writer.flush();
+
+    EXPECT_TRUE(chunks.size() > 10);
+    EXPECT_TRUE(rows_at_flush[0] < 100);
+    EXPECT_TRUE(writer.buffer().empty());
+    EXPECT_EQ(writer.numRows(), 2000);
+
+    String body;
+    for (const auto& c : chunks) {
+      EXPECT_TRUE(c.size() < 1024 + 64);
+      body += c;
+    }
+
+    EXPECT_EQ(writer.numBytes(), body.size());
+    String expected = "_key;name;count\nkey0;name \"0\"\n;0\nkey1;";
+    EXPECT_EQ(body.substr(0, expected.size()), expected);
+  }
+
+  /* small results are not flushed until flush() is called */
+  {
+    SSTableScan scan(&schema2);
+    scan.setLimit(2);
+
+    size_t flushes = 0;
+    SSTableResultWriter writer(
+        SSTableResultWriter::Format::JSON,
+        scan.columnNames(),
+        [&flushes] (const String& data) { ++flushes; });
+
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&writer] (const SSTableRowView& row) {
+      writer.addRow(row);
+    });
+
+    writer.finish();
+
+    EXPECT_EQ(flushes, 0);
+    EXPECT_EQ(
+        writer.buffer(),
+        "[{\"_key\":\"key0\",\"name\":\"name \\\"0\\\"\\n\",\"count\":\"0\"},"
+        "{\"_key\":\"key1\",\"name\":\"name \\\"1\\\"\\n\",\"count\":\"1\"}]");
+  }
+});
+
+class SSTableTestVFS : public VFS {
+public:
+  RefPtr<VFSFile> openFile(const String& filename) override {
+    return new io::MmappedFile(File::openFile(filename, File::O_READ));
+  }
+
+  bool exists(const String& filename) override {
+    return FileUtil::exists(filename);
+  }
+};
+
+/**
+ * Opens the files in /tmp by their file name
+ */
+class SSTableTestMappedVFS : public VFS {
+public:
+  RefPtr<VFSFile> openFile(const String& filename) override {
+    return new io::MmappedFile(
+        File::openFile(FileUtil::joinPaths("/tmp", filename), File::O_READ));
+  }
+
+  bool exists(const String& filename) override {
+    return FileUtil::exists(FileUtil::joinPaths("/tmp", filename));
+  }
+};
+
+TEST_CASE(SSTableTest, TestReaderCache, [] () {
+  String path = "/tmp/__fnord__sstabletest22.sstable";
+
+  auto write_table = [&] (size_t num_rows) {
+    FileUtil::rm(path);
+
+    SSTableColumnSchema schema;
+    schema.addColumn("value", 1, SSTableColumnType::UINT64);
+
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(path, header.data(), header.size());
+
+    SSTableKeyIndex key_index(64);
+    for (size_t i = 0; i < num_rows; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i);
+
+      auto key = StringUtil::format("key$0", 1000 + i);
+      auto pos = tbl->appendRow(
+          key.data(),
+          key.size(),
+          cols.data(),
+          cols.size());
+
+      key_index.addRow(pos, key.data(), key.size());
+    }
+
+    schema.writeIndex(tbl.get());
+    key_index.writeIndex(tbl.get());
+    tbl->commit();
+  };
+
+  auto count_rows = [] (const SSTableReaderCache::Table* table) -> size_t {
+    SSTableScan scan(table->schema());
+    scan.setKeyIndex(table->keyIndex());
+
+    size_t rows = 0;
+    auto reader = table->openReader();
+    auto cursor = reader->getCursor();
+    scan.execute(cursor.get(), [&rows] (const SSTableRowView& row) {
+      ++rows;
+    });
+
+    return rows;
+  };
+
+  write_table(100);
+
+  SSTableTestVFS vfs;
+  SSTableReaderCache cache(&vfs, 2);
+
+  auto table = cache.get(path);
+  EXPECT_EQ(table->path(), path);
+  EXPECT_TRUE(table->keyIndex() != nullptr);
+  EXPECT_TRUE(table->zoneMap() == nullptr);
+  EXPECT_EQ(count_rows(table.get()), 100);
+  EXPECT_EQ(cache.numMisses(), 1);
+
+  /* the cached table is returned until the file changes */
+  EXPECT_TRUE(cache.get(path) == table);
+  EXPECT_EQ(cache.numHits(), 1);
+  EXPECT_EQ(cache.size(), 1);
+
+  write_table(200);
+  auto table2 = cache.get(path);
+  EXPECT_TRUE(table2 != table);
+  EXPECT_EQ(cache.numInvalidations(), 1);
+  EXPECT_EQ(cache.size(), 1);
+  EXPECT_EQ(count_rows(table2.get()), 200);
+
+  /* the old table stays valid while it is referenced */
+  EXPECT_EQ(count_rows(table.get()), 100);
+
+  /* the least recently used table is evicted */
+  String path2 = "/tmp/./__fnord__sstabletest22.sstable";
+  String path3 = "/tmp/../tmp/__fnord__sstabletest22.sstable";
+  cache.get(path2);
+  cache.get(path);
+  cache.get(path3);
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_EQ(cache.numEvictions(), 1);
+  EXPECT_TRUE(cache.get(path) == table2);
+
+  cache.invalidate(path);
+  EXPECT_EQ(cache.size(), 1);
+  EXPECT_TRUE(cache.get(path) != table2);
+
+  /* concurrent lookups share the cached table */
+  cache.clear();
+  auto cached = cache.get(path);
+  Vector<std::thread> threads;
+  std::atomic<size_t> shared(0);
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&] () {
+      for (int j = 0; j < 100; ++j) {
+        auto t = cache.get(path);
+        if (t == cached && count_rows(t.get()) == 200) {
+          ++shared;
+        }
+      }
+    });
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(shared.load(), 400);
+
+  /* files of VFSs that map paths to other files are found with the path
+     resolver */
+  SSTableTestMappedVFS mapped_vfs;
+  String name = "__fnord__sstabletest22.sstable";
+
+  bool raised = false;
+  try {
+    SSTableReaderCache unresolved_cache(&mapped_vfs);
+    unresolved_cache.get(name);
+  } catch (const Exception& e) {
+    raised = true;
+  }
+
+  EXPECT_TRUE(raised);
+
+  SSTableReaderCache mapped_cache(
+      &mapped_vfs,
+      SSTableReaderCache::kDefaultMaxEntries,
+      [] (const String& path) {
+        return FileUtil::joinPaths("/tmp", path);
+      });
+
+  auto mapped = mapped_cache.get(name);
+  EXPECT_EQ(count_rows(mapped.get()), 200);
+  EXPECT_TRUE(mapped_cache.get(name) == mapped);
+  EXPECT_EQ(mapped_cache.numHits(), 1);
+
+  SSTableReaderCache::FileIdentity identity;
+  EXPECT_TRUE(SSTableReaderCache::getFileIdentity(path, &identity));
+  EXPECT_TRUE(mapped->identity() == identity);
+
+  write_table(300);
+  EXPECT_TRUE(mapped_cache.get(name) != mapped);
+  EXPECT_EQ(count_rows(mapped_cache.get(name).get()), 300);
+
+  /* a resolver that returns another file is detected */
+  raised = false;
+  try {
+    SSTableReaderCache::loadTable(
+        &mapped_vfs,
+        name,
+        [] (const String& path) {
+          return String("/tmp/__fnord__sstabletest15.sstable");
+        });
+  } catch (const Exception& e) {
+    raised = true;
+  }
+
+  EXPECT_TRUE(raised);
+});
+
+TEST_CASE(SSTableTest, TestBinaryResultFormat, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest23.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn("name", 1, SSTableColumnType::STRING);
+  schema.addColumn("count", 2, SSTableColumnType::UINT64);
+  schema.addColumn("ratio", 3, SSTableColumnType::FLOAT);
+  schema.addColumn("id", 4, SSTableColumnType::UINT32);
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest23.sstable",
+        header.data(),
+        header.size());
+
+    for (int i = 0; i < 3000; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addStringColumn(1, StringUtil::format("name$0", i % 7));
+      cols.addUInt64Column(2, uint64_t(i) << 33);
+      if (i % 3 != 0) {
+        cols.addFloatColumn(3, i / 8.0);
+      }
+      cols.addUInt32Column(4, i);
+
+      auto key = StringUtil::format("key$0", i);
+      tbl->appendRow(key.data(), key.size(), cols.data(), cols.size());
+    }
+
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  SSTableReader tbl(String("/tmp/__fnord__sstabletest23.sstable"));
+  SSTableColumnSchema schema2;
+  schema2.loadIndex(&tbl);
+
+  /* encode the result of the scan and decode it from pieces of 7 bytes */
+  auto scan_binary = [&] (SSTableScan* scan) -> Vector<Vector<String>> {
+    SSTableResultReader reader;
+    Vector<Vector<String>> rows;
+    size_t batches = 0;
+
+    auto decode = [&] (const String& data) {
+      for (size_t i = 0; i < data.size(); i += 7) {
+        auto size = std::min(data.size() - i, size_t(7));
+        reader.addData(data.data() + i, size);
+        while (reader.nextBatch()) {
+          ++batches;
+          EXPECT_TRUE(reader.numRows() <= 100);
+          for (size_t r = 0; r < reader.numRows(); ++r) {
+            Vector<String> row;
+            for (size_t c = 0; c < reader.columnNames().size(); ++c) {
+              row.emplace_back(reader.getValueAsString(c, r));
+            }
+            rows.emplace_back(row);
+          }
+        }
+      }
+    };
+
+    SSTableResultWriter writer(
+        SSTableResultWriter::Format::BINARY,
+        scan->columnNames(),
+        scan->columnTypes(),
+        decode,
+        4096,
+        100);
+
+    auto cursor = tbl.getCursor();
+    scan->execute(cursor.get(), [&writer] (const SSTableRowView& row) {
+      writer.addRow(row);
+    });
+
+    writer.finish();
+    writer.flush();
+
+    EXPECT_TRUE(reader.isFinished());
+    EXPECT_TRUE(reader.columnNames() == scan->columnNames());
+    EXPECT_TRUE(reader.columnTypes() == scan->columnTypes());
+    EXPECT_EQ(reader.numRowsTotal(), rows.size());
+    EXPECT_EQ(batches, (rows.size() + 99) / 100);
+    return rows;
+  };
+
+  auto scan_strings = [&] (SSTableScan* scan) -> Vector<Vector<String>> {
+    Vector<Vector<String>> rows;
+    auto cursor = tbl.getCursor();
+    scan->execute(cursor.get(), [&rows] (const Vector<String>& row) {
+      rows.emplace_back(row);
+    });
+
+    return rows;
+  };
+
+  /* the binary result has the same values as the string result */
+  {
+    SSTableScan scan(&schema2);
+    auto rows = scan_binary(&scan);
+    EXPECT_EQ(rows.size(), 3000);
+    EXPECT_TRUE(rows == scan_strings(&scan));
+  }
+
+  /* aggregates and ORDER BY rows are typed by the scan */
+  {
+    auto aggregate = [] (SSTableScan* scan) {
+      scan->setGroupBy(Vector<String>{ "name" });
+      scan->addAggregate("count(*)");
+      scan->addAggregate("sum(id)");
+      scan->addAggregate("avg(ratio)");
+      scan->addAggregate("max(ratio)");
+    };
+
+    SSTableScan scan(&schema2);
+    aggregate(&scan);
+
+    auto types = scan.columnTypes();
+    EXPECT_EQ(types.size(), 5);
+    EXPECT_TRUE(types[0] == SSTableColumnType::STRING);
+    EXPECT_TRUE(types[1] == SSTableColumnType::UINT64);
+    EXPECT_TRUE(types[2] == SSTableColumnType::UINT64);
+    EXPECT_TRUE(types[3] == SSTableColumnType::FLOAT);
+    EXPECT_TRUE(types[4] == SSTableColumnType::FLOAT);
+
+    auto rows = scan_binary(&scan);
+    EXPECT_EQ(rows.size(), 7);
+    EXPECT_EQ(rows[0][1], "429");
+
+    SSTableScan string_scan(&schema2);
+    aggregate(&string_scan);
+    EXPECT_TRUE(rows == scan_strings(&string_scan));
+  }
+
+  {
+    SSTableScan scan(&schema2);
+    scan.setOrderBy("count", "NUMDSC");
+    scan.setLimit(250);
+
+    auto rows = scan_binary(&scan);
+    EXPECT_EQ(rows.size(), 250);
+    EXPECT_EQ(rows[0][4], "2999");
+    EXPECT_EQ(rows[2][4], "2997");
+    EXPECT_EQ(rows[2][3], "");
+    EXPECT_TRUE(rows == scan_strings(&scan));
+  }
+
+  /* typed accessors read the values without parsing */
+  {
+    SSTableScan scan(&schema2);
+    scan.setLimit(3);
+
+    String data;
+    SSTableResultWriter writer(
+        SSTableResultWriter::Format::BINARY,
+        scan.columnNames(),
+        scan.columnTypes(),
+        [&data] (const String& chunk) { data += chunk; });
+
+    auto cursor = tbl.getCursor();
+    scan.execute(cursor.get(), [&writer] (const SSTableRowView& row) {
+      writer.addRow(row);
+    });
+
+    writer.finish();
+    writer.flush();
+
+    SSTableResultReader reader;
+    reader.addData(data.data(), data.size());
+    EXPECT_TRUE(reader.nextBatch());
+    EXPECT_EQ(reader.numRows(), 3);
+    EXPECT_TRUE(reader.getString(0, 2) == "key2");
+    EXPECT_TRUE(reader.getString(1, 1) == "name1");
+    EXPECT_EQ(reader.getUInt64(2, 2), uint64_t(2) << 33);
+    EXPECT_FALSE(reader.hasValue(3, 0));
+    EXPECT_TRUE(reader.hasValue(3, 1));
+    EXPECT_TRUE(reader.getFloat(3, 1) == 0.125);
+    EXPECT_EQ(reader.getUInt32(4, 2), 2);
+    EXPECT_EQ(reader.getUInt64(4, 2), 2);
+
+    auto raised = false;
+    try {
+      reader.getUInt64(1, 0);
+    } catch (const std::exception& e) {
+      raised = true;
+    }
+    EXPECT_TRUE(raised);
+
+    EXPECT_FALSE(reader.nextBatch());
+    EXPECT_TRUE(reader.isFinished());
+  }
+
+  /* data that is not a binary result is rejected */
+  {
+    SSTableResultReader reader;
+    reader.addData("_key;name\n", 10);
+
+    auto raised = false;
+    try {
+      reader.nextBatch();
+    } catch (const std::exception& e) {
+      raised = true;
+    }
+    EXPECT_TRUE(raised);
+  }
+});
+
+TEST_CASE(SSTableTest, TestPointLookups, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest24.sstable");
+  FileUtil::rm("/tmp/__fnord__sstabletest25.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn("value", 1, SSTableColumnType::UINT64);
+
+  /* a row-oriented and a columnar table with the keys key10000..key29999 */
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest24.sstable",
+        header.data(),
+        header.size());
+
+    SSTableKeyIndex key_index(256);
+    SSTableBloomFilter bloom_filter;
+    for (int i = 0; i < 20000; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i);
+
+      auto key = StringUtil::format("key$0", 10000 + i);
+      auto pos = tbl->appendRow(
+          key.data(),
+          key.size(),
+          cols.data(),
+          cols.size());
+
+      key_index.addRow(pos, key.data(), key.size());
+      bloom_filter.addKey(key);
+    }
+
+    schema.writeIndex(tbl.get());
+    key_index.writeIndex(tbl.get());
+    bloom_filter.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest25.sstable",
+        header.data(),
+        header.size());
+
+    SSTableKeyIndex key_index;
+    SSTableBloomFilter bloom_filter;
+    PAXWriter pax(tbl.get(), &schema, PAXWriter::kDefaultMaxBlockSize, 100);
+    pax.setKeyIndex(&key_index);
+    pax.setBloomFilter(&bloom_filter);
+
+    for (int i = 0; i < 20000; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i);
+      pax.appendRow(StringUtil::format("key$0", 10000 + i), cols);
+    }
+
+    pax.flush();
+    schema.writeIndex(tbl.get());
+    key_index.writeIndex(tbl.get());
+    bloom_filter.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  for (int t = 24; t <= 25; ++t) {
+    auto path = StringUtil::format("/tmp/__fnord__sstabletest$0.sstable", t);
+    SSTableReader tbl(path);
+    SSTableColumnSchema schema2;
+    schema2.loadIndex(&tbl);
+    SSTableKeyIndex key_index;
+    key_index.loadIndex(&tbl);
+    SSTableBloomFilter bloom_filter;
+    bloom_filter.loadIndex(&tbl);
+    EXPECT_EQ(bloom_filter.numKeys(), 20000);
+
+    auto lookup = [&] (
+        const Set<String>& keys,
+        bool indexed,
+        SSTableScanStats* stats) -> Vector<Vector<String>> {
+      SSTableScan scan(&schema2);
+      scan.setKeyExactMatchFilter(keys);
+      if (indexed) {
+        scan.setKeyIndex(&key_index);
+        scan.setBloomFilter(&bloom_filter);
+      }
+
+      Vector<Vector<String>> rows;
+      auto cursor = tbl.getCursor();
+      scan.execute(cursor.get(), [&rows] (const Vector<String>& row) {
+        rows.emplace_back(row);
+      });
+
+      *stats = scan.stats();
+      return rows;
+    };
+
+    /* the keys are read in ascending order in one forward pass */
+    {
+      SSTableScanStats stats;
+      auto rows = lookup(
+          Set<String>{ "key29000", "key10500", "key20000", "key10500" },
+          true,
+          &stats);
+
+      EXPECT_EQ(rows.size(), 3);
+      EXPECT_EQ(rows[0][0], "key10500");
+      EXPECT_EQ(rows[0][1], "500");
+      EXPECT_EQ(rows[1][0], "key20000");
+      EXPECT_EQ(rows[2][0], "key29000");
+      EXPECT_EQ(rows[2][1], "19000");
+      EXPECT_EQ(stats.key_index_seeks, 3);
+      EXPECT_TRUE(stats.rows_scanned < 400);
+    }
+
+    /* keys that are not in the table are skipped by the bloom filter */
+    {
+      Set<String> keys;
+      for (int i = 0; i < 100; ++i) {
+        keys.emplace(StringUtil::format("nokey$0", i));
+      }
+
+      SSTableScanStats stats;
+      auto rows = lookup(keys, true, &stats);
+      EXPECT_EQ(rows.size(), 0);
+      EXPECT_TRUE(stats.keys_bloom_filtered >= 90);
+
+      rows = lookup(Set<String>{ "key5", "key99999" }, true, &stats);
+      EXPECT_EQ(rows.size(), 0);
+      if (stats.keys_bloom_filtered == 2) {
+        EXPECT_EQ(stats.rows_scanned, 0);
+      }
+    }
+
+    /* indexed lookups return the same rows as full scans */
+    {
+      Set<String> keys;
+      for (int i = 0; i < 21; ++i) {
+        keys.emplace(StringUtil::format("key$0", 9900 + i * 997));
+      }
+
+      SSTableScanStats stats;
+      SSTableScanStats full_stats;
+      auto rows = lookup(keys, true, &stats);
+      EXPECT_EQ(rows.size(), 20);
+      EXPECT_TRUE(rows == lookup(keys, false, &full_stats));
+      EXPECT_EQ(full_stats.rows_scanned, 20000);
+      EXPECT_TRUE(stats.rows_scanned < full_stats.rows_scanned / 10);
+    }
+  }
+
+  /* about 1% of the keys that were not added pass the filter */
+  {
+    SSTableBloomFilter bloom_filter;
+    for (int i = 0; i < 10000; ++i) {
+      bloom_filter.addKey(StringUtil::format("key$0", i));
+    }
+
+    Buffer buf;
+    bloom_filter.writeIndex(&buf);
+    EXPECT_EQ(bloom_filter.size(), 12500);
+
+    size_t false_positives = 0;
+    for (int i = 0; i < 10000; ++i) {
+      EXPECT_TRUE(bloom_filter.mayContain(StringUtil::format("key$0", i)));
+      if (bloom_filter.mayContain(StringUtil::format("other$0", i))) {
+        ++false_positives;
+      }
+    }
+
+    EXPECT_TRUE(false_positives < 200);
+
+    bloom_filter.addKey("key10000");
+    auto raised = false;
+    try {
+      bloom_filter.mayContain("key10000");
+    } catch (const std::exception& e) {
+      raised = true;
+    }
+    EXPECT_TRUE(raised);
+  }
+});
+
+TEST_CASE(SSTableTest, TestScanExecutor, [] () {
+  typedef SSTableScanExecutor::Priority Priority;
+
+  /* 2 threads, at most 2 queued tasks per priority, 1 low priority thread */
+  SSTableScanExecutor executor(2, 2, 1);
+  EXPECT_EQ(executor.numThreads(), 2);
+  EXPECT_EQ(executor.maxLowPriorityThreads(), 1);
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool open = false;
+  Vector<String> started;
+
+  auto task = [&] (const String& name) {
+    return std::function<void ()>([&, name] () {
+      std::unique_lock<std::mutex> lk(mutex);
+      started.emplace_back(name);
+      cv.wait(lk, [&open] () { return open; });
+    });
+  };
+
+  auto wait_for = [] (std::function<bool ()> fn) {
+    for (int i = 0; i < 10000 && !fn(); ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  };
+
+  /* the low priority task occupies the only low priority thread */
+  EXPECT_TRUE(executor.submit(Priority::LOW, task("low1")));
+  wait_for([&] () { return executor.numRunning(Priority::LOW) == 1; });
+  EXPECT_TRUE(executor.submit(Priority::LOW, task("low2")));
+  EXPECT_TRUE(executor.submit(Priority::LOW, task("low3")));
+  EXPECT_FALSE(executor.submit(Priority::LOW, task("low4")));
+  EXPECT_EQ(executor.queueLength(Priority::LOW), 2);
+  EXPECT_EQ(executor.numRejected(Priority::LOW), 1);
+
+  /* high priority tasks still get the other thread */
+  EXPECT_TRUE(executor.submit(Priority::HIGH, task("high1")));
+  wait_for([&] () { return executor.numRunning(Priority::HIGH) == 1; });
+  EXPECT_EQ(executor.numRunning(Priority::HIGH), 1);
+  EXPECT_EQ(executor.numRunning(Priority::LOW), 1);
+  EXPECT_TRUE(executor.submit(Priority::HIGH, task("high2")));
+  EXPECT_TRUE(executor.submit(Priority::HIGH, task("high3")));
+  EXPECT_FALSE(executor.submit(Priority::HIGH, task("high4")));
+  EXPECT_EQ(executor.queueLength(Priority::HIGH), 2);
+  EXPECT_EQ(executor.numRejected(Priority::HIGH), 1);
+
+  {
+    std::unique_lock<std::mutex> lk(mutex);
+    open = true;
+  }
+  cv.notify_all();
+
+  wait_for([&] () { return executor.queueLength(Priority::HIGH) == 0; });
+  EXPECT_TRUE(executor.submit(Priority::HIGH, [] () {
+    RAISE(kRuntimeError, "failed");
+  }));
+
+  wait_for([&] () {
+    return
+        executor.numExecuted(Priority::HIGH) == 4 &&
+        executor.numExecuted(Priority::LOW) == 3;
+  });
+
+  EXPECT_EQ(executor.numExecuted(Priority::HIGH), 4);
+  EXPECT_EQ(executor.numExecuted(Priority::LOW), 3);
+  EXPECT_EQ(executor.numFailed(Priority::HIGH), 1);
+  EXPECT_EQ(executor.numFailed(Priority::LOW), 0);
+  EXPECT_EQ(executor.queueLength(Priority::HIGH), 0);
+  EXPECT_EQ(executor.queueLength(Priority::LOW), 0);
+
+  EXPECT_EQ(started.size(), 6);
+
+  /* queued high priority tasks are started before low priority tasks */
+  {
+    SSTableScanExecutor single(1);
+    open = false;
+    started.clear();
+    EXPECT_TRUE(single.submit(Priority::LOW, task("low1")));
+    wait_for([&] () { return single.numRunning(Priority::LOW) == 1; });
+    EXPECT_TRUE(single.submit(Priority::LOW, task("low2")));
+    EXPECT_TRUE(single.submit(Priority::HIGH, task("high1")));
+    EXPECT_TRUE(single.submit(Priority::HIGH, task("high2")));
+
+    {
+      std::unique_lock<std::mutex> lk(mutex);
+      open = true;
+    }
+    cv.notify_all();
+  }
+
+  EXPECT_EQ(started.size(), 4);
+  EXPECT_EQ(started[0], "low1");
+  EXPECT_EQ(started[1], "high1");
+  EXPECT_EQ(started[2], "high2");
+  EXPECT_EQ(started[3], "low2");
+
+  /* a task that waits for a client that never reads gives up its thread
+     after the timeout, so the queued tasks still run */
+  {
+    std::atomic<bool> blocked_read(true);
+    std::atomic<bool> queued_ran(false);
+    {
+      SSTableScanExecutor single(1);
+      EXPECT_TRUE(single.submit(Priority::LOW, [&blocked_read] () {
+        blocked_read = waitWithTimeout([] () { return false; }, 50000);
+      }));
+      EXPECT_TRUE(single.submit(Priority::LOW, [&queued_ran] () {
+        queued_ran = true;
+      }));
+
+      wait_for([&] () { return queued_ran.load(); });
+    }
+
+    EXPECT_FALSE(blocked_read.load());
+    EXPECT_TRUE(queued_ran.load());
+
+    auto t0 = WallClock::unixMicros();
+    EXPECT_TRUE(waitWithTimeout([t0] () {
+      return WallClock::unixMicros() > t0 + 5000;
+    }, 1000000));
+  }
+
+  bool raised = false;
+  try {
+    SSTableScanExecutor invalid(0);
+  } catch (const std::exception& e) {
+    raised = true;
+  }
+  EXPECT_TRUE(raised);
+});
+
+TEST_CASE(SSTableTest, TestContinuationTokens, [] () {
+  FileUtil::rm("/tmp/__fnord__sstabletest26.sstable");
+  FileUtil::rm("/tmp/__fnord__sstabletest27.sstable");
+
+  SSTableColumnSchema schema;
+  schema.addColumn("value", 1, SSTableColumnType::UINT64);
+
+  /* a row-oriented and a columnar table with 5000 rows */
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest26.sstable",
+        header.data(),
+        header.size());
+
+    for (int i = 0; i < 5000; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i);
+
+      auto key = StringUtil::format("key$0", 10000 + i);
+      tbl->appendRow(key.data(), key.size(), cols.data(), cols.size());
+    }
+
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  {
+    std::string header = "myfnordyheader!";
+    auto tbl = SSTableWriter::create(
+        "/tmp/__fnord__sstabletest27.sstable",
+        header.data(),
+        header.size());
+
+    PAXWriter pax(tbl.get(), &schema, PAXWriter::kDefaultMaxBlockSize, 100);
+    for (int i = 0; i < 5000; ++i) {
+      SSTableColumnWriter cols(&schema);
+      cols.addUInt64Column(1, i);
+      pax.appendRow(StringUtil::format("key$0", 10000 + i), cols);
+    }
+
+    pax.flush();
+    schema.writeIndex(tbl.get());
+    tbl->commit();
+  }
+
+  for (int t = 26; t <= 27; ++t) {
+    auto path = StringUtil::format("/tmp/__fnord__sstabletest$0.sstable", t);
+    SSTableReader tbl(path);
+    SSTableColumnSchema schema2;
+    schema2.loadIndex(&tbl);
+
+    typedef Function<void (SSTableScan* scan)> ConfigFn;
+
+    /* run one page of the scan and return the continuation token */
+    auto run = [&] (
+        ConfigFn config,
+        long int limit,
+        const String& token,
+        Vector<String>* keys,
+        SSTableScanStats* stats) -> String {
+      SSTableScan scan(&schema2);
+      scan.setContinuationScope(path);
+      config(&scan);
+      if (limit > 0) {
+        scan.setLimit(limit);
+      }
+
+      if (!token.empty()) {
+        scan.setContinuationToken(token);
+      }
+
+      auto cursor = tbl.getCursor();
+      scan.execute(cursor.get(), [keys] (const Vector<String>& row) {
+        keys->emplace_back(row[0]);
+      });
+
+      *stats = scan.stats();
+      return scan.continuationToken();
+    };
+
+    /* paging through the scan returns the same rows as one scan */
+    auto check_pages = [&] (ConfigFn config, long int limit) {
+      Vector<String> expected;
+      SSTableScanStats stats;
+      EXPECT_TRUE(run(config, 0, "", &expected, &stats).empty());
+      EXPECT_TRUE(expected.size() > 0);
+
+      Vector<String> keys;
+      String token;
+      size_t num_pages = 0;
+      do {
+        Vector<String> page;
+        token = run(config, limit, token, &page, &stats);
+        EXPECT_TRUE(page.size() <= limit);
+        keys.insert(keys.end(), page.begin(), page.end());
+        ++num_pages;
+      } while (!token.empty() && num_pages < 10000);
+
+      EXPECT_EQ(keys.size(), expected.size());
+      EXPECT_TRUE(keys == expected);
+      EXPECT_TRUE(num_pages <= expected.size() / limit + 2);
+    };
+
+    auto filtered = [] (SSTableScan* scan) {
+      scan->addFilter(SSTableScanPredicate::parse("value >= 1000"));
+    };
+
+    check_pages(filtered, 100);
+
+    /* each page only reads its own rows */
+    {
+      Vector<String> keys;
+      SSTableScanStats stats;
+      auto token = run(filtered, 100, "", &keys, &stats);
+      EXPECT_EQ(stats.rows_scanned, 1100);
+      EXPECT_FALSE(token.empty());
+
+      for (int i = 0; i < 3; ++i) {
+        token = run(filtered, 100, token, &keys, &stats);
+        EXPECT_EQ(stats.rows_scanned, 100);
+        EXPECT_EQ(stats.rows_emitted, 100);
+      }
+
+      EXPECT_EQ(keys.size(), 400);
+      EXPECT_EQ(keys[0], "key11000");
+      EXPECT_EQ(keys[399], "key11399");
+    }
+
+    /* the offset only applies to the first page, so the same parameters
+       can be sent with each token */
+    check_pages([] (SSTableScan* scan) {
+      scan->addFilter(SSTableScanPredicate::parse("value >= 1000"));
+      scan->setOffset(250);
+    }, 100);
+
+    {
+      auto with_offset = [] (SSTableScan* scan) {
+        scan->setOffset(50);
+      };
+
+      Vector<String> keys;
+      SSTableScanStats stats;
+      auto token = run(with_offset, 10, "", &keys, &stats);
+      token = run(with_offset, 10, token, &keys, &stats);
+      EXPECT_EQ(keys.size(), 20);
+      EXPECT_EQ(keys[0], "key10050");
+      EXPECT_EQ(keys[10], "key10060");
+      EXPECT_EQ(keys[19], "key10069");
+    }
+
+    /* systematic samples select the same units across pages */
+    check_pages([] (SSTableScan* scan) {
+      scan->setSample(
+          0.1,
+          SSTableSampler::Method::SYSTEMATIC,
+          SSTableSampler::Unit::ROW,
+          3);
+    }, 7);
+
+    if (t == 27) {
+      check_pages([] (SSTableScan* scan) {
+        scan->setSample(
+            0.25,
+            SSTableSampler::Method::SYSTEMATIC,
+            SSTableSampler::Unit::BLOCK,
+            1);
+      }, 30);
+    }
+
+    /* a cancelled scan can be continued */
+    {
+      std::atomic<bool> cancelled(true);
+      SSTableScan scan(&schema2);
+      scan.setCancellationToken(&cancelled);
+      scan.setCheckInterval(1);
+
+      auto cursor = tbl.getCursor();
+      auto status = scan.execute(cursor.get(), [] (const Vector<String>& r) {});
+      EXPECT_TRUE(status == SSTableScanStatus::CANCELLED);
+      EXPECT_FALSE(scan.continuationToken().empty());
+
+      SSTableScan scan2(&schema2);
+      scan2.setContinuationToken(scan.continuationToken());
+      size_t n = 0;
+      auto cursor2 = tbl.getCursor();
+      scan2.execute(cursor2.get(), [&n] (const Vector<String>& r) { ++n; });
+      EXPECT_EQ(n, 5000);
+      EXPECT_TRUE(scan2.continuationToken().empty());
+    }
+
+    /* tokens are only accepted by the same scan */
+    {
+      Vector<String> keys;
+      SSTableScanStats stats;
+      auto token = run(filtered, 10, "", &keys, &stats);
+
+      bool raised = false;
+      try {
+        run([] (SSTableScan* scan) {}, 10, token, &keys, &stats);
+      } catch (const std::exception& e) {
+        raised = true;
+      }
+      EXPECT_TRUE(raised);
+
+      raised = false;
+      try {
+        SSTableScan scan(&schema2);
+        scan.setContinuationToken("xyz");
+      } catch (const std::exception& e) {
+        raised = true;
+      }
+      EXPECT_TRUE(raised);
+
+      raised = false;
+      try {
+        SSTableScan scan(&schema2);
+        scan.setContinuationScope(path);
+        filtered(&scan);
+        scan.setOrderBy("value", "NUMASC");
+        scan.setContinuationToken(token);
+        auto cursor = tbl.getCursor();
+        scan.execute(cursor.get(), [] (const Vector<String>& r) {});
+      } catch (const std::exception& e) {
+        raised = true;
+      }
+      EXPECT_TRUE(raised);
+    }
+
+    /* tokens are authenticated with the secret, so a client can't change
+       the position in a token */
+    {
+      auto with_secret = [filtered] (SSTableScan* scan) {
+        filtered(scan);
+        scan->setContinuationSecret("secret");
+      };
+
+      auto other_secret = [filtered] (SSTableScan* scan) {
+        filtered(scan);
+        scan->setContinuationSecret("other secret");
+      };
+
+      Vector<String> keys;
+      SSTableScanStats stats;
+      auto token = run(with_secret, 10, "", &keys, &stats);
+      run(with_secret, 10, token, &keys, &stats);
+      EXPECT_EQ(keys.size(), 20);
+      EXPECT_EQ(keys[10], "key11010");
+
+      bool raised = false;
+      try {
+        run(other_secret, 10, token, &keys, &stats);
+      } catch (const std::exception& e) {
+        raised = true;
+      }
+      EXPECT_TRUE(raised);
+
+      /* the position follows the version and the fingerprint */
+      auto forged = token;
+      forged[18] = forged[18] == '0' ? '1' : '0';
+      raised = false;
+      try {
+        run(with_secret, 10, forged, &keys, &stats);
+      } catch (const std::exception& e) {
+        raised = true;
+      }
+      EXPECT_TRUE(raised);
+
+      raised = false;
+      try {
+        run(with_secret, 10, token.substr(0, 16), &keys, &stats);
+      } catch (const std::exception& e) {
+        raised = true;
+      }
+      EXPECT_TRUE(raised);
+      EXPECT_EQ(keys.size(), 20);
+    }
+  }
+});
+
+TEST_CASE(SSTableTest, TestSipHash, [] () {
+  /* test vectors from the SipHash paper */
+  String key;
+  String message;
+  for (int i = 0; i < 16; ++i) {
+    key += (char) i;
+    message += (char) i;
+  }
+
+  SSTableSipHash siphash(key);
+  EXPECT_EQ(siphash.hash(message.data(), 0), 0x726fdb47dd0e0e31ull);
+  EXPECT_EQ(siphash.hash(message.data(), 8), 0x93f5f5799a932462ull);
+  EXPECT_EQ(siphash.hash(message.data(), 15), 0xa129ca6149be45e5ull);
+
+  auto a = SSTableSipHash::fromSecret("secret");
+  auto b = SSTableSipHash::fromSecret("secret");
+  auto c = SSTableSipHash::fromSecret("secret2");
+  EXPECT_EQ(a.hash("fnord", 5), b.hash("fnord", 5));
+  EXPECT_TRUE(a.hash("fnord", 5) != c.hash("fnord", 5));
+
+  bool raised = false;
+  try {
+    SSTableSipHash short_key("fnord");
+  } catch (const Exception& e) {
+    raised = true;
+  }
+
+  EXPECT_TRUE(raised);
+});
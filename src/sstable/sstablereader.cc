@@ -14,6 +14,7 @@
 #include <sstable/binaryformat.h>
 #include <sstable/binaryformat.h>
 #include <sstable/sstablereader.h>
+#include <sstable/PAXCursor.h>
 
 namespace stx {
 namespace sstable {
@@ -82,19 +83,53 @@ Buffer SSTableReader::readFooter(uint32_t type) {
   RAISE(kNotFoundError, "footer not found");
 }
 
-std::unique_ptr<SSTableReader::SSTableReaderCursor> SSTableReader::getCursor() {
+bool SSTableReader::hasFooter(uint32_t type) {
+  is_->seekTo(header_.headerSize() + header_.bodySize());
+
+  while (!is_->eof()) {
+    BinaryFormat::FooterHeader footer_header;
+    is_->readNextBytes(&footer_header, sizeof(footer_header));
+
+    if (footer_header.magic != BinaryFormat::kMagicBytes) {
+      RAISE(kIllegalStateError, "corrupt sstable footer");
+    }
+
+    if (footer_header.type == type) {
+      return true;
+    }
+
+    is_->skipNextBytes(footer_header.footer_size);
+  }
+
+  return false;
+}
+
+std::unique_ptr<Cursor> SSTableReader::getCursor() {
+  if (header_.isColumnar()) {
+    auto cursor = new PAXCursor(
+        is_,
+        header_.headerSize(),
+        header_.headerSize() + header_.bodySize());
+
+    return std::unique_ptr<Cursor>(cursor);
+  }
+
   auto cursor = new SSTableReaderCursor(
       is_,
       header_.headerSize(),
       header_.headerSize() + header_.bodySize());
 
-  return std::unique_ptr<SSTableReaderCursor>(cursor);
+  return std::unique_ptr<Cursor>(cursor);
 }
 
 bool SSTableReader::isFinalized() const {
   return header_.isFinalized();
 }
 
+bool SSTableReader::isColumnar() const {
+  return header_.isColumnar();
+}
+
 size_t SSTableReader::bodySize() const {
   return header_.bodySize();
 }
@@ -66,14 +66,20 @@ public:
   SSTableReader& operator=(const SSTableReader& other) = delete;
 
   /**
-   * Get an sstable cursor for the body of this sstable
+   * Get an sstable cursor for the body of this sstable. On columnar tables
+   * this returns a PAXCursor that iterates the rows stored in the blocks
    */
-  std::unique_ptr<SSTableReaderCursor> getCursor();
+  std::unique_ptr<Cursor> getCursor();
 
   Buffer readHeader();
   void readFooter(uint32_t type, void** data, size_t* size);
   Buffer readFooter(uint32_t type);
 
+  /**
+   * Returns true iff the sstable contains a footer of the provided type
+   */
+  bool hasFooter(uint32_t type);
+
   /**
    * Returns the body size in bytes
    */
@@ -84,6 +90,11 @@ public:
    */
   bool isFinalized() const;
 
+  /**
+   * Returns true iff the table body is stored in the columnar (PAX) layout
+   */
+  bool isColumnar() const;
+
   /**
    * Returns the body offset (the position of the first body byte in the file)
    */